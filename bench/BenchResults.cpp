@@ -0,0 +1,408 @@
+#include "BenchResults.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+std::string Quote(const std::string &text)
+{
+    std::string quoted = "\"";
+
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+
+    return quoted + "\"";
+}
+
+std::string Number(double value)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f", value);
+    return text;
+}
+
+// Just enough JSON for the documents written above
+struct JsonValue
+{
+    enum class Type
+    {
+        Null,
+        Boolean,
+        Number,
+        String,
+        Array,
+        Object,
+    };
+
+    Type type = Type::Null;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> items;
+    // Object members, keys[i] names items[i]
+    std::vector<std::string> keys;
+
+    const JsonValue *Find(const std::string &key) const
+    {
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            if (keys[i] == key)
+            {
+                return &items[i];
+            }
+        }
+
+        return nullptr;
+    }
+};
+
+class JsonParser
+{
+public:
+    JsonParser(const std::string &text) : m_Text(text), m_Offset(0)
+    {
+    }
+
+    JsonValue Parse()
+    {
+        JsonValue value = ParseValue();
+        SkipSpaces();
+
+        if (m_Offset != m_Text.size())
+        {
+            Fail("trailing characters");
+        }
+
+        return value;
+    }
+
+private:
+    [[noreturn]] void Fail(const std::string &what) const
+    {
+        throw std::runtime_error("Malformed JSON at offset " + std::to_string(m_Offset) + ": " + what);
+    }
+
+    void SkipSpaces()
+    {
+        while (m_Offset < m_Text.size() && (m_Text[m_Offset] == ' ' || m_Text[m_Offset] == '\n' ||
+                                            m_Text[m_Offset] == '\r' || m_Text[m_Offset] == '\t'))
+        {
+            m_Offset++;
+        }
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpaces();
+
+        if (m_Offset < m_Text.size() && m_Text[m_Offset] == c)
+        {
+            m_Offset++;
+            return true;
+        }
+
+        return false;
+    }
+
+    void Expect(char c)
+    {
+        if (!Consume(c))
+        {
+            Fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    bool ConsumeWord(const char *word)
+    {
+        std::string expected = word;
+
+        if (m_Text.compare(m_Offset, expected.size(), expected) == 0)
+        {
+            m_Offset += expected.size();
+            return true;
+        }
+
+        return false;
+    }
+
+    JsonValue ParseValue()
+    {
+        SkipSpaces();
+
+        if (m_Offset >= m_Text.size())
+        {
+            Fail("unexpected end");
+        }
+
+        JsonValue value;
+        char c = m_Text[m_Offset];
+
+        if (c == '{')
+        {
+            value.type = JsonValue::Type::Object;
+            m_Offset++;
+
+            if (!Consume('}'))
+            {
+                do
+                {
+                    SkipSpaces();
+                    value.keys.push_back(ParseString());
+                    Expect(':');
+                    value.items.push_back(ParseValue());
+                } while (Consume(','));
+
+                Expect('}');
+            }
+        }
+        else if (c == '[')
+        {
+            value.type = JsonValue::Type::Array;
+            m_Offset++;
+
+            if (!Consume(']'))
+            {
+                do
+                {
+                    value.items.push_back(ParseValue());
+                } while (Consume(','));
+
+                Expect(']');
+            }
+        }
+        else if (c == '"')
+        {
+            value.type = JsonValue::Type::String;
+            value.string = ParseString();
+        }
+        else if (ConsumeWord("true"))
+        {
+            value.type = JsonValue::Type::Boolean;
+            value.number = 1.0;
+        }
+        else if (ConsumeWord("false"))
+        {
+            value.type = JsonValue::Type::Boolean;
+        }
+        else if (ConsumeWord("null"))
+        {
+            value.type = JsonValue::Type::Null;
+        }
+        else
+        {
+            const char *start = m_Text.c_str() + m_Offset;
+            char *end;
+            value.type = JsonValue::Type::Number;
+            value.number = std::strtod(start, &end);
+
+            if (end == start)
+            {
+                Fail("unexpected character");
+            }
+
+            m_Offset += end - start;
+        }
+
+        return value;
+    }
+
+    std::string ParseString()
+    {
+        if (m_Offset >= m_Text.size() || m_Text[m_Offset] != '"')
+        {
+            Fail("expected a string");
+        }
+
+        std::string text;
+        m_Offset++;
+
+        while (m_Offset < m_Text.size() && m_Text[m_Offset] != '"')
+        {
+            char c = m_Text[m_Offset++];
+
+            if (c == '\\' && m_Offset < m_Text.size())
+            {
+                char escaped = m_Text[m_Offset++];
+
+                if (escaped == 'u' && m_Offset + 4 <= m_Text.size())
+                {
+                    // Only the control characters written by Quote
+                    c = static_cast<char>(std::strtol(m_Text.substr(m_Offset, 4).c_str(), nullptr, 16));
+                    m_Offset += 4;
+                }
+                else
+                {
+                    c = escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped;
+                }
+            }
+
+            text += c;
+        }
+
+        if (m_Offset >= m_Text.size())
+        {
+            Fail("unterminated string");
+        }
+
+        m_Offset++;
+        return text;
+    }
+
+    const std::string &m_Text;
+    std::size_t m_Offset;
+};
+
+const JsonValue &Member(const JsonValue &object, const std::string &key, JsonValue::Type type)
+{
+    const JsonValue *value = object.Find(key);
+
+    if (!value || value->type != type)
+    {
+        throw std::runtime_error("Missing or invalid '" + key + "' in the benchmark results");
+    }
+
+    return *value;
+}
+
+void CheckMetric(std::vector<BenchRegression> &regressions, const BenchResult &result, const char *metric,
+                 double baseline, double current, bool higherIsBetter, double threshold)
+{
+    if (baseline <= 0.0)
+    {
+        return;
+    }
+
+    double percent = (current - baseline) * 100.0 / baseline;
+
+    if (higherIsBetter)
+    {
+        percent = -percent;
+    }
+
+    if (percent > threshold)
+    {
+        regressions.push_back({result.rom, result.config, metric, baseline, current, percent});
+    }
+}
+} // namespace
+
+void WriteBenchJson(std::ostream &stream, const BenchRun &run, bool compact)
+{
+    const char *newline = compact ? "" : "\n";
+    const char *indent = compact ? "" : "  ";
+    const char *entryIndent = compact ? "" : "    ";
+    const char *space = compact ? "" : " ";
+
+    stream << "{" << newline;
+    stream << indent << "\"format\":" << space << "\"nesemu-bench\"," << newline;
+    stream << indent << "\"version\":" << space << 1 << "," << newline;
+    stream << indent << "\"timestamp\":" << space << Quote(run.timestamp) << "," << newline;
+    stream << indent << "\"frames\":" << space << run.frames << "," << newline;
+    stream << indent << "\"repeat\":" << space << run.repeat << "," << newline;
+    stream << indent << "\"results\":" << space << "[" << newline;
+
+    for (std::size_t i = 0; i < run.results.size(); i++)
+    {
+        const BenchResult &result = run.results[i];
+        stream << entryIndent << "{\"rom\":" << space << Quote(result.rom) << "," << space
+               << "\"config\":" << space << Quote(result.config) << "," << space
+               << "\"frames_per_second\":" << space << Number(result.framesPerSecond) << "," << space
+               << "\"ns_per_instruction\":" << space << Number(result.nsPerInstruction) << "," << space
+               << "\"instructions\":" << space << result.instructions << "," << space
+               << "\"peak_rss_kib\":" << space << result.peakRssKiB << "," << space
+               << "\"startup_ms\":" << space << Number(result.startupMs) << "}"
+               << (i + 1 < run.results.size() ? "," : "") << newline;
+    }
+
+    stream << indent << "]" << newline << "}" << "\n";
+}
+
+BenchRun ReadBenchJson(const std::string &path)
+{
+    std::ifstream file(path);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    JsonValue document = JsonParser(text).Parse();
+
+    if (document.type != JsonValue::Type::Object ||
+        Member(document, "format", JsonValue::Type::String).string != "nesemu-bench")
+    {
+        throw std::runtime_error("'" + path + "' does not hold benchmark results");
+    }
+
+    BenchRun run;
+    run.timestamp = Member(document, "timestamp", JsonValue::Type::String).string;
+    run.frames = static_cast<long>(Member(document, "frames", JsonValue::Type::Number).number);
+    run.repeat = static_cast<int>(Member(document, "repeat", JsonValue::Type::Number).number);
+
+    for (const JsonValue &entry : Member(document, "results", JsonValue::Type::Array).items)
+    {
+        if (entry.type != JsonValue::Type::Object)
+        {
+            throw std::runtime_error("Invalid entry in '" + path + "'");
+        }
+
+        BenchResult result;
+        result.rom = Member(entry, "rom", JsonValue::Type::String).string;
+        result.config = Member(entry, "config", JsonValue::Type::String).string;
+        result.framesPerSecond = Member(entry, "frames_per_second", JsonValue::Type::Number).number;
+        result.nsPerInstruction = Member(entry, "ns_per_instruction", JsonValue::Type::Number).number;
+        result.instructions =
+            static_cast<std::uint64_t>(Member(entry, "instructions", JsonValue::Type::Number).number);
+        result.peakRssKiB = static_cast<std::uint64_t>(Member(entry, "peak_rss_kib", JsonValue::Type::Number).number);
+        result.startupMs = Member(entry, "startup_ms", JsonValue::Type::Number).number;
+        run.results.push_back(result);
+    }
+
+    return run;
+}
+
+std::vector<BenchRegression> CompareBench(const BenchRun &baseline, const BenchRun &current, double threshold)
+{
+    std::vector<BenchRegression> regressions;
+
+    for (const BenchResult &result : current.results)
+    {
+        for (const BenchResult &reference : baseline.results)
+        {
+            if (reference.rom != result.rom || reference.config != result.config)
+            {
+                continue;
+            }
+
+            CheckMetric(regressions, result, "frames_per_second", reference.framesPerSecond,
+                        result.framesPerSecond, true, threshold);
+            CheckMetric(regressions, result, "ns_per_instruction", reference.nsPerInstruction,
+                        result.nsPerInstruction, false, threshold);
+            CheckMetric(regressions, result, "peak_rss_kib", static_cast<double>(reference.peakRssKiB),
+                        static_cast<double>(result.peakRssKiB), false, threshold);
+            break;
+        }
+    }
+
+    return regressions;
+}
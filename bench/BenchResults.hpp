@@ -0,0 +1,60 @@
+#ifndef BENCH_RESULTS_HPP
+#define BENCH_RESULTS_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*
+   Results of nesemu-bench
+
+   A run is written as a JSON document holding the settings and one entry
+   per rom and configuration, the same document appended on a single line
+   to a history file keeps the runs over time. Baselines are previous
+   documents, an entry is compared with the baseline entry of the same rom
+   and configuration
+ */
+struct BenchResult
+{
+    std::string rom;
+    std::string config;
+    double framesPerSecond = 0.0;
+    double nsPerInstruction = 0.0;
+    std::uint64_t instructions = 0;
+    std::uint64_t peakRssKiB = 0;
+    double startupMs = 0.0;
+};
+
+struct BenchRun
+{
+    std::string timestamp;
+    long frames = 0;
+    int repeat = 0;
+    std::vector<BenchResult> results;
+};
+
+// Pretty printed, or on a single line for the history files
+void WriteBenchJson(std::ostream &stream, const BenchRun &run, bool compact);
+// Throws std::runtime_error when the document is not a run written by WriteBenchJson
+BenchRun ReadBenchJson(const std::string &path);
+
+struct BenchRegression
+{
+    std::string rom;
+    std::string config;
+    std::string metric;
+    double baseline;
+    double current;
+    // Relative change, positive when worse
+    double percent;
+};
+
+/*
+   Metrics worse than the baseline by more than the threshold in percent:
+   lower frames per second, higher ns per instruction or peak RSS. The
+   startup time is too short to be compared reliably
+ */
+std::vector<BenchRegression> CompareBench(const BenchRun &baseline, const BenchRun &current, double threshold);
+
+#endif
@@ -0,0 +1,588 @@
+/*
+   Corpus benchmark
+
+   Runs every rom of a corpus for a fixed amount of frames under each
+   configuration and reports the emulation speed as JSON
+
+   nesemu-bench <corpus> [--frames N] [--repeat N] [--config spec]... [--output file.json]
+                [--history file.jsonl] [--baseline file.json [--threshold percent]]
+                [--coverage directory]
+   nesemu-bench make-movie <rom> <movie> <frames> [seed]
+
+   The corpus is a .nes file or a list with one `rom [movie]` per line,
+   paths relative to the list and # starting a comment. The inputs come
+   from the movie, the controllers stay released without one. make-movie
+   records a movie of random presses with a regular Start so that the
+   title screens are left, enough to get a game to do some work.
+
+   A configuration is a comma separated list of interp=plain|cache,
+   render=on|off, audio=on|off and threads=N, the unspecified settings
+   keeping their default (plain, on, on, 1). Without --config a plain,
+   code cache, no render, no audio and a 4 threads configuration run.
+   threads=N runs N instances of the rom at once and reports their
+   combined frames per second.
+
+   Every run is repeated (3 times by default) and the fastest one is kept.
+   The results are printed as a table, written to --output and appended
+   on a line to --history. Compared with --baseline, the metrics worse by
+   more than --threshold percent (5 by default) are listed and the exit
+   code is 1.
+
+   --coverage records which PRG bytes the run of every rom executes or
+   reads, see CoverageMap, into <rom>.cdl in the directory and prints the
+   shares. The code cache configurations then also decode the code found
+   that way, the results are not comparable with runs without it
+ */
+
+#include "BenchResults.hpp"
+#include "src/Cartridge.hpp"
+#include "src/Controller.hpp"
+#include "src/Movie.hpp"
+#include "src/Nes.hpp"
+#include "src/Cpu/CodeCache.hpp"
+#include "src/Cpu/CoverageMap.hpp"
+#include "src/Cpu/CpuProfiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Config
+{
+    std::string name;
+    bool codeCache = false;
+    bool render = true;
+    bool audio = true;
+    int threads = 1;
+};
+
+struct Entry
+{
+    std::string rom;
+    std::optional<Movie> movie;
+};
+
+struct Measure
+{
+    double seconds;
+    double startupSeconds;
+};
+
+bool ParseSwitch(const std::string &value, const std::string &key)
+{
+    if (value != "on" && value != "off")
+    {
+        throw std::runtime_error("'" + key + "' is either on or off");
+    }
+
+    return value == "on";
+}
+
+Config ParseConfig(const std::string &spec)
+{
+    Config config;
+    std::stringstream stream(spec);
+    std::string setting;
+
+    while (std::getline(stream, setting, ','))
+    {
+        std::size_t equal = setting.find('=');
+        std::string key = setting.substr(0, equal);
+        std::string value = equal == std::string::npos ? "" : setting.substr(equal + 1);
+
+        if (key == "interp" && (value == "plain" || value == "cache"))
+        {
+            config.codeCache = value == "cache";
+        }
+        else if (key == "render")
+        {
+            config.render = ParseSwitch(value, key);
+        }
+        else if (key == "audio")
+        {
+            config.audio = ParseSwitch(value, key);
+        }
+        else if (key == "threads" && std::atoi(value.c_str()) > 0)
+        {
+            config.threads = std::atoi(value.c_str());
+        }
+        else
+        {
+            throw std::runtime_error("Invalid configuration setting '" + setting + "'");
+        }
+    }
+
+    // Canonical so that the baselines match whatever the spelling
+    config.name = std::string("interp=") + (config.codeCache ? "cache" : "plain") +
+                  ",render=" + (config.render ? "on" : "off") + ",audio=" + (config.audio ? "on" : "off") +
+                  ",threads=" + std::to_string(config.threads);
+    return config;
+}
+
+Movie LoadMovie(const std::string &path, const std::string &rom)
+{
+    Movie movie = Movie::Load(path);
+
+    if (movie.GetRomHash() != 0)
+    {
+        Nes nes;
+        nes.LoadRom(rom);
+
+        if (movie.GetRomHash() != CodeCache::Hash(*nes.GetCartridge()))
+        {
+            throw std::runtime_error("'" + path + "' was recorded on another rom than '" + rom + "'");
+        }
+    }
+
+    return movie;
+}
+
+std::vector<Entry> LoadCorpus(const std::string &path)
+{
+    if (std::filesystem::path(path).extension() == ".nes")
+    {
+        return {Entry{path, std::nullopt}};
+    }
+
+    std::ifstream file(path);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open the corpus '" + path + "'");
+    }
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::vector<Entry> corpus;
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        std::stringstream stream(line.substr(0, line.find('#')));
+        std::string rom;
+        std::string movie;
+
+        if (!(stream >> rom))
+        {
+            continue;
+        }
+
+        Entry entry{(directory / rom).string(), std::nullopt};
+
+        if (stream >> movie)
+        {
+            entry.movie = LoadMovie((directory / movie).string(), entry.rom);
+        }
+
+        corpus.push_back(std::move(entry));
+    }
+
+    if (corpus.empty())
+    {
+        throw std::runtime_error("The corpus '" + path + "' lists no rom");
+    }
+
+    return corpus;
+}
+
+void ApplyInput(Nes &nes, const Entry &entry, std::size_t frame)
+{
+    if (entry.movie)
+    {
+        entry.movie->Apply(nes, frame);
+    }
+}
+
+/*
+   The emulation is deterministic, every configuration runs the same
+   instructions. With a coverage directory the bytes the run touched are
+   saved there and extend the code cache analysis
+ */
+std::uint64_t CountInstructions(const Entry &entry, long frames, const std::string &coverageDirectory,
+                                const std::string &cacheDirectory)
+{
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.SetRenderFrame(false);
+    nes.LoadRom(entry.rom);
+
+    CpuProfiler profiler;
+    nes.SetProfiler(&profiler);
+
+    CoverageMap coverage(*nes.GetCartridge());
+
+    if (!coverageDirectory.empty())
+    {
+        nes.SetCoverageMap(&coverage);
+    }
+
+    for (long frame = 0; frame < frames; frame++)
+    {
+        ApplyInput(nes, entry, frame);
+        nes.StepFrame();
+    }
+
+    if (!coverageDirectory.empty())
+    {
+        std::filesystem::path path = coverageDirectory;
+        std::filesystem::create_directories(path);
+        coverage.SaveCdl((path / std::filesystem::path(entry.rom).stem()).string() + ".cdl");
+        nes.LoadCodeCache(cacheDirectory, &coverage);
+
+        CoverageMap::Summary summary = coverage.Summarize();
+        double size = static_cast<double>(coverage.GetSize());
+        std::printf("# %s: %.1f%% code, %.1f%% data, %.1f%% untouched\n",
+                    std::filesystem::path(entry.rom).filename().string().c_str(),
+                    (summary.opcodes + summary.operands) * 100.0 / size, summary.data * 100.0 / size,
+                    summary.untouched * 100.0 / size);
+    }
+
+    return profiler.GetInstructionCount();
+}
+
+Measure RunInstance(const Entry &entry, const Config &config, long frames, const std::string &cacheDirectory)
+{
+    Clock::time_point start = Clock::now();
+
+    Nes nes;
+    nes.SetAudioEnabled(config.audio);
+    nes.LoadRom(entry.rom);
+
+    if (config.codeCache)
+    {
+        nes.LoadCodeCache(cacheDirectory);
+    }
+
+    nes.SetRenderFrame(config.render);
+    Clock::time_point ready = Clock::now();
+
+    // What a front end would do with the sound
+    std::int16_t samples[4096];
+
+    for (long frame = 0; frame < frames; frame++)
+    {
+        ApplyInput(nes, entry, frame);
+        nes.StepFrame();
+
+        while (config.audio && nes.ReadAudio(samples, std::size(samples)) > 0)
+        {
+        }
+    }
+
+    Clock::time_point end = Clock::now();
+    return {std::chrono::duration<double>(end - ready).count(), std::chrono::duration<double>(ready - start).count()};
+}
+
+void ResetPeakRss()
+{
+#ifdef __linux__
+    // Resets VmHWM, refused by old kernels in which case the peak only grows
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+std::uint64_t GetPeakRssKiB()
+{
+#ifdef __linux__
+    std::ifstream status("/proc/self/status");
+    std::string line;
+
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+        {
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+    }
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+BenchResult Benchmark(const Entry &entry, const Config &config, long frames, int repeat, std::uint64_t instructions,
+                    const std::string &cacheDirectory)
+{
+    BenchResult result;
+    result.rom = std::filesystem::path(entry.rom).filename().string();
+    result.config = config.name;
+    result.instructions = instructions;
+
+    for (int run = 0; run < repeat; run++)
+    {
+        ResetPeakRss();
+        std::vector<Measure> measures(config.threads);
+        std::vector<std::thread> threads;
+
+        for (int thread = 0; thread < config.threads; thread++)
+        {
+            threads.emplace_back([&, thread] {
+                measures[thread] = RunInstance(entry, config, frames, cacheDirectory);
+            });
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        double slowest = 0.0;
+        double seconds = 0.0;
+        double startup = 0.0;
+
+        for (const Measure &measure : measures)
+        {
+            slowest = std::max(slowest, measure.seconds);
+            seconds += measure.seconds / config.threads;
+            startup += measure.startupSeconds / config.threads;
+        }
+
+        double framesPerSecond = frames * config.threads / slowest;
+
+        if (framesPerSecond > result.framesPerSecond)
+        {
+            result.framesPerSecond = framesPerSecond;
+            result.nsPerInstruction = instructions ? seconds * 1e9 / instructions : 0.0;
+            result.startupMs = startup * 1e3;
+            result.peakRssKiB = GetPeakRssKiB();
+        }
+    }
+
+    return result;
+}
+
+std::string Timestamp()
+{
+    std::time_t now = std::time(nullptr);
+    char text[32];
+    std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    return text;
+}
+
+int MakeMovie(const std::string &rom, const std::string &path, long frames, unsigned long seed)
+{
+    Nes nes;
+    nes.LoadRom(rom);
+
+    Movie movie(CodeCache::Hash(*nes.GetCartridge()));
+    std::mt19937 random(seed);
+    constexpr Word Directions[] = {Controller::Up, Controller::Down, Controller::Left, Controller::Right, 0x00};
+    Word held = 0x00;
+    long release = 0;
+
+    for (long frame = 0; frame < frames; frame++)
+    {
+        if (frame >= release)
+        {
+            held = Directions[random() % std::size(Directions)] | (random() % 2 ? Controller::A : 0x00) |
+                   (random() % 3 ? 0x00 : Controller::B);
+            release = frame + 10 + random() % 30;
+        }
+
+        // Start pressed a few frames every 2 seconds
+        movie.Record(frame % 120 < 4 ? static_cast<Word>(Controller::Start) : held, 0x00);
+    }
+
+    movie.Save(path);
+    std::cout << frames << " frames recorded to " << path << std::endl;
+    return 0;
+}
+
+int Usage()
+{
+    std::cerr << "usage: nesemu-bench <corpus> [--frames N] [--repeat N] [--config spec]... [--output file.json] "
+                 "[--history file.jsonl] [--baseline file.json [--threshold percent]] [--coverage directory]\n"
+                 "       nesemu-bench make-movie <rom> <movie> <frames> [seed]"
+              << std::endl;
+    return 2;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        return Usage();
+    }
+
+    try
+    {
+        if (std::string(argv[1]) == "make-movie")
+        {
+            if (argc < 5)
+            {
+                return Usage();
+            }
+
+            return MakeMovie(argv[2], argv[3], std::strtol(argv[4], nullptr, 10),
+                             argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 1);
+        }
+
+        long frames = 600;
+        int repeat = 3;
+        double threshold = 5.0;
+        std::vector<Config> configs;
+        std::string output;
+        std::string history;
+        std::string baseline;
+        std::string coverage;
+
+        for (int i = 2; i < argc; i++)
+        {
+            std::string option = argv[i];
+
+            if (option == "--frames" && i + 1 < argc)
+            {
+                frames = std::max(1L, std::strtol(argv[++i], nullptr, 10));
+            }
+            else if (option == "--repeat" && i + 1 < argc)
+            {
+                repeat = std::max(1, std::atoi(argv[++i]));
+            }
+            else if (option == "--config" && i + 1 < argc)
+            {
+                configs.push_back(ParseConfig(argv[++i]));
+            }
+            else if (option == "--output" && i + 1 < argc)
+            {
+                output = argv[++i];
+            }
+            else if (option == "--history" && i + 1 < argc)
+            {
+                history = argv[++i];
+            }
+            else if (option == "--baseline" && i + 1 < argc)
+            {
+                baseline = argv[++i];
+            }
+            else if (option == "--threshold" && i + 1 < argc)
+            {
+                threshold = std::strtod(argv[++i], nullptr);
+            }
+            else if (option == "--coverage" && i + 1 < argc)
+            {
+                coverage = argv[++i];
+            }
+            else
+            {
+                return Usage();
+            }
+        }
+
+        if (configs.empty())
+        {
+            for (const char *spec : {"interp=plain", "interp=cache", "render=off", "audio=off", "threads=4"})
+            {
+                configs.push_back(ParseConfig(spec));
+            }
+        }
+
+        std::vector<Entry> corpus = LoadCorpus(argv[1]);
+        std::string cacheDirectory = (std::filesystem::temp_directory_path() / "nesemu-bench-cache").string();
+
+        BenchRun run;
+        run.timestamp = Timestamp();
+        run.frames = frames;
+        run.repeat = repeat;
+
+        std::printf("%-24s %-44s %10s %10s %10s %11s\n", "rom", "config", "frames/s", "ns/instr", "rss KiB",
+                    "startup ms");
+
+        for (const Entry &entry : corpus)
+        {
+            std::uint64_t instructions = CountInstructions(entry, frames, coverage, cacheDirectory);
+
+            // Analyzed once up front, the timed instances only load it
+            auto cached = [](const Config &config) { return config.codeCache; };
+
+            if (coverage.empty() && std::any_of(configs.begin(), configs.end(), cached))
+            {
+                Nes nes;
+                nes.LoadRom(entry.rom);
+                nes.LoadCodeCache(cacheDirectory);
+            }
+
+            for (const Config &config : configs)
+            {
+                BenchResult result = Benchmark(entry, config, frames, repeat, instructions, cacheDirectory);
+                std::printf("%-24s %-44s %10.1f %10.2f %10llu %11.2f\n", result.rom.c_str(), result.config.c_str(),
+                            result.framesPerSecond, result.nsPerInstruction,
+                            static_cast<unsigned long long>(result.peakRssKiB), result.startupMs);
+                std::fflush(stdout);
+                run.results.push_back(result);
+            }
+        }
+
+        if (!output.empty())
+        {
+            std::ofstream file(output);
+            WriteBenchJson(file, run, false);
+
+            if (!file)
+            {
+                throw std::runtime_error("Could not write '" + output + "'");
+            }
+        }
+
+        if (!history.empty())
+        {
+            std::ofstream file(history, std::ios::app);
+            WriteBenchJson(file, run, true);
+
+            if (!file)
+            {
+                throw std::runtime_error("Could not append to '" + history + "'");
+            }
+        }
+
+        if (!baseline.empty())
+        {
+            std::vector<BenchRegression> regressions = CompareBench(ReadBenchJson(baseline), run, threshold);
+
+            for (const BenchRegression &regression : regressions)
+            {
+                std::printf("REGRESSION %s %s %s: %.2f -> %.2f (%.1f%% worse)\n", regression.rom.c_str(),
+                            regression.config.c_str(), regression.metric.c_str(), regression.baseline,
+                            regression.current, regression.percent);
+            }
+
+            std::printf("%zu regressions beyond %.1f%% against %s\n", regressions.size(), threshold,
+                        baseline.c_str());
+            return regressions.empty() ? 0 : 1;
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+   CPU interpreter micro-benchmark
+
+   Runs a tight loop made of the instructions of each opcode group out of
+   a flat 64 KiB memory and reports the emulated instructions per second
+
+   nesemu-cpu-bench [instructions per group] [--profile]
+
+   --profile attaches a CpuProfiler and prints its report after each group
+ */
+
+#include "src/MemoryMap.hpp"
+#include "src/Cpu/Cpu.hpp"
+#include "src/Cpu/CpuProfiler.hpp"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Flat 64 KiB memory
+struct Machine : MemoryHandler
+{
+    std::array<Word, 0x10000> ram{};
+    MemoryMap memory{*this};
+    Cpu cpu{memory};
+
+    Machine()
+    {
+        memory.MapRead(0, MemoryMap::s_PageCount, ram.data());
+        memory.MapWrite(0, MemoryMap::s_PageCount, ram.data());
+    }
+
+    Word Read(DWord) override
+    {
+        return 0x00;
+    }
+
+    void Write(DWord, Word) override
+    {
+    }
+};
+
+struct Group
+{
+    const char *name;
+    // Loop body assembled at $8000, it must end by jumping back to $8000
+    std::vector<Word> program;
+};
+
+std::vector<Group> Groups()
+{
+    constexpr Word JMP = 0x4C;
+
+    return {
+        {"load/store",
+         {0xA9, 0x01, 0xA6, 0x10, 0xBC, 0x00, 0x02, 0x85, 0x20, 0x8E, 0x00, 0x03, 0x84, 0x30, 0xB1, 0x40, JMP, 0x00,
+          0x80}},
+        {"arithmetic", {0x18, 0x69, 0x01, 0xE5, 0x10, 0x7D, 0x00, 0x02, 0xF1, 0x40, JMP, 0x00, 0x80}},
+        {"logic", {0x29, 0x0F, 0x05, 0x10, 0x5D, 0x00, 0x02, 0x24, 0x20, JMP, 0x00, 0x80}},
+        {"shift/rotate", {0x0A, 0x46, 0x10, 0x3E, 0x00, 0x02, 0x6A, JMP, 0x00, 0x80}},
+        {"compare", {0xC9, 0x10, 0xE4, 0x10, 0xC0, 0x20, 0xDD, 0x00, 0x02, JMP, 0x00, 0x80}},
+        {"increment/decrement", {0xE8, 0x88, 0xE6, 0x10, 0xDE, 0x00, 0x02, JMP, 0x00, 0x80}},
+        {"branch", {0xA2, 0x08, 0xCA, 0xD0, 0xFD, 0xF0, 0x00, 0x90, 0x00, JMP, 0x00, 0x80}},
+        {"stack", {0x48, 0x08, 0x28, 0x68, JMP, 0x00, 0x80}},
+        {"jump/subroutine", {0x20, 0x06, 0x80, 0x6C, 0x50, 0x00, 0x60}},
+        {"transfer/flags",
+         {0xAA, 0x8A, 0xA8, 0x98, 0xBA, 0x9A, 0x38, 0x18, 0x78, 0x58, 0xB8, JMP, 0x00, 0x80}},
+        {"unofficial", {0xA7, 0x10, 0x87, 0x20, 0xC7, 0x30, 0xFF, 0x00, 0x02, 0x07, 0x40, JMP, 0x00, 0x80}},
+    };
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::uint64_t instructions = 10'000'000;
+    bool profile = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--profile")
+        {
+            profile = true;
+        }
+        else
+        {
+            instructions = std::strtoull(argv[i], nullptr, 10);
+        }
+    }
+
+    std::printf("%-22s %14s %14s %10s\n", "group", "instructions/s", "cycles/s", "ns/instr");
+
+    for (const Group &group : Groups())
+    {
+        Machine machine;
+        std::array<Word, 0x10000> &ram = machine.ram;
+        Cpu &cpu = machine.cpu;
+        CpuProfiler profiler;
+
+        if (profile)
+        {
+            cpu.SetProfiler(&profiler);
+        }
+
+        for (std::size_t i = 0; i < group.program.size(); i++)
+        {
+            ram[0x8000 + i] = group.program[i];
+        }
+
+        // Pointers used by the indirect instructions
+        ram[0x0040] = 0x00;
+        ram[0x0041] = 0x03;
+        ram[0x0050] = 0x00;
+        ram[0x0051] = 0x80;
+        ram[0xFFFC] = 0x00;
+        ram[0xFFFD] = 0x80;
+        cpu.Reset();
+
+        std::uint64_t startCycles = cpu.GetCycles();
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::uint64_t i = 0; i < instructions; i++)
+        {
+            cpu.Step();
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double seconds = elapsed.count();
+
+        std::printf("%-22s %14.0f %14.0f %10.2f\n", group.name, instructions / seconds,
+                    (cpu.GetCycles() - startCycles) / seconds, seconds * 1e9 / instructions);
+
+        if (profile)
+        {
+            profiler.Report(std::cout, cpu, 5);
+            std::cout << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,372 @@
+#include "Apu.hpp"
+#include "../State.hpp"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace
+{
+// Frame counter steps in cpu cycles since the beginning of the sequence
+constexpr std::uint64_t s_FourStepCycles[4] = {7457, 14913, 22371, 29829};
+constexpr std::uint64_t s_FiveStepCycles[5] = {7457, 14913, 22371, 29829, 37281};
+constexpr std::uint64_t FourStepPeriod = 29830;
+constexpr std::uint64_t FiveStepPeriod = 37282;
+} // namespace
+
+Apu::Apu(MemoryMap &memory)
+    : m_Pulses{Pulse(true), Pulse(false)}, m_Dmc(memory), m_AudioEnabled(true), m_OutputDiscarded(false),
+      m_SampleRate(s_DefaultSampleRate)
+{
+    m_Blip.SetRates(s_ClockRate, m_SampleRate);
+    Reset(0);
+}
+
+void Apu::Reset(std::uint64_t cycle)
+{
+    for (Pulse &pulse : m_Pulses)
+    {
+        pulse.Reset();
+    }
+
+    m_Triangle.Reset();
+    m_Noise.Reset();
+    m_Dmc.Reset();
+
+    m_Cycle = m_FrameStart = cycle;
+
+    m_FiveStep = m_IrqInhibit = m_FrameIrq = false;
+    m_FrameStep = 0;
+    m_SequenceStart = cycle;
+    ScheduleFrameStep();
+
+    SetAudioEnabled(m_AudioEnabled);
+}
+
+void Apu::SetAudioEnabled(bool enabled)
+{
+    m_AudioEnabled = enabled;
+    m_Blip.Clear();
+
+    m_Pulses[0].ClearLevel();
+    m_Pulses[1].ClearLevel();
+    m_Triangle.ClearLevel();
+    m_Noise.ClearLevel();
+    m_Dmc.ClearLevel();
+
+    UpdateOutputs();
+    UpdateNextEvent();
+}
+
+bool Apu::IsAudioEnabled() const
+{
+    return m_AudioEnabled;
+}
+
+void Apu::SetOutputDiscarded(bool discarded)
+{
+    m_OutputDiscarded = discarded;
+
+    // Step from the last synthesized levels to the ones of the current state
+    UpdateOutputs();
+}
+
+void Apu::SetSampleRate(double rate)
+{
+    m_SampleRate = rate;
+    m_Blip.SetRates(s_ClockRate, rate);
+    SetAudioEnabled(m_AudioEnabled);
+}
+
+double Apu::GetSampleRate() const
+{
+    return m_SampleRate;
+}
+
+Word Apu::ReadStatus(std::uint64_t cycle)
+{
+    RunUntil(cycle);
+
+    Word status = m_Pulses[0].IsActive() | (m_Pulses[1].IsActive() << 1) | (m_Triangle.IsActive() << 2) |
+                  (m_Noise.IsActive() << 3) | (m_Dmc.IsPlaying() << 4) | (m_FrameIrq << 6) | (m_Dmc.GetIrq() << 7);
+
+    // Reading acknowledges the frame interrupt
+    m_FrameIrq = false;
+    UpdateNextEvent();
+
+    return status;
+}
+
+void Apu::WriteRegister(DWord address, Word value, std::uint64_t cycle)
+{
+    RunUntil(cycle);
+
+    if (address < 0x4004)
+    {
+        m_Pulses[0].Write(address & 0x03, value);
+    }
+    else if (address < 0x4008)
+    {
+        m_Pulses[1].Write(address & 0x03, value);
+    }
+    else if (address < 0x400C)
+    {
+        m_Triangle.Write(address & 0x03, value);
+    }
+    else if (address < 0x4010)
+    {
+        m_Noise.Write(address & 0x03, value);
+    }
+    else if (address < 0x4014)
+    {
+        m_Dmc.Write(address & 0x03, value);
+    }
+    else if (address == 0x4015)
+    {
+        m_Pulses[0].SetEnabled(value & 0x01);
+        m_Pulses[1].SetEnabled(value & 0x02);
+        m_Triangle.SetEnabled(value & 0x04);
+        m_Noise.SetEnabled(value & 0x08);
+        m_Dmc.SetEnabled(value & 0x10);
+    }
+    else if (address == 0x4017)
+    {
+        m_FiveStep = value & 0x80;
+        m_IrqInhibit = value & 0x40;
+
+        if (m_IrqInhibit)
+        {
+            m_FrameIrq = false;
+        }
+
+        m_FrameStep = 0;
+        m_SequenceStart = m_Cycle;
+        ScheduleFrameStep();
+
+        // The five step mode clocks the units right away
+        if (m_FiveStep)
+        {
+            ClockQuarterFrame();
+            ClockHalfFrame();
+        }
+    }
+
+    UpdateOutputs();
+    UpdateNextEvent();
+}
+
+void Apu::RunUntil(std::uint64_t cycle)
+{
+    while (m_FrameStepCycle <= cycle)
+    {
+        RunChannels(m_FrameStepCycle);
+        ClockFrameCounter();
+    }
+
+    RunChannels(cycle);
+    UpdateNextEvent();
+}
+
+std::uint64_t Apu::GetNextEventCycle() const
+{
+    return m_NextEvent;
+}
+
+bool Apu::GetIrq() const
+{
+    return m_FrameIrq || m_Dmc.GetIrq();
+}
+
+QWord Apu::TakeStallCycles()
+{
+    return m_Dmc.TakeStallCycles();
+}
+
+void Apu::SetCoverageMap(CoverageMap *coverage)
+{
+    m_Dmc.SetCoverageMap(coverage);
+}
+
+void Apu::EndFrame(std::uint64_t cycle)
+{
+    RunUntil(cycle);
+
+    if (BlipBuffer *blip = GetBlip())
+    {
+        blip->EndFrame(m_Cycle - m_FrameStart);
+    }
+
+    m_FrameStart = m_Cycle;
+}
+
+std::size_t Apu::GetSamplesAvailable() const
+{
+    return m_Blip.GetSamplesAvailable();
+}
+
+std::size_t Apu::ReadSamples(std::int16_t *output, std::size_t count)
+{
+    return m_Blip.ReadSamples(output, count);
+}
+
+void Apu::RunChannels(std::uint64_t cycle)
+{
+    if (cycle <= m_Cycle)
+    {
+        return;
+    }
+
+    std::uint64_t from = m_Cycle - m_FrameStart;
+    std::uint64_t to = cycle - m_FrameStart;
+    BlipBuffer *blip = GetBlip();
+
+    m_Pulses[0].Run(from, to, blip);
+    m_Pulses[1].Run(from, to, blip);
+    m_Triangle.Run(from, to, blip);
+    m_Noise.Run(from, to, blip);
+    m_Dmc.Run(from, to, blip);
+
+    m_Cycle = cycle;
+}
+
+void Apu::ClockFrameCounter()
+{
+    if (m_FiveStep)
+    {
+        // The fourth step does nothing
+        if (m_FrameStep != 3)
+        {
+            ClockQuarterFrame();
+        }
+
+        if (m_FrameStep == 1 || m_FrameStep == 4)
+        {
+            ClockHalfFrame();
+        }
+    }
+    else
+    {
+        ClockQuarterFrame();
+
+        if (m_FrameStep == 1 || m_FrameStep == 3)
+        {
+            ClockHalfFrame();
+        }
+
+        if (m_FrameStep == 3 && !m_IrqInhibit)
+        {
+            m_FrameIrq = true;
+        }
+    }
+
+    UpdateOutputs();
+
+    m_FrameStep++;
+
+    if (m_FrameStep == (m_FiveStep ? 5 : 4))
+    {
+        m_FrameStep = 0;
+        m_SequenceStart += m_FiveStep ? FiveStepPeriod : FourStepPeriod;
+    }
+
+    ScheduleFrameStep();
+}
+
+void Apu::ClockQuarterFrame()
+{
+    m_Pulses[0].QuarterFrame();
+    m_Pulses[1].QuarterFrame();
+    m_Triangle.QuarterFrame();
+    m_Noise.QuarterFrame();
+}
+
+void Apu::ClockHalfFrame()
+{
+    m_Pulses[0].HalfFrame();
+    m_Pulses[1].HalfFrame();
+    m_Triangle.HalfFrame();
+    m_Noise.HalfFrame();
+}
+
+void Apu::ScheduleFrameStep()
+{
+    m_FrameStepCycle = m_SequenceStart + (m_FiveStep ? s_FiveStepCycles : s_FourStepCycles)[m_FrameStep];
+}
+
+void Apu::UpdateOutputs()
+{
+    BlipBuffer *blip = GetBlip();
+    std::uint64_t time = m_Cycle - m_FrameStart;
+
+    m_Pulses[0].Update(blip, time);
+    m_Pulses[1].Update(blip, time);
+    m_Triangle.Update(blip, time);
+    m_Noise.Update(blip, time);
+    m_Dmc.Update(blip, time);
+}
+
+void Apu::UpdateNextEvent()
+{
+    m_NextEvent = m_Dmc.GetNextFetch(m_Cycle);
+
+    // The other frame counter steps are not visible until the registers are accessed
+    if (!m_FiveStep && !m_IrqInhibit && !m_FrameIrq)
+    {
+        m_NextEvent = std::min(m_NextEvent, m_SequenceStart + s_FourStepCycles[3]);
+    }
+}
+
+BlipBuffer *Apu::GetBlip()
+{
+    return m_AudioEnabled && !m_OutputDiscarded ? &m_Blip : nullptr;
+}
+
+void Apu::SaveState(StateWriter &writer) const
+{
+    m_Pulses[0].SaveState(writer);
+    m_Pulses[1].SaveState(writer);
+    m_Triangle.SaveState(writer);
+    m_Noise.SaveState(writer);
+    m_Dmc.SaveState(writer);
+
+    writer.Write(m_Cycle);
+    writer.Write(m_FrameStart);
+    writer.Write(m_FiveStep);
+    writer.Write(m_IrqInhibit);
+    writer.Write(m_FrameIrq);
+    writer.Write(m_FrameStep);
+    writer.Write(m_SequenceStart);
+}
+
+void Apu::LoadState(StateReader &reader)
+{
+    m_Pulses[0].LoadState(reader);
+    m_Pulses[1].LoadState(reader);
+    m_Triangle.LoadState(reader);
+    m_Noise.LoadState(reader);
+    m_Dmc.LoadState(reader);
+
+    reader.Read(m_Cycle);
+    reader.Read(m_FrameStart);
+    reader.Read(m_FiveStep);
+    reader.Read(m_IrqInhibit);
+    reader.Read(m_FrameIrq);
+    reader.Read(m_FrameStep);
+    reader.Read(m_SequenceStart);
+
+    if (m_FrameStep >= (m_FiveStep ? std::size(s_FiveStepCycles) : std::size(s_FourStepCycles)))
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+
+    ScheduleFrameStep();
+
+    // The pending samples belong to the previous timeline, unless the past is being re-emulated
+    if (m_OutputDiscarded)
+    {
+        UpdateNextEvent();
+    }
+    else
+    {
+        SetAudioEnabled(m_AudioEnabled);
+    }
+}
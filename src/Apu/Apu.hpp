@@ -0,0 +1,106 @@
+#ifndef APU_HPP
+#define APU_HPP
+
+#include "ApuChannels.hpp"
+#include "BlipBuffer.hpp"
+#include "../Types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+class CoverageMap;
+class MemoryMap;
+class StateWriter;
+class StateReader;
+
+/*
+   Audio processing unit
+
+   The APU lags behind the cpu and only catches up when something needs its
+   state: a register access, the next cpu visible event (frame counter step,
+   DMC fetch) or the end of the video frame. Catching up runs the channels
+   block by block between the frame counter steps, the channels themselves
+   jump from one timer reload to the next.
+
+   The samples are synthesized at s_DefaultSampleRate unless changed, an
+   output resampler brings them to the device rate. With the audio disabled
+   the channels keep their registers, length counters, $4015 status and
+   IRQs but nothing is synthesized
+ */
+class Apu
+{
+public:
+    Apu(MemoryMap &memory);
+
+    // Power on at the given cpu cycle
+    void Reset(std::uint64_t cycle);
+
+    void SetAudioEnabled(bool enabled);
+    bool IsAudioEnabled() const;
+    // Emulate without synthesis, the pending samples and the output levels are kept for when it is cleared
+    void SetOutputDiscarded(bool discarded);
+    void SetSampleRate(double rate);
+    double GetSampleRate() const;
+
+    // $4015
+    Word ReadStatus(std::uint64_t cycle);
+    // $4000-$4013, $4015 and $4017
+    void WriteRegister(DWord address, Word value, std::uint64_t cycle);
+
+    // Catch up with the cpu
+    void RunUntil(std::uint64_t cycle);
+    // Cpu cycle of the next event visible to the cpu, RunUntil must be called once reached
+    std::uint64_t GetNextEventCycle() const;
+    bool GetIrq() const;
+    // Cpu cycles stolen by the DMC since the last call
+    QWord TakeStallCycles();
+    // The DMC sample fetches are data reads of the PRG ROM, see CoverageMap
+    void SetCoverageMap(CoverageMap *coverage);
+
+    // Close the audio frame at the given cpu cycle, its samples become readable
+    void EndFrame(std::uint64_t cycle);
+    std::size_t GetSamplesAvailable() const;
+    std::size_t ReadSamples(std::int16_t *output, std::size_t count);
+
+    static constexpr double s_ClockRate = 1789773.0;
+    static constexpr double s_DefaultSampleRate = s_ClockRate / 32;
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+private:
+    void RunChannels(std::uint64_t cycle);
+    void ClockFrameCounter();
+    void ClockQuarterFrame();
+    void ClockHalfFrame();
+    void ScheduleFrameStep();
+    void UpdateOutputs();
+    void UpdateNextEvent();
+    BlipBuffer *GetBlip();
+
+    std::array<Pulse, 2> m_Pulses;
+    Triangle m_Triangle;
+    Noise m_Noise;
+    Dmc m_Dmc;
+
+    // Cpu cycle the channels have been run to
+    std::uint64_t m_Cycle;
+    // Cpu cycle at the beginning of the audio frame
+    std::uint64_t m_FrameStart;
+    std::uint64_t m_NextEvent;
+
+    // Frame counter
+    bool m_FiveStep;
+    bool m_IrqInhibit;
+    bool m_FrameIrq;
+    Word m_FrameStep;
+    std::uint64_t m_SequenceStart;
+    std::uint64_t m_FrameStepCycle;
+
+    bool m_AudioEnabled;
+    bool m_OutputDiscarded;
+    double m_SampleRate;
+    BlipBuffer m_Blip;
+};
+
+#endif
@@ -0,0 +1,899 @@
+#include "ApuChannels.hpp"
+#include "BlipBuffer.hpp"
+#include "../MemoryMap.hpp"
+#include "../Cpu/CoverageMap.hpp"
+#include "../State.hpp"
+#include <array>
+#include <limits>
+
+namespace
+{
+constexpr Word s_LengthTable[32] = {
+    10, 254, 20, 2,  40, 4,  80, 6,  160, 8,  60, 10, 14, 12, 26, 14,
+    12, 16,  24, 18, 48, 20, 96, 22, 192, 24, 72, 26, 16, 28, 32, 30,
+};
+
+constexpr Word s_DutyTable[4][8] = {
+    {0, 1, 0, 0, 0, 0, 0, 0},
+    {0, 1, 1, 0, 0, 0, 0, 0},
+    {0, 1, 1, 1, 1, 0, 0, 0},
+    {1, 0, 0, 1, 1, 1, 1, 1},
+};
+
+// NTSC timer periods in cpu cycles
+constexpr DWord s_NoisePeriods[16] = {4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068};
+constexpr DWord s_DmcRates[16] = {428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54};
+
+/*
+   Linear approximation of the 2A03 mixer scaled to 16 bits, the nonlinear
+   tables would need the levels of every channel at each change and prevent
+   running the channels independently
+ */
+constexpr int PulseWeight = 246;
+constexpr int TriangleWeight = 279;
+constexpr int NoiseWeight = 162;
+constexpr int DmcWeight = 110;
+
+// Reloads within [time, to] of a timer reloading at time then every period cycles
+std::uint64_t CountReloads(std::uint64_t time, std::uint64_t to, std::uint64_t period)
+{
+    return (to - time) / period + 1;
+}
+
+// One clock of the 15 bit noise shift register with feedback from bit 0 and the tap bit
+constexpr DWord ClockNoise(DWord shift, int tap)
+{
+    DWord feedback = (shift ^ (shift >> tap)) & 0x01;
+    return static_cast<DWord>((shift >> 1) | (feedback << 14));
+}
+
+/*
+   The shift register is linear over GF(2), n clocks are a 15x15 bit matrix
+   stored as the image of each single bit. NoiseJumps[mode][k] holds the
+   matrix of 2^k clocks so any number of clocks costs one application per
+   set bit instead of one clock per timer reload
+ */
+using NoiseJump = std::array<DWord, 15>;
+using NoiseJumps = std::array<std::array<NoiseJump, 64>, 2>;
+
+constexpr DWord ApplyNoiseJump(const NoiseJump &jump, DWord shift)
+{
+    DWord result = 0;
+
+    for (int bit = 0; bit < 15; ++bit)
+    {
+        if (shift & (1 << bit))
+        {
+            result ^= jump[bit];
+        }
+    }
+
+    return result;
+}
+
+constexpr NoiseJumps BuildNoiseJumps()
+{
+    NoiseJumps jumps = {};
+
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        for (int bit = 0; bit < 15; ++bit)
+        {
+            jumps[mode][0][bit] = ClockNoise(static_cast<DWord>(1 << bit), mode ? 6 : 1);
+        }
+
+        for (int level = 1; level < 64; ++level)
+        {
+            for (int bit = 0; bit < 15; ++bit)
+            {
+                jumps[mode][level][bit] = ApplyNoiseJump(jumps[mode][level - 1], jumps[mode][level - 1][bit]);
+            }
+        }
+    }
+
+    return jumps;
+}
+
+constexpr NoiseJumps s_NoiseJumps = BuildNoiseJumps();
+} // namespace
+
+void Envelope::Reset()
+{
+    m_Period = m_Divider = m_Decay = 0;
+    m_Constant = m_Loop = m_Start = false;
+}
+
+void Envelope::Write(Word value)
+{
+    m_Loop = value & 0x20;
+    m_Constant = value & 0x10;
+    m_Period = value & 0x0F;
+}
+
+void Envelope::Restart()
+{
+    m_Start = true;
+}
+
+void Envelope::Clock()
+{
+    if (m_Start)
+    {
+        m_Start = false;
+        m_Decay = 15;
+        m_Divider = m_Period;
+    }
+    else if (m_Divider == 0)
+    {
+        m_Divider = m_Period;
+
+        if (m_Decay > 0)
+        {
+            m_Decay--;
+        }
+        else if (m_Loop)
+        {
+            m_Decay = 15;
+        }
+    }
+    else
+    {
+        m_Divider--;
+    }
+}
+
+Word Envelope::GetVolume() const
+{
+    return m_Constant ? m_Period : m_Decay;
+}
+
+bool Envelope::GetLoop() const
+{
+    return m_Loop;
+}
+
+void Envelope::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_Period);
+    writer.Write(m_Divider);
+    writer.Write(m_Decay);
+    writer.Write(m_Constant);
+    writer.Write(m_Loop);
+    writer.Write(m_Start);
+}
+
+void Envelope::LoadState(StateReader &reader)
+{
+    reader.Read(m_Period);
+    reader.Read(m_Divider);
+    reader.Read(m_Decay);
+    reader.Read(m_Constant);
+    reader.Read(m_Loop);
+    reader.Read(m_Start);
+}
+
+ApuChannel::ApuChannel(int weight)
+    : m_Length(0), m_Halt(false), m_Enabled(false), m_Delay(1), m_Weight(weight), m_Level(0)
+{
+}
+
+void ApuChannel::SetEnabled(bool enabled)
+{
+    m_Enabled = enabled;
+
+    if (!enabled)
+    {
+        m_Length = 0;
+    }
+}
+
+bool ApuChannel::IsActive() const
+{
+    return m_Length > 0;
+}
+
+void ApuChannel::ClockLength()
+{
+    if (m_Length > 0 && !m_Halt)
+    {
+        m_Length--;
+    }
+}
+
+void ApuChannel::Update(BlipBuffer *blip, std::uint64_t time)
+{
+    Emit(blip, time, GetOutput());
+}
+
+void ApuChannel::ClearLevel()
+{
+    m_Level = 0;
+}
+
+void ApuChannel::LoadLength(Word index)
+{
+    if (m_Enabled)
+    {
+        m_Length = s_LengthTable[index & 0x1F];
+    }
+}
+
+void ApuChannel::Emit(BlipBuffer *blip, std::uint64_t time, int level)
+{
+    if (blip && level != m_Level)
+    {
+        blip->AddDelta(time, (level - m_Level) * m_Weight);
+        m_Level = level;
+    }
+}
+
+void ApuChannel::SaveChannel(StateWriter &writer) const
+{
+    writer.Write(m_Length);
+    writer.Write(m_Halt);
+    writer.Write(m_Enabled);
+    writer.Write(m_Delay);
+}
+
+void ApuChannel::LoadChannel(StateReader &reader)
+{
+    reader.Read(m_Length);
+    reader.Read(m_Halt);
+    reader.Read(m_Enabled);
+    reader.Read(m_Delay);
+}
+
+Pulse::Pulse(bool onesComplement)
+    : ApuChannel(PulseWeight), m_OnesComplement(onesComplement)
+{
+    Reset();
+}
+
+void Pulse::Reset()
+{
+    m_Length = 0;
+    m_Halt = m_Enabled = false;
+    m_Delay = 1;
+    m_Envelope.Reset();
+    m_Duty = m_Step = 0;
+    m_Period = 0;
+    m_SweepEnabled = m_SweepNegate = m_SweepReload = false;
+    m_SweepPeriod = m_SweepShift = m_SweepDivider = 0;
+}
+
+void Pulse::Write(DWord reg, Word value)
+{
+    switch (reg)
+    {
+    case 0:
+        m_Duty = value >> 6;
+        m_Halt = value & 0x20;
+        m_Envelope.Write(value);
+        break;
+    case 1:
+        m_SweepEnabled = value & 0x80;
+        m_SweepPeriod = (value >> 4) & 0x07;
+        m_SweepNegate = value & 0x08;
+        m_SweepShift = value & 0x07;
+        m_SweepReload = true;
+        break;
+    case 2:
+        m_Period = (m_Period & 0x0700) | value;
+        break;
+    case 3:
+        m_Period = (m_Period & 0x00FF) | ((value & 0x07) << 8);
+        LoadLength(value >> 3);
+        m_Step = 0;
+        m_Envelope.Restart();
+        break;
+    }
+}
+
+void Pulse::QuarterFrame()
+{
+    m_Envelope.Clock();
+}
+
+void Pulse::HalfFrame()
+{
+    ClockLength();
+
+    if (m_SweepDivider == 0 && m_SweepEnabled && m_SweepShift > 0 && !IsMuted())
+    {
+        m_Period = GetSweepTarget();
+    }
+
+    if (m_SweepDivider == 0 || m_SweepReload)
+    {
+        m_SweepDivider = m_SweepPeriod;
+        m_SweepReload = false;
+    }
+    else
+    {
+        m_SweepDivider--;
+    }
+}
+
+void Pulse::Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip)
+{
+    std::uint64_t period = (m_Period + 1) * 2ull;
+    std::uint64_t time = from + m_Delay;
+
+    if (time <= to)
+    {
+        if (!blip || m_Envelope.GetVolume() == 0 || m_Length == 0 || IsMuted())
+        {
+            // Silent for the whole span, only the sequencer position matters
+            std::uint64_t reloads = CountReloads(time, to, period);
+            m_Step = (m_Step + reloads) & 0x07;
+            time += reloads * period;
+        }
+        else
+        {
+            for (; time <= to; time += period)
+            {
+                m_Step = (m_Step + 1) & 0x07;
+                Emit(blip, time, GetOutput());
+            }
+        }
+    }
+
+    m_Delay = time - to;
+}
+
+int Pulse::GetOutput() const
+{
+    if (m_Length == 0 || IsMuted() || !s_DutyTable[m_Duty][m_Step])
+    {
+        return 0;
+    }
+
+    return m_Envelope.GetVolume();
+}
+
+DWord Pulse::GetSweepTarget() const
+{
+    int change = m_Period >> m_SweepShift;
+
+    if (m_SweepNegate)
+    {
+        // The first pulse negates with the ones' complement
+        int target = m_Period - change - m_OnesComplement;
+        return target < 0 ? 0 : target;
+    }
+
+    return m_Period + change;
+}
+
+bool Pulse::IsMuted() const
+{
+    return m_Period < 8 || GetSweepTarget() > 0x07FF;
+}
+
+void Pulse::SaveState(StateWriter &writer) const
+{
+    SaveChannel(writer);
+    m_Envelope.SaveState(writer);
+    writer.Write(m_Duty);
+    writer.Write(m_Step);
+    writer.Write(m_Period);
+    writer.Write(m_SweepEnabled);
+    writer.Write(m_SweepNegate);
+    writer.Write(m_SweepReload);
+    writer.Write(m_SweepPeriod);
+    writer.Write(m_SweepShift);
+    writer.Write(m_SweepDivider);
+}
+
+void Pulse::LoadState(StateReader &reader)
+{
+    LoadChannel(reader);
+    m_Envelope.LoadState(reader);
+    reader.Read(m_Duty);
+    reader.Read(m_Step);
+    reader.Read(m_Period);
+    reader.Read(m_SweepEnabled);
+    reader.Read(m_SweepNegate);
+    reader.Read(m_SweepReload);
+    reader.Read(m_SweepPeriod);
+    reader.Read(m_SweepShift);
+    reader.Read(m_SweepDivider);
+
+    // Table indices and a shift amount
+    if (m_Duty > 3 || m_Step > 7 || m_SweepShift > 7)
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+}
+
+Triangle::Triangle()
+    : ApuChannel(TriangleWeight)
+{
+    Reset();
+}
+
+void Triangle::Reset()
+{
+    m_Length = 0;
+    m_Halt = m_Enabled = false;
+    m_Delay = 1;
+    m_Step = 0;
+    m_Period = 0;
+    m_Linear = m_LinearReload = 0;
+    m_LinearReloadFlag = false;
+}
+
+void Triangle::Write(DWord reg, Word value)
+{
+    switch (reg)
+    {
+    case 0:
+        m_Halt = value & 0x80;
+        m_LinearReload = value & 0x7F;
+        break;
+    case 2:
+        m_Period = (m_Period & 0x0700) | value;
+        break;
+    case 3:
+        m_Period = (m_Period & 0x00FF) | ((value & 0x07) << 8);
+        LoadLength(value >> 3);
+        m_LinearReloadFlag = true;
+        break;
+    }
+}
+
+void Triangle::QuarterFrame()
+{
+    if (m_LinearReloadFlag)
+    {
+        m_Linear = m_LinearReload;
+    }
+    else if (m_Linear > 0)
+    {
+        m_Linear--;
+    }
+
+    // The control flag doubles as the length counter halt
+    if (!m_Halt)
+    {
+        m_LinearReloadFlag = false;
+    }
+}
+
+void Triangle::HalfFrame()
+{
+    ClockLength();
+}
+
+void Triangle::Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip)
+{
+    std::uint64_t period = m_Period + 1;
+    std::uint64_t time = from + m_Delay;
+
+    if (time <= to)
+    {
+        bool clocked = m_Length > 0 && m_Linear > 0;
+
+        // Ultrasonic periods are held instead of producing aliasing noise
+        if (clocked && blip && m_Period >= 2)
+        {
+            for (; time <= to; time += period)
+            {
+                m_Step = (m_Step + 1) & 0x1F;
+                Emit(blip, time, GetOutput());
+            }
+        }
+        else
+        {
+            std::uint64_t reloads = CountReloads(time, to, period);
+
+            if (clocked && m_Period >= 2)
+            {
+                m_Step = (m_Step + reloads) & 0x1F;
+            }
+
+            time += reloads * period;
+        }
+    }
+
+    m_Delay = time - to;
+}
+
+int Triangle::GetOutput() const
+{
+    // 15 down to 0 then 0 up to 15
+    return m_Step < 16 ? 15 - m_Step : m_Step - 16;
+}
+
+void Triangle::SaveState(StateWriter &writer) const
+{
+    SaveChannel(writer);
+    writer.Write(m_Step);
+    writer.Write(m_Period);
+    writer.Write(m_Linear);
+    writer.Write(m_LinearReload);
+    writer.Write(m_LinearReloadFlag);
+}
+
+void Triangle::LoadState(StateReader &reader)
+{
+    LoadChannel(reader);
+    reader.Read(m_Step);
+    reader.Read(m_Period);
+    reader.Read(m_Linear);
+    reader.Read(m_LinearReload);
+    reader.Read(m_LinearReloadFlag);
+}
+
+Noise::Noise()
+    : ApuChannel(NoiseWeight)
+{
+    Reset();
+}
+
+void Noise::Reset()
+{
+    m_Length = 0;
+    m_Halt = m_Enabled = false;
+    m_Delay = 1;
+    m_Envelope.Reset();
+    m_Shift = 0x0001;
+    m_Period = s_NoisePeriods[0];
+    m_Mode = false;
+}
+
+void Noise::Write(DWord reg, Word value)
+{
+    switch (reg)
+    {
+    case 0:
+        m_Halt = value & 0x20;
+        m_Envelope.Write(value);
+        break;
+    case 2:
+        m_Mode = value & 0x80;
+        m_Period = s_NoisePeriods[value & 0x0F];
+        break;
+    case 3:
+        LoadLength(value >> 3);
+        m_Envelope.Restart();
+        break;
+    }
+}
+
+void Noise::QuarterFrame()
+{
+    m_Envelope.Clock();
+}
+
+void Noise::HalfFrame()
+{
+    ClockLength();
+}
+
+void Noise::Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip)
+{
+    std::uint64_t time = from + m_Delay;
+
+    if (time <= to)
+    {
+        if (!blip)
+        {
+            // Clocked without emitting, the register is part of the state whether audio is produced or not
+            std::uint64_t reloads = CountReloads(time, to, m_Period);
+            const auto &jumps = s_NoiseJumps[m_Mode ? 1 : 0];
+
+            time += reloads * m_Period;
+
+            for (int level = 0; reloads; ++level, reloads >>= 1)
+            {
+                if (reloads & 0x01)
+                {
+                    m_Shift = ApplyNoiseJump(jumps[level], m_Shift);
+                }
+            }
+        }
+        else
+        {
+            for (; time <= to; time += m_Period)
+            {
+                Shift();
+                Emit(blip, time, GetOutput());
+            }
+        }
+    }
+
+    m_Delay = time - to;
+}
+
+void Noise::Shift()
+{
+    m_Shift = ClockNoise(m_Shift, m_Mode ? 6 : 1);
+}
+
+int Noise::GetOutput() const
+{
+    if (m_Length == 0 || (m_Shift & 0x01))
+    {
+        return 0;
+    }
+
+    return m_Envelope.GetVolume();
+}
+
+void Noise::SaveState(StateWriter &writer) const
+{
+    SaveChannel(writer);
+    m_Envelope.SaveState(writer);
+    writer.Write(m_Shift);
+    writer.Write(m_Period);
+    writer.Write(m_Mode);
+}
+
+void Noise::LoadState(StateReader &reader)
+{
+    LoadChannel(reader);
+    m_Envelope.LoadState(reader);
+    reader.Read(m_Shift);
+    reader.Read(m_Period);
+    reader.Read(m_Mode);
+
+    if (m_Period == 0 || m_Shift > 0x7FFF)
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+}
+
+Dmc::Dmc(MemoryMap &memory)
+    : ApuChannel(DmcWeight), m_Memory(memory), m_Coverage(nullptr)
+{
+    Reset();
+}
+
+void Dmc::Reset()
+{
+    m_Delay = 1;
+    m_IrqEnabled = m_Irq = m_Loop = false;
+    m_Rate = s_DmcRates[0];
+    m_Output = 0;
+    m_SampleAddress = 0xC000;
+    m_SampleLength = 1;
+    m_Address = 0xC000;
+    m_BytesRemaining = 0;
+    m_Buffer = 0x00;
+    m_BufferEmpty = true;
+    m_ShiftRegister = 0x00;
+    m_BitsRemaining = 8;
+    m_Silence = true;
+    m_StallCycles = 0;
+}
+
+void Dmc::Write(DWord reg, Word value)
+{
+    switch (reg)
+    {
+    case 0:
+        m_IrqEnabled = value & 0x80;
+        m_Loop = value & 0x40;
+        m_Rate = s_DmcRates[value & 0x0F];
+
+        if (!m_IrqEnabled)
+        {
+            m_Irq = false;
+        }
+        break;
+    case 1:
+        m_Output = value & 0x7F;
+        break;
+    case 2:
+        m_SampleAddress = 0xC000 | (value << 6);
+        break;
+    case 3:
+        m_SampleLength = (value << 4) | 0x0001;
+        break;
+    }
+}
+
+void Dmc::SetEnabled(bool enabled)
+{
+    m_Irq = false;
+
+    if (!enabled)
+    {
+        m_BytesRemaining = 0;
+    }
+    else if (m_BytesRemaining == 0)
+    {
+        Restart();
+        Fetch();
+    }
+}
+
+void Dmc::Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip)
+{
+    std::uint64_t time = from + m_Delay;
+
+    if (time <= to)
+    {
+        if (m_Silence && m_BufferEmpty && m_BytesRemaining == 0)
+        {
+            // Idle, the output unit keeps cycling over silent bytes
+            std::uint64_t reloads = CountReloads(time, to, m_Rate);
+            m_BitsRemaining = (m_BitsRemaining + 7 - reloads % 8) % 8 + 1;
+            time += reloads * m_Rate;
+        }
+        else
+        {
+            for (; time <= to; time += m_Rate)
+            {
+                ClockOutput(time, blip);
+            }
+        }
+    }
+
+    m_Delay = time - to;
+}
+
+std::uint64_t Dmc::GetNextFetch(std::uint64_t from) const
+{
+    if (m_BytesRemaining == 0)
+    {
+        return std::numeric_limits<std::uint64_t>::max();
+    }
+
+    // The buffer is refilled as soon as the output unit starts a new byte
+    return from + m_Delay + (m_BitsRemaining - 1) * static_cast<std::uint64_t>(m_Rate);
+}
+
+bool Dmc::IsPlaying() const
+{
+    return m_BytesRemaining > 0;
+}
+
+bool Dmc::GetIrq() const
+{
+    return m_Irq;
+}
+
+void Dmc::ClearIrq()
+{
+    m_Irq = false;
+}
+
+QWord Dmc::TakeStallCycles()
+{
+    QWord cycles = m_StallCycles;
+    m_StallCycles = 0;
+    return cycles;
+}
+
+void Dmc::SetCoverageMap(CoverageMap *coverage)
+{
+    m_Coverage = coverage;
+}
+
+int Dmc::GetOutput() const
+{
+    return m_Output;
+}
+
+void Dmc::Restart()
+{
+    m_Address = m_SampleAddress;
+    m_BytesRemaining = m_SampleLength;
+}
+
+void Dmc::Fetch()
+{
+    if (!m_BufferEmpty || m_BytesRemaining == 0)
+    {
+        return;
+    }
+
+    if (m_Coverage)
+    {
+        m_Coverage->MarkData(m_Memory, m_Address);
+    }
+
+    m_Buffer = m_Memory.Read(m_Address);
+    m_BufferEmpty = false;
+    // The cpu is halted while the DMA unit reads the byte
+    m_StallCycles += 4;
+
+    m_Address = m_Address == 0xFFFF ? 0x8000 : m_Address + 1;
+
+    if (--m_BytesRemaining == 0)
+    {
+        if (m_Loop)
+        {
+            Restart();
+        }
+        else if (m_IrqEnabled)
+        {
+            m_Irq = true;
+        }
+    }
+}
+
+void Dmc::ClockOutput(std::uint64_t time, BlipBuffer *blip)
+{
+    if (!m_Silence)
+    {
+        if (m_ShiftRegister & 0x01)
+        {
+            if (m_Output <= 125)
+            {
+                m_Output += 2;
+            }
+        }
+        else if (m_Output >= 2)
+        {
+            m_Output -= 2;
+        }
+
+        Emit(blip, time, m_Output);
+    }
+
+    m_ShiftRegister >>= 1;
+
+    if (--m_BitsRemaining == 0)
+    {
+        m_BitsRemaining = 8;
+
+        if (m_BufferEmpty)
+        {
+            m_Silence = true;
+        }
+        else
+        {
+            m_Silence = false;
+            m_ShiftRegister = m_Buffer;
+            m_BufferEmpty = true;
+            Fetch();
+        }
+    }
+}
+
+void Dmc::SaveState(StateWriter &writer) const
+{
+    SaveChannel(writer);
+    writer.Write(m_IrqEnabled);
+    writer.Write(m_Irq);
+    writer.Write(m_Loop);
+    writer.Write(m_Rate);
+    writer.Write(m_Output);
+    writer.Write(m_SampleAddress);
+    writer.Write(m_SampleLength);
+    writer.Write(m_Address);
+    writer.Write(m_BytesRemaining);
+    writer.Write(m_Buffer);
+    writer.Write(m_BufferEmpty);
+    writer.Write(m_ShiftRegister);
+    writer.Write(m_BitsRemaining);
+    writer.Write(m_Silence);
+}
+
+void Dmc::LoadState(StateReader &reader)
+{
+    LoadChannel(reader);
+    reader.Read(m_IrqEnabled);
+    reader.Read(m_Irq);
+    reader.Read(m_Loop);
+    reader.Read(m_Rate);
+    reader.Read(m_Output);
+    reader.Read(m_SampleAddress);
+    reader.Read(m_SampleLength);
+    reader.Read(m_Address);
+    reader.Read(m_BytesRemaining);
+    reader.Read(m_Buffer);
+    reader.Read(m_BufferEmpty);
+    reader.Read(m_ShiftRegister);
+    reader.Read(m_BitsRemaining);
+    reader.Read(m_Silence);
+    m_StallCycles = 0;
+
+    if (m_Rate == 0)
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+}
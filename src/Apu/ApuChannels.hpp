@@ -0,0 +1,237 @@
+#ifndef APUCHANNELS_HPP
+#define APUCHANNELS_HPP
+
+#include "../Types.hpp"
+#include <cstdint>
+
+class BlipBuffer;
+class CoverageMap;
+class MemoryMap;
+class StateWriter;
+class StateReader;
+
+/*
+   Sound channels of the 2A03
+
+   The channels are not clocked cycle by cycle, Run advances them over a
+   span of cpu cycles by jumping from one timer reload to the next and only
+   reports the output level changes to the BlipBuffer. A null BlipBuffer
+   means that nobody listens, the channels then skip the synthesis.
+   Times are cpu cycles since the beginning of the audio frame
+ */
+
+// Volume envelope shared by the pulse and noise channels
+class Envelope
+{
+public:
+    void Reset();
+    void Write(Word value);
+    void Restart();
+    // Quarter frame clock
+    void Clock();
+
+    Word GetVolume() const;
+    bool GetLoop() const;
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+private:
+    Word m_Period;
+    Word m_Divider;
+    Word m_Decay;
+    bool m_Constant;
+    bool m_Loop;
+    bool m_Start;
+};
+
+class ApuChannel
+{
+public:
+    // Weight of one output step in the final mix
+    ApuChannel(int weight);
+
+    void SetEnabled(bool enabled);
+    // Length counter running, reported by $4015
+    bool IsActive() const;
+    // Half frame clock
+    void ClockLength();
+
+    // Report the current output level, after a register write or a frame counter clock
+    void Update(BlipBuffer *blip, std::uint64_t time);
+    // Forget the reported level, the next update reports it again
+    void ClearLevel();
+
+protected:
+    void LoadLength(Word index);
+    void Emit(BlipBuffer *blip, std::uint64_t time, int level);
+
+    void SaveChannel(StateWriter &writer) const;
+    void LoadChannel(StateReader &reader);
+
+    virtual int GetOutput() const = 0;
+
+    Word m_Length;
+    bool m_Halt;
+    bool m_Enabled;
+    // Cycles until the next timer reload, counted from the end of the last Run
+    std::uint64_t m_Delay;
+
+private:
+    int m_Weight;
+    int m_Level;
+};
+
+class Pulse : public ApuChannel
+{
+public:
+    // The two pulses only differ by their sweep negation
+    Pulse(bool onesComplement);
+
+    void Reset();
+    void Write(DWord reg, Word value);
+    void QuarterFrame();
+    void HalfFrame();
+    void Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip);
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+protected:
+    int GetOutput() const override;
+
+private:
+    DWord GetSweepTarget() const;
+    bool IsMuted() const;
+
+    Envelope m_Envelope;
+    Word m_Duty;
+    Word m_Step;
+    DWord m_Period;
+
+    bool m_SweepEnabled;
+    bool m_SweepNegate;
+    bool m_SweepReload;
+    Word m_SweepPeriod;
+    Word m_SweepShift;
+    Word m_SweepDivider;
+    bool m_OnesComplement;
+};
+
+class Triangle : public ApuChannel
+{
+public:
+    Triangle();
+
+    void Reset();
+    void Write(DWord reg, Word value);
+    void QuarterFrame();
+    void HalfFrame();
+    void Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip);
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+protected:
+    int GetOutput() const override;
+
+private:
+    Word m_Step;
+    DWord m_Period;
+    Word m_Linear;
+    Word m_LinearReload;
+    bool m_LinearReloadFlag;
+};
+
+class Noise : public ApuChannel
+{
+public:
+    Noise();
+
+    void Reset();
+    void Write(DWord reg, Word value);
+    void QuarterFrame();
+    void HalfFrame();
+    void Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip);
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+protected:
+    int GetOutput() const override;
+
+private:
+    // One clock of the linear feedback shift register
+    void Shift();
+
+    Envelope m_Envelope;
+    DWord m_Shift;
+    DWord m_Period;
+    bool m_Mode;
+};
+
+/*
+   Delta modulation channel
+
+   Unlike the other channels its timing is visible to the cpu: the sample
+   bytes are fetched from the cpu memory, stalling it, and the end of the
+   sample raises an IRQ. It is therefore always run, only the synthesis is
+   skipped without a BlipBuffer
+ */
+class Dmc : public ApuChannel
+{
+public:
+    Dmc(MemoryMap &memory);
+
+    void Reset();
+    void Write(DWord reg, Word value);
+    // $4015 enable bit, restarts the sample when it is over
+    void SetEnabled(bool enabled);
+    void Run(std::uint64_t from, std::uint64_t to, BlipBuffer *blip);
+
+    // Time of the next sample fetch when run from the given time, UINT64_MAX if none
+    std::uint64_t GetNextFetch(std::uint64_t from) const;
+    // Sample bytes left, reported by $4015
+    bool IsPlaying() const;
+    bool GetIrq() const;
+    void ClearIrq();
+    // Cpu cycles stolen by the sample fetches since the last call
+    QWord TakeStallCycles();
+    // Sample fetches are marked as data reads, nullptr detaches the map
+    void SetCoverageMap(CoverageMap *coverage);
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+protected:
+    int GetOutput() const override;
+
+private:
+    void Restart();
+    void Fetch();
+    void ClockOutput(std::uint64_t time, BlipBuffer *blip);
+
+    MemoryMap &m_Memory;
+    CoverageMap *m_Coverage;
+
+    bool m_IrqEnabled;
+    bool m_Irq;
+    bool m_Loop;
+    QWord m_Rate;
+    Word m_Output;
+
+    DWord m_SampleAddress;
+    DWord m_SampleLength;
+    DWord m_Address;
+    DWord m_BytesRemaining;
+
+    Word m_Buffer;
+    bool m_BufferEmpty;
+    Word m_ShiftRegister;
+    Word m_BitsRemaining;
+    bool m_Silence;
+
+    QWord m_StallCycles;
+};
+
+#endif
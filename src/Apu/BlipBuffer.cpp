@@ -0,0 +1,152 @@
+#include "BlipBuffer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+constexpr int PhaseCount = 1 << BlipBuffer::s_PhaseBits;
+// High-pass strength of the integrator, about 17 Hz at 56 kHz
+constexpr int BassShift = 9;
+
+using Kernel = std::array<std::array<std::int32_t, BlipBuffer::s_Width>, PhaseCount>;
+
+/*
+   Step response for every sub-sample phase. The sinc is cut at 45% of the
+   sample rate and shaped by a Blackman window, each phase sums to one so
+   that the integrated output settles exactly on the new level
+ */
+Kernel MakeKernel()
+{
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr double Cutoff = 0.9;
+    constexpr int HalfWidth = BlipBuffer::s_Width / 2;
+
+    Kernel kernel{};
+
+    for (int phase = 0; phase < PhaseCount; phase++)
+    {
+        std::array<double, BlipBuffer::s_Width> taps{};
+        double total = 0.0;
+
+        for (int i = 0; i < BlipBuffer::s_Width; i++)
+        {
+            double x = i - (HalfWidth - 1) - static_cast<double>(phase) / PhaseCount;
+            double sinc = x == 0.0 ? 1.0 : std::sin(Pi * Cutoff * x) / (Pi * Cutoff * x);
+            double window = 0.42 + 0.5 * std::cos(Pi * x / HalfWidth) + 0.08 * std::cos(2.0 * Pi * x / HalfWidth);
+
+            taps[i] = sinc * window;
+            total += taps[i];
+        }
+
+        std::int32_t sum = 0;
+
+        for (int i = 0; i < BlipBuffer::s_Width; i++)
+        {
+            kernel[phase][i] = static_cast<std::int32_t>(std::lround(taps[i] / total * (1 << BlipBuffer::s_DeltaBits)));
+            sum += kernel[phase][i];
+        }
+
+        // Rounding leftovers go to the center tap
+        kernel[phase][HalfWidth - 1] += (1 << BlipBuffer::s_DeltaBits) - sum;
+    }
+
+    return kernel;
+}
+
+const Kernel &GetKernel()
+{
+    static const Kernel kernel = MakeKernel();
+    return kernel;
+}
+} // namespace
+
+BlipBuffer::BlipBuffer()
+    : m_Factor(0), m_End(0), m_Buffer(s_Size)
+{
+    Clear();
+}
+
+void BlipBuffer::SetRates(double clockRate, double sampleRate)
+{
+    m_Factor = static_cast<std::uint64_t>(sampleRate / clockRate * static_cast<double>(1ull << s_TimeBits) + 0.5);
+}
+
+void BlipBuffer::Clear()
+{
+    // Only the touched part needs clearing, nothing when the synthesis is off
+    std::fill(m_Buffer.begin(), m_Buffer.begin() + m_End, 0);
+    m_Offset = 0;
+    m_Available = 0;
+    m_End = 0;
+    m_Integrator = 0;
+}
+
+void BlipBuffer::AddDelta(std::uint64_t time, int delta)
+{
+    std::uint64_t fixed = m_Offset + time * m_Factor;
+    std::size_t index = m_Available + static_cast<std::size_t>(fixed >> s_TimeBits);
+
+    if (index + s_Width > s_Size)
+    {
+        return;
+    }
+
+    int phase = static_cast<int>(fixed >> (s_TimeBits - s_PhaseBits)) & (PhaseCount - 1);
+    const std::array<std::int32_t, s_Width> &kernel = GetKernel()[phase];
+    std::int32_t *out = &m_Buffer[index];
+
+    for (int i = 0; i < s_Width; i++)
+    {
+        out[i] += kernel[i] * delta;
+    }
+
+    m_End = std::max(m_End, index + s_Width);
+}
+
+void BlipBuffer::EndFrame(std::uint64_t clocks)
+{
+    std::uint64_t fixed = m_Offset + clocks * m_Factor;
+    m_Available += static_cast<std::size_t>(fixed >> s_TimeBits);
+    m_Offset = fixed & ((1ull << s_TimeBits) - 1);
+
+    if (m_Available > s_MaxAvailable)
+    {
+        ReadSamples(nullptr, m_Available - s_MaxAvailable);
+    }
+}
+
+std::size_t BlipBuffer::GetSamplesAvailable() const
+{
+    return m_Available;
+}
+
+std::size_t BlipBuffer::ReadSamples(std::int16_t *output, std::size_t count)
+{
+    count = std::min(count, m_Available);
+    std::int32_t sum = m_Integrator;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        sum += m_Buffer[i];
+        std::int32_t sample = std::clamp(sum >> s_DeltaBits, -32768, 32767);
+
+        if (output)
+        {
+            output[i] = static_cast<std::int16_t>(sample);
+        }
+
+        sum -= sample * (1 << (s_DeltaBits - BassShift));
+    }
+
+    m_Integrator = sum;
+
+    // Only the pending samples and the tail of the last steps are still in use
+    std::size_t used = std::max(m_End, m_Available);
+    std::copy(m_Buffer.begin() + count, m_Buffer.begin() + used, m_Buffer.begin());
+    std::fill(m_Buffer.begin() + (used - count), m_Buffer.begin() + used, 0);
+    m_Available -= count;
+    m_End = used - count;
+
+    return count;
+}
@@ -0,0 +1,57 @@
+#ifndef BLIPBUFFER_HPP
+#define BLIPBUFFER_HPP
+
+#include "../Types.hpp"
+#include <cstddef>
+#include <vector>
+
+/*
+   Band-limited step synthesis
+
+   The channels only report the changes of their output level (deltas) at
+   the clock they happen, each delta is spread over s_Width samples with a
+   windowed sinc step so that the output carries no aliasing. The buffer
+   holds the differences between consecutive samples and integrates them
+   when the samples are read, this also applies a light DC removal
+
+   Times are clocks since the beginning of the current frame, EndFrame
+   makes the samples of the frame readable and starts the next one
+ */
+class BlipBuffer
+{
+public:
+    BlipBuffer();
+
+    void SetRates(double clockRate, double sampleRate);
+    void Clear();
+
+    void AddDelta(std::uint64_t time, int delta);
+    void EndFrame(std::uint64_t clocks);
+
+    std::size_t GetSamplesAvailable() const;
+    // Returns the amount of samples read, a null output discards them
+    std::size_t ReadSamples(std::int16_t *output, std::size_t count);
+
+    static constexpr int s_Width = 16;
+    static constexpr int s_PhaseBits = 6;
+    static constexpr int s_DeltaBits = 14;
+
+private:
+    static constexpr int s_TimeBits = 32;
+    static constexpr std::size_t s_Size = 1 << 15;
+    // Readable samples kept at most, the oldest are dropped when nobody reads them
+    static constexpr std::size_t s_MaxAvailable = s_Size - 8192;
+
+    // Samples per clock in 32.32 fixed point
+    std::uint64_t m_Factor;
+    // Position of the frame start within the first pending sample
+    std::uint64_t m_Offset;
+    std::size_t m_Available;
+    // End of the samples touched by the steps so far
+    std::size_t m_End;
+    std::int32_t m_Integrator;
+
+    std::vector<std::int32_t> m_Buffer;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "AudioStream.hpp"
+#include <algorithm>
+
+AudioStream::AudioStream(double inputRate, double outputRate, std::size_t capacity)
+    : m_Resampler(inputRate, outputRate), m_Ring(capacity), m_RateControl(true), m_Adjust(1.0)
+{
+}
+
+void AudioStream::Push(const std::int16_t *samples, std::size_t count)
+{
+    if (m_RateControl)
+    {
+        double fill = static_cast<double>(m_Ring.GetFill()) / m_Ring.GetCapacity();
+        m_Adjust = 1.0 + s_MaxAdjust * (1.0 - 2.0 * fill);
+        m_Resampler.SetRatioAdjust(m_Adjust);
+    }
+
+    m_Scratch.resize(m_Resampler.GetMaxOutput(count));
+    std::size_t produced = m_Resampler.Process(samples, count, m_Scratch.data(), m_Scratch.size());
+    m_Ring.Write(m_Scratch.data(), produced);
+}
+
+std::size_t AudioStream::Pull(std::int16_t *samples, std::size_t count)
+{
+    std::size_t read = m_Ring.Read(samples, count);
+    std::fill(samples + read, samples + count, 0);
+    return read;
+}
+
+void AudioStream::SetRateControl(bool enabled)
+{
+    m_RateControl = enabled;
+    m_Adjust = 1.0;
+    m_Resampler.SetRatioAdjust(m_Adjust);
+}
+
+double AudioStream::GetRatioAdjust() const
+{
+    return m_Adjust;
+}
+
+std::size_t AudioStream::GetFill() const
+{
+    return m_Ring.GetFill();
+}
+
+std::size_t AudioStream::GetCapacity() const
+{
+    return m_Ring.GetCapacity();
+}
@@ -0,0 +1,48 @@
+#ifndef AUDIOSTREAM_HPP
+#define AUDIOSTREAM_HPP
+
+#include "Resampler.hpp"
+#include "SampleRing.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+   Hand-off of the APU samples to the audio device
+
+   The emulation thread pushes the samples at the APU rate, they are
+   resampled to the device rate and queued in a lock-free ring that the
+   device callback drains. Neither side blocks: an overflow drops samples
+   and an underrun plays silence.
+
+   The emulation and the device run on different clocks, the rate control
+   keeps the ring half full by scaling the resampling ratio by at most
+   s_MaxAdjust: more output when the ring runs low, less when it fills up
+ */
+class AudioStream
+{
+public:
+    AudioStream(double inputRate, double outputRate, std::size_t capacity);
+
+    // Emulation thread
+    void Push(const std::int16_t *samples, std::size_t count);
+    // Device thread, pads with silence on underrun and returns the amount of real samples
+    std::size_t Pull(std::int16_t *samples, std::size_t count);
+
+    // Sinks consuming everything right away (files) have no clock to track
+    void SetRateControl(bool enabled);
+    double GetRatioAdjust() const;
+    std::size_t GetFill() const;
+    std::size_t GetCapacity() const;
+
+    static constexpr double s_MaxAdjust = 0.005;
+
+private:
+    Resampler m_Resampler;
+    SampleRing m_Ring;
+    std::vector<std::int16_t> m_Scratch;
+    bool m_RateControl;
+    double m_Adjust;
+};
+
+#endif
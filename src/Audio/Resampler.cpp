@@ -0,0 +1,145 @@
+#include "Resampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NES_RESAMPLER_SSE2
+#endif
+
+Resampler::Resampler(double inputRate, double outputRate)
+{
+    SetRates(inputRate, outputRate);
+}
+
+void Resampler::SetRates(double inputRate, double outputRate)
+{
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr int HalfTaps = s_Taps / 2;
+
+    m_InputRate = inputRate;
+    m_OutputRate = outputRate;
+    SetRatioAdjust(1.0);
+
+    // Cutoff in cycles per input sample, with some room for the transition band
+    double cutoff = 0.45 * std::min(1.0, outputRate / inputRate);
+
+    m_Kernel.assign((s_Phases + 1) * s_Taps, 0.0f);
+
+    for (int phase = 0; phase <= s_Phases; phase++)
+    {
+        float *row = &m_Kernel[phase * s_Taps];
+        double total = 0.0;
+        double taps[s_Taps];
+
+        for (int i = 0; i < s_Taps; i++)
+        {
+            double x = i - (HalfTaps - 1) - static_cast<double>(phase) / s_Phases;
+            double sinc = x == 0.0 ? 1.0 : std::sin(2.0 * Pi * cutoff * x) / (2.0 * Pi * cutoff * x);
+            double window = std::fabs(x) >= HalfTaps ? 0.0
+                                                     : 0.42 + 0.5 * std::cos(Pi * x / HalfTaps) +
+                                                           0.08 * std::cos(2.0 * Pi * x / HalfTaps);
+
+            taps[i] = sinc * window;
+            total += taps[i];
+        }
+
+        // Unity gain at DC for every phase
+        for (int i = 0; i < s_Taps; i++)
+        {
+            row[i] = static_cast<float>(taps[i] / total);
+        }
+    }
+
+    Clear();
+}
+
+void Resampler::SetRatioAdjust(double adjust)
+{
+    m_Step = m_InputRate / (m_OutputRate * adjust);
+}
+
+void Resampler::Clear()
+{
+    // The first output is centered on the first input sample
+    m_History.assign(s_Taps / 2 - 1, 0.0f);
+    m_Position = 0.0;
+}
+
+std::size_t Resampler::GetMaxOutput(std::size_t inputCount) const
+{
+    return static_cast<std::size_t>((m_History.size() + inputCount) / m_Step) + 1;
+}
+
+std::size_t Resampler::Process(const std::int16_t *input, std::size_t count, std::int16_t *output,
+                               std::size_t capacity)
+{
+    std::size_t base = m_History.size();
+    m_History.resize(base + count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        m_History[base + i] = input[i];
+    }
+
+    std::size_t produced = 0;
+
+    while (produced < capacity)
+    {
+        std::size_t index = static_cast<std::size_t>(m_Position);
+
+        if (index + s_Taps > m_History.size())
+        {
+            break;
+        }
+
+        float sample = Convolve(&m_History[index], (m_Position - index) * s_Phases);
+        output[produced++] = static_cast<std::int16_t>(std::clamp(std::lrint(sample), -32768l, 32767l));
+        m_Position += m_Step;
+    }
+
+    // Drop the samples no window will start on anymore
+    std::size_t consumed = std::min(static_cast<std::size_t>(m_Position), m_History.size());
+    m_History.erase(m_History.begin(), m_History.begin() + consumed);
+    m_Position -= consumed;
+
+    return produced;
+}
+
+float Resampler::Convolve(const float *input, double phase) const
+{
+    int row = static_cast<int>(phase);
+    float weight = static_cast<float>(phase - row);
+    const float *first = &m_Kernel[row * s_Taps];
+    const float *second = first + s_Taps;
+
+#ifdef NES_RESAMPLER_SSE2
+    __m128 sumFirst = _mm_setzero_ps();
+    __m128 sumSecond = _mm_setzero_ps();
+
+    for (int i = 0; i < s_Taps; i += 4)
+    {
+        __m128 samples = _mm_loadu_ps(input + i);
+        sumFirst = _mm_add_ps(sumFirst, _mm_mul_ps(samples, _mm_loadu_ps(first + i)));
+        sumSecond = _mm_add_ps(sumSecond, _mm_mul_ps(samples, _mm_loadu_ps(second + i)));
+    }
+
+    // Interpolate between both phases then add the four lanes
+    __m128 sum = _mm_add_ps(sumFirst, _mm_mul_ps(_mm_sub_ps(sumSecond, sumFirst), _mm_set1_ps(weight)));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+
+    return _mm_cvtss_f32(sum);
+#else
+    float sumFirst = 0.0f;
+    float sumSecond = 0.0f;
+
+    for (int i = 0; i < s_Taps; i++)
+    {
+        sumFirst += input[i] * first[i];
+        sumSecond += input[i] * second[i];
+    }
+
+    return sumFirst + (sumSecond - sumFirst) * weight;
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef RESAMPLER_HPP
+#define RESAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+   Streaming sample rate converter
+
+   Polyphase windowed-sinc FIR, the phases are interpolated linearly so that
+   the ratio can take any value and be nudged while running. The kernel is
+   low-passed below the lower of both Nyquist frequencies. The convolutions
+   use SSE2 when available and a scalar loop otherwise
+ */
+class Resampler
+{
+public:
+    Resampler(double inputRate, double outputRate);
+
+    void SetRates(double inputRate, double outputRate);
+    // Scale the output rate by a factor close to 1, used to track the consumer clock
+    void SetRatioAdjust(double adjust);
+    void Clear();
+
+    // Upper bound of the samples produced by Process for the given input
+    std::size_t GetMaxOutput(std::size_t inputCount) const;
+    /*
+       Consume the whole input and return the amount of samples produced,
+       input left over for lack of output space stays queued
+     */
+    std::size_t Process(const std::int16_t *input, std::size_t count, std::int16_t *output, std::size_t capacity);
+
+    static constexpr int s_Taps = 32;
+    static constexpr int s_Phases = 64;
+
+private:
+    float Convolve(const float *input, double phase) const;
+
+    double m_InputRate;
+    double m_OutputRate;
+    // Input samples per output sample
+    double m_Step;
+    // Fractional position of the next output within m_History
+    double m_Position;
+
+    std::vector<float> m_History;
+    // s_Phases + 1 rows of s_Taps coefficients, the last row closes the interpolation
+    std::vector<float> m_Kernel;
+};
+
+#endif
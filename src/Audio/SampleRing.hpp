@@ -0,0 +1,85 @@
+#ifndef SAMPLERING_HPP
+#define SAMPLERING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+/*
+   Single producer single consumer sample queue
+
+   Lock free, neither side ever waits: the producer drops what does not fit
+   and the consumer gets what is there. Each index is only written by its
+   own side, the acquire/release pairs publish the samples. The capacity
+   is a power of two so that the indices simply wrap around
+ */
+class SampleRing
+{
+public:
+    SampleRing(std::size_t capacity)
+        : m_Samples(capacity), m_Mask(capacity - 1), m_Head(0), m_Tail(0)
+    {
+        if (capacity == 0 || (capacity & m_Mask) != 0)
+        {
+            throw std::runtime_error("Sample ring capacity must be a power of two");
+        }
+    }
+
+    // Producer side, returns the amount of samples queued
+    std::size_t Write(const std::int16_t *samples, std::size_t count)
+    {
+        std::size_t head = m_Head.load(std::memory_order_relaxed);
+        std::size_t tail = m_Tail.load(std::memory_order_acquire);
+        count = std::min(count, m_Samples.size() - (head - tail));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            m_Samples[(head + i) & m_Mask] = samples[i];
+        }
+
+        m_Head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side, returns the amount of samples dequeued
+    std::size_t Read(std::int16_t *samples, std::size_t count)
+    {
+        std::size_t tail = m_Tail.load(std::memory_order_relaxed);
+        std::size_t head = m_Head.load(std::memory_order_acquire);
+        count = std::min(count, head - tail);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            samples[i] = m_Samples[(tail + i) & m_Mask];
+        }
+
+        m_Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Either side, a snapshot that may be outdated as soon as it is returned
+    std::size_t GetFill() const
+    {
+        // The tail first, it can not move past the head loaded afterwards
+        std::size_t tail = m_Tail.load(std::memory_order_acquire);
+        return m_Head.load(std::memory_order_acquire) - tail;
+    }
+
+    std::size_t GetCapacity() const
+    {
+        return m_Samples.size();
+    }
+
+private:
+    std::vector<std::int16_t> m_Samples;
+    std::size_t m_Mask;
+
+    // Kept on their own cache lines so that both threads do not fight over them
+    alignas(64) std::atomic<std::size_t> m_Head;
+    alignas(64) std::atomic<std::size_t> m_Tail;
+};
+
+#endif
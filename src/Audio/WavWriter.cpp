@@ -0,0 +1,126 @@
+#include "WavWriter.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+void Put16(std::ofstream &file, DWord value)
+{
+    char bytes[2] = {static_cast<char>(value), static_cast<char>(value >> 8)};
+    file.write(bytes, sizeof(bytes));
+}
+
+Word *Put16(Word *header, DWord value)
+{
+    *header++ = static_cast<Word>(value);
+    *header++ = static_cast<Word>(value >> 8);
+    return header;
+}
+
+Word *Put32(Word *header, QWord value)
+{
+    return Put16(Put16(header, static_cast<DWord>(value)), static_cast<DWord>(value >> 16));
+}
+
+Word *PutTag(Word *header, const char *tag)
+{
+    return std::copy(tag, tag + 4, header);
+}
+} // namespace
+
+WavWriter::WavWriter(const std::string &path, QWord sampleRate, Format format)
+    : m_File(path, std::ios::binary), m_SampleRate(sampleRate), m_Format(format), m_SampleCount(0)
+{
+    if (!m_File)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    if (m_Format == Format::Wav)
+    {
+        // Placeholder sizes until Close
+        WriteHeader();
+    }
+}
+
+WavWriter::~WavWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void WavWriter::Write(const std::int16_t *samples, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        Put16(m_File, static_cast<DWord>(samples[i]));
+    }
+
+    m_SampleCount += count;
+
+    if (!m_File)
+    {
+        throw std::runtime_error("Could not write the audio samples");
+    }
+}
+
+void WavWriter::Close()
+{
+    if (!m_File.is_open())
+    {
+        return;
+    }
+
+    if (m_Format == Format::Wav)
+    {
+        m_File.seekp(0);
+        WriteHeader();
+    }
+
+    m_File.close();
+
+    if (!m_File)
+    {
+        throw std::runtime_error("Could not write the audio samples");
+    }
+}
+
+std::size_t WavWriter::GetSampleCount() const
+{
+    return m_SampleCount;
+}
+
+std::array<Word, WavWriter::s_HeaderSize> WavWriter::MakeHeader(QWord sampleRate, std::size_t sampleCount)
+{
+    std::array<Word, s_HeaderSize> header;
+    QWord dataSize = static_cast<QWord>(sampleCount * sizeof(std::int16_t));
+
+    Word *data = PutTag(header.data(), "RIFF");
+    data = Put32(data, static_cast<QWord>(s_HeaderSize - 8 + dataSize));
+    data = PutTag(data, "WAVE");
+
+    data = PutTag(data, "fmt ");
+    data = Put32(data, 16);
+    // PCM, mono, 16 bits
+    data = Put16(data, 1);
+    data = Put16(data, 1);
+    data = Put32(data, sampleRate);
+    data = Put32(data, sampleRate * sizeof(std::int16_t));
+    data = Put16(data, sizeof(std::int16_t));
+    data = Put16(data, 16);
+
+    data = PutTag(data, "data");
+    Put32(data, dataSize);
+    return header;
+}
+
+void WavWriter::WriteHeader()
+{
+    std::array<Word, s_HeaderSize> header = MakeHeader(m_SampleRate, m_SampleCount);
+    m_File.write(reinterpret_cast<const char *>(header.data()), header.size());
+}
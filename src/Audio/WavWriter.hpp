@@ -0,0 +1,51 @@
+#ifndef WAVWRITER_HPP
+#define WAVWRITER_HPP
+
+#include "../Types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/*
+   Headless audio sink
+
+   Writes signed 16 bits mono samples either as a WAV file or as raw
+   little endian PCM. The WAV sizes are patched when the file is closed,
+   throws std::runtime_error when the file can not be written
+ */
+class WavWriter
+{
+public:
+    enum class Format
+    {
+        Wav,
+        Raw,
+    };
+
+    WavWriter(const std::string &path, QWord sampleRate, Format format = Format::Wav);
+    ~WavWriter();
+
+    WavWriter(const WavWriter &) = delete;
+    WavWriter &operator=(const WavWriter &) = delete;
+
+    void Write(const std::int16_t *samples, std::size_t count);
+    void Close();
+
+    std::size_t GetSampleCount() const;
+
+    static constexpr std::size_t s_HeaderSize = 44;
+    // WAV header of a mono 16 bits file holding the given amount of samples
+    static std::array<Word, s_HeaderSize> MakeHeader(QWord sampleRate, std::size_t sampleCount);
+
+private:
+    void WriteHeader();
+
+    std::ofstream m_File;
+    QWord m_SampleRate;
+    Format m_Format;
+    std::size_t m_SampleCount;
+};
+
+#endif
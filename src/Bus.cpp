@@ -1,5 +1,373 @@
 #include "Bus.hpp"
+#include "PerfCounters.hpp"
+#include "State.hpp"
+#include <filesystem>
 
 Bus::Bus()
-    : m_Cpu(m_Ram), m_Ppu(m_Ram)
-{}
+    : m_Memory(*this), m_Cpu(m_Memory), m_Apu(m_Memory), m_PerfCounters(nullptr)
+{
+    m_Ppu.SetCpu(&m_Cpu);
+
+    // The 2 KiB of work RAM are mirrored four times
+    for (std::size_t mirror = 0; mirror < 4; mirror++)
+    {
+        std::size_t first = mirror * (RamSize / MemoryMap::s_PageSize);
+        m_Memory.MapRead(first, RamSize / MemoryMap::s_PageSize, m_Ram.GetData());
+        m_Memory.MapWrite(first, RamSize / MemoryMap::s_PageSize, m_Ram.GetData());
+    }
+}
+
+void Bus::LoadCartridge(std::unique_ptr<Cartridge> cartridge)
+{
+    std::unique_ptr<Mapper> mapper = Mapper::Create(*cartridge);
+
+    m_Cpu.SetCodeCache(nullptr);
+    m_CodeCache.reset();
+    m_Cartridge = std::move(cartridge);
+    m_Mapper = std::move(mapper);
+    m_Cheats.Invalidate();
+    m_Ppu.SetMapper(m_Mapper.get());
+
+    MapCartridge();
+    Reset();
+}
+
+void Bus::OpenSaveFile(const std::string &path, bool shared)
+{
+    m_Cartridge->OpenSaveFile(path, shared);
+    // The RAM moved
+    MapCartridge();
+}
+
+bool Bus::LoadCodeCache(const std::string &directory, const CoverageMap *coverage)
+{
+    std::unique_ptr<CodeCache> cache = std::make_unique<CodeCache>(*m_Cartridge);
+    std::string path = (std::filesystem::path(directory) / cache->GetFileName()).string();
+    bool loaded = !coverage && cache->Load(path, m_Cpu);
+
+    if (!loaded)
+    {
+        // The banks of the power on, whatever the game did since
+        std::unique_ptr<Mapper> mapper = Mapper::Create(*m_Cartridge);
+        mapper->Reset();
+        cache->Analyze(*mapper, m_Cpu, coverage);
+
+        std::filesystem::create_directories(directory);
+        cache->Save(path);
+    }
+
+    m_CodeCache = std::move(cache);
+    m_Cpu.SetCodeCache(m_CodeCache.get());
+    return loaded;
+}
+
+const CodeCache *Bus::GetCodeCache() const
+{
+    return m_CodeCache.get();
+}
+
+void Bus::SetPerfCounters(PerfCounters *counters)
+{
+    m_PerfCounters = counters;
+    m_Ppu.SetPerfCounters(counters);
+}
+
+void Bus::SetCoverageMap(CoverageMap *coverage)
+{
+    m_Cpu.SetCoverageMap(coverage);
+    m_Apu.SetCoverageMap(coverage);
+}
+
+void Bus::Reset()
+{
+    m_Ram.Clear();
+    m_Ppu.Reset();
+
+    if (m_Mapper)
+    {
+        m_Mapper->Reset();
+        MapCartridge();
+    }
+
+    m_Cpu.Reset();
+    m_Apu.Reset(m_Cpu.GetCycles());
+    m_Cpu.SetIrqLine(Cpu::InterruptApu, m_Apu.GetIrq());
+}
+
+void Bus::Clock()
+{
+    m_Cpu.Clock();
+
+    if (m_Cpu.GetCycles() >= m_Apu.GetNextEventCycle())
+    {
+        PerfCounters::Scope scope(m_PerfCounters, PerfCounters::Apu);
+        m_Apu.RunUntil(m_Cpu.GetCycles());
+        SyncApu();
+    }
+
+    m_Ppu.Clock();
+    m_Ppu.Clock();
+    m_Ppu.Clock();
+}
+
+void Bus::StepFrame()
+{
+    if (m_PerfCounters)
+    {
+        m_PerfCounters->BeginFrame();
+    }
+
+    while (!m_Ppu.PollFrameComplete())
+    {
+        Clock();
+    }
+
+    EndFrame();
+
+    if (m_PerfCounters)
+    {
+        m_PerfCounters->EndFrame();
+    }
+}
+
+void Bus::EndFrame()
+{
+    PerfCounters::Scope scope(m_PerfCounters, PerfCounters::Apu);
+    m_Apu.EndFrame(m_Cpu.GetCycles());
+    SyncApu();
+}
+
+void Bus::SetButtons(std::size_t port, Word buttons)
+{
+    m_Controllers[port].SetButtons(buttons);
+}
+
+void Bus::AddCheat(const CheatEngine::Cheat &cheat)
+{
+    m_Cheats.Add(cheat);
+
+    if (m_Mapper)
+    {
+        MapCartridge();
+    }
+}
+
+void Bus::ClearCheats()
+{
+    m_Cheats.Clear();
+
+    if (m_Mapper)
+    {
+        MapCartridge();
+    }
+}
+
+const std::vector<CheatEngine::Cheat> &Bus::GetCheats() const
+{
+    return m_Cheats.GetCheats();
+}
+
+Word Bus::Peek(DWord address) const
+{
+    const Word *page = m_Memory.GetMappedReadPage(address >> 8);
+    return page ? page[address & 0xFF] : 0x00;
+}
+
+Word Bus::Read(DWord address)
+{
+    PerfCounters::Scope scope(m_PerfCounters, PerfCounters::BusIo);
+
+    if (address >= 0x2000 && address < 0x4000)
+    {
+        return m_Ppu.ReadRegister(address);
+    }
+
+    switch (address)
+    {
+    case 0x4015: {
+        PerfCounters::Scope apuScope(m_PerfCounters, PerfCounters::Apu);
+        Word status = m_Apu.ReadStatus(m_Cpu.GetCycles());
+        SyncApu();
+        return status;
+    }
+    case 0x4016:
+    case 0x4017:
+        // The upper bits are open bus, usually the high byte of the address
+        return m_Controllers[address & 0x01].Read() | 0x40;
+    }
+
+    // Open bus approximation
+    return address >> 8;
+}
+
+void Bus::Write(DWord address, Word value)
+{
+    PerfCounters::Scope scope(m_PerfCounters, PerfCounters::BusIo);
+
+    if (address >= 0x2000 && address < 0x4000)
+    {
+        m_Ppu.WriteRegister(address, value);
+    }
+    else if (address == 0x4014)
+    {
+        OamDma(value);
+    }
+    else if ((address >= 0x4000 && address < 0x4014) || address == 0x4015 || address == 0x4017)
+    {
+        PerfCounters::Scope apuScope(m_PerfCounters, PerfCounters::Apu);
+        m_Apu.WriteRegister(address, value, m_Cpu.GetCycles());
+        SyncApu();
+    }
+    else if (address == 0x4016)
+    {
+        m_Controllers[0].Write(value);
+        m_Controllers[1].Write(value);
+    }
+    else if (address >= 0x8000 && m_Mapper)
+    {
+        m_Mapper->Write(address, value);
+        MapCartridge();
+    }
+}
+
+Cpu &Bus::GetCpu()
+{
+    return m_Cpu;
+}
+
+Ppu &Bus::GetPpu()
+{
+    return m_Ppu;
+}
+
+Apu &Bus::GetApu()
+{
+    return m_Apu;
+}
+
+MemoryMap &Bus::GetMemory()
+{
+    return m_Memory;
+}
+
+Cartridge *Bus::GetCartridge()
+{
+    return m_Cartridge.get();
+}
+
+Mapper *Bus::GetMapper()
+{
+    return m_Mapper.get();
+}
+
+void Bus::MapCartridge()
+{
+    constexpr std::size_t PagesPerWindow = Mapper::s_PrgWindowSize / MemoryMap::s_PageSize;
+
+    Word *prgRam = m_Cartridge->GetPrgRam();
+    m_Memory.MapRead(0x60, Cartridge::s_PrgRamSize / MemoryMap::s_PageSize, prgRam);
+    m_Memory.MapWrite(0x60, Cartridge::s_PrgRamSize / MemoryMap::s_PageSize, prgRam);
+
+    const Word *prg = m_Cartridge->GetPrg().data();
+
+    for (std::size_t window = 0; window < Mapper::s_PrgWindowCount; window++)
+    {
+        m_Memory.MapRead(0x80 + window * PagesPerWindow, PagesPerWindow, prg + m_Mapper->GetPrgOffset(window));
+    }
+
+    // Patched copies over the pages just mapped
+    m_Cheats.Apply(m_Memory);
+
+    m_Ppu.UpdatePages();
+}
+
+void Bus::OamDma(Word page)
+{
+    const Word *source = m_Memory.GetReadPage(page);
+
+    if (source)
+    {
+        m_Ppu.WriteOam(source);
+    }
+    else
+    {
+        // Registers and watched pages are read byte by byte
+        for (DWord offset = 0; offset < 256; offset++)
+        {
+            m_Ppu.WriteOam(m_Memory.Read((page << 8) | offset));
+        }
+    }
+
+    // An additional alignment cycle is needed when the transfer starts on an odd cycle
+    m_Cpu.Stall(513 + (m_Cpu.GetCycles() & 0x01));
+
+    // The cpu is already halted for the DMC fetches landing within the transfer, each only takes 2 cycles
+    if (m_Apu.GetNextEventCycle() <= m_Cpu.GetCycles())
+    {
+        m_Apu.RunUntil(m_Cpu.GetCycles());
+        m_Cpu.Stall(m_Apu.TakeStallCycles() / 2);
+        m_Cpu.SetIrqLine(Cpu::InterruptApu, m_Apu.GetIrq());
+    }
+}
+
+void Bus::SyncApu()
+{
+    QWord cycles = m_Apu.TakeStallCycles();
+
+    if (cycles > 0)
+    {
+        m_Cpu.Stall(cycles);
+    }
+
+    m_Cpu.SetIrqLine(Cpu::InterruptApu, m_Apu.GetIrq());
+}
+
+void Bus::SaveState(StateWriter &writer) const
+{
+    m_Cpu.SaveState(writer);
+    m_Ram.SaveState(writer);
+    m_Ppu.SaveState(writer);
+    m_Apu.SaveState(writer);
+
+    for (const Controller &controller : m_Controllers)
+    {
+        controller.SaveState(writer);
+    }
+
+    if (m_Mapper)
+    {
+        m_Mapper->SaveState(writer);
+        writer.WriteBytes(m_Cartridge->GetPrgRam(), Cartridge::s_PrgRamSize);
+
+        if (m_Cartridge->HasChrRam())
+        {
+            writer.WriteBytes(m_Cartridge->GetChr().data(), m_Cartridge->GetChr().size());
+        }
+    }
+}
+
+void Bus::LoadState(StateReader &reader)
+{
+    m_Cpu.LoadState(reader);
+    m_Ram.LoadState(reader);
+    m_Ppu.LoadState(reader);
+    m_Apu.LoadState(reader);
+
+    for (Controller &controller : m_Controllers)
+    {
+        controller.LoadState(reader);
+    }
+
+    if (m_Mapper)
+    {
+        m_Mapper->LoadState(reader);
+        reader.ReadBytes(m_Cartridge->GetPrgRam(), Cartridge::s_PrgRamSize);
+
+        if (m_Cartridge->HasChrRam())
+        {
+            reader.ReadBytes(m_Cartridge->GetChr().data(), m_Cartridge->GetChr().size());
+        }
+
+        MapCartridge();
+    }
+}
@@ -1,19 +1,116 @@
 #ifndef BUS_HPP
 #define BUS_HPP
 
+#include "Cartridge.hpp"
+#include "Cheats.hpp"
+#include "Controller.hpp"
+#include "MemoryMap.hpp"
 #include "Ram.hpp"
+#include "Apu/Apu.hpp"
+#include "Cpu/CodeCache.hpp"
 #include "Cpu/Cpu.hpp"
+#include "Mapper/Mapper.hpp"
 #include "Ppu.hpp"
+#include <array>
+#include <memory>
 
-class Bus
+class CoverageMap;
+class PerfCounters;
+class StateWriter;
+class StateReader;
+
+/*
+   System bus
+
+   Owns the components of the console and wires the CPU address space:
+   $0000-$1FFF  work RAM, mirrored every 2 KiB
+   $2000-$3FFF  PPU registers, mirrored every 8 bytes
+   $4000-$401F  APU and I/O registers
+   $6000-$7FFF  cartridge work RAM
+   $8000-$FFFF  cartridge PRG ROM, writes reach the mapper registers
+   RAM and cartridge pages are mapped directly, the others land on Read/Write
+ */
+class Bus : public MemoryHandler
 {
 public:
     Bus();
-    
+
+    void LoadCartridge(std::unique_ptr<Cartridge> cartridge);
+    // Back the cartridge work RAM with a save file, see SaveRam
+    void OpenSaveFile(const std::string &path, bool shared);
+    void Reset();
+
+    /*
+       Pre-decode the code of the cartridge, see CodeCache. The analysis is
+       kept in the directory under the hash of the rom, returns whether it
+       was found there rather than performed. A coverage map extends the
+       analysis with the code it saw executing, which is then always
+       performed again
+     */
+    bool LoadCodeCache(const std::string &directory, const CoverageMap *coverage = nullptr);
+    const CodeCache *GetCodeCache() const;
+
+    /*
+       Count the host events of every frame run by StepFrame, split between
+       the cpu core, the ppu render, the apu and the register accesses.
+       Passing nullptr detaches the counters, see PerfCounters
+     */
+    void SetPerfCounters(PerfCounters *counters);
+
+    // Classify the PRG bytes executed and read by the cpu and the DMC, nullptr detaches the map
+    void SetCoverageMap(CoverageMap *coverage);
+
+    // Advance the whole system by one cpu cycle
+    void Clock();
+    // Run until the ppu enters the next vblank
+    void StepFrame();
+    // Frame boundary work once the vblank has been reached, for the callers clocking the bus themselves
+    void EndFrame();
+
+    void SetButtons(std::size_t port, Word buttons);
+
+    // ROM patches, kept across resets and state loads
+    void AddCheat(const CheatEngine::Cheat &cheat);
+    void ClearCheats();
+    const std::vector<CheatEngine::Cheat> &GetCheats() const;
+
+    // Side effect free read for the tooling, memory mapped registers read as zero
+    Word Peek(DWord address) const;
+
+    Word Read(DWord address) override;
+    void Write(DWord address, Word value) override;
+
+    Cpu &GetCpu();
+    Ppu &GetPpu();
+    Apu &GetApu();
+    MemoryMap &GetMemory();
+    Cartridge *GetCartridge();
+    Mapper *GetMapper();
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
 private:
+    // Refresh the cartridge pages after a bank switch
+    void MapCartridge();
+    void OamDma(Word page);
+    // Charge the DMC sample fetches to the cpu and forward the APU IRQ line, after each APU access
+    void SyncApu();
+
+    Ram m_Ram;
+    MemoryMap m_Memory;
     Cpu m_Cpu;
     Ppu m_Ppu;
-    Ram m_Ram;
-}; 
+    Apu m_Apu;
+    std::array<Controller, 2> m_Controllers;
+    CheatEngine m_Cheats;
+
+    std::unique_ptr<Cartridge> m_Cartridge;
+    std::unique_ptr<Mapper> m_Mapper;
+    // Refers to the PRG ROM of the cartridge
+    std::unique_ptr<CodeCache> m_CodeCache;
+
+    PerfCounters *m_PerfCounters;
+};
 
 #endif
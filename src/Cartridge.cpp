@@ -0,0 +1,123 @@
+#include "Cartridge.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::size_t HeaderSize = 16;
+constexpr std::size_t TrainerSize = 512;
+} // namespace
+
+Cartridge::Cartridge(const std::string &path)
+    : m_PrgRam(s_PrgRamSize)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open cartridge '" + path + "'");
+    }
+
+    m_Image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    Parse(m_Image.data(), m_Image.size());
+}
+
+Cartridge::Cartridge(const Word *data, std::size_t size)
+    : m_PrgRam(s_PrgRamSize), m_Image(data, data + size)
+{
+    Parse(data, size);
+}
+
+void Cartridge::Parse(const Word *data, std::size_t size)
+{
+    if (size < HeaderSize || std::memcmp(data, "NES\x1A", 4) != 0)
+    {
+        throw std::runtime_error("Invalid iNES header");
+    }
+
+    std::size_t prgSize = data[4] * s_PrgBankSize;
+    std::size_t chrSize = data[5] * s_ChrBankSize;
+    Word flags6 = data[6];
+    Word flags7 = data[7];
+
+    m_MapperId = (flags7 & 0xF0) | (flags6 >> 4);
+    m_Battery = flags6 & 0x02;
+
+    if (flags6 & 0x08)
+    {
+        m_Mirroring = Mirroring::FourScreen;
+    }
+    else
+    {
+        m_Mirroring = (flags6 & 0x01) ? Mirroring::Vertical : Mirroring::Horizontal;
+    }
+
+    std::size_t offset = HeaderSize + ((flags6 & 0x04) ? TrainerSize : 0);
+
+    if (prgSize == 0 || offset + prgSize + chrSize > size)
+    {
+        throw std::runtime_error("Truncated iNES image");
+    }
+
+    m_Prg.assign(data + offset, data + offset + prgSize);
+    offset += prgSize;
+
+    // Cartridges without CHR ROM come with 8 KiB of CHR RAM
+    m_ChrRam = chrSize == 0;
+
+    if (m_ChrRam)
+    {
+        m_Chr.assign(s_ChrBankSize, 0x00);
+    }
+    else
+    {
+        m_Chr.assign(data + offset, data + offset + chrSize);
+    }
+}
+
+const std::vector<Word> &Cartridge::GetPrg() const
+{
+    return m_Prg;
+}
+
+std::vector<Word> &Cartridge::GetChr()
+{
+    return m_Chr;
+}
+
+Word *Cartridge::GetPrgRam()
+{
+    return m_PrgRam.GetData();
+}
+
+void Cartridge::OpenSaveFile(const std::string &path, bool shared)
+{
+    m_PrgRam.Open(path, shared);
+}
+
+const std::vector<Word> &Cartridge::GetImage() const
+{
+    return m_Image;
+}
+
+Word Cartridge::GetMapperId() const
+{
+    return m_MapperId;
+}
+
+Mirroring Cartridge::GetMirroring() const
+{
+    return m_Mirroring;
+}
+
+bool Cartridge::HasBattery() const
+{
+    return m_Battery;
+}
+
+bool Cartridge::HasChrRam() const
+{
+    return m_ChrRam;
+}
@@ -1,4 +1,69 @@
 #ifndef CARTRIDGE_HPP
 #define CARTRIDGE_HPP
 
+#include "SaveRam.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+enum class Mirroring
+{
+    Horizontal,
+    Vertical,
+    SingleLower,
+    SingleUpper,
+    FourScreen,
+};
+
+/*
+   iNES cartridge image
+
+   Holds the PRG (program) and CHR (graphics) memories described by the
+   16 bytes iNES header, throws std::runtime_error on malformed images
+ */
+class Cartridge
+{
+public:
+    Cartridge(const std::string &path);
+    Cartridge(const Word *data, std::size_t size);
+
+    Cartridge(const Cartridge &) = delete;
+    Cartridge &operator=(const Cartridge &) = delete;
+
+    const std::vector<Word> &GetPrg() const;
+    std::vector<Word> &GetChr();
+    // $6000-$7FFF work RAM, s_PrgRamSize bytes which move when a save file is opened
+    Word *GetPrgRam();
+    // Back the work RAM with a save file, see SaveRam
+    void OpenSaveFile(const std::string &path, bool shared);
+
+    // iNES image the cartridge was parsed from, to build identical ones
+    const std::vector<Word> &GetImage() const;
+
+    Word GetMapperId() const;
+    Mirroring GetMirroring() const;
+    // Whether the $6000-$7FFF PRG RAM is battery backed
+    bool HasBattery() const;
+    // Whether the CHR memory is writable RAM rather than ROM
+    bool HasChrRam() const;
+
+    static constexpr std::size_t s_PrgBankSize = 0x4000;
+    static constexpr std::size_t s_ChrBankSize = 0x2000;
+    static constexpr std::size_t s_PrgRamSize = 0x2000;
+
+private:
+    void Parse(const Word *data, std::size_t size);
+
+    std::vector<Word> m_Prg;
+    std::vector<Word> m_Chr;
+    SaveRam m_PrgRam;
+    std::vector<Word> m_Image;
+
+    Word m_MapperId;
+    Mirroring m_Mirroring;
+    bool m_Battery;
+    bool m_ChrRam;
+};
+
 #endif
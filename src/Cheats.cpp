@@ -0,0 +1,161 @@
+#include "Cheats.hpp"
+#include "MemoryMap.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace
+{
+constexpr char GameGenieLetters[] = "APZLGITYEOXUKSVN";
+constexpr DWord RomStart = 0x8000;
+
+int ParseHex(const std::string &text)
+{
+    // Negative chars are undefined behaviour for isxdigit
+    auto hex = [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; };
+
+    if (text.empty() || text.size() > 4 || !std::all_of(text.begin(), text.end(), hex))
+    {
+        return -1;
+    }
+
+    return (int)std::strtol(text.c_str(), nullptr, 16);
+}
+} // namespace
+
+CheatEngine::Cheat CheatEngine::Parse(const std::string &code)
+{
+    std::size_t colon = code.find(':');
+
+    if (colon != std::string::npos)
+    {
+        std::size_t question = code.find('?');
+        bool compared = question != std::string::npos && question < colon;
+
+        Cheat cheat;
+        int address = ParseHex(code.substr(0, compared ? question : colon));
+        int value = ParseHex(code.substr(colon + 1));
+        cheat.compare = compared ? ParseHex(code.substr(question + 1, colon - question - 1)) : -1;
+
+        if (address < RomStart || value < 0 || value > 0xFF ||
+            (compared && (cheat.compare < 0 || cheat.compare > 0xFF)))
+        {
+            throw std::runtime_error("Invalid cheat '" + code + "', expected AAAA:VV or AAAA?CC:VV within $8000-$FFFF");
+        }
+
+        cheat.address = address;
+        cheat.value = value;
+        return cheat;
+    }
+
+    if (code.size() != 6 && code.size() != 8)
+    {
+        throw std::runtime_error("Invalid Game Genie code '" + code + "'");
+    }
+
+    std::array<Word, 8> n{};
+
+    for (std::size_t i = 0; i < code.size(); i++)
+    {
+        const char *letter = std::strchr(GameGenieLetters, std::toupper((unsigned char)code[i]));
+
+        if (!letter || !*letter)
+        {
+            throw std::runtime_error("Invalid Game Genie code '" + code + "'");
+        }
+
+        n[i] = letter - GameGenieLetters;
+    }
+
+    // The bits of the address and values are scattered over the letters
+    Cheat cheat;
+    cheat.address = RomStart | ((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8) | ((n[2] & 7) << 4) |
+                    ((n[1] & 8) << 4) | (n[4] & 7) | (n[3] & 8);
+    cheat.value = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7);
+
+    if (code.size() == 6)
+    {
+        cheat.value |= n[5] & 8;
+    }
+    else
+    {
+        cheat.value |= n[7] & 8;
+        cheat.compare = ((n[7] & 7) << 4) | ((n[6] & 8) << 4) | (n[6] & 7) | (n[5] & 8);
+    }
+
+    return cheat;
+}
+
+void CheatEngine::Add(const Cheat &cheat)
+{
+    if (cheat.address < RomStart)
+    {
+        throw std::runtime_error("Cheats only patch the cartridge ROM at $8000-$FFFF");
+    }
+
+    m_Cheats.push_back(cheat);
+    m_Pages.clear();
+}
+
+void CheatEngine::Clear()
+{
+    m_Cheats.clear();
+    m_Pages.clear();
+}
+
+const std::vector<CheatEngine::Cheat> &CheatEngine::GetCheats() const
+{
+    return m_Cheats;
+}
+
+void CheatEngine::Apply(MemoryMap &memory)
+{
+    for (const Cheat &cheat : m_Cheats)
+    {
+        std::size_t page = cheat.address >> 8;
+        const Word *source = memory.GetMappedReadPage(page);
+
+        if (!source)
+        {
+            continue;
+        }
+
+        auto [copy, created] = m_Pages.try_emplace({page, source});
+
+        // Built once per source page with all of its patches
+        if (created)
+        {
+            std::copy(source, source + copy->second.size(), copy->second.begin());
+
+            for (const Cheat &patch : m_Cheats)
+            {
+                Word &byte = copy->second[patch.address & 0xFF];
+
+                if ((patch.address >> 8) == page &&
+                    (patch.compare < 0 || source[patch.address & 0xFF] == patch.compare))
+                {
+                    byte = patch.value;
+                }
+            }
+        }
+    }
+
+    // Mapped once all the copies exist, the sources are read above
+    for (const Cheat &cheat : m_Cheats)
+    {
+        std::size_t page = cheat.address >> 8;
+        auto copy = m_Pages.find({page, memory.GetMappedReadPage(page)});
+
+        if (copy != m_Pages.end())
+        {
+            memory.MapRead(page, 1, copy->second.data());
+        }
+    }
+}
+
+void CheatEngine::Invalidate()
+{
+    m_Pages.clear();
+}
@@ -0,0 +1,57 @@
+#ifndef CHEATS_HPP
+#define CHEATS_HPP
+
+#include "Types.hpp"
+#include <array>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class MemoryMap;
+
+/*
+   Game Genie and raw ROM patches
+
+   Like the Game Genie the patches apply to CPU addresses in $8000-$FFFF
+   whatever bank is mapped there, optionally only when the ROM byte matches
+   a compare value. Instead of checking each read, the pages holding a
+   patch are replaced by a patched copy of the mapped ROM page, the copies
+   are kept per source page so that bank switches only swap pointers
+ */
+class CheatEngine
+{
+public:
+    struct Cheat
+    {
+        DWord address;
+        Word value;
+        // Byte the ROM must hold for the patch to apply, -1 to always apply
+        int compare = -1;
+    };
+
+    /*
+       Parse a 6 or 8 letters Game Genie code, or a raw patch written as
+       AAAA:VV or AAAA?CC:VV in hexadecimal. Throws std::runtime_error
+     */
+    static Cheat Parse(const std::string &code);
+
+    void Add(const Cheat &cheat);
+    void Clear();
+    const std::vector<Cheat> &GetCheats() const;
+
+    // Map the patched copies over the freshly mapped ROM pages holding a patch
+    void Apply(MemoryMap &memory);
+    // Drop the copies, the ROM they were made from is going away
+    void Invalidate();
+
+private:
+    using Page = std::array<Word, 256>;
+
+    std::vector<Cheat> m_Cheats;
+    // Patched copies by CPU page and source ROM page
+    std::map<std::pair<std::size_t, const Word *>, Page> m_Pages;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "Controller.hpp"
+#include "State.hpp"
+
+Controller::Controller()
+    : m_Buttons(0x00), m_Shift(0x00), m_Strobe(false)
+{
+}
+
+void Controller::SetButtons(Word buttons)
+{
+    m_Buttons = buttons;
+}
+
+Word Controller::GetButtons() const
+{
+    return m_Buttons;
+}
+
+void Controller::Write(Word value)
+{
+    m_Strobe = value & 0x01;
+
+    if (m_Strobe)
+    {
+        m_Shift = m_Buttons;
+    }
+}
+
+Word Controller::Read()
+{
+    if (m_Strobe)
+    {
+        return m_Buttons & 0x01;
+    }
+
+    Word bit = m_Shift & 0x01;
+    // Official controllers report 1 once all the buttons have been shifted out
+    m_Shift = (m_Shift >> 1) | 0x80;
+
+    return bit;
+}
+
+void Controller::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_Buttons);
+    writer.Write(m_Shift);
+    writer.Write(m_Strobe);
+}
+
+void Controller::LoadState(StateReader &reader)
+{
+    reader.Read(m_Buttons);
+    reader.Read(m_Shift);
+    reader.Read(m_Strobe);
+}
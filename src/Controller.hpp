@@ -0,0 +1,47 @@
+#ifndef CONTROLLER_HPP
+#define CONTROLLER_HPP
+
+#include "Types.hpp"
+
+class StateWriter;
+class StateReader;
+
+/*
+   Standard controller
+
+   The buttons are latched while the strobe is high then shifted out one
+   by one through $4016/$4017, in the order of the Button bits
+ */
+class Controller
+{
+public:
+    enum Button : Word
+    {
+        A = 1 << 0,
+        B = 1 << 1,
+        Select = 1 << 2,
+        Start = 1 << 3,
+        Up = 1 << 4,
+        Down = 1 << 5,
+        Left = 1 << 6,
+        Right = 1 << 7,
+    };
+
+    Controller();
+
+    void SetButtons(Word buttons);
+    Word GetButtons() const;
+
+    void Write(Word value);
+    Word Read();
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
+private:
+    Word m_Buttons;
+    Word m_Shift;
+    bool m_Strobe;
+};
+
+#endif
@@ -0,0 +1,492 @@
+#include "CodeCache.hpp"
+#include "Cpu.hpp"
+#include "CoverageMap.hpp"
+#include "../Cartridge.hpp"
+#include "../MemoryMap.hpp"
+#include "../State.hpp"
+#include "../Mapper/Mapper.hpp"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+constexpr char Magic[8] = "NESCODE";
+// Bumped whenever the analysis or the layout changes, older files are analyzed again
+constexpr QWord Version = 1;
+
+constexpr DWord NmiVector = 0xFFFA;
+constexpr DWord ResetVector = 0xFFFC;
+constexpr DWord IrqVector = 0xFFFE;
+
+constexpr std::size_t NotRom = static_cast<std::size_t>(-1);
+
+// Per PRG byte
+constexpr Word InstructionStart = 0x01;
+constexpr Word BlockLeader = 0x02;
+
+// Offset and CPU address of an instruction
+using Location = std::pair<std::size_t, DWord>;
+
+struct Analysis
+{
+    const std::vector<Word> &prg;
+    const Mapper &mapper;
+    const Cpu &cpu;
+
+    // Offset of a CPU address through the banks mapped at the time
+    std::size_t Resolve(DWord address) const
+    {
+        if (address < 0x8000)
+        {
+            return NotRom;
+        }
+
+        std::size_t offset = mapper.GetPrgOffset((address - 0x8000) / Mapper::s_PrgWindowSize) +
+                             (address & (Mapper::s_PrgWindowSize - 1));
+        return offset < prg.size() ? offset : NotRom;
+    }
+
+    // A target within the window of the instruction stays within its bank, whatever is mapped now
+    std::size_t Resolve(const Location &from, DWord target) const
+    {
+        if ((from.second ^ target) < Mapper::s_PrgWindowSize && from.second >= 0x8000)
+        {
+            return (from.first & ~(CodeCache::s_BankSize - 1)) + (target & (CodeCache::s_BankSize - 1));
+        }
+
+        return Resolve(target);
+    }
+
+    DWord ReadVector(DWord vector) const
+    {
+        std::size_t offset = Resolve(vector);
+        return offset == NotRom ? 0x0000 : prg[offset] | prg[offset + 1] << 8;
+    }
+
+    // Length of the instruction at offset, 0 for an illegal opcode or one leaving the bank
+    std::size_t Length(std::size_t offset) const
+    {
+        Word opcode = prg[offset];
+
+        if (std::strcmp(cpu.GetMnemonic(opcode), "ILL") == 0)
+        {
+            return 0;
+        }
+
+        std::size_t length = 1 + Cpu::GetOperandSize(cpu.GetAddressing(opcode));
+        std::size_t bankEnd = (offset | (CodeCache::s_BankSize - 1)) + 1;
+        return offset + length <= bankEnd ? length : 0;
+    }
+
+    /*
+       Destinations of the instruction at the location other than the next
+       one, returns whether the control flow may continue with the next one
+     */
+    bool Follow(const Location &location, std::vector<Location> &targets) const
+    {
+        Word opcode = prg[location.first];
+        const char *mnemonic = cpu.GetMnemonic(opcode);
+        Cpu::Addressing mode = cpu.GetAddressing(opcode);
+        std::size_t length = Length(location.first);
+        DWord next = location.second + static_cast<DWord>(length);
+        DWord operand = length > 1 ? prg[location.first + 1] : 0x00;
+
+        if (length > 2)
+        {
+            operand |= prg[location.first + 2] << 8;
+        }
+
+        auto branch = [&](DWord target) {
+            std::size_t offset = Resolve(location, target);
+
+            if (offset != NotRom)
+            {
+                targets.emplace_back(offset, target);
+            }
+        };
+
+        if (mode == Cpu::Addressing::REL)
+        {
+            branch(next + static_cast<DWord>(static_cast<std::int8_t>(operand)));
+            return true;
+        }
+        if (std::strcmp(mnemonic, "JSR") == 0)
+        {
+            // Assumed to return, which the stack games of some routines defeat
+            branch(operand);
+            return true;
+        }
+        if (std::strcmp(mnemonic, "JMP") == 0)
+        {
+            // Indirect jumps go through tables in RAM or ROM which are not followed
+            if (mode == Cpu::Addressing::ABS)
+            {
+                branch(operand);
+            }
+
+            return false;
+        }
+
+        // BRK is mostly met when running into zero filled data
+        return std::strcmp(mnemonic, "RTS") != 0 && std::strcmp(mnemonic, "RTI") != 0 &&
+               std::strcmp(mnemonic, "BRK") != 0;
+    }
+};
+
+void Put(StateWriter &writer, std::uint64_t hash, const std::vector<CodeCache::Bank> &banks)
+{
+    writer.WriteBytes(Magic, sizeof(Magic));
+    writer.Write(Version);
+    writer.Write(hash);
+    writer.Write(static_cast<QWord>(banks.size()));
+
+    for (const CodeCache::Bank &bank : banks)
+    {
+        writer.Write(static_cast<QWord>(bank.blocks.size()));
+
+        for (const CodeCache::Block &block : bank.blocks)
+        {
+            writer.Write(static_cast<QWord>(block.start));
+            writer.Write(static_cast<QWord>(block.end));
+            writer.Write(block.address);
+            writer.Write(static_cast<QWord>(block.successors.size()));
+
+            for (QWord successor : block.successors)
+            {
+                writer.Write(successor);
+            }
+        }
+    }
+}
+} // namespace
+
+CodeCache::CodeCache(const Cartridge &cartridge)
+    : m_PrgRom(cartridge.GetPrg()), m_Prg(m_PrgRom.data()), m_Hash(Hash(cartridge)), m_InstructionCount(0)
+{
+}
+
+void CodeCache::Analyze(const Mapper &mapper, const Cpu &cpu, const CoverageMap *coverage)
+{
+    Analysis analysis{m_PrgRom, mapper, cpu};
+    std::vector<Word> flags(m_PrgRom.size(), 0x00);
+    std::vector<DWord> addresses(m_PrgRom.size(), 0x0000);
+    std::vector<Location> pending;
+    std::vector<Location> targets;
+
+    auto walk = [&]() {
+        while (!pending.empty())
+        {
+            Location location = pending.back();
+            pending.pop_back();
+            flags[location.first] |= BlockLeader;
+
+            // Run until the control flow leaves or joins code already walked
+            while (true)
+            {
+                if (flags[location.first] & InstructionStart)
+                {
+                    // Entered from elsewhere as well
+                    flags[location.first] |= BlockLeader;
+                    break;
+                }
+
+                std::size_t length = analysis.Length(location.first);
+
+                if (length == 0)
+                {
+                    break;
+                }
+
+                flags[location.first] |= InstructionStart;
+                addresses[location.first] = location.second;
+
+                targets.clear();
+                bool next = analysis.Follow(location, targets);
+
+                for (const Location &target : targets)
+                {
+                    pending.push_back(target);
+                }
+
+                location.first += length;
+                location.second += static_cast<DWord>(length);
+
+                if (!next || !targets.empty())
+                {
+                    // The instruction after a branch or a call starts a block of its own
+                    if (next && location.first < m_PrgRom.size())
+                    {
+                        pending.push_back(location);
+                    }
+
+                    break;
+                }
+
+                if (location.first >= m_PrgRom.size())
+                {
+                    break;
+                }
+            }
+        }
+    };
+
+    for (DWord vector : {NmiVector, ResetVector, IrqVector})
+    {
+        DWord address = analysis.ReadVector(vector);
+        std::size_t offset = analysis.Resolve(address);
+
+        if (offset != NotRom)
+        {
+            pending.emplace_back(offset, address);
+        }
+    }
+
+    walk();
+
+    /*
+       The opcodes seen executing, reached through indirect jumps or banks
+       mapped later, are walked from once the static analysis is done so
+       that the ones it found do not all become block leaders
+     */
+    if (coverage && coverage->GetSize() == m_PrgRom.size())
+    {
+        for (std::size_t offset = 0; offset < m_PrgRom.size(); offset++)
+        {
+            DWord address = coverage->GetAddress(offset);
+
+            if (coverage->GetKind(offset) == CoverageMap::Opcode && address != 0x0000 &&
+                !(flags[offset] & InstructionStart))
+            {
+                pending.emplace_back(offset, address);
+                walk();
+            }
+        }
+    }
+
+    // Split the walked instructions of every bank into blocks
+    m_Banks.assign(m_PrgRom.size() / s_BankSize, {});
+
+    for (std::size_t offset = 0; offset < m_PrgRom.size();)
+    {
+        if (!(flags[offset] & InstructionStart))
+        {
+            offset++;
+            continue;
+        }
+
+        Block block{static_cast<QWord>(offset), static_cast<QWord>(offset), addresses[offset], {}};
+
+        while (true)
+        {
+            Location location(block.end, addresses[block.end]);
+            targets.clear();
+            bool next = analysis.Follow(location, targets);
+            block.end += analysis.Length(location.first);
+
+            for (const Location &target : targets)
+            {
+                block.successors.push_back(static_cast<QWord>(target.first));
+            }
+
+            bool walked = block.end < m_PrgRom.size() && (flags[block.end] & InstructionStart);
+
+            // Branches, calls and jumps end the block, so does the start of another one or of a bank
+            if (!next || !targets.empty() || !walked || (flags[block.end] & BlockLeader) ||
+                block.end % s_BankSize == 0)
+            {
+                if (next && walked)
+                {
+                    block.successors.push_back(static_cast<QWord>(block.end));
+                }
+
+                break;
+            }
+        }
+
+        offset = block.end;
+        m_Banks[block.start / s_BankSize].blocks.push_back(std::move(block));
+    }
+
+    Decode(cpu);
+}
+
+bool CodeCache::Load(const std::string &path, const Cpu &cpu)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<Word> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    StateReader reader(data.data(), data.size());
+    std::vector<Bank> banks;
+
+    try
+    {
+        char magic[sizeof(Magic)];
+        QWord version;
+        QWord bankCount;
+        reader.ReadBytes(magic, sizeof(magic));
+        reader.Read(version);
+
+        if (std::memcmp(magic, Magic, sizeof(Magic)) != 0 || version != Version)
+        {
+            return false;
+        }
+
+        std::uint64_t hash;
+        reader.Read(hash);
+        reader.Read(bankCount);
+
+        if (hash != m_Hash || bankCount != m_PrgRom.size() / s_BankSize)
+        {
+            return false;
+        }
+
+        banks.resize(bankCount);
+
+        for (std::size_t index = 0; index < banks.size(); index++)
+        {
+            QWord blockCount;
+            reader.Read(blockCount);
+
+            for (QWord i = 0; i < blockCount; i++)
+            {
+                Block block;
+                QWord successorCount;
+                reader.Read(block.start);
+                reader.Read(block.end);
+                reader.Read(block.address);
+                reader.Read(successorCount);
+
+                // A damaged file must not reach the decoding
+                if (block.start >= block.end || block.start / s_BankSize != index ||
+                    block.end > (index + 1) * s_BankSize || successorCount > s_BankSize)
+                {
+                    return false;
+                }
+
+                block.successors.resize(successorCount);
+
+                for (QWord &successor : block.successors)
+                {
+                    reader.Read(successor);
+                }
+
+                banks[index].blocks.push_back(std::move(block));
+            }
+        }
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+
+    m_Banks = std::move(banks);
+    Decode(cpu);
+    return true;
+}
+
+void CodeCache::Save(const std::string &path) const
+{
+    StateWriter measure;
+    Put(measure, m_Hash, m_Banks);
+
+    std::vector<Word> data(measure.GetSize());
+    StateWriter writer(data.data(), data.size());
+    Put(writer, m_Hash, m_Banks);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not write the code cache '" + path + "'");
+    }
+}
+
+std::uint64_t CodeCache::Hash(const Cartridge &cartridge)
+{
+    std::uint64_t hash = 0xCBF29CE484222325;
+
+    for (Word byte : cartridge.GetImage())
+    {
+        hash = (hash ^ byte) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+std::string CodeCache::GetFileName() const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.code", static_cast<unsigned long long>(m_Hash));
+    return name;
+}
+
+const std::vector<CodeCache::Bank> &CodeCache::GetBanks() const
+{
+    return m_Banks;
+}
+
+std::size_t CodeCache::GetBlockCount() const
+{
+    std::size_t count = 0;
+
+    for (const Bank &bank : m_Banks)
+    {
+        count += bank.blocks.size();
+    }
+
+    return count;
+}
+
+std::size_t CodeCache::GetInstructionCount() const
+{
+    return m_InstructionCount;
+}
+
+void CodeCache::Decode(const Cpu &cpu)
+{
+    m_Decoded.assign(m_PrgRom.size(), {0x00, 0, 0x0000});
+    m_InstructionCount = 0;
+
+    for (const Bank &bank : m_Banks)
+    {
+        for (const Block &block : bank.blocks)
+        {
+            for (std::size_t offset = block.start; offset < block.end;)
+            {
+                Word opcode = m_PrgRom[offset];
+                std::size_t length = 1 + Cpu::GetOperandSize(cpu.GetAddressing(opcode));
+
+                if (offset + length > block.end)
+                {
+                    break;
+                }
+
+                // The bytes of an instruction crossing a page may come from different memories
+                if ((offset & 0xFF) + length <= MemoryMap::s_PageSize)
+                {
+                    DWord operand = length > 1 ? m_PrgRom[offset + 1] : 0x00;
+
+                    if (length > 2)
+                    {
+                        operand |= m_PrgRom[offset + 2] << 8;
+                    }
+
+                    m_Decoded[offset] = {opcode, static_cast<Word>(length), operand};
+                }
+
+                m_InstructionCount++;
+                offset += length;
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef CODE_CACHE_HPP
+#define CODE_CACHE_HPP
+
+#include "../Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Cartridge;
+class Cpu;
+class CoverageMap;
+class Mapper;
+
+/*
+   Pre-decoded PRG ROM code
+
+   The PRG ROM never changes, so the code reachable from the interrupt
+   vectors can be found before running it. The analysis follows the
+   control flow through the opcode table and splits every 8 KiB PRG bank
+   into basic blocks, the instructions of the blocks are then pre-decoded
+   into a table indexed by PRG offset which the cpu consults instead of
+   fetching the opcode and operand bytes.
+
+   Banks are switched at runtime, the jumps leaving the window of their
+   bank are resolved with the banks mapped at power on, and code only
+   reached through indirect jumps or running from RAM is not found unless
+   a CoverageMap recorded it executing. What is missed simply stays with
+   the interpreter: an entry holds the bytes of the ROM at its offset,
+   whichever window the bank is mapped onto. Only the instructions lying
+   within a single 256 bytes page are decoded, a page patched by a cheat
+   or watched by the debugger is then never partially skipped.
+
+   The blocks are saved in a file named after a hash of the rom image so
+   that later runs skip the analysis, the table is rebuilt from them
+ */
+class CodeCache
+{
+public:
+    CodeCache(const Cartridge &cartridge);
+
+    // Straight line run of instructions, offsets within the PRG ROM
+    struct Block
+    {
+        QWord start;
+        // Past the last instruction
+        QWord end;
+        // CPU address of the first instruction when it was reached
+        DWord address;
+        // Blocks the control flow may continue with, within the PRG ROM
+        std::vector<QWord> successors;
+    };
+
+    // Control flow graph of an 8 KiB PRG bank, blocks ordered by offset
+    struct Bank
+    {
+        std::vector<Block> blocks;
+    };
+
+    struct DecodedInstruction
+    {
+        Word opcode;
+        // Opcode included, 0 when the offset is not decoded
+        Word length;
+        DWord operand;
+    };
+
+    /*
+       Walk the code reachable from the vectors with the banks currently
+       mapped, usually right after the power on, then from the opcodes a
+       coverage map of a previous run saw executing
+     */
+    void Analyze(const Mapper &mapper, const Cpu &cpu, const CoverageMap *coverage = nullptr);
+
+    /*
+       Load the blocks saved for this rom, returns false when the file is
+       missing or belongs to another rom or format version
+     */
+    bool Load(const std::string &path, const Cpu &cpu);
+    void Save(const std::string &path) const;
+
+    // 64 bits FNV-1a of the iNES image, names the cache files
+    static std::uint64_t Hash(const Cartridge &cartridge);
+    std::string GetFileName() const;
+
+    const std::vector<Bank> &GetBanks() const;
+    std::size_t GetBlockCount() const;
+    std::size_t GetInstructionCount() const;
+
+    static constexpr std::size_t s_BankSize = 0x2000;
+
+    // Instruction at pc when page is the memory read through for it, nullptr when it is not decoded
+    const DecodedInstruction *Find(const Word *page, DWord pc) const
+    {
+        // Pages outside of the PRG ROM wrap around to large offsets
+        std::size_t offset = reinterpret_cast<std::uintptr_t>(page) - reinterpret_cast<std::uintptr_t>(m_Prg);
+
+        if (offset >= m_Decoded.size())
+        {
+            return nullptr;
+        }
+
+        const DecodedInstruction &instruction = m_Decoded[offset + (pc & 0xFF)];
+        return instruction.length ? &instruction : nullptr;
+    }
+
+private:
+    // Fill the decoded table from the blocks
+    void Decode(const Cpu &cpu);
+
+    const std::vector<Word> &m_PrgRom;
+    const Word *m_Prg;
+    std::uint64_t m_Hash;
+
+    std::vector<Bank> m_Banks;
+    std::vector<DecodedInstruction> m_Decoded;
+    std::size_t m_InstructionCount;
+};
+
+#endif
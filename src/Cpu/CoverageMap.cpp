@@ -0,0 +1,205 @@
+#include "CoverageMap.hpp"
+#include "../Cartridge.hpp"
+#include "../MemoryMap.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+
+namespace
+{
+// CDL bits
+constexpr Word CdlCode = 0x01;
+constexpr Word CdlData = 0x02;
+constexpr unsigned CdlWindowShift = 2;
+constexpr Word CdlOpcode = 0x80;
+
+double Percent(std::size_t count, std::size_t total)
+{
+    return total ? count * 100.0 / total : 0.0;
+}
+} // namespace
+
+CoverageMap::CoverageMap(const Cartridge &cartridge)
+    : m_Prg(cartridge.GetPrg().data()), m_Size(cartridge.GetPrg().size()),
+      // The CHR ROM size of the header, CHR RAM has no place in the file
+      m_ChrSize(cartridge.GetImage()[5] * Cartridge::s_ChrBankSize)
+{
+    Clear();
+}
+
+void CoverageMap::Clear()
+{
+    m_Map.assign((m_Size + 3) / 4, 0x00);
+    m_Windows.assign(GetBankCount(), s_NoWindow);
+}
+
+void CoverageMap::MarkInstruction(const MemoryMap &memory, DWord pc, Word length)
+{
+    Mark(memory.GetMappedReadPage(pc >> 8), pc, Opcode);
+
+    // The operands may lie on the next page, mapped elsewhere
+    for (Word i = 1; i < length; i++)
+    {
+        DWord address = static_cast<DWord>(pc + i);
+        Mark(memory.GetMappedReadPage(address >> 8), address, Operand);
+    }
+}
+
+void CoverageMap::MarkData(const MemoryMap &memory, DWord address)
+{
+    Mark(memory.GetMappedReadPage(address >> 8), address, Data);
+}
+
+CoverageMap::Kind CoverageMap::GetKind(std::size_t offset) const
+{
+    return static_cast<Kind>((m_Map[offset >> 2] >> ((offset & 3) * 2)) & 0x03);
+}
+
+std::size_t CoverageMap::GetSize() const
+{
+    return m_Size;
+}
+
+DWord CoverageMap::GetAddress(std::size_t offset) const
+{
+    Word window = m_Windows[offset / s_BankSize];
+
+    if (window == s_NoWindow)
+    {
+        return 0x0000;
+    }
+
+    return static_cast<DWord>(0x8000 + window * s_BankSize + (offset & (s_BankSize - 1)));
+}
+
+std::size_t CoverageMap::GetBankCount() const
+{
+    return (m_Size + s_BankSize - 1) / s_BankSize;
+}
+
+CoverageMap::Summary CoverageMap::Summarize(std::size_t bank) const
+{
+    Summary summary;
+    std::size_t end = std::min(m_Size, (bank + 1) * s_BankSize);
+
+    for (std::size_t offset = bank * s_BankSize; offset < end; offset++)
+    {
+        switch (GetKind(offset))
+        {
+        case Untouched:
+            summary.untouched++;
+            break;
+        case Data:
+            summary.data++;
+            break;
+        case Operand:
+            summary.operands++;
+            break;
+        case Opcode:
+            summary.opcodes++;
+            break;
+        }
+    }
+
+    return summary;
+}
+
+CoverageMap::Summary CoverageMap::Summarize() const
+{
+    Summary total;
+
+    for (std::size_t bank = 0; bank < GetBankCount(); bank++)
+    {
+        Summary summary = Summarize(bank);
+        total.opcodes += summary.opcodes;
+        total.operands += summary.operands;
+        total.data += summary.data;
+        total.untouched += summary.untouched;
+    }
+
+    return total;
+}
+
+void CoverageMap::Report(std::ostream &stream) const
+{
+    char line[128];
+    auto print = [&](const char *name, const Summary &summary) {
+        std::size_t total = summary.opcodes + summary.operands + summary.data + summary.untouched;
+        std::snprintf(line, sizeof(line), "%-10s %5.1f%% code %5.1f%% opcodes %5.1f%% data %5.1f%% untouched\n", name,
+                      Percent(summary.opcodes + summary.operands, total), Percent(summary.opcodes, total),
+                      Percent(summary.data, total), Percent(summary.untouched, total));
+        stream << line;
+    };
+
+    for (std::size_t bank = 0; bank < GetBankCount(); bank++)
+    {
+        print(("bank " + std::to_string(bank)).c_str(), Summarize(bank));
+    }
+
+    print("prg", Summarize());
+}
+
+void CoverageMap::LoadCdl(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    std::vector<Word> cdl((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (cdl.size() < m_Size)
+    {
+        throw std::runtime_error("'" + path + "' does not cover the PRG ROM");
+    }
+
+    for (std::size_t offset = 0; offset < m_Size; offset++)
+    {
+        Word flags = cdl[offset];
+        Kind kind = (flags & CdlOpcode) ? Opcode : (flags & CdlCode) ? Operand : (flags & CdlData) ? Data : Untouched;
+
+        if (kind == Untouched)
+        {
+            continue;
+        }
+
+        Raise(offset, kind);
+        m_Windows[offset / s_BankSize] = (flags >> CdlWindowShift) & 0x03;
+    }
+}
+
+void CoverageMap::SaveCdl(const std::string &path) const
+{
+    std::vector<Word> cdl(m_Size + m_ChrSize, 0x00);
+
+    for (std::size_t offset = 0; offset < m_Size; offset++)
+    {
+        Kind kind = GetKind(offset);
+        Word window = m_Windows[offset / s_BankSize];
+
+        if (kind == Untouched)
+        {
+            continue;
+        }
+
+        cdl[offset] = kind == Opcode ? CdlCode | CdlOpcode : kind == Operand ? CdlCode : CdlData;
+
+        if (window != s_NoWindow)
+        {
+            cdl[offset] |= window << CdlWindowShift;
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(cdl.data()), static_cast<std::streamsize>(cdl.size()));
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not write '" + path + "'");
+    }
+}
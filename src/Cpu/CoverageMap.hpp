@@ -0,0 +1,123 @@
+#ifndef COVERAGE_MAP_HPP
+#define COVERAGE_MAP_HPP
+
+#include "../Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+class Cartridge;
+class MemoryMap;
+
+/*
+   PRG ROM coverage
+
+   Every PRG byte is classified by the accesses of the cpu as untouched,
+   read as data, executed as an operand or executed as an opcode, two bits
+   per byte. A byte only moves up that order, the code fetches also being
+   reads the execution wins over the data read. The DMC sample fetches
+   count as data reads.
+
+   The accesses are attributed to the PRG offset of the page they go
+   through, whichever bank is mapped, and the CPU window of the last
+   access is kept per 8 KiB bank so that the code can be located again.
+
+   Saved in the CDL layout of FCEUX: one byte per PRG byte, 0x01 for code,
+   0x02 for data, the $8000/$A000/$C000/$E000 window in bits 2-3, followed
+   by the CHR bytes which are not tracked. Bit 7, unused there, marks the
+   opcodes so that a loaded map tells them from the operands
+ */
+class CoverageMap
+{
+public:
+    CoverageMap(const Cartridge &cartridge);
+    void Clear();
+
+    enum Kind : Word
+    {
+        Untouched = 0,
+        Data = 1,
+        Operand = 2,
+        Opcode = 3,
+    };
+
+    // Called by the cpu before executing the instruction of the given length at pc
+    void MarkInstruction(const MemoryMap &memory, DWord pc, Word length);
+    // Called by the cpu on every read and by the DMC on every sample fetch
+    void MarkData(const MemoryMap &memory, DWord address);
+
+    Kind GetKind(std::size_t offset) const;
+    std::size_t GetSize() const;
+
+    /*
+       CPU address the offset was last accessed at, judging by its bank,
+       0x0000 when nothing of the bank was accessed through $8000-$FFFF
+     */
+    DWord GetAddress(std::size_t offset) const;
+
+    struct Summary
+    {
+        std::size_t opcodes = 0;
+        std::size_t operands = 0;
+        std::size_t data = 0;
+        std::size_t untouched = 0;
+    };
+
+    std::size_t GetBankCount() const;
+    Summary Summarize(std::size_t bank) const;
+    Summary Summarize() const;
+    // Share of every bank and of the whole PRG ROM in each kind
+    void Report(std::ostream &stream) const;
+
+    // Merged into the map, throws std::runtime_error when the file is missing or belongs to a smaller rom
+    void LoadCdl(const std::string &path);
+    void SaveCdl(const std::string &path) const;
+
+    static constexpr std::size_t s_BankSize = 0x2000;
+
+private:
+    void Mark(const Word *page, DWord address, Kind kind)
+    {
+        // Pages outside of the PRG ROM wrap around to large offsets
+        std::size_t offset = reinterpret_cast<std::uintptr_t>(page) - reinterpret_cast<std::uintptr_t>(m_Prg);
+
+        if (offset >= m_Size)
+        {
+            return;
+        }
+
+        offset += address & 0xFF;
+        Raise(offset, kind);
+
+        if (address >= 0x8000)
+        {
+            m_Windows[offset / s_BankSize] = static_cast<Word>((address >> 13) & 0x03);
+        }
+    }
+
+    void Raise(std::size_t offset, Kind kind)
+    {
+        Word &cell = m_Map[offset >> 2];
+        unsigned shift = (offset & 3) * 2;
+
+        if (((cell >> shift) & 0x03) < kind)
+        {
+            cell = static_cast<Word>((cell & ~(0x03 << shift)) | (kind << shift));
+        }
+    }
+
+    const Word *m_Prg;
+    std::size_t m_Size;
+    std::size_t m_ChrSize;
+
+    // Four bytes per cell
+    std::vector<Word> m_Map;
+    // Per bank, s_NoWindow until accessed through $8000-$FFFF
+    std::vector<Word> m_Windows;
+
+    static constexpr Word s_NoWindow = 0xFF;
+};
+
+#endif
@@ -1,37 +1,197 @@
 #include "Cpu.hpp"
+#include "CodeCache.hpp"
+#include "CoverageMap.hpp"
 #include "CpuBitwise.hpp"
-#include "../Ram.hpp"
+#include "CpuProfiler.hpp"
+#include "../MemoryMap.hpp"
+#include "../State.hpp"
 
-Cpu::Cpu(Ram &ram) : m_Ram(ram)
+Cpu::Cpu(MemoryMap &memory)
+    : m_PC(0x0000), m_SP(0xFD), m_A(0x00), m_X(0x00), m_Y(0x00), m_Memory(memory), m_RemainingCycles(0), m_Cycles(0),
+      m_PageCrossed(false), m_PenaltyCycles(0), m_Profiler(nullptr), m_CodeCache(nullptr), m_Coverage(nullptr),
+      m_PendingInterrupts(0), m_PolledInterrupts(0), m_IrqDisabled(false), m_ImplicitSource(false)
 {
+    m_Status.value = 0x24;
     GenerateInstructionSet();
 }
 
+Cpu::~Cpu()
+{
+}
+
 void Cpu::Clock()
 {
-    while (m_RemainingCycles <= 0)
+    if (m_RemainingCycles == 0)
     {
-        Word opcode = Read(m_PC++);
-        Instruction &instruction = m_InstructionSet[opcode];
-	
-        DWord source = instruction.addressing();
-        instruction.operation(source);
-
-        m_RemainingCycles += instruction.cycles;
+        m_RemainingCycles += m_PolledInterrupts ? ServiceInterrupt() : Step();
+    }
+    else if (m_RemainingCycles == 1)
+    {
+        // Whatever the devices raised up to the previous cycle
+        PollInterrupts();
     }
 
     m_RemainingCycles--;
 }
 
+QWord Cpu::Step()
+{
+    DWord pc = m_PC;
+    const CodeCache::DecodedInstruction *decoded =
+        m_CodeCache ? m_CodeCache->Find(m_Memory.GetReadPage(pc >> 8), pc) : nullptr;
+    Word opcode = decoded ? decoded->opcode : Read(m_PC++);
+    Instruction &instruction = m_InstructionSet[opcode];
+
+    m_PageCrossed = false;
+    m_PenaltyCycles = 0;
+    m_ImplicitSource = instruction.mode == Addressing::IMP;
+    m_IrqDisabled = m_Status.I;
+
+    if (m_Coverage)
+    {
+        // Before the operation, which may switch the bank the instruction comes from
+        m_Coverage->MarkInstruction(m_Memory, pc, static_cast<Word>(1 + GetOperandSize(instruction.mode)));
+    }
+
+    DWord source;
+
+    if (decoded)
+    {
+        // ROM reads have no side effect, skipping them is not observable
+        m_PC += decoded->length;
+        source = DecodedAddress(instruction.mode, decoded->operand);
+    }
+    else
+    {
+        source = instruction.addressing();
+    }
+
+    instruction.operation(source);
+
+    bool pagePenalty = instruction.pageCrossCycle && m_PageCrossed;
+    QWord cycles = instruction.cycles + m_PenaltyCycles + pagePenalty;
+    m_Cycles += cycles;
+
+    if (m_Profiler)
+    {
+        m_Profiler->Record(pc, opcode, cycles, pagePenalty, m_PC);
+    }
+
+    return cycles;
+}
+
+bool Cpu::IsInstructionComplete() const
+{
+    return m_RemainingCycles == 0;
+}
+
+Cpu::Registers Cpu::GetRegisters() const
+{
+    return {m_PC, m_SP, m_A, m_X, m_Y, m_Status.value};
+}
+
+void Cpu::SetRegisters(const Registers &registers)
+{
+    m_PC = registers.PC;
+    m_SP = registers.SP;
+    m_A = registers.A;
+    m_X = registers.X;
+    m_Y = registers.Y;
+    m_Status.value = registers.P;
+}
+
+std::uint64_t Cpu::GetCycles() const
+{
+    return m_Cycles;
+}
+
+void Cpu::SetCycles(std::uint64_t cycles)
+{
+    m_Cycles = cycles;
+}
+
+const char *Cpu::GetMnemonic(Word opcode) const
+{
+    return m_InstructionSet[opcode].mnemonic;
+}
+
+Cpu::Addressing Cpu::GetAddressing(Word opcode) const
+{
+    return m_InstructionSet[opcode].mode;
+}
+
+const char *Cpu::GetAddressingName(Addressing addressing)
+{
+    static const char *s_Names[] = {"IMP", "IMM", "REL", "ZER", "ZPX", "ZPY",
+                                    "ABS", "ABX", "ABY", "IND", "IDX", "IDY"};
+    return s_Names[(Word)addressing];
+}
+
+void Cpu::SetProfiler(CpuProfiler *profiler)
+{
+    m_Profiler = profiler;
+}
+
+void Cpu::SetCodeCache(const CodeCache *cache)
+{
+    m_CodeCache = cache;
+}
+
+void Cpu::SetCoverageMap(CoverageMap *coverage)
+{
+    m_Coverage = coverage;
+}
+
+void Cpu::Stall(QWord cycles)
+{
+    m_RemainingCycles += cycles;
+    m_Cycles += cycles;
+}
+
+void Cpu::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_PC);
+    writer.Write(m_SP);
+    writer.Write(m_A);
+    writer.Write(m_X);
+    writer.Write(m_Y);
+    writer.Write(m_Status.value);
+    writer.Write(m_RemainingCycles);
+    writer.Write(m_Cycles);
+    writer.Write(m_PendingInterrupts);
+    writer.Write(m_PolledInterrupts);
+    writer.Write(m_IrqDisabled);
+}
+
+void Cpu::LoadState(StateReader &reader)
+{
+    reader.Read(m_PC);
+    reader.Read(m_SP);
+    reader.Read(m_A);
+    reader.Read(m_X);
+    reader.Read(m_Y);
+    reader.Read(m_Status.value);
+    reader.Read(m_RemainingCycles);
+    reader.Read(m_Cycles);
+    reader.Read(m_PendingInterrupts);
+    reader.Read(m_PolledInterrupts);
+    reader.Read(m_IrqDisabled);
+}
 
 Word Cpu::Read(DWord address)
 {
-    return m_Ram[address];
+    if (m_Coverage)
+    {
+        m_Coverage->MarkData(m_Memory, address);
+    }
+
+    return m_Memory.Read(address);
 }
 
 Word Cpu::Write(DWord address, Word value)
 {
-    return m_Ram[address] = value;
+    m_Memory.Write(address, value);
+    return value;
 }
 
 Word Cpu::PushWord(Word value)
@@ -59,12 +219,12 @@ DWord Cpu::PopDWord()
 
 Word Cpu::FetchWord(DWord source)
 {
-    return source == s_ImplicitSource ? m_A : m_Ram[source];
+    return m_ImplicitSource ? m_A : Read(source);
 }
 
 Word Cpu::SetWord(DWord address, Word value)
 {
-    if (address == s_ImplicitSource)
+    if (m_ImplicitSource)
     {
         return (m_A = value);
     }
@@ -3,20 +3,130 @@
 
 #include "../Types.hpp"
 #include <array>
+#include <cstdint>
 #include <functional>
-class Ram;
+class MemoryMap;
+class CodeCache;
+class CpuProfiler;
+class CoverageMap;
+class StateWriter;
+class StateReader;
 
 class Cpu
 {
 public:
-    Cpu(Ram &ram);
+    Cpu(MemoryMap &memory);
     ~Cpu();
 
     void Clock();
 
+    /*
+       Execute the next instruction as a whole
+
+       Returns the amount of cycles consumed by the instruction, page
+       crossing and taken branch penalties included. DMA stalls triggered
+       by the instruction are not included but count in GetCycles()
+     */
+    QWord Step();
+    // True when the next Clock starts the instruction at PC
+    bool IsInstructionComplete() const;
+
+    void Reset();
+
+    /*
+       Interrupt lines
+
+       Every source owns a bit of a single pending mask, the IRQ line
+       being the OR of the level triggered sources. As on the 6502 the
+       mask is polled before the last cycle of each instruction and the
+       interrupt runs in place of the next one, a line raised later waits
+       for another instruction. CLI, SEI and PLP change the I flag after
+       the poll, their effect is delayed by one instruction while RTI
+       takes effect immediately
+     */
+    enum InterruptSource : Word
+    {
+        InterruptNmi = 0x01,
+        InterruptApu = 0x02,
+        InterruptMapper = 0x04,
+    };
+
+    // Edge triggered, pending until serviced
+    void TriggerNmi();
+    // Level triggered, serviced as long as the source holds it and the I flag is clear
+    void SetIrqLine(InterruptSource source, bool asserted);
+    Word GetPendingInterrupts() const;
+
+    // Suspend the cpu for the given amount of cycles, used by the DMA transfers
+    void Stall(QWord cycles);
+
+    // Snapshot of the programmer visible registers
+    struct Registers
+    {
+        DWord PC;
+        Word SP;
+        Word A;
+        Word X;
+        Word Y;
+        Word P;
+    };
+
+    Registers GetRegisters() const;
+    void SetRegisters(const Registers &registers);
+
+    // Total amount of cycles elapsed since the power on
+    std::uint64_t GetCycles() const;
+    void SetCycles(std::uint64_t cycles);
+
+    // Addressing modes, named after their addressing functions
+    enum class Addressing : Word
+    {
+        IMP,
+        IMM,
+        REL,
+        ZER,
+        ZPX,
+        ZPY,
+        ABS,
+        ABX,
+        ABY,
+        IND,
+        IDX,
+        IDY,
+    };
+
+    // Opcode metadata used by the tooling
+    const char *GetMnemonic(Word opcode) const;
+    Addressing GetAddressing(Word opcode) const;
+    static const char *GetAddressingName(Addressing addressing);
+    // Amount of operand bytes following the opcode
+    static Word GetOperandSize(Addressing addressing);
+
+    /*
+       Attach a profiler recording every executed instruction, passing
+       nullptr detaches it. Without profiler the only cost is a null check
+       per instruction
+     */
+    void SetProfiler(CpuProfiler *profiler);
+
+    /*
+       Execute the instructions the cache pre-decoded without fetching
+       their bytes, the others go through the interpreter. Passing nullptr
+       detaches it, the cache must outlive its use
+     */
+    void SetCodeCache(const CodeCache *cache);
+
+    /*
+       Classify the PRG bytes executed and read from now on, see
+       CoverageMap. Passing nullptr detaches it, without map the cost is a
+       null check per instruction and per read
+     */
+    void SetCoverageMap(CoverageMap *coverage);
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
+
 private:
-    
-    
     // R/W memory
     Word Read(DWord address);
     Word Write(DWord address, Word value);
@@ -75,7 +185,7 @@ private:
         };
     } m_Status;
 
-    Ram &m_Ram;
+    MemoryMap &m_Memory;
 
     /*
        Remaining skipped cycles
@@ -85,6 +195,20 @@ private:
        are completed
      */
     QWord m_RemainingCycles;
+    std::uint64_t m_Cycles;
+
+    /*
+       Set by the indexed addressing modes when the effective address lies
+       on another page than the base address, only the read instructions
+       pay the additional cycle
+     */
+    bool m_PageCrossed;
+    // Taken branches penalties of the current instruction
+    QWord m_PenaltyCycles;
+
+    CpuProfiler *m_Profiler;
+    const CodeCache *m_CodeCache;
+    CoverageMap *m_Coverage;
 
     // The stack memory begins at the 256th byte (second page)
     static constexpr DWord s_StackBase = 0x0100;
@@ -95,27 +219,31 @@ private:
     static constexpr DWord s_ResetVector = 0xFFFC;
     static constexpr DWord s_NmiVector = 0xFFFA;
 
+    static constexpr Word s_IrqSources = InterruptApu | InterruptMapper;
+
     void Interrupt(DWord interruptVector);
-    // Interrupt request
-    void IRQ();
-    // Non maskable interrupt request
-    void NMI();
+    // Sample the lines as seen before the last cycle of the current instruction
+    void PollInterrupts();
+    // Run the interrupt sequence polled during the previous instruction, returns its cycles
+    QWord ServiceInterrupt();
 
-    void Reset();
+    Word m_PendingInterrupts;
+    // Lines polled during the current instruction, serviced once it completes
+    Word m_PolledInterrupts;
+    // I flag as seen by the poll, set before each instruction so that CLI, SEI and PLP act one instruction late
+    bool m_IrqDisabled;
 
     /*
-       Represents an implicit data source
-
-       Whenever the address is equal to 0xFFFF we don't fetch the value from
-       the ram but from the accumulator
+       Set for the implicit addressing mode, the operations which fetch
+       data (the accumulator shifts and rotations) then work on the
+       accumulator instead of the memory. A flag rather than a sentinel
+       address so that every address, $FFFF included, stays reachable
      */
-    DWord s_ImplicitSource = 0xFFFF;
+    bool m_ImplicitSource;
 
     /*
        Implicit addressing mode
-       We return 0xFFFF, it means that if we want to fetch
-       data (which is not always the case) we have to return
-       the accumulator register
+       No operand, the data source if any is the accumulator
      */
     DWord IMP();
     /*
@@ -129,12 +257,13 @@ private:
     Returns the shifted program counter
     */
     DWord REL();
+    DWord Relative(Word offset);
 
     /*
        Zero page addressing mode utility
        Offsets and wraps the specified value to be zero paged
      */
-    DWord ZeroPage(DWord offset);
+    DWord ZeroPage(Word base, DWord offset);
     /*
        Zero page addressing mode
        The data is meant to be located within the first ram page
@@ -145,8 +274,9 @@ private:
     // Zero page addressing mode with y offset
     DWord ZPY();
 
-    // Absolute addressing mode utility
-    DWord Absolute(DWord offset);
+    // Absolute addressing mode utilities
+    DWord FetchAbsolute();
+    DWord Absolute(DWord base, DWord offset);
     /*
       Absolute addressing mode
       The specified value directly contains the address to the fetched value
@@ -162,17 +292,30 @@ private:
       The value contains a 16-bit address to the fetched data pointer
      */
     DWord IND();
+    DWord Indirect(DWord pointer);
     /*
       Indexed Indirect addressing mode
       The pointer is shifted by the one paged X register
      */
     DWord IDX();
+    DWord IndexedIndirect(Word zero);
     // Indirect indexed addressing mode
     DWord IDY();
+    DWord IndirectIndexed(Word zero);
+
+    /*
+       Addressing of a pre-decoded instruction, the operand bytes are
+       given and the program counter already points past the instruction
+     */
+    DWord DecodedAddress(Addressing mode, DWord operand);
 
     struct Instruction
     {
         Word cycles;
+        // Additional cycle when the indexed address crosses a page
+        bool pageCrossCycle;
+        const char *mnemonic;
+        Addressing mode;
         std::function<DWord(void)> addressing;
         std::function<void(DWord)> operation;
     };
@@ -190,7 +333,8 @@ private:
     void Compare(Word reg, Word operand);
     Word Increment(Word operand, bool positive);
     void LoadRegister(Word &reg, Word value);
-    void Return(Word offset);
+    // Pull the status register, the break flag only exists on the stack
+    Word PullStatus();
     void Transfer(Word &from, Word &to);
 
     // Operations
@@ -308,6 +452,24 @@ private:
     void TYA(DWord);
     // Illegal operation
     void ILL(DWord);
+
+    // Unofficial operations relied upon by some games and test roms
+    // Load the accumulator and the x register
+    void LAX(DWord source);
+    // Store the accumulator and the x register
+    void SAX(DWord source);
+    // Decrement then compare with the accumulator
+    void DCP(DWord source);
+    // Increment then substract with carry bit
+    void ISB(DWord source);
+    // Arithmetic shift left then bitwise or
+    void SLO(DWord source);
+    // Bitwise rotate left then bitwise and
+    void RLA(DWord source);
+    // Bitwise shift right then bitwise exclusive or
+    void SRE(DWord source);
+    // Bitwise rotate right then add with carry bit
+    void RRA(DWord source);
 };
 
 #endif
@@ -1,102 +1,175 @@
 #include "Cpu.hpp"
 #include "CpuBitwise.hpp"
-#include "../Ram.hpp"
+#include "../MemoryMap.hpp"
 
 DWord Cpu::IMP()
 {
-    return s_ImplicitSource;
+    return 0x0000;
 }
 
 DWord Cpu::IMM()
 {
-    return Read(m_PC++);
+    return m_PC++;
 }
 
-DWord Cpu::REL()
+DWord Cpu::Relative(Word offset)
 {
-    DWord offset = (DWord)Read(m_PC++);
+    DWord displacement = offset;
 
-    if (offset & NEGATIVE_BIT)
+    if (displacement & NEGATIVE_BIT)
     {
-        offset |= 0xFF00;
+        displacement |= 0xFF00;
     }
 
-    return m_PC + offset;
+    return m_PC + displacement;
+}
+
+DWord Cpu::REL()
+{
+    return Relative(Read(m_PC++));
 }
 
-DWord Cpu::ZeroPage(DWord offset)
+DWord Cpu::ZeroPage(Word base, DWord offset)
 {
-    return (m_PC++ + offset) % 256;
+    return (base + offset) % 256;
 }
 
 DWord Cpu::ZER()
 {
-    return ZeroPage(0);
+    return ZeroPage(Read(m_PC++), 0);
 }
 DWord Cpu::ZPX()
 {
-    return ZeroPage(m_X);
+    return ZeroPage(Read(m_PC++), m_X);
 }
 DWord Cpu::ZPY()
 {
-    return ZeroPage(m_Y);
+    return ZeroPage(Read(m_PC++), m_Y);
 }
 
-DWord Cpu::Absolute(DWord offset)
+DWord Cpu::FetchAbsolute()
 {
     DWord lo = Read(m_PC++);
     DWord hi = Read(m_PC++);
-    DWord address = CONCATENATE_WORDS(hi, lo) + offset;
+    return CONCATENATE_WORDS(hi, lo);
+}
+
+DWord Cpu::Absolute(DWord base, DWord offset)
+{
+    DWord address = base + offset;
 
     // Additional cycle if page crossed
-    if((hi << 8) != (address & 0xFF00))
+    if ((base & 0xFF00) != (address & 0xFF00))
     {
-	m_RemainingCycles++;
+        m_PageCrossed = true;
     }
-    
+
     return address;
 }
 
 DWord Cpu::ABS()
 {
-    return Absolute(0);
+    return Absolute(FetchAbsolute(), 0);
 }
 DWord Cpu::ABX()
 {
-    return Absolute(m_X);
+    return Absolute(FetchAbsolute(), m_X);
 }
 DWord Cpu::ABY()
 {
-    return Absolute(m_Y);
+    return Absolute(FetchAbsolute(), m_Y);
+}
+
+DWord Cpu::Indirect(DWord pointer)
+{
+    // The high byte is fetched without carrying into the pointer high byte
+    DWord pointerNext = (pointer & 0xFF00) | ((pointer + 1) & 0x00FF);
+
+    return CONCATENATE_WORDS(Read(pointerNext), Read(pointer));
 }
 
 DWord Cpu::IND()
 {
-    DWord pointerLo = Read(m_PC++);
-    DWord pointerHi = Read(m_PC++);
+    return Indirect(FetchAbsolute());
+}
 
-    DWord pointer = CONCATENATE_WORDS(pointerLo, pointerHi);
-    
-    if (pointerLo == 0x00FF)
-    {
-        return Read((pointer & 0xFF00) << 8) | Read(pointer);
-    }
-    else
-    {
-        return Read((pointer + 1) << 8) | Read(pointer);
-    }
+DWord Cpu::IndexedIndirect(Word zero)
+{
+    DWord zeroLo = (zero + m_X) % 256;
+    DWord zeroHi = (zeroLo + 1) % 256;
+    return CONCATENATE_WORDS(Read(zeroHi), Read(zeroLo));
 }
 
 DWord Cpu::IDX()
 {
-    DWord zeroLo = (Read(m_PC++) + m_X) % 256;
-    DWord zeroHi = (zeroLo + 1) % 256;
-    return CONCATENATE_WORDS(Read(zeroLo), Read(zeroHi));
+    return IndexedIndirect(Read(m_PC++));
+}
+
+DWord Cpu::IndirectIndexed(Word zero)
+{
+    DWord zeroHi = (zero + 1) % 256;
+    DWord base = CONCATENATE_WORDS(Read(zeroHi), Read(zero));
+    DWord address = base + m_Y;
+
+    // Additional cycle if page crossed
+    if ((base & 0xFF00) != (address & 0xFF00))
+    {
+        m_PageCrossed = true;
+    }
+
+    return address;
 }
 
 DWord Cpu::IDY()
 {
-    DWord zeroLo = Read(m_PC++);
-    DWord zeroHi = (zeroLo + 1) % 256;
-    return CONCATENATE_WORDS(Read(zeroLo), Read(zeroHi)) + m_Y;
+    return IndirectIndexed(Read(m_PC++));
+}
+
+DWord Cpu::DecodedAddress(Addressing mode, DWord operand)
+{
+    Word lo = operand & 0x00FF;
+
+    switch (mode)
+    {
+    case Addressing::IMM:
+        return m_PC - 1;
+    case Addressing::REL:
+        return Relative(lo);
+    case Addressing::ZER:
+        return ZeroPage(lo, 0);
+    case Addressing::ZPX:
+        return ZeroPage(lo, m_X);
+    case Addressing::ZPY:
+        return ZeroPage(lo, m_Y);
+    case Addressing::ABS:
+        return Absolute(operand, 0);
+    case Addressing::ABX:
+        return Absolute(operand, m_X);
+    case Addressing::ABY:
+        return Absolute(operand, m_Y);
+    case Addressing::IND:
+        return Indirect(operand);
+    case Addressing::IDX:
+        return IndexedIndirect(lo);
+    case Addressing::IDY:
+        return IndirectIndexed(lo);
+    default:
+        return 0x0000;
+    }
+}
+
+Word Cpu::GetOperandSize(Addressing addressing)
+{
+    switch (addressing)
+    {
+    case Addressing::IMP:
+        return 0;
+    case Addressing::ABS:
+    case Addressing::ABX:
+    case Addressing::ABY:
+    case Addressing::IND:
+        return 2;
+    default:
+        return 1;
+    }
 }
@@ -3,8 +3,8 @@
 
 #define NEGATIVE_BIT (0x80)
 
-#define CONCATENATE_WORDS(hi, lo) ((hi << 8) | lo)
+#define CONCATENATE_WORDS(hi, lo) (((hi) << 8) | (lo))
 #define SET_NEGATIVE_FLAG(x) (m_Status.N = (x)&NEGATIVE_BIT)
-#define SET_ZERO_FLAG(x) (m_Status.Z = (x) == 0)
+#define SET_ZERO_FLAG(x) (m_Status.Z = ((x)&0xFF) == 0)
 
 #endif
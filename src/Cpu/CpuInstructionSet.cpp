@@ -3,33 +3,41 @@
 void Cpu::GenerateInstructionSet()
 {
 
-#define INS(cycles, addressing, operation) \
-    { cycles, std::bind(&Cpu::addressing, this), std::bind(&Cpu::operation, this, std::placeholders::_1) }
+#define INS(cycles, pageCrossCycle, addressing, operation)                                                          \
+    {                                                                                                                  \
+        cycles, pageCrossCycle, #operation, Addressing::addressing, std::bind(&Cpu::addressing, this),                 \
+            std::bind(&Cpu::operation, this, std::placeholders::_1)                                                    \
+    }
 
-    static Instruction s_DefaultInstruction = INS(0, IMP, ILL);
-    std::fill(m_InstructionSet.begin(), m_InstructionSet.end(), s_DefaultInstruction);
+    Instruction defaultInstruction = INS(2, false, IMP, ILL);
+    std::fill(m_InstructionSet.begin(), m_InstructionSet.end(), defaultInstruction);
 
-#define DEF_INS(opcode, cycles, addressing, operation)	    \
-    static_assert(opcode < 256, "Opcode exceed 256 limit"); \
-    m_InstructionSet[opcode] = INS(cycles, addressing, operation)
+#define DEF_INS(opcode, cycles, addressing, operation)                                                                 \
+    static_assert(opcode < 256, "Opcode exceed 256 limit");                                                            \
+    m_InstructionSet[opcode] = INS(cycles, false, addressing, operation)
+
+    // Read instructions paying an additional cycle when the indexed address crosses a page
+#define DEF_INS_PAGE(opcode, cycles, addressing, operation)                                                            \
+    static_assert(opcode < 256, "Opcode exceed 256 limit");                                                            \
+    m_InstructionSet[opcode] = INS(cycles, true, addressing, operation)
 
     DEF_INS(0x69, 2, IMM, ADC);
     DEF_INS(0x65, 3, ZER, ADC);
     DEF_INS(0x75, 4, ZPX, ADC);
     DEF_INS(0x6D, 4, ABS, ADC);
-    DEF_INS(0x7D, 4, ABX, ADC);
-    DEF_INS(0x79, 4, ABY, ADC);
+    DEF_INS_PAGE(0x7D, 4, ABX, ADC);
+    DEF_INS_PAGE(0x79, 4, ABY, ADC);
     DEF_INS(0x61, 6, IDX, ADC);
-    DEF_INS(0x71, 5, IDY, ADC);
+    DEF_INS_PAGE(0x71, 5, IDY, ADC);
 
     DEF_INS(0x29, 2, IMM, AND);
     DEF_INS(0x25, 3, ZER, AND);
     DEF_INS(0x35, 4, ZPX, AND);
     DEF_INS(0x2D, 4, ABS, AND);
-    DEF_INS(0x3D, 4, ABX, AND);
-    DEF_INS(0x39, 4, ABY, AND);
+    DEF_INS_PAGE(0x3D, 4, ABX, AND);
+    DEF_INS_PAGE(0x39, 4, ABY, AND);
     DEF_INS(0x21, 6, IDX, AND);
-    DEF_INS(0x31, 5, IDY, AND);
+    DEF_INS_PAGE(0x31, 5, IDY, AND);
 
     DEF_INS(0x0A, 2, IMP, ASL);
     DEF_INS(0x06, 5, ZER, ASL);
@@ -44,10 +52,11 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0x24, 3, ZER, BIT);
     DEF_INS(0x2C, 4, ABS, BIT);
 
+    DEF_INS(0x30, 2, REL, BMI);
     DEF_INS(0xD0, 2, REL, BNE);
     DEF_INS(0x10, 2, REL, BPL);
 
-    DEF_INS(0x00, 7, IMP, BNE);
+    DEF_INS(0x00, 7, IMP, BRK);
 
     DEF_INS(0x50, 2, REL, BVC);
     DEF_INS(0x70, 2, REL, BVS);
@@ -61,10 +70,10 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0xC5, 3, ZER, CMP);
     DEF_INS(0xD5, 4, ZPX, CMP);
     DEF_INS(0xCD, 4, ABS, CMP);
-    DEF_INS(0xDD, 4, ABX, CMP);
-    DEF_INS(0xD9, 4, ABY, CMP);
+    DEF_INS_PAGE(0xDD, 4, ABX, CMP);
+    DEF_INS_PAGE(0xD9, 4, ABY, CMP);
     DEF_INS(0xC1, 6, IDX, CMP);
-    DEF_INS(0xD1, 5, IDY, CMP);
+    DEF_INS_PAGE(0xD1, 5, IDY, CMP);
 
     DEF_INS(0xE0, 2, IMM, CPX);
     DEF_INS(0xE4, 3, ZER, CPX);
@@ -86,15 +95,15 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0x45, 3, ZER, EOR);
     DEF_INS(0x55, 4, ZPX, EOR);
     DEF_INS(0x4D, 4, ABS, EOR);
-    DEF_INS(0x5D, 4, ABX, EOR);
-    DEF_INS(0x59, 4, ABY, EOR);
+    DEF_INS_PAGE(0x5D, 4, ABX, EOR);
+    DEF_INS_PAGE(0x59, 4, ABY, EOR);
     DEF_INS(0x41, 6, IDX, EOR);
-    DEF_INS(0x51, 5, IDY, EOR);
+    DEF_INS_PAGE(0x51, 5, IDY, EOR);
 
-    DEF_INS(0xE6, 5, ZER, DEC);
-    DEF_INS(0xF6, 6, ZPX, DEC);
-    DEF_INS(0xEE, 6, ABS, DEC);
-    DEF_INS(0xFE, 7, ABX, DEC);
+    DEF_INS(0xE6, 5, ZER, INC);
+    DEF_INS(0xF6, 6, ZPX, INC);
+    DEF_INS(0xEE, 6, ABS, INC);
+    DEF_INS(0xFE, 7, ABX, INC);
 
     DEF_INS(0xE8, 2, IMP, INX);
     DEF_INS(0xC8, 2, IMP, INY);
@@ -108,24 +117,24 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0xA5, 3, ZER, LDA);
     DEF_INS(0xB5, 4, ZPX, LDA);
     DEF_INS(0xAD, 4, ABS, LDA);
-    DEF_INS(0xBD, 4, ABX, LDA);
-    DEF_INS(0xB9, 4, ABY, LDA);
+    DEF_INS_PAGE(0xBD, 4, ABX, LDA);
+    DEF_INS_PAGE(0xB9, 4, ABY, LDA);
     DEF_INS(0xA1, 6, IDX, LDA);
-    DEF_INS(0xB1, 5, IDY, LDA);
+    DEF_INS_PAGE(0xB1, 5, IDY, LDA);
 
     DEF_INS(0xA2, 2, IMM, LDX);
     DEF_INS(0xA6, 3, ZER, LDX);
     DEF_INS(0xB6, 4, ZPY, LDX);
     DEF_INS(0xAE, 4, ABS, LDX);
-    DEF_INS(0xBE, 4, ABY, LDX);
+    DEF_INS_PAGE(0xBE, 4, ABY, LDX);
 
     DEF_INS(0xA0, 2, IMM, LDY);
     DEF_INS(0xA4, 3, ZER, LDY);
     DEF_INS(0xB4, 4, ZPX, LDY);
     DEF_INS(0xAC, 4, ABS, LDY);
-    DEF_INS(0xBC, 4, ABX, LDY);
+    DEF_INS_PAGE(0xBC, 4, ABX, LDY);
 
-    DEF_INS(0x4A, 2, IMM, LSR);
+    DEF_INS(0x4A, 2, IMP, LSR);
     DEF_INS(0x46, 5, ZER, LSR);
     DEF_INS(0x56, 6, ZPX, LSR);
     DEF_INS(0x4E, 6, ABS, LSR);
@@ -137,10 +146,10 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0x05, 3, ZER, ORA);
     DEF_INS(0x15, 4, ZPX, ORA);
     DEF_INS(0x0D, 4, ABS, ORA);
-    DEF_INS(0x1D, 4, ABX, ORA);
-    DEF_INS(0x19, 4, ABY, ORA);
+    DEF_INS_PAGE(0x1D, 4, ABX, ORA);
+    DEF_INS_PAGE(0x19, 4, ABY, ORA);
     DEF_INS(0x01, 6, IDX, ORA);
-    DEF_INS(0x11, 5, IDY, ORA);
+    DEF_INS_PAGE(0x11, 5, IDY, ORA);
 
     DEF_INS(0x48, 3, IMP, PHA);
     DEF_INS(0x08, 3, IMP, PHP);
@@ -148,13 +157,13 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0x68, 4, IMP, PLA);
     DEF_INS(0x28, 4, IMP, PLP);
 
-    DEF_INS(0X2A, 2, IMM, ROL);
+    DEF_INS(0x2A, 2, IMP, ROL);
     DEF_INS(0x26, 5, ZER, ROL);
     DEF_INS(0x36, 6, ZPX, ROL);
     DEF_INS(0x2E, 6, ABS, ROL);
     DEF_INS(0x3E, 7, ABX, ROL);
 
-    DEF_INS(0X6A, 2, IMM, ROR);
+    DEF_INS(0x6A, 2, IMP, ROR);
     DEF_INS(0x66, 5, ZER, ROR);
     DEF_INS(0x76, 6, ZPX, ROR);
     DEF_INS(0x6E, 6, ABS, ROR);
@@ -167,10 +176,10 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0xE5, 3, ZER, SBC);
     DEF_INS(0xF5, 4, ZPX, SBC);
     DEF_INS(0xED, 4, ABS, SBC);
-    DEF_INS(0xFD, 4, ABX, SBC);
-    DEF_INS(0xF9, 4, ABY, SBC);
+    DEF_INS_PAGE(0xFD, 4, ABX, SBC);
+    DEF_INS_PAGE(0xF9, 4, ABY, SBC);
     DEF_INS(0xE1, 6, IDX, SBC);
-    DEF_INS(0xF1, 5, IDY, SBC);
+    DEF_INS_PAGE(0xF1, 5, IDY, SBC);
 
     DEF_INS(0x38, 2, IMP, SEC);
     DEF_INS(0xF8, 2, IMP, SED);
@@ -199,6 +208,99 @@ void Cpu::GenerateInstructionSet()
     DEF_INS(0x9A, 2, IMP, TXS);
     DEF_INS(0x98, 2, IMP, TYA);
 
+    // Unofficial opcodes
+
+    DEF_INS(0x1A, 2, IMP, NOP);
+    DEF_INS(0x3A, 2, IMP, NOP);
+    DEF_INS(0x5A, 2, IMP, NOP);
+    DEF_INS(0x7A, 2, IMP, NOP);
+    DEF_INS(0xDA, 2, IMP, NOP);
+    DEF_INS(0xFA, 2, IMP, NOP);
+    DEF_INS(0x80, 2, IMM, NOP);
+    DEF_INS(0x82, 2, IMM, NOP);
+    DEF_INS(0x89, 2, IMM, NOP);
+    DEF_INS(0xC2, 2, IMM, NOP);
+    DEF_INS(0xE2, 2, IMM, NOP);
+    DEF_INS(0x04, 3, ZER, NOP);
+    DEF_INS(0x44, 3, ZER, NOP);
+    DEF_INS(0x64, 3, ZER, NOP);
+    DEF_INS(0x14, 4, ZPX, NOP);
+    DEF_INS(0x34, 4, ZPX, NOP);
+    DEF_INS(0x54, 4, ZPX, NOP);
+    DEF_INS(0x74, 4, ZPX, NOP);
+    DEF_INS(0xD4, 4, ZPX, NOP);
+    DEF_INS(0xF4, 4, ZPX, NOP);
+    DEF_INS(0x0C, 4, ABS, NOP);
+    DEF_INS_PAGE(0x1C, 4, ABX, NOP);
+    DEF_INS_PAGE(0x3C, 4, ABX, NOP);
+    DEF_INS_PAGE(0x5C, 4, ABX, NOP);
+    DEF_INS_PAGE(0x7C, 4, ABX, NOP);
+    DEF_INS_PAGE(0xDC, 4, ABX, NOP);
+    DEF_INS_PAGE(0xFC, 4, ABX, NOP);
+
+    DEF_INS(0xA7, 3, ZER, LAX);
+    DEF_INS(0xB7, 4, ZPY, LAX);
+    DEF_INS(0xAF, 4, ABS, LAX);
+    DEF_INS_PAGE(0xBF, 4, ABY, LAX);
+    DEF_INS(0xA3, 6, IDX, LAX);
+    DEF_INS_PAGE(0xB3, 5, IDY, LAX);
+
+    DEF_INS(0x87, 3, ZER, SAX);
+    DEF_INS(0x97, 4, ZPY, SAX);
+    DEF_INS(0x8F, 4, ABS, SAX);
+    DEF_INS(0x83, 6, IDX, SAX);
+
+    DEF_INS(0xEB, 2, IMM, SBC);
+
+    DEF_INS(0xC7, 5, ZER, DCP);
+    DEF_INS(0xD7, 6, ZPX, DCP);
+    DEF_INS(0xCF, 6, ABS, DCP);
+    DEF_INS(0xDF, 7, ABX, DCP);
+    DEF_INS(0xDB, 7, ABY, DCP);
+    DEF_INS(0xC3, 8, IDX, DCP);
+    DEF_INS(0xD3, 8, IDY, DCP);
+
+    DEF_INS(0xE7, 5, ZER, ISB);
+    DEF_INS(0xF7, 6, ZPX, ISB);
+    DEF_INS(0xEF, 6, ABS, ISB);
+    DEF_INS(0xFF, 7, ABX, ISB);
+    DEF_INS(0xFB, 7, ABY, ISB);
+    DEF_INS(0xE3, 8, IDX, ISB);
+    DEF_INS(0xF3, 8, IDY, ISB);
+
+    DEF_INS(0x07, 5, ZER, SLO);
+    DEF_INS(0x17, 6, ZPX, SLO);
+    DEF_INS(0x0F, 6, ABS, SLO);
+    DEF_INS(0x1F, 7, ABX, SLO);
+    DEF_INS(0x1B, 7, ABY, SLO);
+    DEF_INS(0x03, 8, IDX, SLO);
+    DEF_INS(0x13, 8, IDY, SLO);
+
+    DEF_INS(0x27, 5, ZER, RLA);
+    DEF_INS(0x37, 6, ZPX, RLA);
+    DEF_INS(0x2F, 6, ABS, RLA);
+    DEF_INS(0x3F, 7, ABX, RLA);
+    DEF_INS(0x3B, 7, ABY, RLA);
+    DEF_INS(0x23, 8, IDX, RLA);
+    DEF_INS(0x33, 8, IDY, RLA);
+
+    DEF_INS(0x47, 5, ZER, SRE);
+    DEF_INS(0x57, 6, ZPX, SRE);
+    DEF_INS(0x4F, 6, ABS, SRE);
+    DEF_INS(0x5F, 7, ABX, SRE);
+    DEF_INS(0x5B, 7, ABY, SRE);
+    DEF_INS(0x43, 8, IDX, SRE);
+    DEF_INS(0x53, 8, IDY, SRE);
+
+    DEF_INS(0x67, 5, ZER, RRA);
+    DEF_INS(0x77, 6, ZPX, RRA);
+    DEF_INS(0x6F, 6, ABS, RRA);
+    DEF_INS(0x7F, 7, ABX, RRA);
+    DEF_INS(0x7B, 7, ABY, RRA);
+    DEF_INS(0x63, 8, IDX, RRA);
+    DEF_INS(0x73, 8, IDY, RRA);
+
+#undef DEF_INS_PAGE
 #undef DEF_INS
 #undef INS
 }
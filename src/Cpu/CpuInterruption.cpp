@@ -1,47 +1,86 @@
 #include "Cpu.hpp"
 #include "CpuBitwise.hpp"
-#include "../Ram.hpp"
+#include "CpuProfiler.hpp"
+#include "../MemoryMap.hpp"
 
 void Cpu::Interrupt(DWord interruptVector)
 {
+    PushDWord(m_PC);
+    // Hardware interrupts push the status register with the break bit cleared
     m_Status.B = 0;
+    m_Status.U = 1;
     PushWord(m_Status.value);
-    PushDWord(m_PC);
     m_Status.I = 1;
+    m_IrqDisabled = true;
 
     DWord programLo = Read(interruptVector);
     DWord programHi = Read(interruptVector + 1);
-    
+
     m_PC = CONCATENATE_WORDS(programHi, programLo);
 }
 
-void Cpu::IRQ()
+void Cpu::TriggerNmi()
+{
+    m_PendingInterrupts |= InterruptNmi;
+}
+
+void Cpu::SetIrqLine(InterruptSource source, bool asserted)
+{
+    m_PendingInterrupts = asserted ? m_PendingInterrupts | source : m_PendingInterrupts & ~source;
+}
+
+Word Cpu::GetPendingInterrupts() const
+{
+    return m_PendingInterrupts;
+}
+
+void Cpu::PollInterrupts()
+{
+    m_PolledInterrupts = m_PendingInterrupts & (m_IrqDisabled ? InterruptNmi : InterruptNmi | s_IrqSources);
+}
+
+QWord Cpu::ServiceInterrupt()
 {
-    if (!m_Status.I)
+    // The NMI wins when both are polled, the IRQ is then polled again after the first handler instruction
+    if (m_PolledInterrupts & InterruptNmi)
+    {
+        m_PendingInterrupts &= ~InterruptNmi;
+        Interrupt(s_NmiVector);
+    }
+    else
     {
         Interrupt(s_IrqVector);
     }
 
-    m_RemainingCycles = 7;
-}
+    m_PolledInterrupts = 0;
+    m_Cycles += 7;
 
-void Cpu::NMI()
-{
-    Interrupt(s_NmiVector);
-    m_RemainingCycles = 8;
+    if (m_Profiler)
+    {
+        m_Profiler->RecordInterrupt(m_PC, 7);
+    }
+
+    return 7;
 }
 
 void Cpu::Reset()
 {
     DWord programLo = Read(s_ResetVector);
     DWord programHi = Read(s_ResetVector + 1);
-    
+
     m_A = m_X = m_Y = 0x00;
-    m_PC = 0x0000;
+    m_PC = CONCATENATE_WORDS(programHi, programLo);
     m_SP = 0xFD;
-    
+
     m_Status.value = 0x00;
     m_Status.U = 1;
+    m_Status.I = 1;
+
+    // The IRQ sources are reset along with their devices which release their line
+    m_PendingInterrupts &= ~InterruptNmi;
+    m_PolledInterrupts = 0;
+    m_IrqDisabled = true;
 
-    m_RemainingCycles = 8;
+    m_RemainingCycles = 7;
+    m_Cycles = 7;
 }
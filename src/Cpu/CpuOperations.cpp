@@ -1,12 +1,12 @@
 #include "Cpu.hpp"
 #include "CpuBitwise.hpp"
-#include "../Ram.hpp"
+#include "../MemoryMap.hpp"
 
 Word Cpu::Addition(DWord operand)
 {
     DWord result = m_A + operand + m_Status.C;
 
-    m_Status.C = result >= 0xFF;
+    m_Status.C = result > 0xFF;
     SET_NEGATIVE_FLAG(result);
     SET_ZERO_FLAG(result);
     m_Status.V = ~(m_A ^ operand) & (m_A ^ result) & NEGATIVE_BIT;
@@ -18,15 +18,15 @@ void Cpu::Branch(bool condition, DWord destination)
 {
     if (condition)
     {
-	m_RemainingCycles++;
-	
-        m_PC = destination;
+        m_PenaltyCycles++;
+
+        // Additional cycle if page crossed
+        if ((m_PC & 0xFF00) != (destination & 0xFF00))
+        {
+            m_PenaltyCycles++;
+        }
 
-	// Additional cycle if page crossed
-	if((m_PC & 0xFF00) != (destination & 0xFF00))
-	{
-	    m_RemainingCycles++;
-	}
+        m_PC = destination;
     }
 }
 
@@ -54,10 +54,12 @@ void Cpu::LoadRegister(Word &reg, Word value)
     SET_NEGATIVE_FLAG(value);
 }
 
-void Cpu::Return(Word offset)
+Word Cpu::PullStatus()
 {
     m_Status.value = PopWord();
-    m_PC = PopDWord() + offset;
+    m_Status.B = 0;
+    m_Status.U = 1;
+    return m_Status.value;
 }
 
 void Cpu::Transfer(Word &from, Word &to)
@@ -105,7 +107,7 @@ void Cpu::BCS(DWord destination)
 
 void Cpu::BEQ(DWord destination)
 {
-    Branch(m_Status.Z == 0, destination);
+    Branch(m_Status.Z == 1, destination);
 }
 
 void Cpu::BIT(DWord source)
@@ -114,7 +116,7 @@ void Cpu::BIT(DWord source)
     Word result = operand & m_A;
 
     SET_ZERO_FLAG(result);
-    SET_NEGATIVE_FLAG(result);
+    SET_NEGATIVE_FLAG(operand);
     m_Status.V = operand & (1 << 6);
 }
 
@@ -135,17 +137,19 @@ void Cpu::BPL(DWord destination)
 
 void Cpu::BRK(DWord)
 {
+    // Skip the padding byte following the opcode
     m_PC++;
 
     PushDWord(m_PC);
     // Push the status register onto the stack with the break bit active
-    PushWord(m_Status.value | (1 << 4));
+    PushWord(m_Status.value | (1 << 4) | (1 << 5));
     m_Status.I = 1;
+    m_IrqDisabled = true;
 
-    DWord pcLo = FetchWord(s_IrqVector);
-    DWord pcHi = FetchWord(s_IrqVector + 1);
+    DWord pcLo = Read(s_IrqVector);
+    DWord pcHi = Read(s_IrqVector + 1);
 
-    m_PC = CONCATENATE_WORDS(pcLo, pcHi);
+    m_PC = CONCATENATE_WORDS(pcHi, pcLo);
 }
 
 void Cpu::BVC(DWord destination)
@@ -185,7 +189,7 @@ void Cpu::CPX(DWord source)
 }
 void Cpu::CPY(DWord source)
 {
-    Compare(m_X, FetchWord(source));
+    Compare(m_Y, FetchWord(source));
 }
 
 void Cpu::DEC(DWord source)
@@ -206,8 +210,8 @@ void Cpu::EOR(DWord source)
 {
     Word operand = FetchWord(source);
     m_A ^= operand;
-    SET_NEGATIVE_FLAG(operand);
-    SET_ZERO_FLAG(operand);
+    SET_NEGATIVE_FLAG(m_A);
+    SET_ZERO_FLAG(m_A);
 }
 
 void Cpu::INC(DWord source)
@@ -232,7 +236,8 @@ void Cpu::JMP(DWord destination)
 void Cpu::JSR(DWord destination)
 {
     PushDWord(--m_PC);
-    m_PC = destination;
+    // The high byte of the target is fetched after the pushes, which may have overwritten it
+    m_PC = CONCATENATE_WORDS(Read(m_PC), destination & 0x00FF);
 }
 
 void Cpu::LDA(DWord source)
@@ -272,8 +277,6 @@ void Cpu::ORA(DWord source)
 
     SET_ZERO_FLAG(m_A);
     SET_NEGATIVE_FLAG(m_A);
-
-    SetWord(source, m_A);
 }
 
 void Cpu::PHA(DWord)
@@ -282,16 +285,17 @@ void Cpu::PHA(DWord)
 }
 void Cpu::PHP(DWord)
 {
-    PushWord(m_Status.value);
+    // The status register is pushed with the break bit active
+    PushWord(m_Status.value | (1 << 4) | (1 << 5));
 }
 
 void Cpu::PLA(DWord)
 {
-    m_A = PopWord();
+    LoadRegister(m_A, PopWord());
 }
 void Cpu::PLP(DWord)
 {
-    m_Status.value = PopWord();
+    PullStatus();
 }
 
 void Cpu::ROL(DWord source)
@@ -320,16 +324,19 @@ void Cpu::ROR(DWord source)
 
 void Cpu::RTI(DWord)
 {
-    Return(0);
+    PullStatus();
+    // Unlike PLP the restored flag is already polled at the end of the instruction
+    m_IrqDisabled = m_Status.I;
+    m_PC = PopDWord();
 }
 void Cpu::RTS(DWord)
 {
-    Return(1);
+    m_PC = PopDWord() + 1;
 }
 
 void Cpu::SBC(DWord source)
 {
-    Addition(~FetchWord(source));
+    m_A = Addition((Word)~FetchWord(source));
 }
 
 void Cpu::SEC(DWord)
@@ -376,7 +383,8 @@ void Cpu::TXA(DWord)
 }
 void Cpu::TXS(DWord)
 {
-    Transfer(m_X, m_SP);
+    // The only transfer leaving the flags untouched
+    m_SP = m_X;
 }
 void Cpu::TYA(DWord)
 {
@@ -387,3 +395,52 @@ void Cpu::ILL(DWord)
 {
     return;
 }
+
+void Cpu::LAX(DWord source)
+{
+    LoadRegister(m_A, FetchWord(source));
+    m_X = m_A;
+}
+
+void Cpu::SAX(DWord source)
+{
+    SetWord(source, m_A & m_X);
+}
+
+void Cpu::DCP(DWord source)
+{
+    Word result = (FetchWord(source) - 1) & 0xFF;
+    SetWord(source, result);
+    Compare(m_A, result);
+}
+
+void Cpu::ISB(DWord source)
+{
+    Word result = (FetchWord(source) + 1) & 0xFF;
+    SetWord(source, result);
+    m_A = Addition((Word)~result);
+}
+
+void Cpu::SLO(DWord source)
+{
+    ASL(source);
+    ORA(source);
+}
+
+void Cpu::RLA(DWord source)
+{
+    ROL(source);
+    AND(source);
+}
+
+void Cpu::SRE(DWord source)
+{
+    LSR(source);
+    EOR(source);
+}
+
+void Cpu::RRA(DWord source)
+{
+    ROR(source);
+    ADC(source);
+}
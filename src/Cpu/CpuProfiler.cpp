@@ -0,0 +1,224 @@
+#include "CpuProfiler.hpp"
+#include "Cpu.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+
+namespace
+{
+constexpr Word OpcodeBRK = 0x00;
+constexpr Word OpcodeJSR = 0x20;
+constexpr Word OpcodeRTI = 0x40;
+constexpr Word OpcodeRTS = 0x60;
+
+// Indices of the count highest values
+std::vector<std::size_t> Hottest(const std::vector<std::uint64_t> &values, std::size_t count)
+{
+    std::vector<std::size_t> indices;
+
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        if (values[i] != 0)
+        {
+            indices.push_back(i);
+        }
+    }
+
+    count = std::min(count, indices.size());
+    std::partial_sort(indices.begin(), indices.begin() + count, indices.end(),
+                      [&values](std::size_t a, std::size_t b) { return values[a] > values[b]; });
+    indices.resize(count);
+
+    return indices;
+}
+
+double Percent(std::uint64_t part, std::uint64_t total)
+{
+    return total == 0 ? 0.0 : 100.0 * part / total;
+}
+} // namespace
+
+CpuProfiler::CpuProfiler()
+    : m_PcCount(s_AddressSpace), m_PcCycles(s_AddressSpace), m_RoutineCalls(s_AddressSpace),
+      m_RoutineCycles(s_AddressSpace)
+{
+    Clear();
+}
+
+void CpuProfiler::Clear()
+{
+    m_OpcodeCount.fill(0);
+    m_OpcodeCycles.fill(0);
+    m_OpcodePagePenalties.fill(0);
+
+    std::fill(m_PcCount.begin(), m_PcCount.end(), 0);
+    std::fill(m_PcCycles.begin(), m_PcCycles.end(), 0);
+    std::fill(m_RoutineCalls.begin(), m_RoutineCalls.end(), 0);
+    std::fill(m_RoutineCycles.begin(), m_RoutineCycles.end(), 0);
+    m_InterruptCount = m_InterruptCycles = 0;
+
+    m_CallStack[0] = 0x0000;
+    m_CallDepth = 0;
+}
+
+void CpuProfiler::Record(DWord pc, Word opcode, QWord cycles, bool pagePenalty, DWord next)
+{
+    m_OpcodeCount[opcode]++;
+    m_OpcodeCycles[opcode] += cycles;
+    m_OpcodePagePenalties[opcode] += pagePenalty;
+
+    m_PcCount[pc]++;
+    m_PcCycles[pc] += cycles;
+
+    m_RoutineCycles[m_CallStack[m_CallDepth]] += cycles;
+
+    switch (opcode)
+    {
+    case OpcodeJSR:
+    case OpcodeBRK:
+        Enter(next);
+        break;
+
+    case OpcodeRTS:
+    case OpcodeRTI:
+        if (m_CallDepth > 0)
+        {
+            m_CallDepth--;
+        }
+        break;
+    }
+}
+
+void CpuProfiler::RecordInterrupt(DWord handler, QWord cycles)
+{
+    m_InterruptCount++;
+    m_InterruptCycles += cycles;
+
+    // Pushed like a BRK so that the RTI of the handler returns to the interrupted routine
+    Enter(handler);
+    m_RoutineCycles[handler] += cycles;
+}
+
+void CpuProfiler::Enter(DWord entry)
+{
+    m_RoutineCalls[entry]++;
+
+    if (m_CallDepth + 1 < m_CallStack.size())
+    {
+        m_CallStack[++m_CallDepth] = entry;
+    }
+}
+
+std::uint64_t CpuProfiler::GetOpcodeCount(Word opcode) const
+{
+    return m_OpcodeCount[opcode];
+}
+
+std::uint64_t CpuProfiler::GetOpcodeCycles(Word opcode) const
+{
+    return m_OpcodeCycles[opcode];
+}
+
+std::uint64_t CpuProfiler::GetOpcodePagePenalties(Word opcode) const
+{
+    return m_OpcodePagePenalties[opcode];
+}
+
+std::uint64_t CpuProfiler::GetPcCount(DWord pc) const
+{
+    return m_PcCount[pc];
+}
+
+std::uint64_t CpuProfiler::GetPcCycles(DWord pc) const
+{
+    return m_PcCycles[pc];
+}
+
+std::uint64_t CpuProfiler::GetRoutineCalls(DWord entry) const
+{
+    return m_RoutineCalls[entry];
+}
+
+std::uint64_t CpuProfiler::GetRoutineCycles(DWord entry) const
+{
+    return m_RoutineCycles[entry];
+}
+
+std::uint64_t CpuProfiler::GetInterruptCount() const
+{
+    return m_InterruptCount;
+}
+
+std::uint64_t CpuProfiler::GetInstructionCount() const
+{
+    return std::accumulate(m_OpcodeCount.begin(), m_OpcodeCount.end(), std::uint64_t(0));
+}
+
+std::uint64_t CpuProfiler::GetCycleCount() const
+{
+    return std::accumulate(m_OpcodeCycles.begin(), m_OpcodeCycles.end(), m_InterruptCycles);
+}
+
+void CpuProfiler::Report(std::ostream &stream, const Cpu &cpu, std::size_t count) const
+{
+    std::uint64_t instructions = GetInstructionCount();
+    std::uint64_t cycles = GetCycleCount();
+
+    std::ios::fmtflags flags = stream.flags();
+    stream << std::fixed << std::setprecision(2);
+    stream << "instructions " << instructions << ", interrupts " << m_InterruptCount << ", cycles " << cycles << "\n";
+
+    stream << "\nhottest opcodes\n";
+    std::vector<std::uint64_t> opcodeCycles(m_OpcodeCycles.begin(), m_OpcodeCycles.end());
+
+    for (std::size_t opcode : Hottest(opcodeCycles, count))
+    {
+        stream << "  $" << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << opcode << std::dec
+               << std::setfill(' ') << " " << cpu.GetMnemonic(opcode) << " "
+               << Cpu::GetAddressingName(cpu.GetAddressing(opcode)) << std::setw(12) << m_OpcodeCount[opcode]
+               << " executions" << std::setw(12) << m_OpcodeCycles[opcode] << " cycles " << std::setw(6)
+               << Percent(m_OpcodeCycles[opcode], cycles) << "%\n";
+    }
+
+    stream << "\naddressing modes\n";
+    constexpr std::size_t Modes = (std::size_t)Cpu::Addressing::IDY + 1;
+    std::vector<std::uint64_t> modeCount(Modes), modeCycles(Modes), modePenalties(Modes);
+
+    for (std::size_t opcode = 0; opcode < 256; opcode++)
+    {
+        std::size_t mode = (std::size_t)cpu.GetAddressing(opcode);
+        modeCount[mode] += m_OpcodeCount[opcode];
+        modeCycles[mode] += m_OpcodeCycles[opcode];
+        modePenalties[mode] += m_OpcodePagePenalties[opcode];
+    }
+
+    for (std::size_t mode : Hottest(modeCycles, Modes))
+    {
+        stream << "  " << Cpu::GetAddressingName((Cpu::Addressing)mode) << std::setw(12) << modeCount[mode]
+               << " executions" << std::setw(12) << modeCycles[mode] << " cycles " << std::setw(6)
+               << Percent(modeCycles[mode], cycles) << "%" << std::setw(10) << modePenalties[mode]
+               << " page crossing penalties\n";
+    }
+
+    stream << "\nhottest program counters\n";
+
+    for (std::size_t pc : Hottest(m_PcCycles, count))
+    {
+        stream << "  $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << pc << std::dec
+               << std::setfill(' ') << std::setw(12) << m_PcCount[pc] << " executions" << std::setw(12)
+               << m_PcCycles[pc] << " cycles " << std::setw(6) << Percent(m_PcCycles[pc], cycles) << "%\n";
+    }
+
+    stream << "\nhottest routines (exclusive cycles)\n";
+
+    for (std::size_t entry : Hottest(m_RoutineCycles, count))
+    {
+        stream << "  $" << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << entry << std::dec
+               << std::setfill(' ') << std::setw(12) << m_RoutineCalls[entry] << " calls" << std::setw(12)
+               << m_RoutineCycles[entry] << " cycles " << std::setw(6) << Percent(m_RoutineCycles[entry], cycles)
+               << "%\n";
+    }
+
+    stream.flags(flags);
+}
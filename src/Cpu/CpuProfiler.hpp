@@ -0,0 +1,73 @@
+#ifndef CPU_PROFILER_HPP
+#define CPU_PROFILER_HPP
+
+#include "../Types.hpp"
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+class Cpu;
+
+/*
+   Execution profiler
+
+   Counts the executions and consumed cycles per opcode and per program
+   counter using flat arrays covering the whole address space. Cycles are
+   also attributed to the innermost routine, routines being tracked with a
+   shadow call stack fed by JSR/BRK, the NMI and IRQ entries and RTS/RTI
+ */
+class CpuProfiler
+{
+public:
+    CpuProfiler();
+    void Clear();
+
+    // Called by the cpu once the instruction at pc has been executed
+    void Record(DWord pc, Word opcode, QWord cycles, bool pagePenalty, DWord next);
+    // Called by the cpu once it entered the NMI or IRQ handler, the entry cycles are charged to the handler
+    void RecordInterrupt(DWord handler, QWord cycles);
+
+    void Report(std::ostream &stream, const Cpu &cpu, std::size_t count = 10) const;
+
+    std::uint64_t GetOpcodeCount(Word opcode) const;
+    std::uint64_t GetOpcodeCycles(Word opcode) const;
+    std::uint64_t GetOpcodePagePenalties(Word opcode) const;
+    std::uint64_t GetPcCount(DWord pc) const;
+    std::uint64_t GetPcCycles(DWord pc) const;
+    // By routine entry point, the cycles spent in the routine itself, not in its callees
+    std::uint64_t GetRoutineCalls(DWord entry) const;
+    std::uint64_t GetRoutineCycles(DWord entry) const;
+    std::uint64_t GetInterruptCount() const;
+    // Sums over all the opcodes, the cycles include the interrupt entries
+    std::uint64_t GetInstructionCount() const;
+    std::uint64_t GetCycleCount() const;
+
+    static constexpr std::size_t s_AddressSpace = 0x10000;
+
+private:
+    // Push a routine on the shadow call stack
+    void Enter(DWord entry);
+
+    std::array<std::uint64_t, 256> m_OpcodeCount;
+    std::array<std::uint64_t, 256> m_OpcodeCycles;
+    // Page crossing penalties paid by the indexed read instructions
+    std::array<std::uint64_t, 256> m_OpcodePagePenalties;
+
+    std::vector<std::uint64_t> m_PcCount;
+    std::vector<std::uint64_t> m_PcCycles;
+
+    // Indexed by routine entry point
+    std::vector<std::uint64_t> m_RoutineCalls;
+    std::vector<std::uint64_t> m_RoutineCycles;
+
+    std::uint64_t m_InterruptCount;
+    std::uint64_t m_InterruptCycles;
+
+    // Routines entered before the profiler was attached are attributed to the
+    // bottom of the stack, deeper calls than the shadow stack are dropped
+    std::array<DWord, 64> m_CallStack;
+    std::size_t m_CallDepth;
+};
+
+#endif
@@ -0,0 +1,284 @@
+#include "Debugger.hpp"
+#include "Bus.hpp"
+#include "Nes.hpp"
+#include <algorithm>
+
+namespace
+{
+constexpr Word OpcodeJsr = 0x20;
+constexpr std::size_t AddressSpace = 0x10000;
+} // namespace
+
+Debugger::Debugger(Nes &nes)
+    : m_Bus(nes.GetBus()), m_NextId(0), m_Running(false), m_Hit(false), m_Frames(0)
+{
+    m_Bus.GetMemory().SetWatcher(this);
+}
+
+Debugger::~Debugger()
+{
+    MemoryMap &memory = m_Bus.GetMemory();
+    memory.ClearWatches();
+    memory.SetWatcher(nullptr);
+}
+
+int Debugger::AddWatchpoint(DWord first, DWord last, Word access)
+{
+    if (first > last)
+    {
+        std::swap(first, last);
+    }
+
+    m_Watchpoints.push_back({m_NextId, first, last, access});
+    Rebuild();
+    return m_NextId++;
+}
+
+int Debugger::AddBreakpoint(DWord pc)
+{
+    return AddWatchpoint(pc, pc, Execute);
+}
+
+void Debugger::Remove(int id)
+{
+    m_Watchpoints.erase(std::remove_if(m_Watchpoints.begin(), m_Watchpoints.end(),
+                                       [id](const Watchpoint &watchpoint) { return watchpoint.id == id; }),
+                        m_Watchpoints.end());
+    Rebuild();
+}
+
+void Debugger::Clear()
+{
+    m_Watchpoints.clear();
+    Rebuild();
+}
+
+Debugger::Stop Debugger::StepInto()
+{
+    return Resume(Mode::StepInto, 0);
+}
+
+Debugger::Stop Debugger::StepOver()
+{
+    return Resume(Mode::StepOver, 0);
+}
+
+Debugger::Stop Debugger::RunFrame()
+{
+    return Resume(Mode::Run, 1);
+}
+
+Debugger::Stop Debugger::Run(std::uint64_t frames)
+{
+    return Resume(Mode::Run, frames);
+}
+
+Debugger::Stop Debugger::Resume(Mode mode, std::uint64_t frames)
+{
+    Cpu &cpu = m_Bus.GetCpu();
+    Ppu &ppu = m_Bus.GetPpu();
+
+    Cpu::Registers start = cpu.GetRegisters();
+    bool stepOver = mode == Mode::StepOver && m_Bus.Peek(start.PC) == OpcodeJsr;
+    DWord returnAddress = start.PC + 3;
+
+    // Resuming from a breakpoint must not stop on it again, an unfinished instruction is completed first
+    bool started = !cpu.IsInstructionComplete();
+    bool stopped = false;
+    Stop stop;
+    m_Running = true;
+    Arm(true);
+
+    while (!stopped)
+    {
+        if (cpu.IsInstructionComplete())
+        {
+            Cpu::Registers registers = cpu.GetRegisters();
+
+            // The stack pointer tells a recursive call apart from the return of the stepped one
+            bool stepped = stepOver ? registers.PC == returnAddress && registers.SP >= start.SP : mode != Mode::Run;
+
+            if (m_Hit)
+            {
+                m_Hit = false;
+                stop = m_Stop;
+                stopped = true;
+                continue;
+            }
+
+            if (started && stepped)
+            {
+                stop.reason = StopReason::Step;
+                stop.address = registers.PC;
+                stopped = true;
+                continue;
+            }
+
+            if (started && !m_ExecuteBitmap.empty() && IsBreakpoint(registers.PC))
+            {
+                stop.reason = StopReason::Breakpoint;
+                stop.address = registers.PC;
+
+                for (const Watchpoint &watchpoint : m_Watchpoints)
+                {
+                    if ((watchpoint.access & Execute) && registers.PC >= watchpoint.first &&
+                        registers.PC <= watchpoint.last)
+                    {
+                        stop.id = watchpoint.id;
+                        break;
+                    }
+                }
+
+                stopped = true;
+                continue;
+            }
+
+            started = true;
+        }
+
+        m_Bus.Clock();
+
+        // Same stopping point as Nes::StepFrame, a pending watchpoint hit is reported by the next run
+        if (ppu.PollFrameComplete())
+        {
+            m_Bus.EndFrame();
+            m_Frames++;
+
+            if (mode == Mode::Run && frames > 0 && --frames == 0)
+            {
+                stop.reason = StopReason::Frame;
+                stop.address = cpu.GetRegisters().PC;
+                stopped = true;
+            }
+        }
+    }
+
+    Arm(false);
+    m_Running = false;
+    return stop;
+}
+
+Cpu::Registers Debugger::GetRegisters() const
+{
+    return m_Bus.GetCpu().GetRegisters();
+}
+
+void Debugger::SetRegisters(const Cpu::Registers &registers)
+{
+    m_Bus.GetCpu().SetRegisters(registers);
+}
+
+std::uint64_t Debugger::GetCycles() const
+{
+    return m_Bus.GetCpu().GetCycles();
+}
+
+std::uint64_t Debugger::GetFrameCount() const
+{
+    return m_Frames;
+}
+
+Word Debugger::Peek(DWord address) const
+{
+    return m_Bus.Peek(address);
+}
+
+void Debugger::Peek(DWord address, Word *data, std::size_t count) const
+{
+    for (std::size_t i = 0; i < count; i++)
+    {
+        data[i] = m_Bus.Peek((address + i) & 0xFFFF);
+    }
+}
+
+bool Debugger::Poke(DWord address, Word value)
+{
+    Word *page = m_Bus.GetMemory().GetMappedWritePage(address >> 8);
+
+    if (!page)
+    {
+        return false;
+    }
+
+    page[address & 0xFF] = value;
+    return true;
+}
+
+void Debugger::Rebuild()
+{
+    m_WatchedPages.assign(MemoryMap::s_PageCount, 0);
+    m_ExecuteBitmap.clear();
+
+    for (const Watchpoint &watchpoint : m_Watchpoints)
+    {
+        for (std::size_t page = watchpoint.first >> 8; page <= std::size_t(watchpoint.last >> 8); page++)
+        {
+            m_WatchedPages[page] |= watchpoint.access;
+        }
+
+        if (watchpoint.access & Execute)
+        {
+            m_ExecuteBitmap.resize(AddressSpace / 64);
+
+            for (std::size_t pc = watchpoint.first; pc <= watchpoint.last; pc++)
+            {
+                m_ExecuteBitmap[pc / 64] |= std::uint64_t(1) << (pc % 64);
+            }
+        }
+    }
+
+}
+
+void Debugger::Arm(bool armed)
+{
+    MemoryMap &memory = m_Bus.GetMemory();
+
+    if (!armed || m_Watchpoints.empty())
+    {
+        memory.ClearWatches();
+        return;
+    }
+
+    for (std::size_t page = 0; page < MemoryMap::s_PageCount; page++)
+    {
+        memory.Watch(page, m_WatchedPages[page] & Read, m_WatchedPages[page] & Write);
+    }
+}
+
+bool Debugger::IsBreakpoint(DWord pc) const
+{
+    return (m_ExecuteBitmap[pc / 64] >> (pc % 64)) & 0x01;
+}
+
+void Debugger::OnRead(DWord address, Word value)
+{
+    Hit(address, value, Read);
+}
+
+void Debugger::OnWrite(DWord address, Word value)
+{
+    Hit(address, value, Write);
+}
+
+void Debugger::Hit(DWord address, Word value, Access access)
+{
+    // The first access of the instruction is reported, the pages also hold unwatched addresses
+    if (!m_Running || m_Hit)
+    {
+        return;
+    }
+
+    for (const Watchpoint &watchpoint : m_Watchpoints)
+    {
+        if ((watchpoint.access & access) && address >= watchpoint.first && address <= watchpoint.last)
+        {
+            m_Hit = true;
+            m_Stop.reason = StopReason::Watchpoint;
+            m_Stop.id = watchpoint.id;
+            m_Stop.address = address;
+            m_Stop.value = value;
+            m_Stop.access = access;
+            return;
+        }
+    }
+}
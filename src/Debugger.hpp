@@ -0,0 +1,138 @@
+#ifndef DEBUGGER_HPP
+#define DEBUGGER_HPP
+
+#include "MemoryMap.hpp"
+#include "Types.hpp"
+#include "Cpu/Cpu.hpp"
+#include <cstdint>
+#include <vector>
+
+class Bus;
+class Nes;
+
+/*
+   Breakpoints, watchpoints and controlled execution
+
+   Watchpoints cover address ranges. Their reads and writes are caught by
+   taking the pages they touch out of the memory map tables, every other
+   page keeps its direct access. Execution breakpoints are checked against
+   a bitmap of the address space which only exists while some are set.
+   The pages are only taken out for the duration of the run functions of
+   the debugger: Nes::StepFrame runs at full speed, code cache included,
+   even with watchpoints set
+
+   The execution stops between two instructions, a read or a write is
+   reported once the instruction doing it has completed and the
+   instruction fetches count as reads. Frame stops happen at the vblank
+   like Nes::StepFrame, even within an instruction which the next step
+   then completes
+ */
+class Debugger : private MemoryWatcher
+{
+public:
+    enum Access : Word
+    {
+        Read = 1 << 0,
+        Write = 1 << 1,
+        Execute = 1 << 2,
+    };
+
+    enum class StopReason
+    {
+        // The vblank of the frame has been reached
+        Frame,
+        Step,
+        Breakpoint,
+        Watchpoint,
+    };
+
+    struct Stop
+    {
+        StopReason reason = StopReason::Frame;
+        // Watchpoint hit, -1 for the other reasons
+        int id = -1;
+        // Accessed address or program counter of the breakpoint
+        DWord address = 0x0000;
+        Word value = 0x00;
+        Access access = Execute;
+    };
+
+    // The console must outlive the debugger
+    Debugger(Nes &nes);
+    ~Debugger();
+
+    Debugger(const Debugger &) = delete;
+    Debugger &operator=(const Debugger &) = delete;
+
+    // Watch the accesses of the given kinds (Access bits) to [first, last], returns its id
+    int AddWatchpoint(DWord first, DWord last, Word access);
+    int AddBreakpoint(DWord pc);
+    void Remove(int id);
+    void Clear();
+
+    // Execute one instruction, interrupts are entered like instructions
+    Stop StepInto();
+    // Same as StepInto but run a called subroutine until it returns
+    Stop StepOver();
+    // Run until the next vblank, or until a breakpoint or watchpoint stops the execution earlier
+    Stop RunFrame();
+    // Run the given amount of frames unless stopped earlier, 0 only stops on a breakpoint or watchpoint
+    Stop Run(std::uint64_t frames);
+
+    Cpu::Registers GetRegisters() const;
+    void SetRegisters(const Cpu::Registers &registers);
+    std::uint64_t GetCycles() const;
+    // Frames completed by the run functions
+    std::uint64_t GetFrameCount() const;
+
+    // Side effect free accesses, memory mapped registers read as zero and ignore the writes
+    Word Peek(DWord address) const;
+    void Peek(DWord address, Word *data, std::size_t count) const;
+    bool Poke(DWord address, Word value);
+
+private:
+    enum class Mode
+    {
+        StepInto,
+        StepOver,
+        Run,
+    };
+
+    struct Watchpoint
+    {
+        int id;
+        DWord first;
+        DWord last;
+        Word access;
+    };
+
+    Stop Resume(Mode mode, std::uint64_t frames);
+    // Rebuild the watched pages and the execution bitmap after a change
+    void Rebuild();
+    // Take the watched pages out of the memory map tables for a run, or give them back
+    void Arm(bool armed);
+    bool IsBreakpoint(DWord pc) const;
+
+    void OnRead(DWord address, Word value) override;
+    void OnWrite(DWord address, Word value) override;
+    void Hit(DWord address, Word value, Access access);
+
+    Bus &m_Bus;
+    std::vector<Watchpoint> m_Watchpoints;
+    int m_NextId;
+
+    // Access bits watched in each page
+    std::vector<Word> m_WatchedPages;
+    // One bit per address, empty without execution breakpoint
+    std::vector<std::uint64_t> m_ExecuteBitmap;
+
+    // Accesses are only reported while the debugger runs the emulation
+    bool m_Running;
+    // Set by the watcher, reported once the instruction completes
+    bool m_Hit;
+    Stop m_Stop;
+
+    std::uint64_t m_Frames;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "BlockWriter.hpp"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#define NES_OPEN _open
+#define NES_WRITE _write
+#define NES_CLOSE _close
+#define NES_SEEK _lseeki64
+#define NES_TRUNCATE _chsize_s
+#else
+#include <unistd.h>
+#define NES_OPEN ::open
+#define NES_WRITE ::write
+#define NES_CLOSE ::close
+#define NES_SEEK ::lseek
+#define NES_TRUNCATE ::ftruncate
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+namespace
+{
+void WriteAll(int file, const Word *data, std::size_t size)
+{
+    while (size > 0)
+    {
+        auto written = NES_WRITE(file, data, static_cast<unsigned>(size));
+
+        if (written <= 0)
+        {
+            throw std::runtime_error("Could not write the recording");
+        }
+
+        data += written;
+        size -= written;
+    }
+}
+} // namespace
+
+void BlockWriter::AlignedFree::operator()(Word *block) const
+{
+    ::operator delete(block, std::align_val_t(s_Alignment));
+}
+
+BlockWriter::BlockWriter(const std::string &path, bool direct, std::size_t blockSize)
+    : m_Path(path), m_BlockSize((blockSize + s_Alignment - 1) / s_Alignment * s_Alignment), m_Used(0), m_Size(0),
+      m_File(-1), m_Direct(false)
+{
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+
+#ifdef O_DIRECT
+    if (direct)
+    {
+        // Some file systems (tmpfs) refuse it, the page cache is used then
+        m_File = NES_OPEN(path.c_str(), flags | O_DIRECT, 0644);
+        m_Direct = m_File >= 0;
+    }
+#else
+    (void)direct;
+#endif
+
+    if (m_File < 0)
+    {
+        m_File = NES_OPEN(path.c_str(), flags, 0644);
+    }
+
+    if (m_File < 0)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    // Twice the block size so that a reservation never needs to wrap
+    m_Block.reset(static_cast<Word *>(::operator new(2 * m_BlockSize, std::align_val_t(s_Alignment))));
+}
+
+BlockWriter::~BlockWriter()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void BlockWriter::Write(const void *data, std::size_t size)
+{
+    const Word *bytes = static_cast<const Word *>(data);
+
+    while (size > 0)
+    {
+        std::size_t chunk = std::min(size, m_BlockSize);
+        std::memcpy(Reserve(chunk), bytes, chunk);
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+Word *BlockWriter::Reserve(std::size_t size)
+{
+    if (size > m_BlockSize)
+    {
+        throw std::runtime_error("Reservation larger than the block size");
+    }
+
+    Flush(m_BlockSize);
+
+    Word *data = m_Block.get() + m_Used;
+    m_Used += size;
+    m_Size += size;
+    return data;
+}
+
+void BlockWriter::Close()
+{
+    if (m_File < 0)
+    {
+        return;
+    }
+
+    Flush(m_BlockSize);
+
+    // The padding of the last block is cut off below
+    std::size_t padded = (m_Used + s_Alignment - 1) / s_Alignment * s_Alignment;
+    std::memset(m_Block.get() + m_Used, 0, padded - m_Used);
+    m_Used = padded;
+    Flush(s_Alignment);
+
+    bool truncated = NES_TRUNCATE(m_File, m_Size) == 0;
+    bool closed = NES_CLOSE(m_File) == 0;
+    m_File = -1;
+
+    if (!truncated || !closed)
+    {
+        throw std::runtime_error("Could not write '" + m_Path + "'");
+    }
+}
+
+void BlockWriter::Patch(std::uint64_t offset, const void *data, std::size_t size)
+{
+    int file = NES_OPEN(m_Path.c_str(), O_WRONLY | O_BINARY, 0644);
+
+    if (file < 0)
+    {
+        throw std::runtime_error("Could not open '" + m_Path + "'");
+    }
+
+    bool sought = NES_SEEK(file, offset, SEEK_SET) >= 0;
+
+    if (sought)
+    {
+        WriteAll(file, static_cast<const Word *>(data), size);
+    }
+
+    NES_CLOSE(file);
+
+    if (!sought)
+    {
+        throw std::runtime_error("Could not write '" + m_Path + "'");
+    }
+}
+
+std::uint64_t BlockWriter::GetSize() const
+{
+    return m_Size;
+}
+
+bool BlockWriter::IsDirect() const
+{
+    return m_Direct;
+}
+
+void BlockWriter::Flush(std::size_t size)
+{
+    // Whole multiples of size only, the rest waits for more data
+    std::size_t flushed = m_Used / size * size;
+
+    if (flushed == 0)
+    {
+        return;
+    }
+
+    WriteAll(m_File, m_Block.get(), flushed);
+    std::memmove(m_Block.get(), m_Block.get() + flushed, m_Used - flushed);
+    m_Used -= flushed;
+}
@@ -0,0 +1,60 @@
+#ifndef BLOCKWRITER_HPP
+#define BLOCKWRITER_HPP
+
+#include "../Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/*
+   Sequential file output in large aligned blocks
+
+   Data is gathered into a block aligned on s_Alignment and only written
+   when the block is full, every write is a multiple of the alignment so
+   that the file can be opened with O_DIRECT to bypass the page cache
+   where supported (the request is ignored elsewhere). The last partial
+   block is padded then the file is truncated to the real size.
+   Throws std::runtime_error on I/O errors
+ */
+class BlockWriter
+{
+public:
+    BlockWriter(const std::string &path, bool direct, std::size_t blockSize = 1 << 20);
+    ~BlockWriter();
+
+    BlockWriter(const BlockWriter &) = delete;
+    BlockWriter &operator=(const BlockWriter &) = delete;
+
+    void Write(const void *data, std::size_t size);
+    // Room for size bytes in the current block, to be filled before the next call
+    Word *Reserve(std::size_t size);
+    // Flush the pending data and close the file
+    void Close();
+    // Overwrite bytes already written, once closed (headers sized at the end)
+    void Patch(std::uint64_t offset, const void *data, std::size_t size);
+
+    std::uint64_t GetSize() const;
+    bool IsDirect() const;
+
+    static constexpr std::size_t s_Alignment = 4096;
+
+private:
+    struct AlignedFree
+    {
+        void operator()(Word *block) const;
+    };
+
+    void Flush(std::size_t size);
+
+    std::string m_Path;
+    std::unique_ptr<Word, AlignedFree> m_Block;
+    std::size_t m_BlockSize;
+    std::size_t m_Used;
+    std::uint64_t m_Size;
+
+    int m_File;
+    bool m_Direct;
+};
+
+#endif
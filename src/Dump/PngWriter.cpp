@@ -0,0 +1,128 @@
+#include "PngWriter.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+// Largest stored deflate block
+constexpr std::size_t StoredBlockSize = 0xFFFF;
+
+const std::array<QWord, 256> &CrcTable()
+{
+    static const std::array<QWord, 256> s_Table = [] {
+        std::array<QWord, 256> table{};
+
+        for (QWord n = 0; n < 256; n++)
+        {
+            QWord c = n;
+
+            for (int bit = 0; bit < 8; bit++)
+            {
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            }
+
+            table[n] = c;
+        }
+
+        return table;
+    }();
+
+    return s_Table;
+}
+
+void Put32(std::vector<Word> &data, QWord value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        data.push_back(static_cast<Word>(value >> shift));
+    }
+}
+
+// Length, type, data and the CRC of the type and data
+void PutChunk(std::vector<Word> &file, const char *type, const std::vector<Word> &data)
+{
+    Put32(file, static_cast<QWord>(data.size()));
+    std::size_t start = file.size();
+    file.insert(file.end(), type, type + 4);
+    file.insert(file.end(), data.begin(), data.end());
+
+    QWord crc = 0xFFFFFFFF;
+
+    for (std::size_t i = start; i < file.size(); i++)
+    {
+        crc = CrcTable()[(crc ^ file[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    Put32(file, crc ^ 0xFFFFFFFF);
+}
+} // namespace
+
+void WritePng(const std::string &path, const QWord *pixels, int width, int height)
+{
+    // Every row starts with its filter type, none
+    std::vector<Word> raw;
+    raw.reserve(static_cast<std::size_t>(height) * (1 + width * 3));
+
+    for (int y = 0; y < height; y++)
+    {
+        raw.push_back(0x00);
+
+        for (int x = 0; x < width; x++)
+        {
+            QWord pixel = pixels[y * width + x];
+            raw.push_back(static_cast<Word>(pixel >> 16));
+            raw.push_back(static_cast<Word>(pixel >> 8));
+            raw.push_back(static_cast<Word>(pixel));
+        }
+    }
+
+    // zlib stream: header, stored blocks, Adler-32 of the raw data
+    std::vector<Word> zlib = {0x78, 0x01};
+
+    for (std::size_t offset = 0; offset < raw.size() || offset == 0; offset += StoredBlockSize)
+    {
+        std::size_t size = std::min(StoredBlockSize, raw.size() - offset);
+        bool last = offset + size == raw.size();
+
+        zlib.push_back(last ? 0x01 : 0x00);
+        zlib.push_back(static_cast<Word>(size));
+        zlib.push_back(static_cast<Word>(size >> 8));
+        zlib.push_back(static_cast<Word>(~size));
+        zlib.push_back(static_cast<Word>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+    }
+
+    QWord a = 1;
+    QWord b = 0;
+
+    for (Word byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    Put32(zlib, (b << 16) | a);
+
+    std::vector<Word> header;
+    Put32(header, static_cast<QWord>(width));
+    Put32(header, static_cast<QWord>(height));
+    // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+
+    std::vector<Word> file = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    PutChunk(file, "IHDR", header);
+    PutChunk(file, "IDAT", zlib);
+    PutChunk(file, "IEND", {});
+
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+
+    if (!stream)
+    {
+        throw std::runtime_error("Could not write '" + path + "'");
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef PNGWRITER_HPP
+#define PNGWRITER_HPP
+
+#include "../Types.hpp"
+#include <string>
+
+/*
+   PNG output of a frame
+
+   The 0xAARRGGBB pixels are written as 8 bits RGB. The image data is
+   kept in stored deflate blocks, no compression library is needed and
+   the files stay readable by any viewer, at the price of their size.
+   Throws std::runtime_error when the file cannot be written
+ */
+void WritePng(const std::string &path, const QWord *pixels, int width, int height);
+
+#endif
@@ -0,0 +1,240 @@
+#include "SessionRecorder.hpp"
+#include "../Audio/WavWriter.hpp"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace
+{
+// NTSC frame rate 60.0988 as a ratio and the 8:7 pixel aspect of the console
+constexpr char Y4mHeader[] = "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7 C420jpeg\n";
+constexpr char Y4mFrame[] = "FRAME\n";
+
+constexpr std::size_t LumaSize = SessionRecorder::s_Width * SessionRecorder::s_Height;
+constexpr std::size_t ChromaSize = LumaSize / 4;
+constexpr std::size_t FrameSize = sizeof(Y4mFrame) - 1 + LumaSize + 2 * ChromaSize;
+
+// Full range BT.601 in 16.16 fixed point, chroma weights are applied to sums of 4 pixels
+Word Luma(int r, int g, int b)
+{
+    return (19595 * r + 38470 * g + 7471 * b + 32768) >> 16;
+}
+
+Word Chroma(int r, int g, int b, int kr, int kg, int kb)
+{
+    // Offset by 128 before the shift so that it never applies to a negative value
+    int value = kr * r + kg * g + kb * b + (128 << 18) + (1 << 17);
+    return std::clamp(value >> 18, 0, 255);
+}
+} // namespace
+
+SessionRecorder::SessionRecorder(const std::string &videoPath, const std::string &audioPath, QWord sampleRate,
+                                 bool direct, std::size_t slots)
+    : m_SampleRate(sampleRate), m_SampleCount(0), m_Slots(std::max<std::size_t>(slots, 1)), m_Read(0), m_Write(0),
+      m_Closing(false), m_Stalls(0)
+{
+    if (!videoPath.empty())
+    {
+        m_Video = std::make_unique<BlockWriter>(videoPath, direct);
+        m_Video->Write(Y4mHeader, sizeof(Y4mHeader) - 1);
+    }
+
+    if (!audioPath.empty())
+    {
+        m_Audio = std::make_unique<BlockWriter>(audioPath, direct);
+        // Placeholder sizes until Close
+        std::array<Word, WavWriter::s_HeaderSize> header = WavWriter::MakeHeader(m_SampleRate, 0);
+        m_Audio->Write(header.data(), header.size());
+    }
+
+    for (Slot &slot : m_Slots)
+    {
+        slot.pixels.resize(LumaSize);
+    }
+
+    m_Thread = std::thread(&SessionRecorder::Run, this);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::exception &)
+    {
+    }
+}
+
+void SessionRecorder::PushFrame(const QWord *pixels, const std::int16_t *samples, std::size_t count)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    RethrowError();
+
+    if (m_Write - m_Read == m_Slots.size())
+    {
+        m_Stalls++;
+        m_Written.wait(lock, [this]() { return m_Write - m_Read < m_Slots.size(); });
+        RethrowError();
+    }
+
+    Slot &slot = m_Slots[m_Write % m_Slots.size()];
+    lock.unlock();
+
+    // The writer is busy with other slots, the copy happens outside of the lock
+    std::copy(pixels, pixels + LumaSize, slot.pixels.begin());
+    slot.samples.assign(samples, samples + count);
+
+    lock.lock();
+    m_Write++;
+    m_Pushed.notify_one();
+}
+
+void SessionRecorder::Close()
+{
+    if (!m_Thread.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Closing = true;
+    }
+
+    m_Pushed.notify_one();
+    m_Thread.join();
+
+    if (m_Video)
+    {
+        m_Video->Close();
+    }
+
+    if (m_Audio)
+    {
+        m_Audio->Close();
+        std::array<Word, WavWriter::s_HeaderSize> header = WavWriter::MakeHeader(m_SampleRate, m_SampleCount);
+        m_Audio->Patch(0, header.data(), header.size());
+    }
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    RethrowError();
+}
+
+std::uint64_t SessionRecorder::GetFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Write;
+}
+
+std::uint64_t SessionRecorder::GetStalls() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Stalls;
+}
+
+void SessionRecorder::Run()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_Pushed.wait(lock, [this]() { return m_Read != m_Write || m_Closing; });
+
+        if (m_Read == m_Write)
+        {
+            break;
+        }
+
+        const Slot &slot = m_Slots[m_Read % m_Slots.size()];
+        bool failed = !m_Error.empty();
+        lock.unlock();
+
+        std::string error;
+
+        // After a failure the slots are only released so that the emulation never blocks forever
+        if (!failed)
+        {
+            try
+            {
+                WriteFrame(slot);
+            }
+            catch (const std::exception &exception)
+            {
+                error = exception.what();
+            }
+        }
+
+        lock.lock();
+
+        if (!error.empty())
+        {
+            m_Error = error;
+        }
+
+        m_Read++;
+        m_Written.notify_one();
+    }
+}
+
+void SessionRecorder::WriteFrame(const Slot &slot)
+{
+    if (m_Video)
+    {
+        Word *frame = m_Video->Reserve(FrameSize);
+        frame = std::copy_n(Y4mFrame, sizeof(Y4mFrame) - 1, frame);
+
+        Word *luma = frame;
+        Word *cb = luma + LumaSize;
+        Word *cr = cb + ChromaSize;
+
+        for (int y = 0; y < s_Height; y += 2)
+        {
+            const QWord *top = &slot.pixels[y * s_Width];
+            const QWord *bottom = top + s_Width;
+
+            for (int x = 0; x < s_Width; x += 2)
+            {
+                int r = 0, g = 0, b = 0;
+
+                for (const QWord *row : {top, bottom})
+                {
+                    for (int dx = 0; dx < 2; dx++)
+                    {
+                        QWord pixel = row[x + dx];
+                        int pr = (pixel >> 16) & 0xFF, pg = (pixel >> 8) & 0xFF, pb = pixel & 0xFF;
+                        luma[(row == top ? y : y + 1) * s_Width + x + dx] = Luma(pr, pg, pb);
+                        r += pr;
+                        g += pg;
+                        b += pb;
+                    }
+                }
+
+                *cb++ = Chroma(r, g, b, -11059, -21709, 32768);
+                *cr++ = Chroma(r, g, b, 32768, -27439, -5329);
+            }
+        }
+    }
+
+    if (m_Audio && !slot.samples.empty())
+    {
+        // Little endian whatever the host
+        Word *data = m_Audio->Reserve(slot.samples.size() * sizeof(std::int16_t));
+
+        for (std::int16_t sample : slot.samples)
+        {
+            *data++ = static_cast<Word>(sample);
+            *data++ = static_cast<Word>(static_cast<DWord>(sample) >> 8);
+        }
+
+        m_SampleCount += slot.samples.size();
+    }
+}
+
+void SessionRecorder::RethrowError()
+{
+    if (!m_Error.empty())
+    {
+        throw std::runtime_error("Recording failed: " + m_Error);
+    }
+}
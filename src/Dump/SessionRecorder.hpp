@@ -0,0 +1,79 @@
+#ifndef SESSIONRECORDER_HPP
+#define SESSIONRECORDER_HPP
+
+#include "BlockWriter.hpp"
+#include "../Types.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+   Full session recording to Y4M video and WAV audio
+
+   The emulation thread only copies each frame and its samples into a
+   preallocated slot. A background thread converts the frames to YUV
+   4:2:0 (full range BT.601) and writes both streams through BlockWriter.
+   When the writer falls behind by more than the slot count the emulation
+   waits for it, nothing is ever dropped.
+   Throws std::runtime_error, errors of the writer thread are reported by
+   the next push or by Close
+ */
+class SessionRecorder
+{
+public:
+    // Either path may be empty to skip the stream
+    SessionRecorder(const std::string &videoPath, const std::string &audioPath, QWord sampleRate, bool direct = false,
+                    std::size_t slots = 64);
+    ~SessionRecorder();
+
+    SessionRecorder(const SessionRecorder &) = delete;
+    SessionRecorder &operator=(const SessionRecorder &) = delete;
+
+    // s_Width * s_Height pixels in 0xAARRGGBB and the samples produced with the frame
+    void PushFrame(const QWord *pixels, const std::int16_t *samples, std::size_t count);
+    // Write what is queued and close the files
+    void Close();
+
+    std::uint64_t GetFrameCount() const;
+    // Pushes which had to wait for the writer
+    std::uint64_t GetStalls() const;
+
+    static constexpr int s_Width = 256;
+    static constexpr int s_Height = 240;
+
+private:
+    struct Slot
+    {
+        std::vector<QWord> pixels;
+        std::vector<std::int16_t> samples;
+    };
+
+    void Run();
+    void WriteFrame(const Slot &slot);
+    void RethrowError();
+
+    std::unique_ptr<BlockWriter> m_Video;
+    std::unique_ptr<BlockWriter> m_Audio;
+    QWord m_SampleRate;
+    std::uint64_t m_SampleCount;
+
+    // Ring of slots: [m_Read, m_Write) are waiting for the writer
+    std::vector<Slot> m_Slots;
+    std::uint64_t m_Read;
+    std::uint64_t m_Write;
+    bool m_Closing;
+    std::string m_Error;
+    std::uint64_t m_Stalls;
+
+    mutable std::mutex m_Mutex;
+    std::condition_variable m_Pushed;
+    std::condition_variable m_Written;
+    std::thread m_Thread;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "EmulationThread.hpp"
+#include "Audio/AudioStream.hpp"
+#include "Dump/SessionRecorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+EmulationThread::EmulationThread(Nes &nes)
+    : m_Nes(nes), m_Throttle(false), m_FrameLimit(0), m_AudioStream(nullptr), m_Recorder(nullptr), m_RunAheadFrames(0),
+      m_FrameSkip(0), m_Stop(false), m_Running(false), m_FrameCount(0),
+      m_Frames(Frame{std::vector<QWord>(Nes::s_Width * Nes::s_Height, 0xFF000000)})
+{
+    for (std::atomic<Word> &input : m_Inputs)
+    {
+        input.store(0x00);
+    }
+}
+
+EmulationThread::~EmulationThread()
+{
+    Stop();
+}
+
+void EmulationThread::SetThrottle(bool throttle)
+{
+    m_Throttle = throttle;
+}
+
+void EmulationThread::SetFrameLimit(std::uint64_t frames)
+{
+    m_FrameLimit = frames;
+}
+
+void EmulationThread::SetAudioStream(AudioStream *stream)
+{
+    m_AudioStream = stream;
+}
+
+void EmulationThread::SetRunAhead(int frames)
+{
+    m_RunAheadFrames = frames;
+}
+
+void EmulationThread::SetFrameSkip(int skip)
+{
+    m_FrameSkip = std::max(skip, 0);
+}
+
+void EmulationThread::SetRecorder(SessionRecorder *recorder)
+{
+    m_Recorder = recorder;
+}
+
+void EmulationThread::Start()
+{
+    Stop();
+
+    m_Stop.store(false);
+    m_Running.store(true);
+    m_Error.clear();
+    m_Thread = std::thread(&EmulationThread::Run, this);
+}
+
+void EmulationThread::Stop()
+{
+    m_Stop.store(true);
+
+    if (m_Thread.joinable())
+    {
+        m_Thread.join();
+    }
+}
+
+bool EmulationThread::IsRunning() const
+{
+    return m_Running.load(std::memory_order_acquire);
+}
+
+const std::string &EmulationThread::GetError() const
+{
+    return m_Error;
+}
+
+void EmulationThread::SetInput(std::size_t port, Word buttons)
+{
+    m_Inputs[port & 0x01].store(buttons, std::memory_order_relaxed);
+}
+
+std::uint64_t EmulationThread::GetFrameCount() const
+{
+    return m_FrameCount.load(std::memory_order_relaxed);
+}
+
+bool EmulationThread::AcquireFrame()
+{
+    return m_Frames.Acquire();
+}
+
+const RunAhead::Stats &EmulationThread::GetRunAheadStats() const
+{
+    return m_RunAheadStats;
+}
+
+const EmulationThread::Frame &EmulationThread::GetFrame() const
+{
+    return m_Frames.GetFront();
+}
+
+void EmulationThread::Run()
+{
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration framePeriod =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / s_FrameRate));
+
+    std::vector<std::int16_t> samples(4096);
+    std::uint64_t frame = m_FrameCount.load();
+    Clock::time_point deadline = Clock::now();
+
+    try
+    {
+        RunAhead runAhead(m_Nes, m_RunAheadFrames);
+        Nes &presented = runAhead.GetPresented();
+        presented.SetFrameBuffer(m_Frames.GetBack().pixels.data());
+
+        while (!m_Stop.load(std::memory_order_relaxed) && (m_FrameLimit == 0 || frame < m_FrameLimit))
+        {
+            runAhead.SetInput(0, m_Inputs[0].load(std::memory_order_relaxed));
+            runAhead.SetInput(1, m_Inputs[1].load(std::memory_order_relaxed));
+
+            bool render = m_Recorder || (frame + 1) % (m_FrameSkip + 1) == 0 || frame + 1 == m_FrameLimit;
+            runAhead.SetRenderFrame(render);
+            runAhead.StepFrame();
+
+            std::size_t count = 0;
+
+            if (m_AudioStream || m_Recorder)
+            {
+                count = m_Nes.ReadAudio(samples.data(), samples.size());
+            }
+
+            if (m_AudioStream)
+            {
+                m_AudioStream->Push(samples.data(), count);
+            }
+
+            if (m_Recorder)
+            {
+                m_Recorder->PushFrame(m_Frames.GetBack().pixels.data(), samples.data(), count);
+            }
+
+            frame++;
+
+            // A skipped frame would hand over the stale content of the back buffer
+            if (render)
+            {
+                m_Frames.GetBack().number = frame;
+                m_Frames.Publish();
+                presented.SetFrameBuffer(m_Frames.GetBack().pixels.data());
+            }
+
+            m_FrameCount.store(frame, std::memory_order_relaxed);
+
+            if (m_Throttle)
+            {
+                deadline += framePeriod;
+
+                // Do not try to catch up after a long stall, restart the pacing instead
+                if (Clock::now() > deadline + 4 * framePeriod)
+                {
+                    deadline = Clock::now();
+                }
+
+                std::this_thread::sleep_until(deadline);
+            }
+        }
+
+        m_RunAheadStats = runAhead.GetStats();
+    }
+    catch (const std::exception &error)
+    {
+        m_Error = error.what();
+    }
+
+    m_Nes.SetFrameBuffer(nullptr);
+    m_Running.store(false, std::memory_order_release);
+}
@@ -0,0 +1,102 @@
+#ifndef EMULATIONTHREAD_HPP
+#define EMULATIONTHREAD_HPP
+
+#include "Nes.hpp"
+#include "RunAhead.hpp"
+#include "TripleBuffer.hpp"
+#include "Types.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AudioStream;
+class SessionRecorder;
+
+/*
+   Runs a Nes on its own thread
+
+   The ppu draws straight into the back buffer of a triple buffer which is
+   published at each vblank, the presentation side acquires the newest
+   completed frame whenever it is ready. Nothing is copied and a slow
+   consumer only misses frames, it never holds the emulation back.
+
+   The Nes must not be touched by other threads while running, the inputs
+   go through SetInput and the sound through the optional AudioStream.
+   An optional SessionRecorder receives every frame with its samples
+ */
+class EmulationThread
+{
+public:
+    struct Frame
+    {
+        std::vector<QWord> pixels;
+        // 1 for the first frame emulated by the thread
+        std::uint64_t number = 0;
+    };
+
+    EmulationThread(Nes &nes);
+    ~EmulationThread();
+
+    EmulationThread(const EmulationThread &) = delete;
+    EmulationThread &operator=(const EmulationThread &) = delete;
+
+    // Setup, before Start
+    // Pace the emulation to the NTSC frame rate instead of running as fast as possible
+    void SetThrottle(bool throttle);
+    // Stop by itself after the given amount of frames, 0 for no limit
+    void SetFrameLimit(std::uint64_t frames);
+    // Receives the APU samples of every frame
+    void SetAudioStream(AudioStream *stream);
+    // Present frames emulated that many frames ahead, 0 disables, see RunAhead
+    void SetRunAhead(int frames);
+    // Draw and publish one frame out of skip + 1, the last frame before the limit always is
+    void SetFrameSkip(int skip);
+    // Receives every frame and its APU samples, the frame skip is ignored while recording
+    void SetRecorder(SessionRecorder *recorder);
+
+    void Start();
+    // Wait for the thread to exit, the Nes renders into its internal buffer again
+    void Stop();
+    bool IsRunning() const;
+    // Reason of the exception that stopped the emulation, empty if none
+    const std::string &GetError() const;
+
+    // Any thread
+    void SetInput(std::size_t port, Word buttons);
+    std::uint64_t GetFrameCount() const;
+    // Cost of the run-ahead, valid once stopped
+    const RunAhead::Stats &GetRunAheadStats() const;
+
+    // Presentation thread, returns false when no new frame has been completed
+    bool AcquireFrame();
+    const Frame &GetFrame() const;
+
+    static constexpr double s_FrameRate = 60.0988;
+
+private:
+    void Run();
+
+    Nes &m_Nes;
+    std::thread m_Thread;
+
+    bool m_Throttle;
+    std::uint64_t m_FrameLimit;
+    AudioStream *m_AudioStream;
+    SessionRecorder *m_Recorder;
+    int m_RunAheadFrames;
+    int m_FrameSkip;
+    RunAhead::Stats m_RunAheadStats;
+
+    std::atomic<bool> m_Stop;
+    std::atomic<bool> m_Running;
+    std::atomic<std::uint64_t> m_FrameCount;
+    std::array<std::atomic<Word>, 2> m_Inputs;
+    std::string m_Error;
+
+    TripleBuffer<Frame> m_Frames;
+};
+
+#endif
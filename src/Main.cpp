@@ -1,7 +1,356 @@
+/*
+   Headless front end
+
+   NesEMU <rom> [--frames N] [--screenshot file.ppm] [--profile] [--throttle]
+                [--dump-frames directory] [--wav file.wav | --pcm file.raw] [--rate Hz]
+                [--run-ahead N] [--frame-skip N] [--cheat code]...
+                [--sav file.sav [--sav-private]] [--record basename [--record-direct]]
+                [--code-cache directory] [--perf] [--coverage file.cdl]
+
+   The emulation runs on its own thread, the main thread presents the
+   frames. --throttle paces the emulation to the console frame rate,
+   --dump-frames writes every frame the presentation gets to see, frames
+   completed while it is busy writing are skipped. --wav and --pcm record
+   the sound resampled to --rate (48000 by default). --run-ahead presents
+   frames emulated N frames ahead and reports what it costs. --frame-skip
+   only draws one frame out of N + 1, the emulation itself is unchanged.
+   --cheat applies a Game Genie code or a raw AAAA:VV / AAAA?CC:VV patch.
+   --sav keeps the cartridge RAM in a save file, --sav-private only reads it.
+   --record writes every frame to basename.y4m and the unresampled sound to
+   basename.wav from a background thread, --record-direct bypasses the page
+   cache where O_DIRECT is supported. --code-cache pre-decodes the code of
+   the rom, the analysis is kept in the directory for the next runs.
+   --perf reports the host cycles, instructions, branch and cache misses
+   per frame and per subsystem from the Linux performance counters.
+   --coverage adds the PRG bytes the run executes and reads to the CDL
+   file, created when missing, and reports the shares per bank. The code
+   found in an existing file extends the --code-cache analysis
+ */
+
+#include "Cartridge.hpp"
+#include "EmulationThread.hpp"
+#include "Nes.hpp"
+#include "PerfCounters.hpp"
+#include "Audio/AudioStream.hpp"
+#include "Audio/WavWriter.hpp"
+#include "Cpu/CodeCache.hpp"
+#include "Cpu/CoverageMap.hpp"
+#include "Cpu/CpuProfiler.hpp"
+#include "Dump/SessionRecorder.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+void WritePpm(const std::string &path, const QWord *pixels)
+{
+    std::ofstream file(path, std::ios::binary);
 
-int main()
+    if (!file)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    file << "P6\n" << Nes::s_Width << " " << Nes::s_Height << "\n255\n";
+
+    for (int i = 0; i < Nes::s_Width * Nes::s_Height; i++)
+    {
+        char rgb[3] = {(char)(pixels[i] >> 16), (char)(pixels[i] >> 8), (char)pixels[i]};
+        file.write(rgb, sizeof(rgb));
+    }
+}
+} // namespace
+
+int main(int argc, char **argv)
 {
-    std::cout << "Hello world" << std::endl;
+    if (argc < 2)
+    {
+        std::cerr << "usage: NesEMU <rom> [--frames N] [--screenshot file.ppm] [--profile] [--throttle] [--dump-frames "
+                     "directory] [--wav file.wav | --pcm file.raw] [--rate Hz] [--run-ahead N] [--frame-skip N] "
+                     "[--cheat code]... [--sav file.sav [--sav-private]] [--record basename [--record-direct]] "
+                     "[--code-cache directory] [--perf] [--coverage file.cdl]"
+                  << std::endl;
+        return 2;
+    }
+
+    std::string rom = argv[1];
+    std::string screenshot;
+    std::string audio;
+    std::string dumpDirectory;
+    std::vector<std::string> cheats;
+    std::string save;
+    bool savePrivate = false;
+    std::string record;
+    bool recordDirect = false;
+    std::string codeCache;
+    std::string coverageFile;
+    WavWriter::Format audioFormat = WavWriter::Format::Wav;
+    long frames = 60;
+    long rate = 48000;
+    int runAhead = 0;
+    int frameSkip = 0;
+    bool profile = false;
+    bool perf = false;
+    bool throttle = false;
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+
+        if (option == "--frames" && i + 1 < argc)
+        {
+            frames = std::strtol(argv[++i], nullptr, 10);
+        }
+        else if (option == "--screenshot" && i + 1 < argc)
+        {
+            screenshot = argv[++i];
+        }
+        else if (option == "--profile")
+        {
+            profile = true;
+        }
+        else if (option == "--perf")
+        {
+            perf = true;
+        }
+        else if (option == "--throttle")
+        {
+            throttle = true;
+        }
+        else if (option == "--dump-frames" && i + 1 < argc)
+        {
+            dumpDirectory = argv[++i];
+        }
+        else if ((option == "--wav" || option == "--pcm") && i + 1 < argc)
+        {
+            audio = argv[++i];
+            audioFormat = option == "--wav" ? WavWriter::Format::Wav : WavWriter::Format::Raw;
+        }
+        else if (option == "--rate" && i + 1 < argc)
+        {
+            rate = std::strtol(argv[++i], nullptr, 10);
+        }
+        else if (option == "--run-ahead" && i + 1 < argc)
+        {
+            runAhead = std::atoi(argv[++i]);
+        }
+        else if (option == "--frame-skip" && i + 1 < argc)
+        {
+            frameSkip = std::atoi(argv[++i]);
+        }
+        else if (option == "--cheat" && i + 1 < argc)
+        {
+            cheats.push_back(argv[++i]);
+        }
+        else if (option == "--sav" && i + 1 < argc)
+        {
+            save = argv[++i];
+        }
+        else if (option == "--sav-private")
+        {
+            savePrivate = true;
+        }
+        else if (option == "--record" && i + 1 < argc)
+        {
+            record = argv[++i];
+        }
+        else if (option == "--record-direct")
+        {
+            recordDirect = true;
+        }
+        else if (option == "--code-cache" && i + 1 < argc)
+        {
+            codeCache = argv[++i];
+        }
+        else if (option == "--coverage" && i + 1 < argc)
+        {
+            coverageFile = argv[++i];
+        }
+    }
+
+    try
+    {
+        Nes nes;
+        // Without recording nothing plays the sound
+        nes.SetAudioEnabled(!audio.empty() || !record.empty());
+        nes.LoadRom(rom);
+
+        if (!save.empty())
+        {
+            nes.OpenSaveFile(save, !savePrivate);
+        }
+
+        for (const std::string &cheat : cheats)
+        {
+            nes.AddCheat(cheat);
+        }
+
+        CoverageMap coverage(*nes.GetCartridge());
+        bool previousCoverage = !coverageFile.empty() && std::filesystem::exists(coverageFile);
+
+        if (previousCoverage)
+        {
+            coverage.LoadCdl(coverageFile);
+        }
+
+        if (!codeCache.empty())
+        {
+            bool loaded = nes.LoadCodeCache(codeCache, previousCoverage ? &coverage : nullptr);
+            const CodeCache *cache = nes.GetCodeCache();
+            std::cout << "code cache " << (loaded ? "loaded" : "built") << ": " << cache->GetBlockCount()
+                      << " blocks, " << cache->GetInstructionCount() << " instructions" << std::endl;
+        }
+
+        std::unique_ptr<AudioStream> stream;
+        std::unique_ptr<WavWriter> writer;
+        std::vector<std::int16_t> samples;
+
+        if (!audio.empty())
+        {
+            // A few seconds of room, the emulation may run well ahead of the writes
+            stream = std::make_unique<AudioStream>(nes.GetAudioSampleRate(), rate, 1 << 18);
+            // The file takes everything, there is no device clock to follow
+            stream->SetRateControl(false);
+            writer = std::make_unique<WavWriter>(audio, rate, audioFormat);
+        }
+
+        std::unique_ptr<SessionRecorder> recorder;
+
+        if (!record.empty())
+        {
+            recorder = std::make_unique<SessionRecorder>(record + ".y4m", record + ".wav",
+                                                         static_cast<QWord>(std::lround(nes.GetAudioSampleRate())),
+                                                         recordDirect);
+        }
+
+        CpuProfiler profiler;
+
+        if (profile)
+        {
+            nes.SetProfiler(&profiler);
+        }
+
+        if (!coverageFile.empty())
+        {
+            nes.SetCoverageMap(&coverage);
+        }
+
+        // Opened by the emulation thread on its first frame
+        PerfCounters counters;
+
+        if (perf)
+        {
+            nes.SetPerfCounters(&counters);
+        }
+
+        EmulationThread emulation(nes);
+        emulation.SetFrameLimit(frames);
+        emulation.SetThrottle(throttle);
+        emulation.SetAudioStream(stream.get());
+        emulation.SetRunAhead(runAhead);
+        emulation.SetFrameSkip(frameSkip);
+        emulation.SetRecorder(recorder.get());
+        emulation.Start();
+
+        // Presentation side: whatever frame is the newest when we get to it
+        std::uint64_t written = 0;
+        bool running = true;
+
+        while (running)
+        {
+            running = emulation.IsRunning();
+
+            if (emulation.AcquireFrame() && !dumpDirectory.empty())
+            {
+                const EmulationThread::Frame &frame = emulation.GetFrame();
+                char name[32];
+                std::snprintf(name, sizeof(name), "/frame_%06llu.ppm", static_cast<unsigned long long>(frame.number));
+                WritePpm(dumpDirectory + name, frame.pixels.data());
+                written++;
+            }
+
+            if (writer)
+            {
+                samples.resize(stream->GetFill());
+                writer->Write(samples.data(), stream->Pull(samples.data(), samples.size()));
+            }
+
+            if (running)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        emulation.Stop();
+
+        if (!emulation.GetError().empty())
+        {
+            throw std::runtime_error(emulation.GetError());
+        }
+
+        if (writer)
+        {
+            writer->Close();
+        }
+
+        if (recorder)
+        {
+            recorder->Close();
+            std::cout << recorder->GetFrameCount() << " frames recorded, " << recorder->GetStalls()
+                      << " waits for the writer" << std::endl;
+        }
+
+        if (!dumpDirectory.empty())
+        {
+            std::cout << written << " of " << emulation.GetFrameCount() << " frames written" << std::endl;
+        }
+
+        if (!screenshot.empty())
+        {
+            WritePpm(screenshot, emulation.GetFrame().pixels.data());
+        }
+
+        if (runAhead > 0)
+        {
+            const RunAhead::Stats &stats = emulation.GetRunAheadStats();
+            double main = stats.mainSeconds * 1e6 / stats.frames;
+            double extra = stats.extraSeconds * 1e6 / stats.frames;
+
+            std::printf("run-ahead %d: %.1f us/frame emulated, %.1f us/frame extra (%.0f%%)\n", runAhead, main, extra,
+                        extra * 100.0 / main);
+        }
+
+        if (profile)
+        {
+            profiler.Report(std::cout, nes.GetCpu());
+        }
+
+        if (perf)
+        {
+            counters.Report(std::cout);
+        }
+
+        if (!coverageFile.empty())
+        {
+            coverage.SaveCdl(coverageFile);
+            coverage.Report(std::cout);
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
     return 0;
 }
@@ -0,0 +1,11 @@
+#include "CnRom.hpp"
+
+CnRom::CnRom(Cartridge &cartridge)
+    : Mapper(cartridge)
+{
+}
+
+void CnRom::Write(DWord, Word value)
+{
+    SetChrBank(0, 8, value & 0x03);
+}
@@ -0,0 +1,15 @@
+#ifndef CNROM_HPP
+#define CNROM_HPP
+
+#include "Mapper.hpp"
+
+// Mapper 3: fixed PRG ROM and switchable 8 KiB CHR bank
+class CnRom : public Mapper
+{
+public:
+    CnRom(Cartridge &cartridge);
+
+    void Write(DWord address, Word value) override;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "Mapper.hpp"
+#include "CnRom.hpp"
+#include "Mmc1.hpp"
+#include "Nrom.hpp"
+#include "UxRom.hpp"
+#include "../State.hpp"
+#include <stdexcept>
+#include <string>
+
+Mapper::Mapper(Cartridge &cartridge)
+    : m_Cartridge(cartridge), m_Chr(cartridge.GetChr()), m_Mirroring(cartridge.GetMirroring())
+{
+    m_PrgOffsets.fill(0);
+    m_ChrOffsets.fill(0);
+}
+
+std::unique_ptr<Mapper> Mapper::Create(Cartridge &cartridge)
+{
+    std::unique_ptr<Mapper> mapper;
+
+    switch (cartridge.GetMapperId())
+    {
+    case 0:
+        mapper = std::make_unique<Nrom>(cartridge);
+        break;
+    case 1:
+        mapper = std::make_unique<Mmc1>(cartridge);
+        break;
+    case 2:
+        mapper = std::make_unique<UxRom>(cartridge);
+        break;
+    case 3:
+        mapper = std::make_unique<CnRom>(cartridge);
+        break;
+    default:
+        throw std::runtime_error("Unsupported mapper " + std::to_string(cartridge.GetMapperId()));
+    }
+
+    mapper->Reset();
+    return mapper;
+}
+
+void Mapper::Reset()
+{
+    // Last 32 KiB of PRG and first 8 KiB of CHR, NROM-256 and NROM-128 mirror included
+    SetPrgBank(0, 2, -2);
+    SetPrgBank(2, 2, -1);
+    SetChrBank(0, 8, 0);
+}
+
+void Mapper::Write(DWord, Word)
+{
+}
+
+void Mapper::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_PrgOffsets);
+    writer.Write(m_ChrOffsets);
+    writer.Write(m_Mirroring);
+}
+
+void Mapper::LoadState(StateReader &reader)
+{
+    reader.Read(m_PrgOffsets);
+    reader.Read(m_ChrOffsets);
+    reader.Read(m_Mirroring);
+
+    // The windows are mapped straight onto the memories, they must lie within them
+    for (std::size_t offset : m_PrgOffsets)
+    {
+        if (offset % s_PrgWindowSize != 0 || offset + s_PrgWindowSize > m_Cartridge.GetPrg().size())
+        {
+            throw std::runtime_error("Corrupt save state");
+        }
+    }
+
+    for (std::size_t offset : m_ChrOffsets)
+    {
+        if (offset % s_ChrWindowSize != 0 || offset + s_ChrWindowSize > m_Chr.size())
+        {
+            throw std::runtime_error("Corrupt save state");
+        }
+    }
+
+    if (m_Mirroring > Mirroring::FourScreen)
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+}
+
+Mirroring Mapper::GetMirroring() const
+{
+    return m_Mirroring;
+}
+
+Cartridge &Mapper::GetCartridge()
+{
+    return m_Cartridge;
+}
+
+void Mapper::SetPrgBank(std::size_t first, std::size_t windows, int bank)
+{
+    std::size_t bankSize = windows * s_PrgWindowSize;
+    std::size_t banks = m_Cartridge.GetPrg().size() / bankSize;
+
+    // Smaller images are mirrored across the bank
+    if (banks == 0)
+    {
+        banks = 1;
+    }
+
+    // Negative banks count from the end of the PRG ROM
+    std::size_t index = bank < 0 ? banks - (std::size_t)(-bank) % banks : (std::size_t)bank;
+    std::size_t base = (index % banks) * bankSize;
+
+    for (std::size_t window = 0; window < windows; window++)
+    {
+        m_PrgOffsets[first + window] = (base + window * s_PrgWindowSize) % m_Cartridge.GetPrg().size();
+    }
+}
+
+void Mapper::SetChrBank(std::size_t first, std::size_t windows, int bank)
+{
+    std::size_t bankSize = windows * s_ChrWindowSize;
+    std::size_t banks = m_Chr.size() / bankSize;
+
+    if (banks == 0)
+    {
+        banks = 1;
+    }
+
+    std::size_t base = ((std::size_t)bank % banks) * bankSize;
+
+    for (std::size_t window = 0; window < windows; window++)
+    {
+        m_ChrOffsets[first + window] = (base + window * s_ChrWindowSize) % m_Chr.size();
+    }
+}
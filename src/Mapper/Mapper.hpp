@@ -0,0 +1,69 @@
+#ifndef MAPPER_HPP
+#define MAPPER_HPP
+
+#include "../Cartridge.hpp"
+#include "../Types.hpp"
+#include <array>
+#include <memory>
+
+class StateWriter;
+class StateReader;
+
+/*
+   Cartridge board logic
+
+   Mappers translate the CPU $8000-$FFFF and PPU $0000-$1FFF windows into
+   offsets within the PRG and CHR memories. The PRG windows are 8 KiB wide
+   and the CHR windows 1 KiB wide so that every board can be expressed with
+   the same bank tables, the board registers live in the subclasses
+ */
+class Mapper
+{
+public:
+    Mapper(Cartridge &cartridge);
+    virtual ~Mapper() = default;
+
+    // Build the mapper matching the cartridge header, throws for unsupported boards
+    static std::unique_ptr<Mapper> Create(Cartridge &cartridge);
+
+    virtual void Reset();
+    // CPU writes to $8000-$FFFF
+    virtual void Write(DWord address, Word value);
+
+    virtual void SaveState(StateWriter &writer) const;
+    virtual void LoadState(StateReader &reader);
+
+    // Offset within the PRG ROM of the window starting at $8000 + window * $2000
+    std::size_t GetPrgOffset(std::size_t window) const
+    {
+        return m_PrgOffsets[window];
+    }
+
+    // Offset within the CHR memory of the window starting at window * $0400
+    std::size_t GetChrOffset(std::size_t window) const
+    {
+        return m_ChrOffsets[window];
+    }
+
+    Mirroring GetMirroring() const;
+    Cartridge &GetCartridge();
+
+    static constexpr std::size_t s_PrgWindowSize = 0x2000;
+    static constexpr std::size_t s_PrgWindowCount = 4;
+    static constexpr std::size_t s_ChrWindowSize = 0x0400;
+    static constexpr std::size_t s_ChrWindowCount = 8;
+
+protected:
+    // Map a bank of size windows * window size onto the windows starting at the first one
+    void SetPrgBank(std::size_t first, std::size_t windows, int bank);
+    void SetChrBank(std::size_t first, std::size_t windows, int bank);
+
+    Cartridge &m_Cartridge;
+    std::vector<Word> &m_Chr;
+
+    std::array<std::size_t, s_PrgWindowCount> m_PrgOffsets;
+    std::array<std::size_t, s_ChrWindowCount> m_ChrOffsets;
+    Mirroring m_Mirroring;
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include "Mmc1.hpp"
+#include "../State.hpp"
+
+Mmc1::Mmc1(Cartridge &cartridge)
+    : Mapper(cartridge), m_Shift(0), m_ShiftCount(0), m_Control(0x0C), m_ChrBank0(0), m_ChrBank1(0), m_PrgBank(0)
+{
+}
+
+void Mmc1::Reset()
+{
+    m_Shift = 0;
+    m_ShiftCount = 0;
+    m_Control = 0x0C;
+    m_ChrBank0 = m_ChrBank1 = m_PrgBank = 0;
+
+    UpdateBanks();
+}
+
+void Mmc1::Write(DWord address, Word value)
+{
+    // Writing a value with the bit 7 set resets the shift register
+    if (value & 0x80)
+    {
+        m_Shift = 0;
+        m_ShiftCount = 0;
+        m_Control |= 0x0C;
+        UpdateBanks();
+        return;
+    }
+
+    m_Shift |= (value & 0x01) << m_ShiftCount;
+
+    if (++m_ShiftCount < 5)
+    {
+        return;
+    }
+
+    switch ((address >> 13) & 0x03)
+    {
+    case 0:
+        m_Control = m_Shift;
+        break;
+    case 1:
+        m_ChrBank0 = m_Shift;
+        break;
+    case 2:
+        m_ChrBank1 = m_Shift;
+        break;
+    case 3:
+        m_PrgBank = m_Shift;
+        break;
+    }
+
+    m_Shift = 0;
+    m_ShiftCount = 0;
+    UpdateBanks();
+}
+
+void Mmc1::UpdateBanks()
+{
+    static constexpr Mirroring s_Mirroring[] = {Mirroring::SingleLower, Mirroring::SingleUpper, Mirroring::Vertical,
+                                                Mirroring::Horizontal};
+    m_Mirroring = s_Mirroring[m_Control & 0x03];
+
+    // 512 KiB boards (SUROM) select the PRG half through the CHR bank bit 4
+    int outerBank = m_Cartridge.GetPrg().size() > 0x40000 ? (m_ChrBank0 & 0x10) : 0;
+    int prgBank = outerBank | (m_PrgBank & 0x0F);
+
+    switch ((m_Control >> 2) & 0x03)
+    {
+    case 0:
+    case 1:
+        SetPrgBank(0, 4, prgBank >> 1);
+        break;
+    case 2:
+        SetPrgBank(0, 2, outerBank);
+        SetPrgBank(2, 2, prgBank);
+        break;
+    case 3:
+        SetPrgBank(0, 2, prgBank);
+        SetPrgBank(2, 2, outerBank | 0x0F);
+        break;
+    }
+
+    if (m_Control & 0x10)
+    {
+        SetChrBank(0, 4, m_ChrBank0);
+        SetChrBank(4, 4, m_ChrBank1);
+    }
+    else
+    {
+        SetChrBank(0, 8, m_ChrBank0 >> 1);
+    }
+}
+
+void Mmc1::SaveState(StateWriter &writer) const
+{
+    Mapper::SaveState(writer);
+    writer.Write(m_Shift);
+    writer.Write(m_ShiftCount);
+    writer.Write(m_Control);
+    writer.Write(m_ChrBank0);
+    writer.Write(m_ChrBank1);
+    writer.Write(m_PrgBank);
+}
+
+void Mmc1::LoadState(StateReader &reader)
+{
+    Mapper::LoadState(reader);
+    reader.Read(m_Shift);
+    reader.Read(m_ShiftCount);
+    reader.Read(m_Control);
+    reader.Read(m_ChrBank0);
+    reader.Read(m_ChrBank1);
+    reader.Read(m_PrgBank);
+}
@@ -0,0 +1,35 @@
+#ifndef MMC1_HPP
+#define MMC1_HPP
+
+#include "Mapper.hpp"
+
+/*
+   Mapper 1: Nintendo MMC1
+
+   Registers are loaded serially, one bit per write, through a 5 bits
+   shift register. The fifth write selects the register from its address
+ */
+class Mmc1 : public Mapper
+{
+public:
+    Mmc1(Cartridge &cartridge);
+
+    void Reset() override;
+    void Write(DWord address, Word value) override;
+
+    void SaveState(StateWriter &writer) const override;
+    void LoadState(StateReader &reader) override;
+
+private:
+    void UpdateBanks();
+
+    Word m_Shift;
+    Word m_ShiftCount;
+
+    Word m_Control;
+    Word m_ChrBank0;
+    Word m_ChrBank1;
+    Word m_PrgBank;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#include "Nrom.hpp"
+
+Nrom::Nrom(Cartridge &cartridge)
+    : Mapper(cartridge)
+{
+}
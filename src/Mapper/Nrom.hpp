@@ -0,0 +1,13 @@
+#ifndef NROM_HPP
+#define NROM_HPP
+
+#include "Mapper.hpp"
+
+// Mapper 0: fixed 16/32 KiB PRG ROM and 8 KiB CHR
+class Nrom : public Mapper
+{
+public:
+    Nrom(Cartridge &cartridge);
+};
+
+#endif
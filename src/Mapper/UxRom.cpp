@@ -0,0 +1,11 @@
+#include "UxRom.hpp"
+
+UxRom::UxRom(Cartridge &cartridge)
+    : Mapper(cartridge)
+{
+}
+
+void UxRom::Write(DWord, Word value)
+{
+    SetPrgBank(0, 2, value);
+}
@@ -0,0 +1,15 @@
+#ifndef UXROM_HPP
+#define UXROM_HPP
+
+#include "Mapper.hpp"
+
+// Mapper 2: switchable 16 KiB PRG bank at $8000, last bank fixed at $C000
+class UxRom : public Mapper
+{
+public:
+    UxRom(Cartridge &cartridge);
+
+    void Write(DWord address, Word value) override;
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include "MemoryMap.hpp"
+
+MemoryMap::MemoryMap(MemoryHandler &handler)
+    : m_Handler(&handler), m_Watcher(nullptr)
+{
+    m_ReadPages.fill(nullptr);
+    m_WritePages.fill(nullptr);
+    m_MappedReadPages.fill(nullptr);
+    m_MappedWritePages.fill(nullptr);
+    m_ReadWatched.fill(false);
+    m_WriteWatched.fill(false);
+}
+
+void MemoryMap::MapRead(std::size_t first, std::size_t count, const Word *data)
+{
+    for (std::size_t page = first; page < first + count; page++)
+    {
+        m_MappedReadPages[page] = data ? data + (page - first) * s_PageSize : nullptr;
+        UpdatePage(page);
+    }
+}
+
+void MemoryMap::MapWrite(std::size_t first, std::size_t count, Word *data)
+{
+    for (std::size_t page = first; page < first + count; page++)
+    {
+        m_MappedWritePages[page] = data ? data + (page - first) * s_PageSize : nullptr;
+        UpdatePage(page);
+    }
+}
+
+const Word *MemoryMap::GetReadPage(std::size_t page) const
+{
+    return m_ReadPages[page];
+}
+
+Word *MemoryMap::GetWritePage(std::size_t page) const
+{
+    return m_WritePages[page];
+}
+
+const Word *MemoryMap::GetMappedReadPage(std::size_t page) const
+{
+    return m_MappedReadPages[page];
+}
+
+Word *MemoryMap::GetMappedWritePage(std::size_t page) const
+{
+    return m_MappedWritePages[page];
+}
+
+void MemoryMap::SetWatcher(MemoryWatcher *watcher)
+{
+    m_Watcher = watcher;
+
+    for (std::size_t page = 0; page < s_PageCount; page++)
+    {
+        UpdatePage(page);
+    }
+}
+
+void MemoryMap::Watch(std::size_t page, bool read, bool write)
+{
+    m_ReadWatched[page] = read;
+    m_WriteWatched[page] = write;
+    UpdatePage(page);
+}
+
+void MemoryMap::ClearWatches()
+{
+    m_ReadWatched.fill(false);
+    m_WriteWatched.fill(false);
+
+    for (std::size_t page = 0; page < s_PageCount; page++)
+    {
+        UpdatePage(page);
+    }
+}
+
+Word MemoryMap::ReadIndirect(DWord address)
+{
+    std::size_t page = address >> 8;
+    const Word *data = m_MappedReadPages[page];
+    Word value = data ? data[address & 0xFF] : m_Handler->Read(address);
+
+    if (m_ReadWatched[page] && m_Watcher)
+    {
+        m_Watcher->OnRead(address, value);
+    }
+
+    return value;
+}
+
+void MemoryMap::WriteIndirect(DWord address, Word value)
+{
+    std::size_t page = address >> 8;
+    Word *data = m_MappedWritePages[page];
+
+    if (data)
+    {
+        data[address & 0xFF] = value;
+    }
+    else
+    {
+        m_Handler->Write(address, value);
+    }
+
+    if (m_WriteWatched[page] && m_Watcher)
+    {
+        m_Watcher->OnWrite(address, value);
+    }
+}
+
+void MemoryMap::UpdatePage(std::size_t page)
+{
+    bool watched = m_Watcher != nullptr;
+    m_ReadPages[page] = watched && m_ReadWatched[page] ? nullptr : m_MappedReadPages[page];
+    m_WritePages[page] = watched && m_WriteWatched[page] ? nullptr : m_MappedWritePages[page];
+}
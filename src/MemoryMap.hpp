@@ -0,0 +1,104 @@
+#ifndef MEMORY_MAP_HPP
+#define MEMORY_MAP_HPP
+
+#include "Types.hpp"
+#include <array>
+#include <cstddef>
+
+/*
+   Receives the accesses to the pages which are not directly mapped onto
+   memory, such as the memory mapped registers
+ */
+class MemoryHandler
+{
+public:
+    virtual ~MemoryHandler() = default;
+
+    virtual Word Read(DWord address) = 0;
+    virtual void Write(DWord address, Word value) = 0;
+};
+
+// Notified of the accesses to the watched pages, see MemoryMap::Watch
+class MemoryWatcher
+{
+public:
+    virtual ~MemoryWatcher() = default;
+
+    virtual void OnRead(DWord address, Word value) = 0;
+    virtual void OnWrite(DWord address, Word value) = 0;
+};
+
+/*
+   CPU address space
+
+   The 64 KiB address space is split into 256 pages of 256 bytes, each page
+   either points directly to its backing memory or falls back onto the
+   handler. Reads and writes have their own page table so that ROM pages can
+   be read directly while their writes reach the mapper registers
+
+   Watched pages are taken out of the tables so that their accesses fall
+   onto the slow path which reports them to the watcher, the other pages
+   keep their direct accesses and nothing is checked when nothing is watched
+ */
+class MemoryMap
+{
+public:
+    MemoryMap(MemoryHandler &handler);
+
+    Word Read(DWord address)
+    {
+        const Word *page = m_ReadPages[address >> 8];
+        return page ? page[address & 0xFF] : ReadIndirect(address);
+    }
+
+    void Write(DWord address, Word value)
+    {
+        Word *page = m_WritePages[address >> 8];
+
+        if (page)
+        {
+            page[address & 0xFF] = value;
+        }
+        else
+        {
+            WriteIndirect(address, value);
+        }
+    }
+
+    // Map count pages starting at the first page, a nullptr data routes them to the handler
+    void MapRead(std::size_t first, std::size_t count, const Word *data);
+    void MapWrite(std::size_t first, std::size_t count, Word *data);
+
+    // Memory accessed directly through the page, null when the accesses go through the handler or the watcher
+    const Word *GetReadPage(std::size_t page) const;
+    Word *GetWritePage(std::size_t page) const;
+    // Memory mapped onto the page, watched or not
+    const Word *GetMappedReadPage(std::size_t page) const;
+    Word *GetMappedWritePage(std::size_t page) const;
+
+    // Report the reads and/or the writes of the page to the watcher, a null watcher detaches it
+    void SetWatcher(MemoryWatcher *watcher);
+    void Watch(std::size_t page, bool read, bool write);
+    void ClearWatches();
+
+    static constexpr std::size_t s_PageSize = 0x100;
+    static constexpr std::size_t s_PageCount = 0x100;
+
+private:
+    Word ReadIndirect(DWord address);
+    void WriteIndirect(DWord address, Word value);
+    void UpdatePage(std::size_t page);
+
+    // Direct accesses, the mapped memory unless the page is watched
+    std::array<const Word *, s_PageCount> m_ReadPages;
+    std::array<Word *, s_PageCount> m_WritePages;
+    std::array<const Word *, s_PageCount> m_MappedReadPages;
+    std::array<Word *, s_PageCount> m_MappedWritePages;
+    std::array<bool, s_PageCount> m_ReadWatched;
+    std::array<bool, s_PageCount> m_WriteWatched;
+
+    MemoryHandler *m_Handler;
+    MemoryWatcher *m_Watcher;
+};
+
+#endif
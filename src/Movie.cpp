@@ -0,0 +1,102 @@
+#include "Movie.hpp"
+#include "Nes.hpp"
+#include "State.hpp"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace
+{
+constexpr char Magic[8] = "NESMOVI";
+constexpr QWord Version = 1;
+} // namespace
+
+Movie::Movie(std::uint64_t romHash)
+    : m_RomHash(romHash)
+{
+}
+
+void Movie::Record(Word port0, Word port1)
+{
+    m_Inputs.push_back({port0, port1});
+}
+
+Word Movie::GetInput(std::size_t frame, std::size_t port) const
+{
+    return frame < m_Inputs.size() ? m_Inputs[frame][port & 0x01] : 0x00;
+}
+
+void Movie::Apply(Nes &nes, std::size_t frame) const
+{
+    nes.SetInput(0, GetInput(frame, 0));
+    nes.SetInput(1, GetInput(frame, 1));
+}
+
+std::size_t Movie::GetFrameCount() const
+{
+    return m_Inputs.size();
+}
+
+std::uint64_t Movie::GetRomHash() const
+{
+    return m_RomHash;
+}
+
+Movie Movie::Load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open the movie '" + path + "'");
+    }
+
+    std::vector<Word> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    StateReader reader(data.data(), data.size());
+
+    char magic[sizeof(Magic)];
+    QWord version;
+    std::uint64_t hash;
+    QWord frames;
+    reader.ReadBytes(magic, sizeof(magic));
+    reader.Read(version);
+
+    if (std::memcmp(magic, Magic, sizeof(Magic)) != 0 || version != Version)
+    {
+        throw std::runtime_error("'" + path + "' is not a movie of this version");
+    }
+
+    reader.Read(hash);
+    reader.Read(frames);
+
+    if (data.size() - reader.GetOffset() != frames * 2ull)
+    {
+        throw std::runtime_error("Truncated movie '" + path + "'");
+    }
+
+    Movie movie(hash);
+    movie.m_Inputs.resize(frames);
+    reader.ReadBytes(movie.m_Inputs.data(), frames * 2ull);
+    return movie;
+}
+
+void Movie::Save(const std::string &path) const
+{
+    std::vector<Word> data(sizeof(Magic) + sizeof(QWord) + sizeof(std::uint64_t) + sizeof(QWord) +
+                           m_Inputs.size() * 2);
+    StateWriter writer(data.data(), data.size());
+    writer.WriteBytes(Magic, sizeof(Magic));
+    writer.Write(Version);
+    writer.Write(m_RomHash);
+    writer.Write(static_cast<QWord>(m_Inputs.size()));
+    writer.WriteBytes(m_Inputs.data(), m_Inputs.size() * 2);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not write the movie '" + path + "'");
+    }
+}
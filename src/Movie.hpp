@@ -0,0 +1,49 @@
+#ifndef MOVIE_HPP
+#define MOVIE_HPP
+
+#include "Types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Nes;
+
+/*
+   Input movie
+
+   The buttons of both controller ports for every frame since the power
+   on, applied before the frame is stepped. The emulation being
+   deterministic a movie replays the same run whatever the configuration,
+   which the benchmarks and the regression runs rely on.
+
+   Saved as "NESMOVI", a format version, the hash of the rom it was
+   recorded on (see CodeCache::Hash, 0 when not bound to a rom), the frame
+   count and two bytes per frame
+ */
+class Movie
+{
+public:
+    Movie(std::uint64_t romHash = 0);
+
+    // Append the next frame
+    void Record(Word port0, Word port1);
+    // Buttons of the port for the frame, released past the end of the movie
+    Word GetInput(std::size_t frame, std::size_t port) const;
+    // Set both ports for the frame about to be stepped
+    void Apply(Nes &nes, std::size_t frame) const;
+
+    std::size_t GetFrameCount() const;
+    std::uint64_t GetRomHash() const;
+
+    // Throws std::runtime_error when the file is missing or damaged
+    static Movie Load(const std::string &path);
+    void Save(const std::string &path) const;
+
+private:
+    std::uint64_t m_RomHash;
+    std::vector<std::array<Word, 2>> m_Inputs;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include "Nes.hpp"
+#include "Bus.hpp"
+#include "State.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+// Save state header: magic followed by the layout version
+constexpr char StateMagic[4] = {'N', 'E', 'S', 'S'};
+constexpr QWord StateVersion = 3;
+} // namespace
+
+Nes::Nes()
+    : m_Bus(std::make_unique<Bus>()), m_StateSize(0)
+{
+    m_StateSize = MeasureState();
+    m_LoadBackup.assign(m_StateSize, 0x00);
+}
+
+Nes::~Nes() = default;
+
+void Nes::LoadRom(const std::string &path)
+{
+    m_Bus->LoadCartridge(std::make_unique<Cartridge>(path));
+    m_StateSize = MeasureState();
+    m_LoadBackup.assign(m_StateSize, 0x00);
+}
+
+void Nes::LoadRom(const Word *data, std::size_t size)
+{
+    m_Bus->LoadCartridge(std::make_unique<Cartridge>(data, size));
+    m_StateSize = MeasureState();
+    m_LoadBackup.assign(m_StateSize, 0x00);
+}
+
+void Nes::Reset()
+{
+    m_Bus->Reset();
+}
+
+void Nes::OpenSaveFile(const std::string &path, bool shared)
+{
+    if (!m_Bus->GetCartridge())
+    {
+        throw std::runtime_error("No rom loaded");
+    }
+
+    m_Bus->OpenSaveFile(path, shared);
+}
+
+bool Nes::LoadCodeCache(const std::string &directory, const CoverageMap *coverage)
+{
+    if (!m_Bus->GetCartridge())
+    {
+        throw std::runtime_error("No rom loaded");
+    }
+
+    return m_Bus->LoadCodeCache(directory, coverage);
+}
+
+void Nes::StepFrame()
+{
+    if (!m_Bus->GetCartridge())
+    {
+        throw std::runtime_error("No rom loaded");
+    }
+
+    m_Bus->StepFrame();
+}
+
+const QWord *Nes::GetFrameBuffer() const
+{
+    return m_Bus->GetPpu().GetFrameBuffer();
+}
+
+QWord *Nes::SetFrameBuffer(QWord *pixels)
+{
+    return m_Bus->GetPpu().SetFrameBuffer(pixels);
+}
+
+void Nes::SetRenderFrame(bool render)
+{
+    m_Bus->GetPpu().SetRenderFrame(render);
+}
+
+void Nes::SetInput(std::size_t port, Word buttons)
+{
+    if (port > 1)
+    {
+        throw std::runtime_error("Invalid controller port");
+    }
+
+    m_Bus->SetButtons(port, buttons);
+}
+
+void Nes::AddCheat(const std::string &code)
+{
+    m_Bus->AddCheat(CheatEngine::Parse(code));
+}
+
+void Nes::AddCheat(const CheatEngine::Cheat &cheat)
+{
+    m_Bus->AddCheat(cheat);
+}
+
+void Nes::ClearCheats()
+{
+    m_Bus->ClearCheats();
+}
+
+const std::vector<CheatEngine::Cheat> &Nes::GetCheats() const
+{
+    return m_Bus->GetCheats();
+}
+
+void Nes::SetAudioEnabled(bool enabled)
+{
+    m_Bus->GetApu().SetAudioEnabled(enabled);
+}
+
+bool Nes::IsAudioEnabled() const
+{
+    return m_Bus->GetApu().IsAudioEnabled();
+}
+
+void Nes::SetAudioDiscarded(bool discarded)
+{
+    m_Bus->GetApu().SetOutputDiscarded(discarded);
+}
+
+double Nes::GetAudioSampleRate() const
+{
+    return m_Bus->GetApu().GetSampleRate();
+}
+
+std::size_t Nes::ReadAudio(std::int16_t *samples, std::size_t count)
+{
+    return m_Bus->GetApu().ReadSamples(samples, count);
+}
+
+std::size_t Nes::GetStateSize() const
+{
+    return m_StateSize;
+}
+
+std::size_t Nes::MeasureState() const
+{
+    StateWriter writer;
+    writer.Write(StateMagic);
+    writer.Write(StateVersion);
+    m_Bus->SaveState(writer);
+
+    return writer.GetSize();
+}
+
+std::size_t Nes::SaveState(Word *buffer, std::size_t size) const
+{
+    // Checked up front rather than by the writer so that nothing is written
+    if (size < m_StateSize)
+    {
+        throw std::runtime_error("Save state buffer too small");
+    }
+
+    StateWriter writer(buffer, size);
+    writer.Write(StateMagic);
+    writer.Write(StateVersion);
+    m_Bus->SaveState(writer);
+
+    return writer.GetSize();
+}
+
+std::vector<Word> Nes::SaveState() const
+{
+    std::vector<Word> state(GetStateSize());
+    SaveState(state.data(), state.size());
+    return state;
+}
+
+void Nes::ReadStateHeader(StateReader &reader, std::size_t size) const
+{
+    char magic[4];
+    QWord version;
+    reader.Read(magic);
+    reader.Read(version);
+
+    if (std::memcmp(magic, StateMagic, sizeof(magic)) != 0 || version != StateVersion || size < m_StateSize)
+    {
+        throw std::runtime_error("Incompatible save state");
+    }
+}
+
+void Nes::LoadState(const Word *buffer, std::size_t size)
+{
+    StateReader reader(buffer, size);
+    ReadStateHeader(reader, size);
+
+    /*
+       The sizes match, a corrupt content is only found by the components
+       reading it. The current state is kept so that a failure leaves the
+       console as it was instead of half loaded
+     */
+    SaveState(m_LoadBackup.data(), m_LoadBackup.size());
+
+    try
+    {
+        m_Bus->LoadState(reader);
+    }
+    catch (const std::exception &)
+    {
+        StateReader backup(m_LoadBackup.data(), m_LoadBackup.size());
+        ReadStateHeader(backup, m_LoadBackup.size());
+        m_Bus->LoadState(backup);
+        throw;
+    }
+}
+
+void Nes::LoadSnapshot(const Word *buffer, std::size_t size)
+{
+    StateReader reader(buffer, size);
+    ReadStateHeader(reader, size);
+    m_Bus->LoadState(reader);
+}
+
+void Nes::LoadState(const std::vector<Word> &state)
+{
+    LoadState(state.data(), state.size());
+}
+
+const Cartridge *Nes::GetCartridge() const
+{
+    return m_Bus->GetCartridge();
+}
+
+Word Nes::Peek(DWord address) const
+{
+    return m_Bus->Peek(address);
+}
+
+void Nes::SetProfiler(CpuProfiler *profiler)
+{
+    m_Bus->GetCpu().SetProfiler(profiler);
+}
+
+void Nes::SetCoverageMap(CoverageMap *coverage)
+{
+    m_Bus->SetCoverageMap(coverage);
+}
+
+void Nes::SetPerfCounters(PerfCounters *counters)
+{
+    m_Bus->SetPerfCounters(counters);
+}
+
+const Cpu &Nes::GetCpu() const
+{
+    return m_Bus->GetCpu();
+}
+
+const MemoryMap &Nes::GetMemory() const
+{
+    return m_Bus->GetMemory();
+}
+
+const CodeCache *Nes::GetCodeCache() const
+{
+    return m_Bus->GetCodeCache();
+}
+
+Bus &Nes::GetBus()
+{
+    return *m_Bus;
+}
@@ -0,0 +1,154 @@
+#ifndef NES_HPP
+#define NES_HPP
+
+#include "Cheats.hpp"
+#include "Types.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Bus;
+class Cartridge;
+class CodeCache;
+class CoverageMap;
+class Cpu;
+class CpuProfiler;
+class Debugger;
+class MemoryMap;
+class PerfCounters;
+class StateReader;
+
+/*
+   Emulator core API
+
+   Stable entry point of the nesemu_core library, the components stay
+   behind the Bus so that their layout can change without breaking the
+   code linking the library. Errors are reported with std::runtime_error
+ */
+class Nes
+{
+public:
+    Nes();
+    ~Nes();
+
+    Nes(const Nes &) = delete;
+    Nes &operator=(const Nes &) = delete;
+
+    // Load an iNES image and power the console on
+    void LoadRom(const std::string &path);
+    void LoadRom(const Word *data, std::size_t size);
+
+    void Reset();
+
+    /*
+       Keep the $6000-$7FFF work RAM in a save file, created when missing.
+       A shared file is memory mapped and receives the writes of the game
+       as they happen, a private one is only loaded into this instance.
+       Usually done right after loading a battery backed rom
+     */
+    void OpenSaveFile(const std::string &path, bool shared = true);
+    /*
+       Pre-decode the code reachable in the PRG ROM so that the cpu skips
+       its opcode and operand fetches, the rest is still interpreted. The
+       analysis is kept in the directory, created when missing, under the
+       hash of the rom. Returns whether it was found there, a coverage map
+       of previous runs adds the code they executed to the analysis
+     */
+    bool LoadCodeCache(const std::string &directory, const CoverageMap *coverage = nullptr);
+    // Emulate until the next vblank, the frame buffer then holds the completed frame
+    void StepFrame();
+
+    static constexpr int s_Width = 256;
+    static constexpr int s_Height = 240;
+
+    // s_Width * s_Height pixels in 0xAARRGGBB
+    const QWord *GetFrameBuffer() const;
+    // Render the next frames into a caller owned buffer, null restores the internal one
+    QWord *SetFrameBuffer(QWord *pixels);
+    /*
+       Draw the frames stepped from now on, enabled by default. Skipping
+       them leaves the frame buffer untouched but emulates exactly the
+       same, fast-forwards and replays only render the frames they show
+     */
+    void SetRenderFrame(bool render);
+
+    // Controller buttons of the port (0 or 1), see Controller::Button
+    void SetInput(std::size_t port, Word buttons);
+
+    /*
+       Patch the ROM with a Game Genie code (6 or 8 letters) or a raw
+       AAAA:VV / AAAA?CC:VV patch, throws on malformed codes. Cheats apply
+       at no cost per access and stay active across resets
+     */
+    void AddCheat(const std::string &code);
+    void AddCheat(const CheatEngine::Cheat &cheat);
+    void ClearCheats();
+    const std::vector<CheatEngine::Cheat> &GetCheats() const;
+
+    // Headless runs without audio skip the sound synthesis, enabled by default
+    void SetAudioEnabled(bool enabled);
+    bool IsAudioEnabled() const;
+    /*
+       Re-emulate frames whose sound has already been played. Nothing is
+       synthesized meanwhile, across LoadSnapshot too, and the unread
+       samples and the output levels are kept so that the playback goes on
+       without a click. Set and cleared between two frames
+     */
+    void SetAudioDiscarded(bool discarded);
+    double GetAudioSampleRate() const;
+    // Signed 16 bits mono samples produced by the previous frames, returns the amount read
+    std::size_t ReadAudio(std::int16_t *samples, std::size_t count);
+
+    // Size of a save state for the loaded rom, measured once when it is loaded
+    std::size_t GetStateSize() const;
+    // Serialize into a caller provided buffer, returns the written size
+    std::size_t SaveState(Word *buffer, std::size_t size) const;
+    std::vector<Word> SaveState() const;
+    // Throws for a state of another rom or build, a state which fails to load leaves the console untouched
+    void LoadState(const Word *buffer, std::size_t size);
+    void LoadState(const std::vector<Word> &state);
+    /*
+       Load a snapshot saved by an instance of this process running the
+       same rom, such as the ones RunAhead and RollbackSession keep every
+       frame. The content is trusted: no copy of the current state is
+       taken, a corrupt snapshot leaves the console half loaded
+     */
+    void LoadSnapshot(const Word *buffer, std::size_t size);
+
+    // Loaded rom, nullptr before the first LoadRom
+    const Cartridge *GetCartridge() const;
+    // CPU view of the memory, reads have no side effect
+    Word Peek(DWord address) const;
+
+    /*
+       Instrumentation for the in-tree tooling, see CpuProfiler,
+       CoverageMap and PerfCounters. Passing nullptr detaches them, they
+       must outlive their use
+     */
+    void SetProfiler(CpuProfiler *profiler);
+    void SetCoverageMap(CoverageMap *coverage);
+    void SetPerfCounters(PerfCounters *counters);
+    // Read-only views of the components, for the reports and the tests
+    const Cpu &GetCpu() const;
+    const MemoryMap &GetMemory() const;
+    // nullptr until LoadCodeCache
+    const CodeCache *GetCodeCache() const;
+
+private:
+    // The debugger hooks the memory map and clocks the bus itself
+    friend class Debugger;
+    Bus &GetBus();
+
+    // Serialize into a measuring writer, the size only depends on the cartridge
+    std::size_t MeasureState() const;
+    // Checks the header, positioning the reader on the components
+    void ReadStateHeader(StateReader &reader, std::size_t size) const;
+
+    std::unique_ptr<Bus> m_Bus;
+    std::size_t m_StateSize;
+    // State restored when loading another one fails, allocated with the rom
+    std::vector<Word> m_LoadBackup;
+};
+
+#endif
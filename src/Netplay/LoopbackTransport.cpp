@@ -0,0 +1,86 @@
+#include "LoopbackTransport.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+LoopbackLink::Endpoint::Endpoint(LoopbackLink &link, std::size_t side) : m_Link(link), m_Side(side)
+{
+}
+
+void LoopbackLink::Endpoint::Send(const Word *data, std::size_t size)
+{
+    m_Link.Send(m_Side, data, size);
+}
+
+bool LoopbackLink::Endpoint::Receive(std::vector<Word> &packet)
+{
+    return m_Link.Receive(m_Side, packet);
+}
+
+LoopbackLink::LoopbackLink(QWord delay, QWord jitter, double loss, std::uint32_t seed)
+    : m_Endpoints{Endpoint(*this, 0), Endpoint(*this, 1)}, m_Delay(delay), m_Jitter(jitter), m_Loss(loss),
+      m_Random(seed), m_Time(0), m_Sent(0), m_Dropped(0)
+{
+}
+
+Transport &LoopbackLink::GetEndpoint(std::size_t side)
+{
+    if (side > 1)
+    {
+        throw std::runtime_error("Invalid loopback side");
+    }
+
+    return m_Endpoints[side];
+}
+
+void LoopbackLink::Advance(QWord ticks)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Time += ticks;
+}
+
+std::uint64_t LoopbackLink::GetSentCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Sent;
+}
+
+std::uint64_t LoopbackLink::GetDroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Dropped;
+}
+
+void LoopbackLink::Send(std::size_t side, const Word *data, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_Sent++;
+
+    if (m_Loss > 0.0 && std::uniform_real_distribution<double>(0.0, 1.0)(m_Random) < m_Loss)
+    {
+        m_Dropped++;
+        return;
+    }
+
+    QWord jitter = m_Jitter ? m_Random() % (m_Jitter + 1) : 0;
+    // Towards the other side
+    m_InFlight[side ^ 1].push_back({m_Time + m_Delay + jitter, m_Sent, std::vector<Word>(data, data + size)});
+}
+
+bool LoopbackLink::Receive(std::size_t side, std::vector<Word> &packet)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    std::vector<Packet> &inFlight = m_InFlight[side];
+
+    auto earliest = std::min_element(inFlight.begin(), inFlight.end(), [](const Packet &a, const Packet &b) {
+        return a.due != b.due ? a.due < b.due : a.sequence < b.sequence;
+    });
+
+    if (earliest == inFlight.end() || earliest->due > m_Time)
+    {
+        return false;
+    }
+
+    packet = std::move(earliest->data);
+    inFlight.erase(earliest);
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef LOOPBACKTRANSPORT_HPP
+#define LOOPBACKTRANSPORT_HPP
+
+#include "Transport.hpp"
+#include "../Types.hpp"
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+
+/*
+   In-memory link between two transports, for tests and local sessions
+
+   The link has its own clock advanced by the caller so that the delays
+   are counted in frames (or any other tick) and runs are reproducible.
+   Each packet is delayed by the base delay plus a random jitter, which
+   reorders them, and dropped with the given probability. Both endpoints
+   may be used from different threads
+ */
+class LoopbackLink
+{
+public:
+    LoopbackLink(QWord delay = 0, QWord jitter = 0, double loss = 0.0, std::uint32_t seed = 1);
+
+    LoopbackLink(const LoopbackLink &) = delete;
+    LoopbackLink &operator=(const LoopbackLink &) = delete;
+
+    // Transport of the peer on the given side (0 or 1)
+    Transport &GetEndpoint(std::size_t side);
+    // Packets become receivable once their delay has elapsed
+    void Advance(QWord ticks = 1);
+
+    std::uint64_t GetSentCount() const;
+    std::uint64_t GetDroppedCount() const;
+
+private:
+    class Endpoint : public Transport
+    {
+    public:
+        Endpoint(LoopbackLink &link, std::size_t side);
+
+        void Send(const Word *data, std::size_t size) override;
+        bool Receive(std::vector<Word> &packet) override;
+
+    private:
+        LoopbackLink &m_Link;
+        std::size_t m_Side;
+    };
+
+    struct Packet
+    {
+        std::uint64_t due;
+        std::uint64_t sequence;
+        std::vector<Word> data;
+    };
+
+    void Send(std::size_t side, const Word *data, std::size_t size);
+    bool Receive(std::size_t side, std::vector<Word> &packet);
+
+    std::array<Endpoint, 2> m_Endpoints;
+    // Packets in flight towards each side
+    std::array<std::vector<Packet>, 2> m_InFlight;
+
+    QWord m_Delay;
+    QWord m_Jitter;
+    double m_Loss;
+    std::mt19937 m_Random;
+
+    std::uint64_t m_Time;
+    std::uint64_t m_Sent;
+    std::uint64_t m_Dropped;
+    mutable std::mutex m_Mutex;
+};
+
+#endif
@@ -0,0 +1,216 @@
+#include "RollbackSession.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+// Acknowledged remote frames, first local frame, input count, then the inputs
+constexpr std::size_t PacketHeaderSize = 9;
+constexpr std::size_t MaxPacketInputs = 255;
+
+void Put32(std::vector<Word> &packet, std::uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        packet.push_back(static_cast<Word>(value >> shift));
+    }
+}
+
+std::uint32_t Get32(const Word *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+} // namespace
+
+RollbackSession::RollbackSession(Nes &nes, Transport &transport, std::size_t localPort, int maxRollback)
+    : m_Nes(nes), m_Transport(transport), m_LocalPort(localPort & 0x01),
+      m_MaxRollback(std::clamp(maxRollback, 1, s_MaxRollbackLimit)), m_Frame(0), m_RemoteCount(0), m_RemoteAck(0),
+      m_Mispredicted(0), m_LocalInputs(s_InputHistory, 0x00), m_RemoteInputs(s_InputHistory, 0x00),
+      m_Predicted(s_InputHistory, 0x00)
+{
+    if (!nes.GetCartridge())
+    {
+        throw std::runtime_error("No rom loaded");
+    }
+
+    // Preallocated, keeping a state is a few memcpy per frame
+    m_States.resize(m_MaxRollback + 1, std::vector<Word>(nes.GetStateSize()));
+    m_Packet.reserve(PacketHeaderSize + MaxPacketInputs);
+}
+
+bool RollbackSession::AdvanceFrame(Word input)
+{
+    Receive();
+
+    if (m_Frame >= m_RemoteCount + m_MaxRollback)
+    {
+        Rollback(true);
+        Send();
+        m_Stats.stalls++;
+        return false;
+    }
+
+    // The corrected frames are not drawn, the new one is
+    Rollback(false);
+
+    m_LocalInputs[m_Frame % s_InputHistory] = input;
+    Simulate(m_Frame, true);
+    m_Frame++;
+    m_Mispredicted = m_Frame;
+    m_Stats.frames++;
+
+    Send();
+    return true;
+}
+
+void RollbackSession::Poll()
+{
+    Receive();
+    Rollback(true);
+    Send();
+}
+
+std::uint32_t RollbackSession::GetFrame() const
+{
+    return m_Frame;
+}
+
+std::uint32_t RollbackSession::GetConfirmedFrame() const
+{
+    return std::min(m_Frame, m_RemoteCount);
+}
+
+const RollbackSession::Stats &RollbackSession::GetStats() const
+{
+    return m_Stats;
+}
+
+void RollbackSession::Receive()
+{
+    std::vector<Word> packet;
+
+    while (m_Transport.Receive(packet))
+    {
+        if (packet.size() < PacketHeaderSize)
+        {
+            continue;
+        }
+
+        std::uint32_t ack = Get32(&packet[0]);
+        std::uint32_t first = Get32(&packet[4]);
+        std::size_t count = std::min<std::size_t>(packet[8], packet.size() - PacketHeaderSize);
+
+        // Packets may arrive out of order, only the newest acknowledgement counts
+        m_RemoteAck = std::max(m_RemoteAck, std::min(ack, m_Frame));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            std::uint32_t frame = first + static_cast<std::uint32_t>(i);
+
+            // Already known, or a gap which a later packet will fill
+            if (frame < m_RemoteCount)
+            {
+                continue;
+            }
+
+            // Far ahead inputs would overwrite the ones a rollback still needs
+            if (frame > m_RemoteCount || frame >= m_Frame + s_InputHistory / 2)
+            {
+                break;
+            }
+
+            Word input = packet[PacketHeaderSize + i];
+            m_RemoteInputs[frame % s_InputHistory] = input;
+
+            if (frame < m_Frame && m_Predicted[frame % s_InputHistory] != input)
+            {
+                m_Mispredicted = std::min(m_Mispredicted, frame);
+            }
+
+            m_RemoteCount++;
+        }
+    }
+}
+
+void RollbackSession::Send()
+{
+    std::size_t count = std::min<std::size_t>(m_Frame - m_RemoteAck, MaxPacketInputs);
+
+    m_Packet.clear();
+    Put32(m_Packet, m_RemoteCount);
+    Put32(m_Packet, m_RemoteAck);
+    m_Packet.push_back(static_cast<Word>(count));
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        m_Packet.push_back(m_LocalInputs[(m_RemoteAck + i) % s_InputHistory]);
+    }
+
+    m_Transport.Send(m_Packet.data(), m_Packet.size());
+}
+
+void RollbackSession::Rollback(bool drawLast)
+{
+    if (m_Mispredicted >= m_Frame)
+    {
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+
+    /*
+       The sound of these frames has already been played, they are
+       re-emulated without synthesis and the playback resumes from the
+       samples still buffered. The channels keep running silently so the
+       peers hold identical states whether they produce audio or not
+     */
+    m_Nes.SetAudioDiscarded(true);
+
+    const std::vector<Word> &state = m_States[m_Mispredicted % m_States.size()];
+    m_Nes.LoadSnapshot(state.data(), state.size());
+
+    for (std::uint32_t frame = m_Mispredicted; frame < m_Frame; frame++)
+    {
+        Simulate(frame, drawLast && frame + 1 == m_Frame);
+    }
+
+    m_Nes.SetAudioDiscarded(false);
+
+    int frames = static_cast<int>(m_Frame - m_Mispredicted);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    m_Stats.rollbacks++;
+    m_Stats.resimulatedFrames += frames;
+    m_Stats.resimulationSeconds += seconds;
+    m_Stats.longestRollback = std::max(m_Stats.longestRollback, frames);
+    m_Stats.longestRollbackSeconds = std::max(m_Stats.longestRollbackSeconds, seconds);
+
+    m_Mispredicted = m_Frame;
+}
+
+void RollbackSession::Simulate(std::uint32_t frame, bool draw)
+{
+    std::vector<Word> &state = m_States[frame % m_States.size()];
+    m_Nes.SaveState(state.data(), state.size());
+
+    // Repeat the last known remote input until the actual one arrives
+    Word remote = 0x00;
+
+    if (frame < m_RemoteCount)
+    {
+        remote = m_RemoteInputs[frame % s_InputHistory];
+    }
+    else if (m_RemoteCount > 0)
+    {
+        remote = m_RemoteInputs[(m_RemoteCount - 1) % s_InputHistory];
+    }
+
+    m_Predicted[frame % s_InputHistory] = remote;
+
+    m_Nes.SetInput(m_LocalPort, m_LocalInputs[frame % s_InputHistory]);
+    m_Nes.SetInput(m_LocalPort ^ 1, remote);
+    m_Nes.SetRenderFrame(draw);
+    m_Nes.StepFrame();
+}
@@ -0,0 +1,100 @@
+#ifndef ROLLBACKSESSION_HPP
+#define ROLLBACKSESSION_HPP
+
+#include "Transport.hpp"
+#include "../Nes.hpp"
+#include "../Types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+   Two players rollback netplay
+
+   Each peer emulates the whole console and only the inputs travel. The
+   local input of a frame is applied at once, the remote one is predicted
+   to be the last one received so the game never waits for the network.
+   The state at the beginning of each unconfirmed frame is kept in a ring,
+   when a remote input turns out to differ from its prediction the state of
+   that frame is restored and the frames up to the present are emulated
+   again in one burst, their sound is dropped and only the newest frame
+   is drawn.
+
+   The remote inputs may lag behind by at most maxRollback frames, past
+   that the session stalls until they arrive. Every packet repeats the
+   local inputs that the peer has not acknowledged yet so lost packets
+   cost no round trip. Both peers must load the same rom and start from
+   the same state
+ */
+class RollbackSession
+{
+public:
+    struct Stats
+    {
+        std::uint64_t frames = 0;
+        // Calls which could not advance, waiting for the remote inputs
+        std::uint64_t stalls = 0;
+        std::uint64_t rollbacks = 0;
+        std::uint64_t resimulatedFrames = 0;
+        int longestRollback = 0;
+        double resimulationSeconds = 0.0;
+        double longestRollbackSeconds = 0.0;
+    };
+
+    // The rom must already be loaded, the local player uses the given controller port
+    RollbackSession(Nes &nes, Transport &transport, std::size_t localPort, int maxRollback = 8);
+
+    /*
+       Emulate the next frame with the local buttons, draws it. Returns
+       false without emulating when the remote inputs lag too far behind,
+       the same input should be given again next time
+     */
+    bool AdvanceFrame(Word input);
+    // Exchange the inputs and fix the past frames without advancing
+    void Poll();
+
+    // Amount of frames emulated
+    std::uint32_t GetFrame() const;
+    // Frames emulated with the actual inputs of both players, they will never be rolled back
+    std::uint32_t GetConfirmedFrame() const;
+    const Stats &GetStats() const;
+
+    static constexpr int s_MaxRollbackLimit = 60;
+
+private:
+    void Receive();
+    void Send();
+    // Emulate again the frames from the first misprediction
+    void Rollback(bool drawLast);
+    // Keep the state of the frame then emulate it
+    void Simulate(std::uint32_t frame, bool draw);
+
+    Nes &m_Nes;
+    Transport &m_Transport;
+    std::size_t m_LocalPort;
+    int m_MaxRollback;
+
+    // Next frame to emulate
+    std::uint32_t m_Frame;
+    // Remote inputs are known for all the frames below
+    std::uint32_t m_RemoteCount;
+    // Local inputs the peer acknowledged
+    std::uint32_t m_RemoteAck;
+    // First frame emulated with a wrong prediction, m_Frame when none
+    std::uint32_t m_Mispredicted;
+
+    // Rings indexed by frame
+    std::vector<Word> m_LocalInputs;
+    std::vector<Word> m_RemoteInputs;
+    // Remote input the frame was emulated with
+    std::vector<Word> m_Predicted;
+    // State at the beginning of each frame which may be rolled back
+    std::vector<std::vector<Word>> m_States;
+
+    std::vector<Word> m_Packet;
+    Stats m_Stats;
+
+    static constexpr std::size_t s_InputHistory = 256;
+};
+
+#endif
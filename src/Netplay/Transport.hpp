@@ -0,0 +1,25 @@
+#ifndef TRANSPORT_HPP
+#define TRANSPORT_HPP
+
+#include "../Types.hpp"
+#include <cstddef>
+#include <vector>
+
+/*
+   Unreliable datagram channel between the two peers of a netplay session
+
+   Packets may be dropped, delayed or reordered but are never corrupted
+   or split, which is what UDP offers. Neither call may block, the session
+   polls the transport once per frame
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    virtual void Send(const Word *data, std::size_t size) = 0;
+    // Oldest pending packet, returns false when there is none
+    virtual bool Receive(std::vector<Word> &packet) = 0;
+};
+
+#endif
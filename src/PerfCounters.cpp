@@ -0,0 +1,317 @@
+#include "PerfCounters.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef __linux__
+constexpr std::uint64_t EventConfigs[PerfCounters::EventCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+int OpenEvent(std::uint64_t config, int group)
+{
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    // The whole group starts at once through the leader
+    attr.disabled = group == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+double PerFrame(std::uint64_t value, std::uint64_t frames)
+{
+    return frames ? static_cast<double>(value) / frames : 0.0;
+}
+} // namespace
+
+PerfCounters::Sample PerfCounters::Frame::GetTotal() const
+{
+    Sample total = {};
+
+    for (const Sample &sample : subsystems)
+    {
+        for (std::size_t event = 0; event < EventCount; event++)
+        {
+            total[event] += sample[event];
+        }
+    }
+
+    return total;
+}
+
+PerfCounters::PerfCounters()
+    : m_Opened(false), m_LastRead{}, m_FrameCount(0), m_InFrame(false), m_Stack{}, m_Depth(0)
+{
+    m_Descriptors.fill(-1);
+}
+
+PerfCounters::~PerfCounters()
+{
+    Close();
+}
+
+bool PerfCounters::IsAvailable() const
+{
+    return m_Descriptors[Cycles] != -1;
+}
+
+bool PerfCounters::IsCounted(Event event) const
+{
+    return m_Descriptors[event] != -1;
+}
+
+void PerfCounters::BeginFrame()
+{
+    if (!m_Opened)
+    {
+        Open();
+    }
+
+    if (!IsAvailable())
+    {
+        return;
+    }
+
+    m_Stack[0] = CpuCore;
+    m_Depth = 1;
+    m_InFrame = true;
+
+    // Only sets the starting point, nothing is open yet
+    Charge();
+    m_Current = Frame();
+}
+
+void PerfCounters::EndFrame()
+{
+    if (!m_InFrame)
+    {
+        return;
+    }
+
+    Charge();
+    m_InFrame = false;
+    m_Depth = 0;
+
+    m_LastFrame = m_Current;
+
+    for (std::size_t subsystem = 0; subsystem < SubsystemCount; subsystem++)
+    {
+        for (std::size_t event = 0; event < EventCount; event++)
+        {
+            m_Totals.subsystems[subsystem][event] += m_Current.subsystems[subsystem][event];
+        }
+    }
+
+    m_FrameCount++;
+}
+
+void PerfCounters::Enter(Subsystem subsystem)
+{
+    if (!m_InFrame)
+    {
+        return;
+    }
+
+    Charge();
+
+    // Deeper scopes than the stack stay charged to the last one recorded
+    if (m_Depth < m_Stack.size())
+    {
+        m_Stack[m_Depth] = subsystem;
+    }
+
+    m_Depth++;
+}
+
+void PerfCounters::Leave()
+{
+    // Also ignores the scopes left after the frame ended
+    if (!m_InFrame || m_Depth <= 1)
+    {
+        return;
+    }
+
+    Charge();
+    m_Depth--;
+}
+
+const PerfCounters::Frame &PerfCounters::GetLastFrame() const
+{
+    return m_LastFrame;
+}
+
+const PerfCounters::Frame &PerfCounters::GetTotals() const
+{
+    return m_Totals;
+}
+
+std::uint64_t PerfCounters::GetFrameCount() const
+{
+    return m_FrameCount;
+}
+
+void PerfCounters::Clear()
+{
+    m_LastFrame = Frame();
+    m_Totals = Frame();
+    m_FrameCount = 0;
+}
+
+void PerfCounters::Report(std::ostream &stream) const
+{
+    if (!IsAvailable())
+    {
+        stream << "performance counters unavailable\n";
+        return;
+    }
+
+    std::ios::fmtflags flags = stream.flags();
+    stream << std::fixed << std::setprecision(0);
+    stream << "performance counters, per frame over " << m_FrameCount << " frames\n";
+    stream << std::setw(12) << "" << std::setw(14) << "cycles" << std::setw(14) << "instructions" << std::setw(7)
+           << "IPC" << std::setw(15) << "branch misses" << std::setw(14) << "cache misses" << std::setw(8) << "share"
+           << "\n";
+
+    Sample total = m_Totals.GetTotal();
+
+    auto row = [&](const char *name, const Sample &sample) {
+        stream << "  " << std::left << std::setw(10) << name << std::right;
+
+        for (Event event : {Cycles, Instructions})
+        {
+            stream << std::setw(14) << PerFrame(sample[event], m_FrameCount);
+        }
+
+        double ipc = sample[Cycles] ? static_cast<double>(sample[Instructions]) / sample[Cycles] : 0.0;
+        stream << std::setw(7) << std::setprecision(2) << ipc << std::setprecision(0);
+
+        for (Event event : {BranchMisses, CacheMisses})
+        {
+            int width = event == BranchMisses ? 15 : 14;
+
+            if (IsCounted(event))
+            {
+                stream << std::setw(width) << PerFrame(sample[event], m_FrameCount);
+            }
+            else
+            {
+                stream << std::setw(width) << "n/a";
+            }
+        }
+
+        double share = total[Cycles] ? sample[Cycles] * 100.0 / total[Cycles] : 0.0;
+        stream << std::setw(7) << std::setprecision(1) << share << "%" << std::setprecision(0) << "\n";
+    };
+
+    for (std::size_t subsystem = 0; subsystem < SubsystemCount; subsystem++)
+    {
+        row(GetSubsystemName(static_cast<Subsystem>(subsystem)), m_Totals.subsystems[subsystem]);
+    }
+
+    row("frame", total);
+    stream.flags(flags);
+}
+
+const char *PerfCounters::GetEventName(Event event)
+{
+    static const char *s_Names[] = {"cycles", "instructions", "branch-misses", "cache-misses"};
+    return s_Names[event];
+}
+
+const char *PerfCounters::GetSubsystemName(Subsystem subsystem)
+{
+    static const char *s_Names[] = {"cpu", "ppu", "apu", "bus-io"};
+    return s_Names[subsystem];
+}
+
+void PerfCounters::Open()
+{
+    m_Opened = true;
+
+#ifdef __linux__
+    int leader = OpenEvent(EventConfigs[Cycles], -1);
+
+    if (leader == -1)
+    {
+        return;
+    }
+
+    m_Descriptors[Cycles] = leader;
+
+    // Virtual machines often lack some of the events, the others still count
+    for (std::size_t event = Cycles + 1; event < EventCount; event++)
+    {
+        m_Descriptors[event] = OpenEvent(EventConfigs[event], leader);
+    }
+
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+void PerfCounters::Close()
+{
+#ifdef __linux__
+    // Members first, the leader last
+    for (std::size_t event = EventCount; event-- > 0;)
+    {
+        if (m_Descriptors[event] != -1)
+        {
+            close(m_Descriptors[event]);
+        }
+    }
+#endif
+
+    m_Descriptors.fill(-1);
+}
+
+void PerfCounters::Charge()
+{
+#ifdef __linux__
+    // Count followed by the values, in the order the events joined the group
+    std::uint64_t buffer[1 + EventCount];
+
+    if (read(m_Descriptors[Cycles], buffer, sizeof(buffer)) <= 0)
+    {
+        return;
+    }
+
+    Sample now = {};
+    std::size_t index = 1;
+
+    for (std::size_t event = 0; event < EventCount && index <= buffer[0]; event++)
+    {
+        if (m_Descriptors[event] != -1)
+        {
+            now[event] = buffer[index++];
+        }
+    }
+
+    Sample &charged = m_Current.subsystems[m_Stack[std::min(m_Depth, m_Stack.size()) - 1]];
+
+    for (std::size_t event = 0; event < EventCount; event++)
+    {
+        charged[event] += now[event] - m_LastRead[event];
+    }
+
+    m_LastRead = now;
+#endif
+}
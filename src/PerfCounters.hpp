@@ -0,0 +1,139 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include "Types.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+/*
+   Hardware performance counters
+
+   Counts the host cycles, instructions, branch misses and cache misses
+   spent per emulated frame through Linux perf_event_open. The frame is
+   split between the subsystems with scopes: every counter read charges
+   the events since the previous read to the innermost open scope, so the
+   subsystems add up to the frame and the CPU core gets whatever is left
+   outside of the others. A read is a system call, the scopes only sit
+   around coarse work (a scanline render, an APU catch up, a register
+   access) and the cpu instruction loop itself is never instrumented.
+
+   The counters follow the thread which begins the first frame, the
+   emulation thread. Where perf_event_open is missing or refused (another
+   system, perf_event_paranoid, a container) every call is a no-op and
+   IsAvailable() is false, events the host does not count read as zero
+ */
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        CacheMisses,
+        EventCount,
+    };
+
+    enum Subsystem
+    {
+        // Instruction loop and device clocking, the remainder of the frame
+        CpuCore,
+        PpuRender,
+        Apu,
+        // CPU accesses to the PPU, APU and controller registers
+        BusIo,
+        SubsystemCount,
+    };
+
+    using Sample = std::array<std::uint64_t, EventCount>;
+
+    // Events per subsystem
+    struct Frame
+    {
+        std::array<Sample, SubsystemCount> subsystems{};
+
+        Sample GetTotal() const;
+    };
+
+    bool IsAvailable() const;
+    // Whether the host counts the event, known once the first frame began
+    bool IsCounted(Event event) const;
+
+    void BeginFrame();
+    void EndFrame();
+
+    // Charge the events to the subsystem until the matching Leave, scopes nest
+    void Enter(Subsystem subsystem);
+    void Leave();
+
+    // Leaves on destruction, a null counter set costs a single check
+    class Scope
+    {
+    public:
+        Scope(PerfCounters *counters, Subsystem subsystem) : m_Counters(counters)
+        {
+            if (m_Counters)
+            {
+                m_Counters->Enter(subsystem);
+            }
+        }
+
+        ~Scope()
+        {
+            if (m_Counters)
+            {
+                m_Counters->Leave();
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        PerfCounters *m_Counters;
+    };
+
+    // Last complete frame
+    const Frame &GetLastFrame() const;
+    // Sum of the frames since the creation or the last Clear
+    const Frame &GetTotals() const;
+    std::uint64_t GetFrameCount() const;
+    void Clear();
+
+    // Averages per frame, per subsystem
+    void Report(std::ostream &stream) const;
+
+    static const char *GetEventName(Event event);
+    static const char *GetSubsystemName(Subsystem subsystem);
+
+private:
+    void Open();
+    void Close();
+    // Charge the events since the last read to the current subsystem
+    void Charge();
+
+    // perf_event_open descriptors, -1 for the events not counted, the cycles lead the group
+    std::array<int, EventCount> m_Descriptors;
+    bool m_Opened;
+
+    Sample m_LastRead;
+    Frame m_Current;
+    Frame m_LastFrame;
+    Frame m_Totals;
+    std::uint64_t m_FrameCount;
+    bool m_InFrame;
+
+    // Open scopes, the bottom one being the CPU core
+    std::array<Subsystem, 8> m_Stack;
+    std::size_t m_Depth;
+};
+
+#endif
@@ -1,6 +1,863 @@
 #include "Ppu.hpp"
-#include "Ram.hpp"
+#include "PerfCounters.hpp"
+#include "State.hpp"
+#include "Cpu/Cpu.hpp"
+#include "Mapper/Mapper.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 
-Ppu::Ppu(Ram &ram)
-    : m_Ram(ram)
-{}
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NES_PPU_SSE2
+#endif
+
+namespace
+{
+// 2C02 master palette in 0xAARRGGBB
+constexpr QWord s_Colors[64] = {
+    0xFF666666, 0xFF002A88, 0xFF1412A7, 0xFF3B00A4, 0xFF5C007E, 0xFF6E0040, 0xFF6C0600, 0xFF561D00,
+    0xFF333500, 0xFF0B4800, 0xFF005200, 0xFF004F08, 0xFF00404D, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFFADADAD, 0xFF155FD9, 0xFF4240FF, 0xFF7527FE, 0xFFA01ACC, 0xFFB71E7B, 0xFFB53120, 0xFF994E00,
+    0xFF6B6D00, 0xFF388700, 0xFF0C9300, 0xFF008F32, 0xFF007C8D, 0xFF000000, 0xFF000000, 0xFF000000,
+    0xFFFFFEFF, 0xFF64B0FF, 0xFF9290FF, 0xFFC676FF, 0xFFF36AFF, 0xFFFE6ECC, 0xFFFE8170, 0xFFEA9E22,
+    0xFFBCBE00, 0xFF88D800, 0xFF5CE430, 0xFF45E082, 0xFF48CDDE, 0xFF4F4F4F, 0xFF000000, 0xFF000000,
+    0xFFFFFEFF, 0xFFC0DFFF, 0xFFD3D2FF, 0xFFE8C8FF, 0xFFFBC2FF, 0xFFFEC4EA, 0xFFFECCC5, 0xFFF7D8A5,
+    0xFFE4E594, 0xFFCFEF96, 0xFFBDF4AB, 0xFFB3F3CC, 0xFFB5EBF2, 0xFFB8B8B8, 0xFF000000, 0xFF000000,
+};
+
+constexpr int VisibleScanlines = 240;
+constexpr int VblankScanline = 241;
+constexpr int PreRenderScanline = 261;
+constexpr int LastDot = 340;
+
+// PPUCTRL
+constexpr Word ControlIncrement = 0x04;
+constexpr Word ControlSpriteTable = 0x08;
+constexpr Word ControlBackgroundTable = 0x10;
+constexpr Word ControlSpriteSize = 0x20;
+constexpr Word ControlNmi = 0x80;
+
+// PPUMASK
+constexpr Word MaskGrayscale = 0x01;
+constexpr Word MaskBackgroundLeft = 0x02;
+constexpr Word MaskSpritesLeft = 0x04;
+constexpr Word MaskBackground = 0x08;
+constexpr Word MaskSprites = 0x10;
+
+// PPUSTATUS
+constexpr Word StatusOverflow = 0x20;
+constexpr Word StatusSprite0Hit = 0x40;
+constexpr Word StatusVblank = 0x80;
+
+// Pattern tables of a console without cartridge
+const std::array<Word, 0x0400> EmptyPage{};
+
+// Priority bit of the composed sprite pixels, outside of the palette indices
+constexpr Word SpriteBehind = 0x80;
+
+/*
+   The sprite rows are handled 8 pixels at once, a pixel per byte of a 64
+   bits word in memory order: loaded and stored with memcpy, the lanes
+   never depend on the host endianness
+ */
+constexpr std::uint64_t Bytes = 0x0101010101010101;
+
+// 0xFF in the non zero bytes, 0x00 in the others
+std::uint64_t NonZeroBytes(std::uint64_t value)
+{
+    constexpr std::uint64_t Low = 0x7F7F7F7F7F7F7F7F;
+    std::uint64_t high = (((value & Low) + Low) | value) & ~Low;
+    return (high >> 7) * 0xFF;
+}
+
+// Pattern byte to 8 pixels of 0 or 1, left to right then mirrored for the horizontally flipped sprites
+std::array<std::array<std::uint64_t, 256>, 2> BuildExpandBits()
+{
+    std::array<std::array<std::uint64_t, 256>, 2> tables;
+
+    for (int value = 0; value < 256; value++)
+    {
+        Word pixels[2][8];
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            pixels[0][bit] = (value >> (7 - bit)) & 0x01;
+            pixels[1][bit] = (value >> bit) & 0x01;
+        }
+
+        std::memcpy(&tables[0][value], pixels[0], 8);
+        std::memcpy(&tables[1][value], pixels[1], 8);
+    }
+
+    return tables;
+}
+
+const std::array<std::array<std::uint64_t, 256>, 2> ExpandBits = BuildExpandBits();
+
+int LowestBit(std::uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int bit = 0;
+
+    while (!(value & 0x01))
+    {
+        value >>= 1;
+        bit++;
+    }
+
+    return bit;
+#endif
+}
+
+/*
+   Final palette indices of a scanline: the sprite pixel unless it is
+   transparent, or behind an opaque background pixel
+ */
+void CompositeSprites(const Word *background, const Word *sprites, Word *indices)
+{
+#ifdef NES_PPU_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i behindBit = _mm_set1_epi8(static_cast<char>(SpriteBehind));
+    const __m128i paletteBits = _mm_set1_epi8(0x1F);
+
+    for (int x = 0; x < Ppu::s_Width; x += 16)
+    {
+        __m128i back = _mm_loadu_si128(reinterpret_cast<const __m128i *>(background + x));
+        __m128i sprite = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sprites + x));
+
+        __m128i transparent = _mm_cmpeq_epi8(sprite, zero);
+        __m128i hidden = _mm_andnot_si128(_mm_cmpeq_epi8(back, zero),
+                                          _mm_cmpeq_epi8(_mm_and_si128(sprite, behindBit), behindBit));
+        __m128i useBackground = _mm_or_si128(transparent, hidden);
+
+        __m128i result = _mm_or_si128(_mm_and_si128(useBackground, back),
+                                      _mm_andnot_si128(useBackground, _mm_and_si128(sprite, paletteBits)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(indices + x), result);
+    }
+#else
+    for (int x = 0; x < Ppu::s_Width; x++)
+    {
+        Word sprite = sprites[x];
+        bool hidden = background[x] && (sprite & SpriteBehind);
+        indices[x] = (sprite && !hidden) ? sprite & 0x1F : background[x];
+    }
+#endif
+}
+} // namespace
+
+Ppu::Ppu()
+    : m_RenderFrame(true), m_RenderNextFrame(true), m_FrameBuffer(nullptr), m_Mapper(nullptr), m_Cpu(nullptr),
+      m_PerfCounters(nullptr)
+{
+    m_FrameBuffer = m_InternalFrameBuffer.data();
+    Reset();
+    UpdatePages();
+}
+
+void Ppu::Reset()
+{
+    m_Control = m_Mask = m_Status = m_OamAddress = m_ReadBuffer = 0x00;
+    m_V = m_T = 0x0000;
+    m_FineX = 0;
+    m_WriteToggle = false;
+
+    m_Scanline = 0;
+    m_Dot = 0;
+    m_OddFrame = false;
+    m_FrameComplete = false;
+    m_Sprite0HitDot = -1;
+
+    m_Oam.fill(0x00);
+    m_Nametables.fill(0x00);
+    m_Palette.fill(0x00);
+    std::fill_n(m_FrameBuffer, s_Width * s_Height, s_Colors[0x0F]);
+}
+
+void Ppu::SetMapper(Mapper *mapper)
+{
+    m_Mapper = mapper;
+    UpdatePages();
+}
+
+void Ppu::SetCpu(Cpu *cpu)
+{
+    m_Cpu = cpu;
+}
+
+void Ppu::SetPerfCounters(PerfCounters *counters)
+{
+    m_PerfCounters = counters;
+}
+
+void Ppu::RaiseNmi()
+{
+    if (m_Cpu)
+    {
+        m_Cpu->TriggerNmi();
+    }
+}
+
+void Ppu::Clock()
+{
+    if (m_Scanline < VisibleScanlines)
+    {
+        if (m_Dot == 1)
+        {
+            PerfCounters::Scope scope(m_PerfCounters, PerfCounters::PpuRender);
+            RenderScanline();
+        }
+
+        if (m_Dot == m_Sprite0HitDot)
+        {
+            m_Status |= StatusSprite0Hit;
+        }
+
+        if (IsRendering())
+        {
+            if (m_Dot == 256)
+            {
+                IncrementY();
+            }
+            else if (m_Dot == 257)
+            {
+                // Horizontal scroll bits: ....F.. ...XXXXX
+                m_V = (m_V & ~0x041F) | (m_T & 0x041F);
+            }
+        }
+    }
+    else if (m_Scanline == VblankScanline && m_Dot == 1)
+    {
+        m_Status |= StatusVblank;
+        m_FrameComplete = true;
+
+        if (m_Control & ControlNmi)
+        {
+            RaiseNmi();
+        }
+    }
+    else if (m_Scanline == PreRenderScanline)
+    {
+        if (m_Dot == 1)
+        {
+            m_Status &= ~(StatusVblank | StatusSprite0Hit | StatusOverflow);
+        }
+
+        if (IsRendering())
+        {
+            if (m_Dot == 256)
+            {
+                IncrementY();
+            }
+            else if (m_Dot == 257)
+            {
+                m_V = (m_V & ~0x041F) | (m_T & 0x041F);
+            }
+            else if (m_Dot >= 280 && m_Dot <= 304)
+            {
+                // Vertical scroll bits: yyy.N.. YYYYY.....
+                m_V = (m_V & ~0x7BE0) | (m_T & 0x7BE0);
+            }
+            else if (m_Dot == 339 && m_OddFrame)
+            {
+                // Odd frames skip the last dot of the pre-render scanline
+                m_Dot = LastDot;
+            }
+        }
+    }
+
+    if (++m_Dot > LastDot)
+    {
+        m_Dot = 0;
+        m_Sprite0HitDot = -1;
+
+        if (++m_Scanline > PreRenderScanline)
+        {
+            m_Scanline = 0;
+            m_OddFrame = !m_OddFrame;
+        }
+    }
+}
+
+Word Ppu::ReadRegister(DWord address)
+{
+    switch (address & 0x07)
+    {
+    case 2: {
+        Word value = (m_Status & 0xE0) | (m_ReadBuffer & 0x1F);
+        m_Status &= ~StatusVblank;
+        m_WriteToggle = false;
+        return value;
+    }
+    case 4:
+        return m_Oam[m_OamAddress];
+    case 7: {
+        Word value;
+
+        // Palette reads are not delayed, the buffer receives the nametable byte underneath
+        if ((m_V & 0x3FFF) >= 0x3F00)
+        {
+            value = ReadVram(m_V);
+            m_ReadBuffer = ReadVram(m_V - 0x1000);
+        }
+        else
+        {
+            value = m_ReadBuffer;
+            m_ReadBuffer = ReadVram(m_V);
+        }
+
+        m_V = (m_V + ((m_Control & ControlIncrement) ? 32 : 1)) & 0x7FFF;
+        return value;
+    }
+    default:
+        return m_ReadBuffer;
+    }
+}
+
+void Ppu::WriteRegister(DWord address, Word value)
+{
+    switch (address & 0x07)
+    {
+    case 0:
+        // Enabling the NMI during the vblank raises it immediately
+        if (!(m_Control & ControlNmi) && (value & ControlNmi) && (m_Status & StatusVblank))
+        {
+            RaiseNmi();
+        }
+
+        m_Control = value;
+        m_T = (m_T & 0xF3FF) | ((value & 0x03) << 10);
+        break;
+    case 1:
+        m_Mask = value;
+        break;
+    case 3:
+        m_OamAddress = value;
+        break;
+    case 4:
+        WriteOam(value);
+        break;
+    case 5:
+        if (!m_WriteToggle)
+        {
+            m_T = (m_T & 0xFFE0) | (value >> 3);
+            m_FineX = value & 0x07;
+        }
+        else
+        {
+            m_T = (m_T & 0x8C1F) | ((value & 0x07) << 12) | ((value & 0xF8) << 2);
+        }
+
+        m_WriteToggle = !m_WriteToggle;
+        break;
+    case 6:
+        if (!m_WriteToggle)
+        {
+            m_T = (m_T & 0x00FF) | ((value & 0x3F) << 8);
+        }
+        else
+        {
+            m_T = (m_T & 0xFF00) | value;
+            m_V = m_T;
+        }
+
+        m_WriteToggle = !m_WriteToggle;
+        break;
+    case 7:
+        WriteVram(m_V, value);
+        m_V = (m_V + ((m_Control & ControlIncrement) ? 32 : 1)) & 0x7FFF;
+        break;
+    }
+}
+
+void Ppu::WriteOam(Word value)
+{
+    m_Oam[m_OamAddress++] = value;
+}
+
+void Ppu::WriteOam(const Word *data)
+{
+    // The address wraps around and ends where it started
+    std::size_t split = m_Oam.size() - m_OamAddress;
+    std::copy(data, data + split, m_Oam.begin() + m_OamAddress);
+    std::copy(data + split, data + m_Oam.size(), m_Oam.begin());
+}
+
+bool Ppu::PollFrameComplete()
+{
+    bool complete = m_FrameComplete;
+    m_FrameComplete = false;
+    return complete;
+}
+
+const QWord *Ppu::GetFrameBuffer() const
+{
+    return m_FrameBuffer;
+}
+
+QWord *Ppu::SetFrameBuffer(QWord *buffer)
+{
+    QWord *previous = m_FrameBuffer;
+    m_FrameBuffer = buffer ? buffer : m_InternalFrameBuffer.data();
+    return previous;
+}
+
+void Ppu::SetRenderFrame(bool render)
+{
+    m_RenderNextFrame = render;
+}
+
+bool Ppu::IsFrameRendered() const
+{
+    return m_RenderFrame;
+}
+
+Word Ppu::ReadVram(DWord address)
+{
+    address &= 0x3FFF;
+
+    if (address >= 0x3F00)
+    {
+        return m_Palette[MirrorPalette(address)];
+    }
+
+    return Fetch(address);
+}
+
+void Ppu::WriteVram(DWord address, Word value)
+{
+    address &= 0x3FFF;
+
+    if (address >= 0x3F00)
+    {
+        m_Palette[MirrorPalette(address)] = value & 0x3F;
+        return;
+    }
+
+    Word *page = m_WritePages[address >> 10];
+
+    if (page)
+    {
+        page[address & (s_PageSize - 1)] = value;
+    }
+}
+
+void Ppu::UpdatePages()
+{
+    constexpr std::size_t PatternPages = 0x2000 / s_PageSize;
+    constexpr std::size_t NametablePages = 4;
+
+    for (std::size_t page = 0; page < PatternPages; page++)
+    {
+        if (m_Mapper)
+        {
+            std::vector<Word> &chr = m_Mapper->GetCartridge().GetChr();
+            Word *data = chr.data() + m_Mapper->GetChrOffset(page);
+            m_ReadPages[page] = data;
+            m_WritePages[page] = m_Mapper->GetCartridge().HasChrRam() ? data : nullptr;
+        }
+        else
+        {
+            m_ReadPages[page] = EmptyPage.data();
+            m_WritePages[page] = nullptr;
+        }
+    }
+
+    // Physical nametable of each of the 4 logical ones
+    std::array<std::size_t, NametablePages> tables = {0, 0, 1, 1};
+
+    switch (m_Mapper ? m_Mapper->GetMirroring() : Mirroring::Horizontal)
+    {
+    case Mirroring::Horizontal:
+        break;
+    case Mirroring::Vertical:
+        tables = {0, 1, 0, 1};
+        break;
+    case Mirroring::SingleLower:
+        tables = {0, 0, 0, 0};
+        break;
+    case Mirroring::SingleUpper:
+        tables = {1, 1, 1, 1};
+        break;
+    case Mirroring::FourScreen:
+        tables = {0, 1, 2, 3};
+        break;
+    }
+
+    // $2000-$2FFF and their $3000-$3EFF mirror
+    for (std::size_t page = PatternPages; page < s_PageCount; page++)
+    {
+        Word *data = &m_Nametables[tables[page % NametablePages] * s_PageSize];
+        m_ReadPages[page] = data;
+        m_WritePages[page] = data;
+    }
+}
+
+DWord Ppu::MirrorPalette(DWord address)
+{
+    address &= 0x1F;
+
+    // The sprite backdrop entries mirror the background ones
+    if ((address & 0x13) == 0x10)
+    {
+        address &= ~0x10;
+    }
+
+    return address;
+}
+
+bool Ppu::IsRendering() const
+{
+    return m_Mask & (MaskBackground | MaskSprites);
+}
+
+void Ppu::RenderScanline()
+{
+    QWord *line = &m_FrameBuffer[m_Scanline * s_Width];
+    m_Sprite0HitDot = -1;
+
+    if (m_Scanline == 0)
+    {
+        m_RenderFrame = m_RenderNextFrame;
+    }
+
+    if (!IsRendering())
+    {
+        if (m_RenderFrame)
+        {
+            QWord backdrop = s_Colors[m_Palette[0] & 0x3F];
+
+            for (int x = 0; x < s_Width; x++)
+            {
+                line[x] = backdrop;
+            }
+        }
+
+        return;
+    }
+
+    bool showBackground = m_Mask & MaskBackground;
+    bool showSprites = m_Mask & MaskSprites;
+    int height = (m_Control & ControlSpriteSize) ? 16 : 8;
+
+    /*
+       Palette RAM indices, 0 being transparent. The sprite pixels carry
+       their priority in SpriteBehind and the rows have room for the
+       sprites running past the right edge, written 8 pixels at once
+     */
+    alignas(16) std::array<Word, s_Width> background{};
+    alignas(16) std::array<Word, s_Width + 8> sprites{};
+
+    std::array<Word, 9> found;
+    int count = showSprites ? EvaluateSprites(height, found) : 0;
+
+    if (showBackground)
+    {
+        if (m_RenderFrame)
+        {
+            RenderBackground(background, 0, s_Width);
+        }
+        else if (count > 0 && found[0] == 0)
+        {
+            // Only what lies under sprite 0 can be seen by the program
+            RenderBackground(background, m_Oam[3], std::min(m_Oam[3] + 8, s_Width));
+        }
+
+        if (!(m_Mask & MaskBackgroundLeft))
+        {
+            std::fill(background.begin(), background.begin() + 8, 0);
+        }
+    }
+
+    if (count > 8)
+    {
+        m_Status |= StatusOverflow;
+        count = 8;
+    }
+
+    // Skipped frames still need the sprite 0 pixels for the hit
+    if (!m_RenderFrame)
+    {
+        count = (count > 0 && found[0] == 0) ? 1 : 0;
+    }
+
+    for (int n = 0; n < count; n++)
+    {
+        int i = found[n];
+        const Word *sprite = &m_Oam[i * 4];
+        // Sprites are delayed by one scanline
+        int row = m_Scanline - 1 - sprite[0];
+        Word tile = sprite[1];
+        Word attribute = sprite[2];
+        int x = sprite[3];
+
+        if (attribute & 0x80)
+        {
+            row = height - 1 - row;
+        }
+
+        DWord address;
+
+        if (height == 16)
+        {
+            address = ((tile & 0x01) ? 0x1000 : 0x0000) + (tile & 0xFE) * 16;
+
+            if (row >= 8)
+            {
+                address += 16;
+                row -= 8;
+            }
+        }
+        else
+        {
+            address = ((m_Control & ControlSpriteTable) ? 0x1000 : 0x0000) + tile * 16;
+        }
+
+        Word lo = Fetch(address + row);
+        Word hi = Fetch(address + row + 8);
+
+        // The 8 pixels of the row side by side, one per byte
+        const std::array<std::uint64_t, 256> &expand = ExpandBits[(attribute & 0x40) ? 1 : 0];
+        std::uint64_t pixels = expand[lo] | expand[hi] << 1;
+        std::uint64_t opaque = NonZeroBytes(pixels);
+
+        if (!opaque)
+        {
+            continue;
+        }
+
+        if (i == 0 && m_Sprite0HitDot < 0 && !(m_Status & StatusSprite0Hit))
+        {
+            std::uint64_t under = 0;
+            std::memcpy(&under, &background[x], std::min(8, s_Width - x));
+            std::uint64_t hit = opaque & NonZeroBytes(under);
+
+            for (int bit = 0; hit && bit < 8; bit++)
+            {
+                int dot = x + bit;
+                bool left = dot < 8 && !(m_Mask & MaskSpritesLeft);
+
+                if (reinterpret_cast<const Word *>(&hit)[bit] && dot != 255 && !left)
+                {
+                    m_Sprite0HitDot = dot + 1;
+                    break;
+                }
+            }
+        }
+
+        // Lower OAM indices have the priority, only the free pixels are written
+        std::uint64_t occupied;
+        std::memcpy(&occupied, &sprites[x], sizeof(occupied));
+        std::uint64_t write = opaque & ~NonZeroBytes(occupied);
+        Word base = 0x10 | ((attribute & 0x03) << 2) | ((attribute & 0x20) ? SpriteBehind : 0x00);
+        occupied |= (pixels | base * Bytes) & write;
+        std::memcpy(&sprites[x], &occupied, sizeof(occupied));
+    }
+
+    if (!m_RenderFrame)
+    {
+        return;
+    }
+
+    if (!(m_Mask & MaskSpritesLeft))
+    {
+        std::fill(sprites.begin(), sprites.begin() + 8, 0);
+    }
+
+    Word grayscale = (m_Mask & MaskGrayscale) ? 0x30 : 0x3F;
+    std::array<QWord, 32> colors;
+
+    for (std::size_t i = 0; i < colors.size(); i++)
+    {
+        colors[i] = s_Colors[m_Palette[i] & grayscale];
+    }
+
+    // In place, the background row becomes the final palette indices
+    CompositeSprites(background.data(), sprites.data(), background.data());
+
+    for (int x = 0; x < s_Width; x++)
+    {
+        line[x] = colors[background[x]];
+    }
+}
+
+void Ppu::RenderBackground(std::array<Word, s_Width> &background, int first, int last)
+{
+    DWord v = m_V;
+    DWord table = (m_Control & ControlBackgroundTable) ? 0x1000 : 0x0000;
+    DWord fineY = (v >> 12) & 0x07;
+
+    // Tiles are counted from the one partially hidden by the fine x scroll
+    int firstTile = (first + m_FineX) / 8;
+    int lastTile = (last - 1 + m_FineX) / 8;
+    DWord coarseX = (v & 0x001F) + firstTile;
+
+    // Coarse x increments, wrapping onto the horizontally adjacent nametable
+    if (coarseX >= 32)
+    {
+        v ^= 0x0400;
+        coarseX -= 32;
+    }
+
+    v = (v & ~0x001F) | coarseX;
+    int x = firstTile * 8 - (int)m_FineX;
+
+    for (int tile = firstTile; tile <= lastTile; tile++)
+    {
+        Word index = Fetch(0x2000 | (v & 0x0FFF));
+        Word attribute = Fetch(0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07));
+        Word palette = ((attribute >> (((v >> 4) & 0x04) | (v & 0x02))) & 0x03) << 2;
+
+        Word lo = Fetch(table + index * 16 + fineY);
+        Word hi = Fetch(table + index * 16 + fineY + 8);
+
+        for (int bit = 7; bit >= 0; bit--, x++)
+        {
+            Word pixel = ((lo >> bit) & 0x01) | (((hi >> bit) & 0x01) << 1);
+
+            if (x >= first && x < last && pixel)
+            {
+                background[x] = palette | pixel;
+            }
+        }
+
+        if ((v & 0x001F) == 31)
+        {
+            v = (v & ~0x001F) ^ 0x0400;
+        }
+        else
+        {
+            v++;
+        }
+    }
+}
+
+int Ppu::EvaluateSprites(int height, std::array<Word, 9> &found) const
+{
+    // Sprites are delayed by one scanline
+    int scanline = m_Scanline - 1;
+    std::uint64_t inRange = 0;
+
+#ifdef NES_PPU_SSE2
+    const __m128i yBits = _mm_set1_epi32(0xFF);
+    const __m128i lines = _mm_set1_epi16(static_cast<short>(scanline));
+    const __m128i heights = _mm_set1_epi16(static_cast<short>(height));
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i *oam = reinterpret_cast<const __m128i *>(m_Oam.data());
+
+    // 16 sprites per round, their Y coordinates packed into 16 bits lanes
+    for (int group = 0; group < 4; group++, oam += 4)
+    {
+        __m128i first = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(oam), yBits),
+                                        _mm_and_si128(_mm_loadu_si128(oam + 1), yBits));
+        __m128i second = _mm_packs_epi32(_mm_and_si128(_mm_loadu_si128(oam + 2), yBits),
+                                         _mm_and_si128(_mm_loadu_si128(oam + 3), yBits));
+
+        __m128i rowsFirst = _mm_sub_epi16(lines, first);
+        __m128i rowsSecond = _mm_sub_epi16(lines, second);
+        __m128i inFirst = _mm_andnot_si128(_mm_cmplt_epi16(rowsFirst, zero), _mm_cmplt_epi16(rowsFirst, heights));
+        __m128i inSecond = _mm_andnot_si128(_mm_cmplt_epi16(rowsSecond, zero), _mm_cmplt_epi16(rowsSecond, heights));
+
+        std::uint64_t mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(inFirst, inSecond)));
+        inRange |= mask << (group * 16);
+    }
+#else
+    for (int i = 0; i < 64; i++)
+    {
+        int row = scanline - m_Oam[i * 4];
+
+        if (row >= 0 && row < height)
+        {
+            inRange |= std::uint64_t(1) << i;
+        }
+    }
+#endif
+
+    int count = 0;
+
+    for (; inRange && count < static_cast<int>(found.size()); inRange &= inRange - 1)
+    {
+        found[count++] = static_cast<Word>(LowestBit(inRange));
+    }
+
+    return count;
+}
+
+void Ppu::IncrementY()
+{
+    if ((m_V & 0x7000) != 0x7000)
+    {
+        m_V += 0x1000;
+        return;
+    }
+
+    m_V &= ~0x7000;
+    DWord y = (m_V & 0x03E0) >> 5;
+
+    if (y == 29)
+    {
+        y = 0;
+        m_V ^= 0x0800;
+    }
+    else if (y == 31)
+    {
+        y = 0;
+    }
+    else
+    {
+        y++;
+    }
+
+    m_V = (m_V & ~0x03E0) | (y << 5);
+}
+
+void Ppu::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_Control);
+    writer.Write(m_Mask);
+    writer.Write(m_Status);
+    writer.Write(m_OamAddress);
+    writer.Write(m_ReadBuffer);
+    writer.Write(m_V);
+    writer.Write(m_T);
+    writer.Write(m_FineX);
+    writer.Write(m_WriteToggle);
+    writer.Write(m_Scanline);
+    writer.Write(m_Dot);
+    writer.Write(m_OddFrame);
+    writer.Write(m_FrameComplete);
+    writer.Write(m_Sprite0HitDot);
+    writer.Write(m_Oam);
+    writer.Write(m_Nametables);
+    writer.Write(m_Palette);
+}
+
+void Ppu::LoadState(StateReader &reader)
+{
+    reader.Read(m_Control);
+    reader.Read(m_Mask);
+    reader.Read(m_Status);
+    reader.Read(m_OamAddress);
+    reader.Read(m_ReadBuffer);
+    reader.Read(m_V);
+    reader.Read(m_T);
+    reader.Read(m_FineX);
+    reader.Read(m_WriteToggle);
+    reader.Read(m_Scanline);
+    reader.Read(m_Dot);
+    reader.Read(m_OddFrame);
+    reader.Read(m_FrameComplete);
+    reader.Read(m_Sprite0HitDot);
+    reader.Read(m_Oam);
+    reader.Read(m_Nametables);
+    reader.Read(m_Palette);
+
+    // The scanline indexes the frame buffer, the fine X offsets the rendered tiles
+    if (m_Scanline < 0 || m_Scanline > PreRenderScanline || m_Dot < 0 || m_Dot > LastDot || m_FineX > 7)
+    {
+        throw std::runtime_error("Corrupt save state");
+    }
+}
@@ -1,15 +1,159 @@
 #ifndef PPU_HPP
 #define PPU_HPP
 
-class Ram;
+#include "Types.hpp"
+#include <array>
 
+class Cpu;
+class Mapper;
+class PerfCounters;
+class StateWriter;
+class StateReader;
+
+/*
+   Picture processing unit
+
+   Clocked once per dot, 341 dots per scanline and 262 scanlines per frame.
+   Visible scanlines are composed as a whole on their first dot from the
+   scroll position at that time, the timing visible events (sprite 0 hit,
+   vblank, scroll increments) still happen on their own dot
+ */
 class Ppu
 {
 public:
-    Ppu(Ram &ram);
+    Ppu();
+
+    void Reset();
+    void Clock();
+
+    // Cartridge providing the pattern tables and the nametable mirroring
+    void SetMapper(Mapper *mapper);
+    // Point the pattern table and nametable pages at their memory again, after a bank switch or a mirroring change
+    void UpdatePages();
+    // Cpu receiving the NMI raised at the vblank
+    void SetCpu(Cpu *cpu);
+    // Charge the scanline renders to the PPU subsystem, nullptr detaches the counters
+    void SetPerfCounters(PerfCounters *counters);
+
+    // CPU side registers, $2000-$2007 mirrored up to $3FFF
+    Word ReadRegister(DWord address);
+    void WriteRegister(DWord address, Word value);
+    // OAM DMA destination
+    void WriteOam(Word value);
+    // 256 bytes written from the OAM address on, as many WriteOam calls would
+    void WriteOam(const Word *data);
+
+    // Returns true once per frame when the vblank begins
+    bool PollFrameComplete();
+
+    static constexpr int s_Width = 256;
+    static constexpr int s_Height = 240;
+
+    // Frame buffer in 0xAARRGGBB pixels
+    const QWord *GetFrameBuffer() const;
+    /*
+       Render into a s_Width * s_Height buffer owned by the caller, null
+       goes back to the internal one. Returns the previous buffer, swapping
+       buffers at each vblank hands the frames over without copying them
+     */
+    QWord *SetFrameBuffer(QWord *buffer);
+    /*
+       Whether the frames starting from the next one are drawn. Skipped
+       frames still evaluate the sprites for the overflow flag and fetch
+       the background under sprite 0 for its hit, so that the emulation
+       stays identical, but compose no pixel and leave the buffer as is
+     */
+    void SetRenderFrame(bool render);
+    // Whether the current or last completed frame is being drawn
+    bool IsFrameRendered() const;
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
 
 private:
-    Ram &m_Ram;
-};    
+    Word ReadVram(DWord address);
+    void WriteVram(DWord address, Word value);
+    static DWord MirrorPalette(DWord address);
+
+    // Pattern table and nametable reads of the renderer, below $3F00
+    Word Fetch(DWord address) const
+    {
+        return m_ReadPages[address >> 10][address & (s_PageSize - 1)];
+    }
+
+    bool IsRendering() const;
+    void RaiseNmi();
+    void RenderScanline();
+    // Palette indices of the background pixels [first, last) of the scanline
+    void RenderBackground(std::array<Word, s_Width> &background, int first, int last);
+    /*
+       OAM indices of the sprites in range of the scanline in priority
+       order, the Y coordinates of the 64 entries are compared at once.
+       Stops at a ninth sprite, which sets the overflow flag
+     */
+    int EvaluateSprites(int height, std::array<Word, 9> &found) const;
+    void IncrementY();
+
+    // Registers
+    Word m_Control;
+    Word m_Mask;
+    Word m_Status;
+    Word m_OamAddress;
+    // PPUDATA reads are delayed through this buffer
+    Word m_ReadBuffer;
+
+    /*
+       Internal scroll registers
+
+       v: current VRAM address, t: temporary VRAM address, x: fine x
+       scroll and w: first/second write toggle shared by $2005 and $2006
+       The VRAM addresses are laid out as yyy NN YYYYY XXXXX
+     */
+    DWord m_V;
+    DWord m_T;
+    Word m_FineX;
+    bool m_WriteToggle;
+
+    int m_Scanline;
+    int m_Dot;
+    bool m_OddFrame;
+    bool m_FrameComplete;
+
+    // Dot at which the sprite 0 hit flag rises on the current scanline, -1 if none
+    int m_Sprite0HitDot;
+
+    std::array<Word, 256> m_Oam;
+    // 4 KiB to cover four-screen boards
+    std::array<Word, 0x1000> m_Nametables;
+    std::array<Word, 32> m_Palette;
+
+    // Latched from m_RenderNextFrame on the first visible scanline
+    bool m_RenderFrame;
+    bool m_RenderNextFrame;
+
+    std::array<QWord, s_Width * s_Height> m_InternalFrameBuffer;
+    QWord *m_FrameBuffer;
+
+    Mapper *m_Mapper;
+    Cpu *m_Cpu;
+    PerfCounters *m_PerfCounters;
+
+    /*
+       PPU address space
+
+       $0000-$3FFF as 16 pages of 1 KiB: the 8 pattern table pages point
+       into the CHR memory through the mapper banks, the 4 nametables and
+       their $3000 mirror into m_Nametables through the mirroring. Bank
+       switches and mirroring changes only move pointers. The palette
+       overlaps the end of the last page, the register accesses check for
+       it while the renderer never reaches it. Writes to CHR ROM have no
+       page and are dropped
+     */
+    static constexpr std::size_t s_PageSize = 0x0400;
+    static constexpr std::size_t s_PageCount = 16;
+
+    std::array<const Word *, s_PageCount> m_ReadPages;
+    std::array<Word *, s_PageCount> m_WritePages;
+};
 
 #endif
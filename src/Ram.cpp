@@ -1,18 +1,32 @@
 #include "Ram.hpp"
-#include <iostream>
-#include <stdexcept>
+#include "State.hpp"
+
+Ram::Ram()
+{
+    Clear();
+}
+
+void Ram::Clear()
+{
+    m_Data.fill(0x00);
+}
 
 Word &Ram::operator[](std::size_t index)
 {
-    try
-    {
-        return m_Data[index];
-    }
-    catch (const std::out_of_range &error)
-    {
-        std::cerr << error.what() << std::endl;
-        // Returning dummy value if an error occured
-        return m_Data[RamSize - 1];
-    }
+    return m_Data[index % RamSize];
+}
+
+Word *Ram::GetData()
+{
+    return m_Data.data();
 }
 
+void Ram::SaveState(StateWriter &writer) const
+{
+    writer.Write(m_Data);
+}
+
+void Ram::LoadState(StateReader &reader)
+{
+    reader.Read(m_Data);
+}
@@ -4,7 +4,11 @@
 #include "Types.hpp"
 #include <array>
 
-constexpr std::size_t RamSize = 256 * 256;
+class StateWriter;
+class StateReader;
+
+// Internal work RAM, mirrored every 2 KiB up to $1FFF
+constexpr std::size_t RamSize = 0x0800;
 
 class Ram
 {
@@ -13,6 +17,10 @@ public:
     void Clear();
 
     Word &operator[](std::size_t index);
+    Word *GetData();
+
+    void SaveState(StateWriter &writer) const;
+    void LoadState(StateReader &reader);
 
 private:
     std::array<Word, RamSize> m_Data;
@@ -0,0 +1,97 @@
+#include "RunAhead.hpp"
+#include "Cartridge.hpp"
+#include <chrono>
+#include <stdexcept>
+
+RunAhead::RunAhead(Nes &nes, int frames)
+    : m_Nes(nes), m_Frames(frames), m_Render(true)
+{
+    const Cartridge *cartridge = nes.GetCartridge();
+
+    if (!cartridge)
+    {
+        throw std::runtime_error("No rom loaded");
+    }
+
+    if (m_Frames > 0)
+    {
+        const std::vector<Word> &image = cartridge->GetImage();
+        m_Ahead.LoadRom(image.data(), image.size());
+
+        for (const CheatEngine::Cheat &cheat : nes.GetCheats())
+        {
+            m_Ahead.AddCheat(cheat);
+        }
+
+        // Only the main timeline is heard
+        m_Ahead.SetAudioEnabled(false);
+
+        m_State.resize(nes.GetStateSize());
+        // Its frames are replaced by the ones run ahead
+        m_Nes.SetRenderFrame(false);
+    }
+}
+
+RunAhead::~RunAhead()
+{
+    m_Nes.SetRenderFrame(true);
+}
+
+void RunAhead::SetInput(std::size_t port, Word buttons)
+{
+    m_Nes.SetInput(port, buttons);
+    m_Ahead.SetInput(port, buttons);
+}
+
+void RunAhead::SetRenderFrame(bool render)
+{
+    m_Render = render;
+
+    if (m_Frames == 0)
+    {
+        m_Nes.SetRenderFrame(render);
+    }
+}
+
+void RunAhead::StepFrame()
+{
+    using Clock = std::chrono::steady_clock;
+
+    Clock::time_point start = Clock::now();
+    m_Nes.StepFrame();
+    Clock::time_point stepped = Clock::now();
+
+    if (m_Frames > 0)
+    {
+        // Preallocated, a state is a few memcpy of the component fields
+        m_Nes.SaveState(m_State.data(), m_State.size());
+        m_Ahead.LoadSnapshot(m_State.data(), m_State.size());
+
+        for (int frame = 0; frame < m_Frames; frame++)
+        {
+            m_Ahead.SetRenderFrame(m_Render && frame == m_Frames - 1);
+            m_Ahead.StepFrame();
+        }
+    }
+
+    Clock::time_point done = Clock::now();
+
+    m_Stats.frames++;
+    m_Stats.mainSeconds += std::chrono::duration<double>(stepped - start).count();
+    m_Stats.extraSeconds += std::chrono::duration<double>(done - stepped).count();
+}
+
+Nes &RunAhead::GetPresented()
+{
+    return m_Frames > 0 ? m_Ahead : m_Nes;
+}
+
+int RunAhead::GetFrames() const
+{
+    return m_Frames;
+}
+
+const RunAhead::Stats &RunAhead::GetStats() const
+{
+    return m_Stats;
+}
@@ -0,0 +1,58 @@
+#ifndef RUNAHEAD_HPP
+#define RUNAHEAD_HPP
+
+#include "Nes.hpp"
+#include "Types.hpp"
+#include <cstdint>
+#include <vector>
+
+/*
+   Input latency reduction by emulating ahead
+
+   Games usually react to an input a frame or more after reading it. Each
+   frame the main instance is stepped as usual, then its state is copied
+   into a second instance which runs the given amount of frames further
+   with the same inputs; the frame shown is the one of that second
+   instance. The main timeline, and the sound it produces, is never
+   rewound so the run-ahead can not introduce audio glitches or desyncs.
+   Only the last frame run ahead is drawn, the others are never shown
+ */
+class RunAhead
+{
+public:
+    struct Stats
+    {
+        std::uint64_t frames = 0;
+        // Time spent stepping the main instance
+        double mainSeconds = 0.0;
+        // Time spent copying the state and running ahead
+        double extraSeconds = 0.0;
+    };
+
+    // The rom must already be loaded in the main instance
+    RunAhead(Nes &nes, int frames);
+    ~RunAhead();
+
+    RunAhead(const RunAhead &) = delete;
+    RunAhead &operator=(const RunAhead &) = delete;
+
+    void SetInput(std::size_t port, Word buttons);
+    // Whether the frame presented after the next step gets drawn
+    void SetRenderFrame(bool render);
+    void StepFrame();
+
+    // Instance holding the frame to present
+    Nes &GetPresented();
+    int GetFrames() const;
+    const Stats &GetStats() const;
+
+private:
+    Nes &m_Nes;
+    Nes m_Ahead;
+    int m_Frames;
+    bool m_Render;
+    std::vector<Word> m_State;
+    Stats m_Stats;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "SaveRam.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define NES_SAVE_MMAP 1
+#endif
+
+SaveRam::SaveRam(std::size_t size)
+    : m_Memory(size, 0x00), m_Data(m_Memory.data()), m_Size(size)
+{
+}
+
+SaveRam::~SaveRam()
+{
+    try
+    {
+        Close();
+    }
+    catch (const std::exception &)
+    {
+        // Nothing more can be done for the saves from a destructor
+    }
+}
+
+void SaveRam::Open(const std::string &path, bool shared)
+{
+    Close();
+
+    if (!shared)
+    {
+        // A missing file simply starts from the current content
+        std::ifstream file(path, std::ios::binary);
+        std::vector<Word> content(std::istreambuf_iterator<char>(file), (std::istreambuf_iterator<char>()));
+        std::copy_n(content.begin(), std::min(content.size(), m_Size), m_Memory.begin());
+        return;
+    }
+
+#ifdef NES_SAVE_MMAP
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    struct stat status;
+
+    if (fd < 0 || ::fstat(fd, &status) != 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+
+        throw std::runtime_error("Could not open save file '" + path + "'");
+    }
+
+    std::size_t existing = std::min<std::size_t>(status.st_size, m_Size);
+
+    // The mapping must not extend past the end of the file
+    if (existing < m_Size && ::ftruncate(fd, m_Size) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Could not resize save file '" + path + "'");
+    }
+
+    void *mapping = ::mmap(nullptr, m_Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map save file '" + path + "'");
+    }
+
+    m_Data = static_cast<Word *>(mapping);
+
+    // What the file does not cover yet comes from the current content
+    std::copy(m_Memory.begin() + existing, m_Memory.end(), m_Data + existing);
+#else
+    std::ifstream file(path, std::ios::binary);
+    std::vector<Word> content(std::istreambuf_iterator<char>(file), (std::istreambuf_iterator<char>()));
+    std::copy_n(content.begin(), std::min(content.size(), m_Size), m_Memory.begin());
+#endif
+
+    m_Path = path;
+}
+
+void SaveRam::Close()
+{
+    if (m_Path.empty())
+    {
+        return;
+    }
+
+#ifdef NES_SAVE_MMAP
+    std::copy(m_Data, m_Data + m_Size, m_Memory.begin());
+    ::munmap(m_Data, m_Size);
+    m_Data = m_Memory.data();
+    m_Path.clear();
+#else
+    std::string path = m_Path;
+    m_Path.clear();
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(m_Memory.data()), m_Memory.size());
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not write save file '" + path + "'");
+    }
+#endif
+}
+
+Word *SaveRam::GetData()
+{
+    return m_Data;
+}
+
+const Word *SaveRam::GetData() const
+{
+    return m_Data;
+}
+
+std::size_t SaveRam::GetSize() const
+{
+    return m_Size;
+}
+
+bool SaveRam::IsShared() const
+{
+    return !m_Path.empty();
+}
@@ -0,0 +1,51 @@
+#ifndef SAVERAM_HPP
+#define SAVERAM_HPP
+
+#include "Types.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+   Cartridge work RAM, optionally backed by a save file
+
+   A shared save file is mapped into memory so that the writes of the game
+   reach the file through the page cache, nothing is serialized or copied
+   per frame and the saves survive a crash. A private save file is only
+   read, the instance works on its own copy and never writes it back,
+   which suits the parallel instances that must not share their saves.
+   Without memory mapping support the shared file is written back on close
+ */
+class SaveRam
+{
+public:
+    SaveRam(std::size_t size);
+    ~SaveRam();
+
+    SaveRam(const SaveRam &) = delete;
+    SaveRam &operator=(const SaveRam &) = delete;
+
+    /*
+       Back the RAM with the file, created from the current content when
+       missing or too short. The data pointer changes, throws
+       std::runtime_error when the file can not be opened or mapped
+     */
+    void Open(const std::string &path, bool shared);
+    // Back to plain memory, the content is kept
+    void Close();
+
+    Word *GetData();
+    const Word *GetData() const;
+    std::size_t GetSize() const;
+    bool IsShared() const;
+
+private:
+    std::vector<Word> m_Memory;
+    Word *m_Data;
+    std::size_t m_Size;
+
+    // Shared file, mapped or to write back
+    std::string m_Path;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef STATE_HPP
+#define STATE_HPP
+
+#include "Types.hpp"
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+/*
+   Save state serialization
+
+   Components write their state field by field as raw bytes, the layout is
+   only meant to be read back by the same build. A writer without buffer
+   only measures the state size
+ */
+class StateWriter
+{
+public:
+    StateWriter(Word *data = nullptr, std::size_t size = 0)
+        : m_Data(data), m_Size(size), m_Offset(0)
+    {
+    }
+
+    void WriteBytes(const void *data, std::size_t size)
+    {
+        if (m_Data)
+        {
+            if (m_Offset + size > m_Size)
+            {
+                throw std::runtime_error("Save state buffer too small");
+            }
+
+            std::memcpy(m_Data + m_Offset, data, size);
+        }
+
+        m_Offset += size;
+    }
+
+    template <typename T> void Write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "State fields must be trivially copyable");
+        WriteBytes(&value, sizeof(T));
+    }
+
+    std::size_t GetSize() const
+    {
+        return m_Offset;
+    }
+
+private:
+    Word *m_Data;
+    std::size_t m_Size;
+    std::size_t m_Offset;
+};
+
+class StateReader
+{
+public:
+    StateReader(const Word *data, std::size_t size)
+        : m_Data(data), m_Size(size), m_Offset(0)
+    {
+    }
+
+    void ReadBytes(void *data, std::size_t size)
+    {
+        if (m_Offset + size > m_Size)
+        {
+            throw std::runtime_error("Truncated save state");
+        }
+
+        std::memcpy(data, m_Data + m_Offset, size);
+        m_Offset += size;
+    }
+
+    template <typename T> void Read(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "State fields must be trivially copyable");
+        ReadBytes(&value, sizeof(T));
+    }
+
+    std::size_t GetOffset() const
+    {
+        return m_Offset;
+    }
+
+private:
+    const Word *m_Data;
+    std::size_t m_Size;
+    std::size_t m_Offset;
+};
+
+#endif
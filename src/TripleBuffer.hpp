@@ -0,0 +1,70 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include "Types.hpp"
+#include <array>
+#include <atomic>
+
+/*
+   Lock-free hand-off of the latest value between two threads
+
+   The producer fills the back buffer then publishes it by swapping it with
+   the middle one, the consumer swaps the middle buffer with its front one
+   when a new value has been published since its last acquisition. Only
+   indices move, the buffers are never copied, and neither side waits:
+   unread values are simply replaced by newer ones
+ */
+template <typename T> class TripleBuffer
+{
+public:
+    TripleBuffer(const T &initial = T())
+        : m_Buffers{initial, initial, initial}, m_Back(0), m_Middle(1), m_Front(2)
+    {
+    }
+
+    // Producer side
+    T &GetBack()
+    {
+        return m_Buffers[m_Back];
+    }
+
+    void Publish()
+    {
+        m_Back = m_Middle.exchange(m_Back | FreshBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Consumer side, returns false when nothing new has been published
+    bool Acquire()
+    {
+        if (!(m_Middle.load(std::memory_order_relaxed) & FreshBit))
+        {
+            return false;
+        }
+
+        m_Front = m_Middle.exchange(m_Front, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    T &GetFront()
+    {
+        return m_Buffers[m_Front];
+    }
+
+    const T &GetFront() const
+    {
+        return m_Buffers[m_Front];
+    }
+
+private:
+    static constexpr Word IndexMask = 0x03;
+    static constexpr Word FreshBit = 0x04;
+
+    std::array<T, 3> m_Buffers;
+
+    Word m_Back;
+    // Index of the middle buffer and whether it holds an unread value
+    alignas(64) std::atomic<Word> m_Middle;
+    alignas(64) Word m_Front;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#include "nesemu.h"
+#include "Nes.hpp"
+#include <exception>
+#include <new>
+#include <string>
+
+static_assert(sizeof(QWord) == sizeof(uint32_t), "Frame pixels are exposed as uint32_t");
+
+struct nes_t
+{
+    Nes nes;
+    // Only written on failure so that the successful paths never allocate
+    std::string error;
+};
+
+namespace
+{
+template <typename Function> int Guard(nes_t *nes, Function &&function)
+{
+    if (!nes)
+    {
+        return NES_ERROR;
+    }
+
+    try
+    {
+        function();
+        return NES_OK;
+    }
+    catch (const std::exception &error)
+    {
+        nes->error = error.what();
+        return NES_ERROR;
+    }
+}
+} // namespace
+
+nes_t *nes_create(void)
+{
+    return new (std::nothrow) nes_t();
+}
+
+void nes_destroy(nes_t *nes)
+{
+    delete nes;
+}
+
+int nes_load_rom(nes_t *nes, const char *path)
+{
+    return Guard(nes, [&]() { nes->nes.LoadRom(path); });
+}
+
+int nes_load_rom_memory(nes_t *nes, const uint8_t *data, size_t size)
+{
+    return Guard(nes, [&]() { nes->nes.LoadRom(data, size); });
+}
+
+int nes_reset(nes_t *nes)
+{
+    return Guard(nes, [&]() { nes->nes.Reset(); });
+}
+
+int nes_open_save_file(nes_t *nes, const char *path, int shared)
+{
+    return Guard(nes, [&]() { nes->nes.OpenSaveFile(path ? path : "", shared != 0); });
+}
+
+int nes_step_frames(nes_t *nes, int frames)
+{
+    return Guard(nes, [&]() {
+        for (int frame = 0; frame < frames; frame++)
+        {
+            nes->nes.StepFrame();
+        }
+    });
+}
+
+int nes_step_frames_batch(nes_t *const *instances, const uint8_t *inputs, size_t count, int frames)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        nes_t *nes = instances[i];
+
+        int result = Guard(nes, [&]() {
+            if (inputs)
+            {
+                nes->nes.SetInput(0, inputs[i * 2]);
+                nes->nes.SetInput(1, inputs[i * 2 + 1]);
+            }
+
+            for (int frame = 0; frame < frames; frame++)
+            {
+                nes->nes.StepFrame();
+            }
+        });
+
+        if (result != NES_OK)
+        {
+            return result;
+        }
+    }
+
+    return NES_OK;
+}
+
+const uint32_t *nes_get_frame(const nes_t *nes)
+{
+    return nes ? nes->nes.GetFrameBuffer() : nullptr;
+}
+
+int nes_set_render_frame(nes_t *nes, int render)
+{
+    return Guard(nes, [&]() { nes->nes.SetRenderFrame(render != 0); });
+}
+
+int nes_set_input(nes_t *nes, int port, uint8_t buttons)
+{
+    return Guard(nes, [&]() { nes->nes.SetInput(port, buttons); });
+}
+
+int nes_add_cheat(nes_t *nes, const char *code)
+{
+    return Guard(nes, [&]() { nes->nes.AddCheat(code ? code : ""); });
+}
+
+int nes_clear_cheats(nes_t *nes)
+{
+    return Guard(nes, [&]() { nes->nes.ClearCheats(); });
+}
+
+int nes_set_audio_enabled(nes_t *nes, int enabled)
+{
+    return Guard(nes, [&]() { nes->nes.SetAudioEnabled(enabled != 0); });
+}
+
+double nes_audio_sample_rate(const nes_t *nes)
+{
+    return nes ? nes->nes.GetAudioSampleRate() : 0.0;
+}
+
+size_t nes_read_audio(nes_t *nes, int16_t *samples, size_t count)
+{
+    return nes ? nes->nes.ReadAudio(samples, count) : 0;
+}
+
+size_t nes_state_size(const nes_t *nes)
+{
+    return nes ? nes->nes.GetStateSize() : 0;
+}
+
+int nes_save_state_into(nes_t *nes, uint8_t *buffer, size_t size)
+{
+    if (!nes)
+    {
+        return NES_ERROR;
+    }
+
+    // The size is measured when the rom is loaded, checking it costs nothing
+    if (size < nes->nes.GetStateSize())
+    {
+        nes->error = "Save state buffer too small";
+        return NES_BUFFER_TOO_SMALL;
+    }
+
+    return Guard(nes, [&]() { nes->nes.SaveState(buffer, size); });
+}
+
+int nes_load_state_from(nes_t *nes, const uint8_t *buffer, size_t size)
+{
+    return Guard(nes, [&]() { nes->nes.LoadState(buffer, size); });
+}
+
+const char *nes_last_error(const nes_t *nes)
+{
+    return nes ? nes->error.c_str() : "Invalid instance";
+}
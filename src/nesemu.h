@@ -0,0 +1,95 @@
+#ifndef NESEMU_H
+#define NESEMU_H
+
+/*
+   C interface of the emulator core
+
+   Meant for foreign language hosts: every entry point is allocation free
+   once the rom is loaded, frames and states are exchanged through buffers
+   owned by the emulator or by the caller. Functions returning an int
+   return NES_OK on success, the message of the last failure is available
+   from nes_last_error
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(NESEMU_SHARED)
+#define NESEMU_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define NESEMU_API __attribute__((visibility("default")))
+#else
+#define NESEMU_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define NES_FRAME_WIDTH 256
+#define NES_FRAME_HEIGHT 240
+
+enum
+{
+    NES_OK = 0,
+    NES_ERROR = -1,
+    NES_BUFFER_TOO_SMALL = -2,
+};
+
+typedef struct nes_t nes_t;
+
+NESEMU_API nes_t *nes_create(void);
+NESEMU_API void nes_destroy(nes_t *nes);
+
+NESEMU_API int nes_load_rom(nes_t *nes, const char *path);
+NESEMU_API int nes_load_rom_memory(nes_t *nes, const uint8_t *data, size_t size);
+NESEMU_API int nes_reset(nes_t *nes);
+/*
+   Keep the cartridge work RAM in a save file, created when missing. A
+   shared file receives the saves as they happen, a private one is only read
+ */
+NESEMU_API int nes_open_save_file(nes_t *nes, const char *path, int shared);
+
+NESEMU_API int nes_step_frames(nes_t *nes, int frames);
+
+/*
+   Step count instances by the given amount of frames. When inputs is not
+   NULL it holds two controller states per instance which are applied first
+   Stops at the first failing instance and returns its error
+ */
+NESEMU_API int nes_step_frames_batch(nes_t *const *instances, const uint8_t *inputs, size_t count, int frames);
+
+/*
+   NES_FRAME_WIDTH * NES_FRAME_HEIGHT pixels in 0xAARRGGBB, the pointer
+   stays valid for the lifetime of the instance and the content is
+   updated by every step
+ */
+NESEMU_API const uint32_t *nes_get_frame(const nes_t *nes);
+// Whether the next steps draw their frames (default), skipped ones leave the frame untouched
+NESEMU_API int nes_set_render_frame(nes_t *nes, int render);
+
+// Buttons bits: A, B, Select, Start, Up, Down, Left, Right from the bit 0
+NESEMU_API int nes_set_input(nes_t *nes, int port, uint8_t buttons);
+
+// Game Genie code or raw AAAA:VV / AAAA?CC:VV ROM patch, active until cleared
+NESEMU_API int nes_add_cheat(nes_t *nes, const char *code);
+NESEMU_API int nes_clear_cheats(nes_t *nes);
+
+// Audio is enabled by default, disabling it skips the sound synthesis
+NESEMU_API int nes_set_audio_enabled(nes_t *nes, int enabled);
+NESEMU_API double nes_audio_sample_rate(const nes_t *nes);
+// Read up to count signed 16 bits mono samples, returns the amount read
+NESEMU_API size_t nes_read_audio(nes_t *nes, int16_t *samples, size_t count);
+
+NESEMU_API size_t nes_state_size(const nes_t *nes);
+NESEMU_API int nes_save_state_into(nes_t *nes, uint8_t *buffer, size_t size);
+NESEMU_API int nes_load_state_from(nes_t *nes, const uint8_t *buffer, size_t size);
+
+NESEMU_API const char *nes_last_error(const nes_t *nes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
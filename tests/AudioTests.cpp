@@ -0,0 +1,529 @@
+/*
+   Audio output tests, no sound card involved
+
+   nesemu-audio-tests ring          Ordering of the lock-free ring across two threads
+   nesemu-audio-tests resampler     Rate, pitch, gain and anti-aliasing of the resampler
+   nesemu-audio-tests ratecontrol   Fill level tracking against a drifting consumer clock
+   nesemu-audio-tests wav           Header and payload of the file sink
+   nesemu-audio-tests record        Y4M and WAV streams of the session recorder
+   nesemu-audio-tests noise         Noise channel state with and without sound synthesis
+   nesemu-audio-tests discard       Unbroken samples across frames re-emulated without output
+
+   Exits with 0 on success and 1 on the first failure
+ */
+
+#include "TestRom.hpp"
+#include "src/Apu/Apu.hpp"
+#include "src/Audio/AudioStream.hpp"
+#include "src/Audio/Resampler.hpp"
+#include "src/Audio/SampleRing.hpp"
+#include "src/Audio/WavWriter.hpp"
+#include "src/Dump/SessionRecorder.hpp"
+#include "src/Nes.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr double Pi = 3.14159265358979323846;
+constexpr double OutputRate = 48000.0;
+
+bool Check(bool condition, const std::string &message)
+{
+    if (!condition)
+    {
+        std::cerr << message << std::endl;
+    }
+
+    return condition;
+}
+
+std::vector<std::int16_t> Sine(double frequency, double rate, double amplitude, std::size_t count)
+{
+    std::vector<std::int16_t> samples(count);
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        samples[i] = static_cast<std::int16_t>(std::lround(amplitude * std::sin(2.0 * Pi * frequency * i / rate)));
+    }
+
+    return samples;
+}
+
+// Feed the input by chunks of one video frame like the emulation does
+std::vector<std::int16_t> Resample(Resampler &resampler, const std::vector<std::int16_t> &input)
+{
+    constexpr std::size_t Chunk = 931;
+    std::vector<std::int16_t> output;
+
+    for (std::size_t offset = 0; offset < input.size(); offset += Chunk)
+    {
+        std::size_t count = std::min(Chunk, input.size() - offset);
+        std::vector<std::int16_t> chunk(resampler.GetMaxOutput(count));
+        chunk.resize(resampler.Process(&input[offset], count, chunk.data(), chunk.size()));
+        output.insert(output.end(), chunk.begin(), chunk.end());
+    }
+
+    return output;
+}
+
+double Rms(const std::vector<std::int16_t> &samples, std::size_t first)
+{
+    double sum = 0.0;
+
+    for (std::size_t i = first; i < samples.size(); i++)
+    {
+        sum += static_cast<double>(samples[i]) * samples[i];
+    }
+
+    return std::sqrt(sum / (samples.size() - first));
+}
+
+int RunRing()
+{
+    constexpr std::size_t Total = 1'000'000;
+    SampleRing ring(1024);
+
+    std::thread producer([&ring]() {
+        std::int16_t chunk[97];
+        std::size_t sent = 0;
+
+        while (sent < Total)
+        {
+            std::size_t count = std::min<std::size_t>(std::size(chunk), Total - sent);
+
+            for (std::size_t i = 0; i < count; i++)
+            {
+                chunk[i] = static_cast<std::int16_t>(sent + i);
+            }
+
+            std::size_t written = ring.Write(chunk, count);
+            sent += written;
+
+            if (written == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::int16_t chunk[61];
+    std::size_t received = 0;
+    bool ordered = true;
+
+    while (received < Total)
+    {
+        std::size_t count = ring.Read(chunk, std::size(chunk));
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            ordered &= chunk[i] == static_cast<std::int16_t>(received + i);
+        }
+
+        received += count;
+
+        if (count == 0)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    producer.join();
+
+    return Check(ordered, "ring: samples out of order") && Check(ring.GetFill() == 0, "ring: not drained") ? 0 : 1;
+}
+
+int RunResampler()
+{
+    const double inputRate = Apu::s_DefaultSampleRate;
+    const std::size_t inputCount = static_cast<std::size_t>(inputRate);
+    bool ok = true;
+
+    {
+        Resampler resampler(inputRate, OutputRate);
+        std::vector<std::int16_t> output = Resample(resampler, Sine(1000.0, inputRate, 10000.0, inputCount));
+
+        // One second of input minus the filter latency
+        ok &= Check(std::fabs(output.size() - OutputRate) < Resampler::s_Taps, "resampler: wrong output count " +
+                                                                                   std::to_string(output.size()));
+
+        std::size_t first = Resampler::s_Taps;
+        std::size_t crossings = 0;
+
+        for (std::size_t i = first + 1; i < output.size(); i++)
+        {
+            crossings += (output[i - 1] < 0) != (output[i] < 0);
+        }
+
+        double frequency = crossings / 2.0 / ((output.size() - first) / OutputRate);
+        ok &= Check(std::fabs(frequency - 1000.0) < 2.0, "resampler: pitch " + std::to_string(frequency) + " Hz");
+
+        double rms = Rms(output, first);
+        ok &= Check(std::fabs(rms - 10000.0 / std::sqrt(2.0)) < 150.0, "resampler: gain rms " + std::to_string(rms));
+    }
+
+    {
+        // Above the output Nyquist frequency, must not fold back
+        Resampler resampler(inputRate, OutputRate);
+        std::vector<std::int16_t> output = Resample(resampler, Sine(27000.0, inputRate, 10000.0, inputCount));
+
+        double rms = Rms(output, Resampler::s_Taps);
+        ok &= Check(rms < 10000.0 / std::sqrt(2.0) * 0.01, "resampler: aliasing rms " + std::to_string(rms));
+    }
+
+    return ok ? 0 : 1;
+}
+
+int RunRateControl()
+{
+    constexpr double FrameRate = 60.0988;
+    constexpr std::size_t Capacity = 4096;
+    // The device plays 0.3% faster than the emulation produces
+    constexpr double DeviceRate = OutputRate * 1.003;
+    constexpr int Frames = 60 * 120;
+
+    const double inputRate = Apu::s_DefaultSampleRate;
+    AudioStream stream(inputRate, OutputRate, Capacity);
+    std::vector<std::int16_t> sine = Sine(440.0, inputRate, 8000.0, static_cast<std::size_t>(inputRate));
+    std::vector<std::int16_t> pulled(4096);
+
+    double produced = 0.0;
+    double consumed = 0.0;
+    std::size_t position = 0;
+    std::size_t underruns = 0;
+    std::size_t lowest = Capacity;
+    std::size_t highest = 0;
+
+    for (int frame = 0; frame < Frames; frame++)
+    {
+        produced += inputRate / FrameRate;
+        std::size_t count = static_cast<std::size_t>(produced);
+        produced -= count;
+
+        for (std::size_t pushed = 0; pushed < count;)
+        {
+            std::size_t chunk = std::min(count - pushed, sine.size() - position);
+            stream.Push(&sine[position], chunk);
+            position = (position + chunk) % sine.size();
+            pushed += chunk;
+        }
+
+        consumed += DeviceRate / FrameRate;
+        std::size_t wanted = static_cast<std::size_t>(consumed);
+        consumed -= wanted;
+
+        std::size_t got = stream.Pull(pulled.data(), wanted);
+
+        // The second half must be steady
+        if (frame >= Frames / 2)
+        {
+            underruns += got < wanted;
+            lowest = std::min(lowest, stream.GetFill());
+            highest = std::max(highest, stream.GetFill());
+        }
+    }
+
+    bool ok = Check(underruns == 0, "ratecontrol: " + std::to_string(underruns) + " underruns");
+    ok &= Check(lowest > Capacity / 20 && highest < Capacity * 3 / 4,
+                "ratecontrol: fill between " + std::to_string(lowest) + " and " + std::to_string(highest));
+    ok &= Check(std::fabs(stream.GetRatioAdjust() - 1.003) < 0.001,
+                "ratecontrol: ratio adjust " + std::to_string(stream.GetRatioAdjust()));
+
+    return ok ? 0 : 1;
+}
+
+int RunWav()
+{
+    const std::string path = "nesemu-audio-test.wav";
+    std::vector<std::int16_t> samples = Sine(440.0, OutputRate, 1000.0, 1000);
+
+    {
+        WavWriter writer(path, 48000);
+        writer.Write(samples.data(), 600);
+        writer.Write(samples.data() + 600, 400);
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(path.c_str());
+
+    auto read32 = [&bytes](std::size_t offset) {
+        return bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16) | (bytes[offset + 3] << 24);
+    };
+
+    if (!Check(bytes.size() == 44 + 2000, "wav: file size " + std::to_string(bytes.size())))
+    {
+        return 1;
+    }
+
+    bool ok = Check(std::string(bytes.begin(), bytes.begin() + 4) == "RIFF", "wav: missing RIFF tag");
+    ok &= Check(read32(4) == 36 + 2000, "wav: wrong RIFF size");
+    ok &= Check(read32(24) == 48000, "wav: wrong sample rate");
+    ok &= Check(read32(40) == 2000, "wav: wrong data size");
+
+    for (std::size_t i = 0; i < samples.size() && ok; i++)
+    {
+        std::int16_t sample = static_cast<std::int16_t>(bytes[44 + i * 2] | (bytes[45 + i * 2] << 8));
+        ok &= Check(sample == samples[i], "wav: sample " + std::to_string(i) + " differs");
+    }
+
+    return ok ? 0 : 1;
+}
+
+int RunRecord()
+{
+    const std::string video = "nesemu-record-test.y4m";
+    const std::string audio = "nesemu-record-test.wav";
+    constexpr int Frames = 50;
+    constexpr std::size_t SamplesPerFrame = 930;
+    constexpr std::size_t Pixels = SessionRecorder::s_Width * SessionRecorder::s_Height;
+    const std::string header = "YUV4MPEG2 W256 H240 F39375000:655171 Ip A8:7 C420jpeg\n";
+
+    std::vector<std::int16_t> samples = Sine(440.0, 55930.0, 1000.0, Frames * SamplesPerFrame);
+    std::vector<QWord> white(Pixels, 0xFFFFFFFF);
+    std::vector<QWord> red(Pixels, 0xFFFF0000);
+
+    {
+        // Few slots so that the pushes have to wait for the writer now and then
+        SessionRecorder recorder(video, audio, 55930, true, 2);
+
+        for (int frame = 0; frame < Frames; frame++)
+        {
+            recorder.PushFrame(frame % 2 ? red.data() : white.data(), &samples[frame * SamplesPerFrame],
+                               SamplesPerFrame);
+        }
+
+        recorder.Close();
+
+        if (!Check(recorder.GetFrameCount() == Frames, "record: frame count"))
+        {
+            return 1;
+        }
+    }
+
+    auto load = [](const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        file.close();
+        std::remove(path.c_str());
+        return bytes;
+    };
+
+    std::vector<unsigned char> y4m = load(video);
+    std::vector<unsigned char> wav = load(audio);
+    const std::size_t frameSize = 6 + Pixels * 3 / 2;
+
+    bool ok = Check(y4m.size() == header.size() + Frames * frameSize, "record: y4m size " + std::to_string(y4m.size()));
+    ok &= Check(wav.size() == 44 + Frames * SamplesPerFrame * 2, "record: wav size " + std::to_string(wav.size()));
+
+    if (!ok)
+    {
+        return 1;
+    }
+
+    ok &= Check(std::string(y4m.begin(), y4m.begin() + header.size()) == header, "record: y4m header");
+
+    for (int frame = 0; frame < Frames && ok; frame++)
+    {
+        const unsigned char *data = &y4m[header.size() + frame * frameSize];
+        ok &= Check(std::string(data, data + 6) == "FRAME\n", "record: frame " + std::to_string(frame) + " marker");
+
+        // Full range BT.601 of white and pure red
+        int y = frame % 2 ? 76 : 255, cb = frame % 2 ? 85 : 128, cr = frame % 2 ? 255 : 128;
+        data += 6;
+        ok &= Check(data[0] == y && data[Pixels - 1] == y, "record: frame " + std::to_string(frame) + " luma");
+        ok &= Check(data[Pixels] == cb && data[Pixels * 5 / 4] == cr,
+                    "record: frame " + std::to_string(frame) + " chroma " + std::to_string(data[Pixels]) + " " +
+                        std::to_string(data[Pixels * 5 / 4]));
+    }
+
+    auto read32 = [&wav](std::size_t offset) {
+        return wav[offset] | (wav[offset + 1] << 8) | (wav[offset + 2] << 16) | (wav[offset + 3] << 24);
+    };
+
+    ok &= Check(read32(4) == static_cast<int>(36 + samples.size() * 2), "record: wrong RIFF size");
+    ok &= Check(read32(24) == 55930, "record: wrong sample rate");
+    ok &= Check(read32(40) == static_cast<int>(samples.size() * 2), "record: wrong data size");
+
+    for (std::size_t i = 0; i < samples.size() && ok; i++)
+    {
+        std::int16_t sample = static_cast<std::int16_t>(wav[44 + i * 2] | (wav[45 + i * 2] << 8));
+        ok &= Check(sample == samples[i], "record: sample " + std::to_string(i) + " differs");
+    }
+
+    return ok ? 0 : 1;
+}
+
+// Audible noise switching its mode and period every 1280 cycles, so that both taps run at every rate
+std::vector<Word> BuildNoiseRom()
+{
+    const std::vector<Word> program = {
+        0xA9, 0x08,       // $8000 LDA #$08
+        0x8D, 0x15, 0x40, // $8002 STA $4015
+        0xA9, 0x3F,       // $8005 LDA #$3F
+        0x8D, 0x0C, 0x40, // $8007 STA $400C
+        0xA9, 0x08,       // $800A LDA #$08
+        0x8D, 0x0F, 0x40, // $800C STA $400F
+        0xE8,             // $800F INX
+        0x8A,             // $8010 TXA
+        0x8D, 0x0E, 0x40, // $8011 STA $400E
+        0x88,             // $8014 DEY
+        0xD0, 0xFD,       // $8015 BNE $8014
+        0x4C, 0x0F, 0x80, // $8017 JMP $800F
+    };
+    return BuildRom(program);
+}
+
+int RunNoise()
+{
+    const std::vector<Word> image = BuildNoiseRom();
+    constexpr int Frames = 120;
+
+    // The headless console clocks the shift register in bulk, the other one reload by reload
+    Nes audible;
+    Nes headless;
+    headless.SetAudioEnabled(false);
+    audible.LoadRom(image.data(), image.size());
+    headless.LoadRom(image.data(), image.size());
+
+    std::vector<std::int16_t> samples(4096);
+    bool sound = false;
+    bool ok = true;
+
+    for (int frame = 0; frame < Frames && ok; frame++)
+    {
+        audible.StepFrame();
+        headless.StepFrame();
+
+        for (std::size_t count; (count = audible.ReadAudio(samples.data(), samples.size())) != 0;)
+        {
+            sound |= std::any_of(samples.begin(), samples.begin() + count, [](std::int16_t s) { return s != 0; });
+        }
+
+        ok &= Check(audible.SaveState() == headless.SaveState(),
+                    "noise: states differ at frame " + std::to_string(frame));
+    }
+
+    ok &= Check(sound, "noise: no sound produced");
+    return ok ? 0 : 1;
+}
+
+int RunDiscard()
+{
+    const std::vector<Word> image = BuildNoiseRom();
+    constexpr int Frames = 20;
+    constexpr int Rollback = 5;
+
+    auto drain = [](Nes &nes, std::vector<std::int16_t> &output) {
+        std::int16_t samples[1024];
+
+        for (std::size_t count; (count = nes.ReadAudio(samples, std::size(samples))) != 0;)
+        {
+            output.insert(output.end(), samples, samples + count);
+        }
+    };
+
+    Nes reference;
+    reference.LoadRom(image.data(), image.size());
+    std::vector<std::int16_t> expected;
+
+    for (int frame = 0; frame < Frames; frame++)
+    {
+        reference.StepFrame();
+        drain(reference, expected);
+    }
+
+    // Same frames, halfway the last ones are re-emulated as a rollback does
+    Nes nes;
+    nes.LoadRom(image.data(), image.size());
+    std::vector<std::int16_t> samples;
+    std::vector<Word> state;
+
+    for (int frame = 0; frame < Frames; frame++)
+    {
+        if (frame == Frames / 2 - Rollback)
+        {
+            state = nes.SaveState();
+        }
+
+        if (frame == Frames / 2)
+        {
+            nes.SetAudioDiscarded(true);
+            nes.LoadSnapshot(state.data(), state.size());
+
+            for (int past = 0; past < Rollback; past++)
+            {
+                nes.StepFrame();
+            }
+
+            nes.SetAudioDiscarded(false);
+        }
+
+        nes.StepFrame();
+
+        // The samples of the frames just before the rollback are still pending when it happens
+        if (frame < Frames / 2 - 3 || frame >= Frames / 2)
+        {
+            drain(nes, samples);
+        }
+    }
+
+    bool ok = Check(samples.size() == expected.size(), "discard: " + std::to_string(samples.size()) + " samples, " +
+                                                             std::to_string(expected.size()) + " expected");
+    ok &= Check(samples == expected, "discard: samples differ");
+    return ok ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "";
+
+    try
+    {
+        if (command == "ring")
+        {
+            return RunRing();
+        }
+        if (command == "resampler")
+        {
+            return RunResampler();
+        }
+        if (command == "ratecontrol")
+        {
+            return RunRateControl();
+        }
+        if (command == "wav")
+        {
+            return RunWav();
+        }
+        if (command == "record")
+        {
+            return RunRecord();
+        }
+        if (command == "noise")
+        {
+            return RunNoise();
+        }
+        if (command == "discard")
+        {
+            return RunDiscard();
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "usage: nesemu-audio-tests [ring | resampler | ratecontrol | wav | record | noise | discard]" << std::endl;
+    return 2;
+}
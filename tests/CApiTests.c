@@ -0,0 +1,205 @@
+/*
+   C interface checks
+
+   nesemu-capi-tests
+
+   Built as C so that nesemu.h stays free of C++ constructs. Drives a
+   built-in rom through every group of entry points, the error codes and
+   the last error message included. Exits with 0 on success and 1 on
+   failures
+ */
+
+#include "src/nesemu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int s_Failures = 0;
+
+static void Check(int condition, const char *what)
+{
+    if (!condition)
+    {
+        printf("FAIL %s\n", what);
+        s_Failures++;
+    }
+}
+
+/*
+   NROM image counting the loop iterations in $00-$01 and storing the
+   buttons of the first pad in $02, the state changes every frame
+ */
+static uint8_t *BuildRom(size_t *size)
+{
+    static const uint8_t program[] = {
+        0xE6, 0x00,       /* $8000 INC $00 */
+        0xD0, 0x02,       /* $8002 BNE $8006 */
+        0xE6, 0x01,       /* $8004 INC $01 */
+        0xA9, 0x01,       /* $8006 LDA #$01 */
+        0x8D, 0x16, 0x40, /* $8008 STA $4016 */
+        0xA9, 0x00,       /* $800B LDA #$00 */
+        0x8D, 0x16, 0x40, /* $800D STA $4016 */
+        0xAD, 0x16, 0x40, /* $8010 LDA $4016 */
+        0x85, 0x02,       /* $8013 STA $02 */
+        0x4C, 0x00, 0x80, /* $8015 JMP $8000 */
+    };
+    static const uint8_t vectors[] = {0x00, 0x80, 0x00, 0x80, 0x00, 0x80};
+    static const uint8_t header[] = {'N', 'E', 'S', 0x1A, 0x01, 0x01, 0x00, 0x00};
+
+    size_t prgSize = 0x4000;
+    uint8_t *image;
+
+    *size = 16 + prgSize + 0x2000;
+    image = (uint8_t *)calloc(*size, 1);
+
+    if (image)
+    {
+        memcpy(image, header, sizeof(header));
+        memcpy(image + 16, program, sizeof(program));
+        memcpy(image + 16 + prgSize - sizeof(vectors), vectors, sizeof(vectors));
+    }
+
+    return image;
+}
+
+static void CheckInvalidInstance(void)
+{
+    uint8_t buffer[16];
+    nes_t *instances[1] = {NULL};
+
+    Check(nes_step_frames(NULL, 1) == NES_ERROR, "NULL instance step");
+    Check(nes_set_input(NULL, 0, 0x01) == NES_ERROR, "NULL instance input");
+    Check(nes_save_state_into(NULL, buffer, sizeof(buffer)) == NES_ERROR, "NULL instance save");
+    Check(nes_load_state_from(NULL, buffer, sizeof(buffer)) == NES_ERROR, "NULL instance load");
+    Check(nes_step_frames_batch(instances, NULL, 1, 1) == NES_ERROR, "NULL instance in a batch");
+    Check(nes_state_size(NULL) == 0 && nes_get_frame(NULL) == NULL, "NULL instance queries");
+    Check(strcmp(nes_last_error(NULL), "Invalid instance") == 0, "NULL instance error message");
+}
+
+static void CheckLoading(nes_t *nes, const uint8_t *image, size_t size)
+{
+    Check(nes_step_frames(nes, 1) == NES_ERROR && strlen(nes_last_error(nes)) > 0, "step without rom");
+    Check(nes_load_rom(nes, "/nonexistent/rom.nes") == NES_ERROR, "missing rom file");
+    Check(nes_load_rom_memory(nes, image, 8) == NES_ERROR && strlen(nes_last_error(nes)) > 0, "truncated image");
+    Check(nes_load_rom_memory(nes, image, size) == NES_OK, "rom loaded");
+    Check(nes_step_frames(nes, 10) == NES_OK, "frames stepped");
+    Check(nes_get_frame(nes) != NULL, "frame buffer");
+    Check(nes_set_input(nes, 2, 0x00) == NES_ERROR, "invalid port");
+}
+
+static void CheckBatch(const uint8_t *image, size_t size)
+{
+    nes_t *instances[2];
+    const uint8_t inputs[4] = {0x08, 0x00, 0x08, 0x00};
+    size_t stateSize;
+    uint8_t *states[2];
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        instances[i] = nes_create();
+        Check(instances[i] && nes_load_rom_memory(instances[i], image, size) == NES_OK, "batch instance loaded");
+    }
+
+    if (!instances[0] || !instances[1])
+    {
+        return;
+    }
+
+    Check(nes_step_frames_batch(instances, inputs, 2, 5) == NES_OK, "batch stepped");
+
+    /* The same inputs lead to the same states */
+    stateSize = nes_state_size(instances[0]);
+    states[0] = (uint8_t *)malloc(stateSize);
+    states[1] = (uint8_t *)malloc(stateSize);
+
+    if (states[0] && states[1])
+    {
+        Check(nes_save_state_into(instances[0], states[0], stateSize) == NES_OK &&
+                  nes_save_state_into(instances[1], states[1], stateSize) == NES_OK,
+              "batch states saved");
+        Check(memcmp(states[0], states[1], stateSize) == 0, "batch instances identical");
+    }
+
+    free(states[0]);
+    free(states[1]);
+    nes_destroy(instances[0]);
+    nes_destroy(instances[1]);
+}
+
+static void CheckStates(nes_t *nes)
+{
+    size_t size = nes_state_size(nes);
+    uint8_t *saved = (uint8_t *)malloc(size);
+    uint8_t *expected = (uint8_t *)malloc(size);
+    uint8_t *actual = (uint8_t *)malloc(size);
+    uint8_t *corrupt = (uint8_t *)malloc(size);
+
+    if (!saved || !expected || !actual || !corrupt)
+    {
+        Check(0, "state buffers allocated");
+    }
+    else
+    {
+        Check(size > 0, "state size");
+        Check(nes_save_state_into(nes, saved, size - 1) == NES_BUFFER_TOO_SMALL &&
+                  strlen(nes_last_error(nes)) > 0,
+              "undersized buffer rejected");
+
+        /* Replaying from a saved state reaches the same state */
+        Check(nes_save_state_into(nes, saved, size) == NES_OK, "state saved");
+        Check(nes_set_input(nes, 0, 0x01) == NES_OK && nes_step_frames(nes, 5) == NES_OK, "frames after save");
+        Check(nes_save_state_into(nes, expected, size) == NES_OK, "state after the frames saved");
+        /* The buttons are part of the state, pressed again like a player would */
+        Check(nes_load_state_from(nes, saved, size) == NES_OK, "state loaded");
+        Check(nes_set_input(nes, 0, 0x01) == NES_OK && nes_step_frames(nes, 5) == NES_OK, "frames after load");
+        Check(nes_save_state_into(nes, actual, size) == NES_OK && memcmp(expected, actual, size) == 0,
+              "replay identical");
+
+        /* Rejected states leave the instance as it was */
+        memcpy(corrupt, saved, size);
+        corrupt[0] ^= 0xFF;
+        Check(nes_load_state_from(nes, corrupt, size) == NES_ERROR && strlen(nes_last_error(nes)) > 0,
+              "wrong magic rejected");
+        Check(nes_load_state_from(nes, saved, size - 1) == NES_ERROR, "truncated state rejected");
+
+        /* Header intact, content garbage */
+        memcpy(corrupt, saved, size);
+        memset(corrupt + 8, 0xFF, size - 8);
+        Check(nes_load_state_from(nes, corrupt, size) == NES_ERROR, "corrupt state rejected");
+
+        Check(nes_save_state_into(nes, actual, size) == NES_OK && memcmp(expected, actual, size) == 0,
+              "failed loads left the state untouched");
+        Check(nes_step_frames(nes, 1) == NES_OK, "still running");
+    }
+
+    free(saved);
+    free(expected);
+    free(actual);
+    free(corrupt);
+}
+
+int main(void)
+{
+    size_t size;
+    uint8_t *image = BuildRom(&size);
+    nes_t *nes = nes_create();
+
+    if (!image || !nes)
+    {
+        printf("FAIL setup\n");
+        return 1;
+    }
+
+    CheckInvalidInstance();
+    Check(nes_set_audio_enabled(nes, 0) == NES_OK, "audio disabled");
+    CheckLoading(nes, image, size);
+    CheckBatch(image, size);
+    CheckStates(nes);
+
+    nes_destroy(nes);
+    free(image);
+
+    printf("%s\n", s_Failures == 0 ? "C API checks passed" : "C API checks failed");
+    return s_Failures == 0 ? 0 : 1;
+}
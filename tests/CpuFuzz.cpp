@@ -0,0 +1,343 @@
+/*
+   Differential fuzzing of the CPU core against ReferenceCpu
+
+   nesemu-cpu-fuzz random <count> [seed]   Generated inputs, the corpus run by CTest
+   nesemu-cpu-fuzz <file>...               Replay inputs, such as the crashes found by libFuzzer
+
+   Configured with NES_LIBFUZZER the target is a libFuzzer entry point
+   instead, run it as `nesemu-cpu-fuzz [corpus directory] [libFuzzer options]`
+
+   An input is the initial registers followed by the memory image: A, X,
+   Y, SP, P, PC (little endian) and the amount of instructions to run,
+   the rest is repeated over the whole 64 KiB address space. After every
+   instruction the registers, the cycles and the memory writes of both
+   cores must match. The input stops at the first opcode the reference
+   does not support.
+   The random mode exits with 0 when everything matches, 1 on the first
+   divergence after printing the input
+ */
+
+#include "ReferenceCpu.hpp"
+#include "src/MemoryMap.hpp"
+#include "src/Cpu/Cpu.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t HeaderSize = 8;
+
+struct MemoryWrite
+{
+    DWord address;
+    Word value;
+
+    bool operator==(const MemoryWrite &other) const
+    {
+        return address == other.address && value == other.value;
+    }
+};
+
+// Flat memory behind the handler so that every write of the core is seen
+struct CoreMachine : MemoryHandler
+{
+    std::array<Word, 0x10000> ram{};
+    std::vector<MemoryWrite> writes;
+    MemoryMap memory{*this};
+    Cpu cpu{memory};
+
+    Word Read(DWord address) override
+    {
+        return ram[address];
+    }
+
+    void Write(DWord address, Word value) override
+    {
+        ram[address] = value;
+        writes.push_back({address, value});
+    }
+};
+
+struct ReferenceMachine : ReferenceCpu::Bus
+{
+    std::array<Word, 0x10000> ram{};
+    std::vector<MemoryWrite> writes;
+    ReferenceCpu cpu{*this};
+
+    Word Read(DWord address) override
+    {
+        return ram[address];
+    }
+
+    void Write(DWord address, Word value, bool dummy) override
+    {
+        ram[address] = value;
+
+        if (!dummy)
+        {
+            writes.push_back({address, value});
+        }
+    }
+};
+
+std::string Hex(unsigned value, int digits)
+{
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+    return buffer;
+}
+
+std::string FormatRegisters(const Cpu::Registers &registers)
+{
+    std::ostringstream stream;
+    stream << "PC:" << Hex(registers.PC, 4) << " A:" << Hex(registers.A, 2) << " X:" << Hex(registers.X, 2)
+           << " Y:" << Hex(registers.Y, 2) << " P:" << Hex(registers.P, 2) << " SP:" << Hex(registers.SP, 2);
+    return stream.str();
+}
+
+std::string FormatWrites(const std::vector<MemoryWrite> &writes)
+{
+    std::string text;
+
+    for (const MemoryWrite &write : writes)
+    {
+        text += " $" + Hex(write.address, 4) + "=" + Hex(write.value, 2);
+    }
+
+    return text.empty() ? " none" : text;
+}
+
+bool SameRegisters(const Cpu::Registers &a, const Cpu::Registers &b)
+{
+    return a.PC == b.PC && a.SP == b.SP && a.A == b.A && a.X == b.X && a.Y == b.Y && a.P == b.P;
+}
+
+/*
+   Run the input on both cores, returns an empty string when they agree
+   and the description of the first divergence otherwise
+ */
+std::string RunInput(const std::uint8_t *data, std::size_t size)
+{
+    if (size < HeaderSize)
+    {
+        return {};
+    }
+
+    // Large enough to be reused across the inputs of a run
+    static CoreMachine s_Core;
+    static ReferenceMachine s_Reference;
+
+    const std::uint8_t *image = data + HeaderSize;
+    std::size_t imageSize = size - HeaderSize;
+
+    if (imageSize == 0)
+    {
+        s_Core.ram.fill(0x00);
+    }
+    else
+    {
+        // Repeat the image by doubling what is already in place
+        std::size_t filled = std::min(imageSize, s_Core.ram.size());
+        std::memcpy(s_Core.ram.data(), image, filled);
+
+        while (filled < s_Core.ram.size())
+        {
+            std::size_t copied = std::min(filled, s_Core.ram.size() - filled);
+            std::memcpy(s_Core.ram.data() + filled, s_Core.ram.data(), copied);
+            filled += copied;
+        }
+    }
+
+    s_Reference.ram = s_Core.ram;
+
+    // B and the unused flag do not exist in the register
+    Cpu::Registers registers = {static_cast<DWord>(data[5] | data[6] << 8), data[3], data[0], data[1], data[2],
+                                static_cast<Word>((data[4] | 0x20) & ~0x10)};
+    s_Core.cpu.SetRegisters(registers);
+    s_Reference.cpu.SetRegisters(registers);
+
+    for (int step = 0; step < data[7]; step++)
+    {
+        Cpu::Registers before = s_Core.cpu.GetRegisters();
+        Word opcode = s_Core.ram[before.PC];
+
+        if (!ReferenceCpu::IsSupported(opcode))
+        {
+            break;
+        }
+
+        s_Core.writes.clear();
+        s_Reference.writes.clear();
+
+        QWord cycles = s_Core.cpu.Step();
+        QWord expectedCycles = s_Reference.cpu.Step();
+        Cpu::Registers after = s_Core.cpu.GetRegisters();
+        Cpu::Registers expected = s_Reference.cpu.GetRegisters();
+
+        std::string divergence;
+
+        if (!SameRegisters(after, expected))
+        {
+            divergence = "registers";
+        }
+        else if (cycles != expectedCycles)
+        {
+            divergence = "cycles " + std::to_string(cycles) + " instead of " + std::to_string(expectedCycles);
+        }
+        else if (s_Core.writes != s_Reference.writes)
+        {
+            divergence = "writes";
+        }
+
+        if (!divergence.empty())
+        {
+            return divergence + " after " + s_Core.cpu.GetMnemonic(opcode) + " ($" + Hex(opcode, 2) + ", " +
+                   Cpu::GetAddressingName(s_Core.cpu.GetAddressing(opcode)) + ") at step " + std::to_string(step) +
+                   "\n  before    " + FormatRegisters(before) + "\n  expected  " + FormatRegisters(expected) +
+                   " writes" + FormatWrites(s_Reference.writes) + "\n  got       " + FormatRegisters(after) +
+                   " writes" + FormatWrites(s_Core.writes);
+        }
+    }
+
+    return {};
+}
+
+#ifndef NES_LIBFUZZER
+std::string FormatInput(const std::vector<std::uint8_t> &input)
+{
+    std::string text;
+
+    for (std::uint8_t byte : input)
+    {
+        text += Hex(byte, 2);
+    }
+
+    return text;
+}
+
+/*
+   Inputs biased towards the corners where the cores tend to disagree:
+   pointers and addresses close to page boundaries, the top of the address
+   space and the stack wrapping
+ */
+std::vector<std::uint8_t> GenerateInput(std::mt19937 &random)
+{
+    static const std::uint8_t s_Interesting[] = {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF};
+
+    std::vector<std::uint8_t> input(HeaderSize + 1 + random() % 1024);
+    bool edges = random() % 4 == 0;
+
+    for (std::uint8_t &byte : input)
+    {
+        byte = edges && random() % 3 == 0 ? s_Interesting[random() % sizeof(s_Interesting)] : random();
+    }
+
+    input[7] = 1 + random() % 64;
+    return input;
+}
+
+int RunRandom(unsigned long count, unsigned long seed)
+{
+    // Both sides must agree on what can be compared
+    CoreMachine machine;
+
+    for (int opcode = 0; opcode < 256; opcode++)
+    {
+        bool implemented = std::strcmp(machine.cpu.GetMnemonic(opcode), "ILL") != 0;
+
+        if (implemented != ReferenceCpu::IsSupported(opcode))
+        {
+            std::cerr << "opcode $" << Hex(opcode, 2) << " is not supported by both cores" << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937 random(seed);
+
+    for (unsigned long i = 0; i < count; i++)
+    {
+        std::vector<std::uint8_t> input = GenerateInput(random);
+        std::string divergence = RunInput(input.data(), input.size());
+
+        if (!divergence.empty())
+        {
+            std::cerr << "input " << i << ": " << divergence << "\n  input     " << FormatInput(input) << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << count << " inputs, no divergence" << std::endl;
+    return 0;
+}
+
+int RunFiles(int count, char **paths)
+{
+    int failures = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        std::ifstream file(paths[i], std::ios::binary);
+
+        if (!file)
+        {
+            std::cerr << "Could not open '" << paths[i] << "'" << std::endl;
+            return 2;
+        }
+
+        std::vector<std::uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::string divergence = RunInput(input.data(), input.size());
+
+        if (!divergence.empty())
+        {
+            std::cerr << paths[i] << ": " << divergence << std::endl;
+            failures++;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
+#endif
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data, std::size_t size)
+{
+    std::string divergence = RunInput(data, size);
+
+    if (!divergence.empty())
+    {
+        std::cerr << divergence << std::endl;
+        std::abort();
+    }
+
+    return 0;
+}
+
+#ifndef NES_LIBFUZZER
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "";
+
+    if (command == "random" && argc >= 3)
+    {
+        return RunRandom(std::strtoul(argv[2], nullptr, 10), argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1);
+    }
+    if (argc > 1 && command != "random")
+    {
+        return RunFiles(argc - 1, argv + 1);
+    }
+
+    std::cerr << "usage: nesemu-cpu-fuzz [random <count> [seed] | <file>...]" << std::endl;
+    return 2;
+}
+#endif
@@ -0,0 +1,1608 @@
+/*
+   CPU conformance runner
+
+   nesemu-tests builtin                 Hand assembled programs targeting known pitfalls
+   nesemu-tests nestest <rom> <log>     Instruction level comparison against a golden trace
+   nesemu-tests blargg <rom>            Result reported by blargg's test roms at $6000
+   nesemu-tests debugger                Breakpoints, watchpoints and stepping on a built-in rom
+   nesemu-tests cheats                  Game Genie decoding and ROM patches on a built-in rom
+   nesemu-tests saves                   Battery RAM kept in shared and private save files
+   nesemu-tests rollback [--timing]     Two rollback netplay peers over a lossy loopback, --timing also
+                                        requires 8 re-emulated frames to fit in a 60 Hz frame
+   nesemu-tests codecache               Pre-decoded code against the interpreter on a built-in rom
+   nesemu-tests interrupts              NMI and IRQ latency, I flag delays included
+   nesemu-tests profiler                Routine attribution of the profiler across calls and interrupts
+   nesemu-tests movie                   Input movies saved, loaded and replayed on a built-in rom
+   nesemu-tests coverage                PRG coverage map, its CDL file and the code cache it extends
+
+   Exits with 0 on success, 1 on the first divergence and 77 when the
+   requested rom is not available so CTest reports the test as skipped
+ */
+
+#include "TestRom.hpp"
+#include "src/Cartridge.hpp"
+#include "src/Cheats.hpp"
+#include "src/Debugger.hpp"
+#include "src/MemoryMap.hpp"
+#include "src/Movie.hpp"
+#include "src/Nes.hpp"
+#include "src/Netplay/LoopbackTransport.hpp"
+#include "src/Netplay/RollbackSession.hpp"
+#include "src/Cpu/CodeCache.hpp"
+#include "src/Cpu/CoverageMap.hpp"
+#include "src/Cpu/Cpu.hpp"
+#include "src/Cpu/CpuProfiler.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#define NES_GETPID _getpid
+#else
+#include <unistd.h>
+#define NES_GETPID ::getpid
+#endif
+
+namespace
+{
+constexpr int ExitSkipped = 77;
+
+// Flat 64 KiB memory, enough for the cpu only test programs
+struct Machine : MemoryHandler
+{
+    std::array<Word, 0x10000> ram{};
+    MemoryMap memory{*this};
+    Cpu cpu{memory};
+
+    Machine()
+    {
+        memory.MapRead(0, MemoryMap::s_PageCount, ram.data());
+        memory.MapWrite(0, MemoryMap::s_PageCount, ram.data());
+    }
+
+    Word Read(DWord) override
+    {
+        return 0x00;
+    }
+
+    void Write(DWord, Word) override
+    {
+    }
+
+    void Load(DWord address, const std::vector<Word> &data)
+    {
+        for (std::size_t i = 0; i < data.size(); i++)
+        {
+            ram[address + i] = data[i];
+        }
+    }
+
+    void LoadPrg(const std::vector<Word> &prg)
+    {
+        Load(0x8000, prg);
+
+        // 16 KiB images are mirrored on the upper bank
+        if (prg.size() == Cartridge::s_PrgBankSize)
+        {
+            Load(0xC000, prg);
+        }
+    }
+};
+
+std::string Hex(unsigned value, int digits)
+{
+    char buffer[8];
+    std::snprintf(buffer, sizeof(buffer), "%0*X", digits, value);
+    return buffer;
+}
+
+std::string FormatRegisters(const Cpu::Registers &registers, std::uint64_t cycles)
+{
+    std::ostringstream stream;
+    stream << Hex(registers.PC, 4) << "  A:" << Hex(registers.A, 2) << " X:" << Hex(registers.X, 2)
+           << " Y:" << Hex(registers.Y, 2) << " P:" << Hex(registers.P, 2) << " SP:" << Hex(registers.SP, 2)
+           << " CYC:" << cycles;
+    return stream.str();
+}
+
+std::string FormatFlags(Word flags)
+{
+    static const char *s_Names = "CZIDBUVN";
+    std::string names;
+
+    for (int bit = 7; bit >= 0; bit--)
+    {
+        if (flags & (1 << bit))
+        {
+            names += s_Names[bit];
+        }
+    }
+
+    return names;
+}
+
+/*
+   Compare the registers field by field, returns an empty string when they
+   match, a description of the first divergent field otherwise
+ */
+std::string Diverge(const Cpu::Registers &expected, const Cpu::Registers &actual)
+{
+    auto field = [](const char *name, unsigned expected, unsigned actual, int digits) {
+        return std::string(name) + ": expected $" + Hex(expected, digits) + " got $" + Hex(actual, digits);
+    };
+
+    if (expected.PC != actual.PC)
+        return field("PC", expected.PC, actual.PC, 4);
+    if (expected.A != actual.A)
+        return field("A", expected.A, actual.A, 2);
+    if (expected.X != actual.X)
+        return field("X", expected.X, actual.X, 2);
+    if (expected.Y != actual.Y)
+        return field("Y", expected.Y, actual.Y, 2);
+    if (expected.SP != actual.SP)
+        return field("SP", expected.SP, actual.SP, 2);
+    if (expected.P != actual.P)
+        return field("P", expected.P, actual.P, 2) + " (flags " + FormatFlags(expected.P ^ actual.P) + " differ)";
+
+    return {};
+}
+
+struct MemoryCheck
+{
+    DWord address;
+    Word value;
+};
+
+struct BuiltinCase
+{
+    const char *name;
+    std::vector<Word> program;
+    // Extra memory initialisation, used by the indirect addressing cases
+    std::vector<std::pair<DWord, std::vector<Word>>> memory;
+    Cpu::Registers expected;
+    std::uint64_t cycles;
+    std::vector<MemoryCheck> checks;
+};
+
+/*
+   Each program starts at $8000 right after the reset sequence (7 cycles)
+   and ends on a `JMP *` trap, the trap itself is not executed
+ */
+std::vector<BuiltinCase> BuiltinCases()
+{
+    constexpr Word JMP = 0x4C;
+
+    return {
+        {"BRK pushes PC+2 and the break flag then jumps through $FFFE",
+         {0xA9, 0x00, 0x00, 0xFF, JMP, 0x04, 0x80},
+         {{0x9000, {0xA9, 0x42, JMP, 0x02, 0x90}}, {0xFFFE, {0x00, 0x90}}},
+         {0x9002, 0xFA, 0x42, 0x00, 0x00, 0x24},
+         7 + 2 + 7 + 2,
+         {{0x01FD, 0x80}, {0x01FC, 0x04}, {0x01FB, 0x36}}},
+        {"BEQ branches when Z is set",
+         {0xA9, 0x00, 0xF0, 0x02, 0xA2, 0x01, 0xA0, 0x02, JMP, 0x08, 0x80},
+         {},
+         {0x8008, 0xFD, 0x00, 0x00, 0x02, 0x24},
+         7 + 2 + 3 + 2,
+         {}},
+        {"BNE does not branch when Z is set",
+         {0xA9, 0x00, 0xD0, 0x02, 0xA2, 0x01, JMP, 0x06, 0x80},
+         {},
+         {0x8006, 0xFD, 0x00, 0x01, 0x00, 0x24},
+         7 + 2 + 2 + 2,
+         {}},
+        {"BMI branches when N is set",
+         {0xA9, 0x80, 0x30, 0x02, 0xA2, 0x01, JMP, 0x06, 0x80},
+         {},
+         {0x8006, 0xFD, 0x80, 0x00, 0x00, 0xA4},
+         7 + 2 + 3,
+         {}},
+        {"ADC of $FF + $00 leaves carry clear",
+         {0x18, 0xA9, 0xFF, 0x69, 0x00, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0xFD, 0xFF, 0x00, 0x00, 0xA4},
+         7 + 2 + 2 + 2,
+         {}},
+        {"ADC of $FF + $01 wraps to zero with carry",
+         {0x18, 0xA9, 0xFF, 0x69, 0x01, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0xFD, 0x00, 0x00, 0x00, 0x27},
+         7 + 2 + 2 + 2,
+         {}},
+        {"ADC signed overflow",
+         {0x18, 0xA9, 0x7F, 0x69, 0x01, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0xFD, 0x80, 0x00, 0x00, 0xE4},
+         7 + 2 + 2 + 2,
+         {}},
+        {"SBC stores its result in A",
+         {0x38, 0xA9, 0x05, 0xE9, 0x03, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0xFD, 0x02, 0x00, 0x00, 0x25},
+         7 + 2 + 2 + 2,
+         {}},
+        {"JMP indirect reads its pointer in little endian",
+         {0x6C, 0x00, 0x02},
+         {{0x0200, {0x34, 0x90}}, {0x9034, {JMP, 0x34, 0x90}}},
+         {0x9034, 0xFD, 0x00, 0x00, 0x00, 0x24},
+         7 + 5,
+         {}},
+        {"JMP indirect does not carry into the pointer high byte",
+         {0x6C, 0xFF, 0x02},
+         {{0x02FF, {0x00}}, {0x0200, {0x90}}, {0x0300, {0xA0}}, {0x9000, {JMP, 0x00, 0x90}}},
+         {0x9000, 0xFD, 0x00, 0x00, 0x00, 0x24},
+         7 + 5,
+         {}},
+        {"Indexed indirect and indirect indexed addressing",
+         {0xA2, 0x02, 0xA1, 0x10, 0xA0, 0x01, 0x91, 0x20, JMP, 0x08, 0x80},
+         {{0x0012, {0x00, 0x03}}, {0x0300, {0x5A}}, {0x0020, {0xFF, 0x03}}},
+         {0x8008, 0xFD, 0x5A, 0x02, 0x01, 0x24},
+         7 + 2 + 6 + 2 + 6,
+         {{0x0400, 0x5A}}},
+        {"Zero page addressing reads its operand",
+         {0xA9, 0x11, 0x85, 0x40, 0xA2, 0x01, 0xB5, 0x3F, JMP, 0x08, 0x80},
+         {},
+         {0x8008, 0xFD, 0x11, 0x01, 0x00, 0x24},
+         7 + 2 + 3 + 2 + 4,
+         {{0x0040, 0x11}}},
+        {"Zero page indexed addressing wraps around the page",
+         {0xA2, 0x10, 0xB5, 0xF8, JMP, 0x04, 0x80},
+         {{0x0008, {0x77}}},
+         {0x8004, 0xFD, 0x77, 0x10, 0x00, 0x24},
+         7 + 2 + 4,
+         {}},
+        {"Page crossing costs a cycle to reads only",
+         {0xA2, 0x01, 0xBD, 0xFF, 0x10, 0x9D, 0xFF, 0x10, JMP, 0x08, 0x80},
+         {},
+         {0x8008, 0xFD, 0x00, 0x01, 0x00, 0x26},
+         7 + 2 + 5 + 5,
+         {}},
+        {"Taken branch crossing a page costs two cycles",
+         {JMP, 0xFC, 0x80},
+         {{0x80FC, {0x18, 0x90, 0x02, 0xEA, 0xEA, JMP, 0x01, 0x81}}},
+         {0x8101, 0xFD, 0x00, 0x00, 0x00, 0x24},
+         7 + 3 + 2 + 4,
+         {}},
+        {"INC increments memory",
+         {0xE6, 0x10, 0xEE, 0x00, 0x02, JMP, 0x05, 0x80},
+         {{0x0010, {0x7F}}, {0x0200, {0xFF}}},
+         {0x8005, 0xFD, 0x00, 0x00, 0x00, 0x26},
+         7 + 5 + 6,
+         {{0x0010, 0x80}, {0x0200, 0x00}}},
+        {"CPY compares the Y register",
+         {0xA2, 0x05, 0xA0, 0x09, 0xC0, 0x09, JMP, 0x06, 0x80},
+         {},
+         {0x8006, 0xFD, 0x00, 0x05, 0x09, 0x27},
+         7 + 2 + 2 + 2,
+         {}},
+        {"EOR sets the flags from the result",
+         {0xA9, 0xFF, 0x49, 0xFF, JMP, 0x04, 0x80},
+         {},
+         {0x8004, 0xFD, 0x00, 0x00, 0x00, 0x26},
+         7 + 2 + 2,
+         {}},
+        {"ORA does not write its operand back",
+         {0xA9, 0x0F, 0x05, 0x10, JMP, 0x04, 0x80},
+         {{0x0010, {0xF0}}},
+         {0x8004, 0xFD, 0xFF, 0x00, 0x00, 0xA4},
+         7 + 2 + 3,
+         {{0x0010, 0xF0}}},
+        {"Accumulator shifts and rotates",
+         {0xA9, 0x81, 0x4A, 0x2A, 0x6A, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0xFD, 0x40, 0x00, 0x00, 0x25},
+         7 + 2 + 2 + 2 + 2,
+         {}},
+        {"BIT takes N and V from the operand",
+         {0xA9, 0x01, 0x24, 0x10, JMP, 0x04, 0x80},
+         {{0x0010, {0xC0}}},
+         {0x8004, 0xFD, 0x01, 0x00, 0x00, 0xE6},
+         7 + 2 + 3,
+         {}},
+        {"PHP pushes the break flag and PLP ignores it",
+         {0x08, 0x68, 0xA9, 0xFF, 0x48, 0x28, JMP, 0x06, 0x80},
+         {},
+         {0x8006, 0xFD, 0xFF, 0x00, 0x00, 0xEF},
+         7 + 3 + 4 + 2 + 3 + 4,
+         {{0x01FD, 0xFF}}},
+        {"PLA sets the flags",
+         {0xA9, 0x00, 0x48, 0xA9, 0x01, 0x68, JMP, 0x06, 0x80},
+         {},
+         {0x8006, 0xFD, 0x00, 0x00, 0x00, 0x26},
+         7 + 2 + 3 + 2 + 4,
+         {}},
+        {"TXS leaves the flags untouched",
+         {0xA2, 0x00, 0xA9, 0x01, 0x9A, JMP, 0x05, 0x80},
+         {},
+         {0x8005, 0x00, 0x01, 0x00, 0x00, 0x24},
+         7 + 2 + 2 + 2,
+         {}},
+        {"JSR and RTS",
+         {0x20, 0x00, 0x90, JMP, 0x03, 0x80},
+         {{0x9000, {0xA0, 0x33, 0x60}}},
+         {0x8003, 0xFD, 0x00, 0x00, 0x33, 0x24},
+         7 + 6 + 2 + 6,
+         {{0x01FD, 0x80}, {0x01FC, 0x02}}},
+        {"JSR fetches the target high byte after its pushes",
+         {JMP, 0xFA, 0x01},
+         {{0x01FA, {0x20, 0x00, 0x90}}, {0xFC00, {JMP, 0x00, 0xFC}}},
+         {0xFC00, 0xFB, 0x00, 0x00, 0x00, 0x24},
+         7 + 3 + 6,
+         {{0x01FD, 0x01}, {0x01FC, 0xFC}}},
+        {"ASL and LDA reach $FFFF rather than the accumulator",
+         {0xA9, 0x12, 0x0E, 0xFF, 0xFF, 0xAD, 0xFF, 0xFF, JMP, 0x08, 0x80},
+         {{0xFFFF, {0x48}}},
+         {0x8008, 0xFD, 0x90, 0x00, 0x00, 0xA4},
+         7 + 2 + 6 + 4,
+         {{0xFFFF, 0x90}}},
+        {"RTI restores the status and the program counter",
+         {0xA9, 0x80, 0x48, 0xA9, 0x10, 0x48, 0xA9, 0xC3, 0x48, 0x40},
+         {{0x8010, {JMP, 0x10, 0x80}}},
+         {0x8010, 0xFD, 0xC3, 0x00, 0x00, 0xE3},
+         7 + 2 * 3 + 3 * 3 + 6,
+         {}},
+        {"Unofficial LAX, SAX, DCP and ISB",
+         {0xA7, 0x10, 0x87, 0x11, 0xC7, 0x12, 0x38, 0xE7, 0x13, JMP, 0x09, 0x80},
+         {{0x0010, {0x3C, 0x00, 0x3D, 0x0B}}},
+         {0x8009, 0xFD, 0x30, 0x3C, 0x00, 0x25},
+         7 + 3 + 3 + 5 + 2 + 5,
+         {{0x0011, 0x3C}, {0x0012, 0x3C}, {0x0013, 0x0C}}},
+    };
+}
+
+int RunBuiltin()
+{
+    int failures = 0;
+
+    for (const BuiltinCase &test : BuiltinCases())
+    {
+        Machine machine;
+        machine.Load(0x8000, test.program);
+        machine.Load(0xFFFC, {0x00, 0x80});
+
+        for (const auto &[address, data] : test.memory)
+        {
+            machine.Load(address, data);
+        }
+
+        machine.cpu.Reset();
+
+        // Run until the program reaches its `JMP *` trap
+        for (int i = 0; i < 64; i++)
+        {
+            Cpu::Registers registers = machine.cpu.GetRegisters();
+
+            if (machine.ram[registers.PC] == 0x4C && machine.ram[registers.PC + 1] == (registers.PC & 0xFF) &&
+                machine.ram[registers.PC + 2] == (registers.PC >> 8))
+            {
+                break;
+            }
+
+            machine.cpu.Step();
+        }
+
+        Cpu::Registers actual = machine.cpu.GetRegisters();
+        std::string divergence = Diverge(test.expected, actual);
+
+        if (divergence.empty() && machine.cpu.GetCycles() != test.cycles)
+        {
+            divergence = "cycles: expected " + std::to_string(test.cycles) + " got " +
+                         std::to_string(machine.cpu.GetCycles());
+        }
+
+        for (const MemoryCheck &check : test.checks)
+        {
+            if (divergence.empty() && machine.ram[check.address] != check.value)
+            {
+                divergence = "$" + Hex(check.address, 4) + ": expected $" + Hex(check.value, 2) + " got $" +
+                             Hex(machine.ram[check.address], 2);
+            }
+        }
+
+        if (!divergence.empty())
+        {
+            std::cout << "FAIL " << test.name << "\n  " << divergence << "\n  state "
+                      << FormatRegisters(actual, machine.cpu.GetCycles()) << std::endl;
+            failures++;
+        }
+    }
+
+    std::cout << BuiltinCases().size() - failures << "/" << BuiltinCases().size() << " builtin cases passed"
+              << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Registers and cycles parsed from a nestest.log line
+struct TraceLine
+{
+    Cpu::Registers registers;
+    std::uint64_t cycles;
+    bool hasCycles;
+};
+
+bool ParseTraceLine(const std::string &line, TraceLine &trace)
+{
+    auto field = [&line](const char *name, unsigned &value, int base) {
+        std::size_t position = line.find(name);
+
+        if (position == std::string::npos)
+        {
+            return false;
+        }
+
+        value = std::stoul(line.substr(position + std::strlen(name)), nullptr, base);
+        return true;
+    };
+
+    unsigned pc, a, x, y, p, sp;
+
+    if (line.size() < 4 || !field("A:", a, 16) || !field("X:", x, 16) || !field("Y:", y, 16) || !field("P:", p, 16) ||
+        !field("SP:", sp, 16))
+    {
+        return false;
+    }
+
+    pc = std::stoul(line.substr(0, 4), nullptr, 16);
+    trace.registers = {(DWord)pc, (Word)sp, (Word)a, (Word)x, (Word)y, (Word)p};
+
+    // Only the logs providing the PPU position carry a cpu cycle counter
+    unsigned cycles = 0;
+    trace.hasCycles = line.find("PPU:") != std::string::npos && field("CYC:", cycles, 10);
+    trace.cycles = cycles;
+
+    return true;
+}
+
+int RunNestest(const std::string &romPath, const std::string &logPath)
+{
+    std::ifstream log(logPath);
+
+    if (!std::ifstream(romPath) || !log)
+    {
+        std::cout << "nestest rom or log not found, skipping" << std::endl;
+        return ExitSkipped;
+    }
+
+    Cartridge cartridge(romPath);
+    Machine machine;
+    machine.LoadPrg(cartridge.GetPrg());
+
+    // Automated mode starts at $C000 instead of the reset vector
+    machine.cpu.SetRegisters({0xC000, 0xFD, 0x00, 0x00, 0x00, 0x24});
+    machine.cpu.SetCycles(7);
+
+    std::string line;
+    std::size_t number = 0;
+
+    while (std::getline(log, line))
+    {
+        number++;
+        TraceLine expected;
+
+        if (!ParseTraceLine(line, expected))
+        {
+            continue;
+        }
+
+        Cpu::Registers actual = machine.cpu.GetRegisters();
+        std::string divergence = Diverge(expected.registers, actual);
+
+        if (divergence.empty() && expected.hasCycles && expected.cycles != machine.cpu.GetCycles())
+        {
+            divergence = "cycles: expected " + std::to_string(expected.cycles) + " got " +
+                         std::to_string(machine.cpu.GetCycles());
+        }
+
+        if (!divergence.empty())
+        {
+            std::cout << "nestest diverged at line " << number << ": " << divergence << "\n  expected " << line
+                      << "\n  actual   " << FormatRegisters(actual, machine.cpu.GetCycles()) << std::endl;
+            return 1;
+        }
+
+        machine.cpu.Step();
+    }
+
+    // nestest stores its error codes at $02 (official) and $03 (unofficial)
+    if (machine.ram[0x02] != 0x00 || machine.ram[0x03] != 0x00)
+    {
+        std::cout << "nestest reported errors $" << Hex(machine.ram[0x02], 2) << " $" << Hex(machine.ram[0x03], 2)
+                  << std::endl;
+        return 1;
+    }
+
+    std::cout << "nestest passed " << number << " lines" << std::endl;
+    return 0;
+}
+
+int RunBlargg(const std::string &romPath)
+{
+    if (!std::ifstream(romPath))
+    {
+        std::cout << "rom not found, skipping" << std::endl;
+        return ExitSkipped;
+    }
+
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom(romPath);
+
+    // The status at $6000 is only valid once the signature has been written
+    auto signed_ = [&nes]() {
+        return nes.Peek(0x6001) == 0xDE && nes.Peek(0x6002) == 0xB0 && nes.Peek(0x6003) == 0x61;
+    };
+
+    constexpr int TimeoutFrames = 60 * 60;
+
+    for (int frame = 0; frame < TimeoutFrames; frame++)
+    {
+        nes.StepFrame();
+
+        if (!signed_())
+        {
+            continue;
+        }
+
+        Word status = nes.Peek(0x6000);
+
+        if (status == 0x81)
+        {
+            // Some tests ask to be reset after a short delay
+            for (int delay = 0; delay < 10; delay++)
+            {
+                nes.StepFrame();
+            }
+
+            Debugger(nes).Poke(0x6000, 0x80);
+            nes.Reset();
+        }
+        else if (status < 0x80)
+        {
+            std::string text;
+
+            for (DWord address = 0x6004; address < 0x7000 && nes.Peek(address) != 0; address++)
+            {
+                text += (char)nes.Peek(address);
+            }
+
+            std::cout << text << std::endl;
+            return status == 0x00 ? 0 : 1;
+        }
+    }
+
+    std::cout << "timed out at PC $" << Hex(nes.GetCpu().GetRegisters().PC, 4) << std::endl;
+    return 1;
+}
+
+// File or directory of the temporary directory, named after the process so that parallel runs do not share it
+class TempPath
+{
+public:
+    TempPath(const std::string &name, const std::string &extension = "")
+        : m_Path(std::filesystem::temp_directory_path() / (name + "-" + std::to_string(NES_GETPID()) + extension))
+    {
+        std::filesystem::remove_all(m_Path);
+    }
+
+    TempPath(const TempPath &) = delete;
+    TempPath &operator=(const TempPath &) = delete;
+
+    // Removed whichever way the runner ends
+    ~TempPath()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(m_Path, error);
+    }
+
+    const std::filesystem::path &Get() const
+    {
+        return m_Path;
+    }
+
+private:
+    std::filesystem::path m_Path;
+};
+
+// Failed checks of a runner, printed as they happen and summed up at the end
+class Checks
+{
+public:
+    explicit Checks(const char *name)
+        : m_Name(name)
+    {
+    }
+
+    void operator()(bool condition, const std::string &what)
+    {
+        if (!condition)
+        {
+            Fail(what);
+        }
+    }
+
+    void Fail(const std::string &what)
+    {
+        std::cout << "FAIL " << what << std::endl;
+        m_Failures++;
+    }
+
+    // Exit code of the runner
+    int Report() const
+    {
+        std::cout << m_Name << (m_Failures == 0 ? " checks passed" : " checks failed") << std::endl;
+        return m_Failures == 0 ? 0 : 1;
+    }
+
+private:
+    const char *m_Name;
+    int m_Failures = 0;
+};
+
+int RunDebugger()
+{
+    // Loop calling a routine which copies $0300 to $0301 while X is stored into $0300
+    const std::vector<Word> program = {
+        0xA2, 0x00,       // $8000 LDX #$00
+        0x20, 0x10, 0x80, // $8002 JSR $8010
+        0xE8,             // $8005 INX
+        0x8E, 0x00, 0x03, // $8006 STX $0300
+        0x4C, 0x02, 0x80, // $8009 JMP $8002
+        0xEA, 0xEA, 0xEA, 0xEA,
+        0xAD, 0x00, 0x03, // $8010 LDA $0300
+        0x8D, 0x01, 0x03, // $8013 STA $0301
+        0x60,             // $8016 RTS
+    };
+    std::vector<Word> image = BuildRom(program);
+
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom(image.data(), image.size());
+
+    Checks check("debugger");
+
+    {
+        Debugger debugger(nes);
+        int breakpoint = debugger.AddBreakpoint(0x8005);
+
+        Debugger::Stop stop = debugger.RunFrame();
+        check(stop.reason == Debugger::StopReason::Breakpoint && stop.id == breakpoint && stop.address == 0x8005,
+              "breakpoint after the first call");
+        check(debugger.RunFrame().address == 0x8005, "breakpoint on the second call");
+        check(debugger.GetRegisters().X == 0x01, "X after two calls");
+
+        stop = debugger.StepInto();
+        check(stop.reason == Debugger::StopReason::Step && stop.address == 0x8006, "step into INX");
+        check(debugger.StepInto().address == 0x8009, "step into STX");
+        check(debugger.StepInto().address == 0x8002, "step into JMP");
+        check(debugger.StepInto().address == 0x8010, "step into JSR");
+        check(debugger.StepOver().address == 0x8013, "step over LDA");
+
+        check(debugger.StepInto().address == 0x8016 && debugger.StepInto().address == 0x8005, "step out of RTS");
+        check(debugger.StepInto().address == 0x8006, "step past the breakpoint");
+
+        int write = debugger.AddWatchpoint(0x0300, 0x0300, Debugger::Write);
+        stop = debugger.RunFrame();
+        check(stop.reason == Debugger::StopReason::Watchpoint && stop.id == write && stop.address == 0x0300 &&
+                  stop.value == 0x03 && stop.access == Debugger::Write,
+              "write watchpoint");
+        check(debugger.GetRegisters().PC == 0x8009, "write watchpoint stops after the instruction");
+
+        // The routine is stepped over at once, its accesses stay watched
+        debugger.Remove(breakpoint);
+        debugger.StepInto();
+        int read = debugger.AddWatchpoint(0x0300, 0x0300, Debugger::Read);
+        stop = debugger.StepOver();
+        check(stop.reason == Debugger::StopReason::Watchpoint && stop.id == read && stop.access == Debugger::Read,
+              "read watchpoint within a stepped over routine");
+        check(debugger.GetRegisters().PC == 0x8013, "read watchpoint location");
+        check(nes.GetMemory().GetReadPage(0x03) != nullptr && nes.GetMemory().GetWritePage(0x03) != nullptr,
+              "watched pages direct outside of the runs");
+
+        debugger.Clear();
+        check(debugger.StepOver().address == 0x8016, "step after clearing");
+
+        check(debugger.Poke(0x0300, 0x42) && debugger.Peek(0x0300) == 0x42, "poke and peek");
+        check(!debugger.Poke(0x8000, 0x00) && debugger.Peek(0x8000) == 0xA2, "rom is not poked");
+
+        stop = debugger.RunFrame();
+        check(stop.reason == Debugger::StopReason::Frame && debugger.GetFrameCount() == 1, "run to the vblank");
+    }
+
+    check(nes.GetMemory().GetReadPage(0x03) != nullptr, "pages restored once detached");
+
+    // Watched pages and frame runs must not change the emulation
+    Nes plain;
+    plain.SetAudioEnabled(false);
+    plain.LoadRom(image.data(), image.size());
+
+    Nes watched;
+    watched.SetAudioEnabled(false);
+    watched.LoadRom(image.data(), image.size());
+
+    {
+        Debugger debugger(watched);
+        debugger.AddWatchpoint(0x0300, 0x03FF, Debugger::Read | Debugger::Write);
+        debugger.AddWatchpoint(0x0700, 0x0700, Debugger::Read);
+        debugger.AddBreakpoint(0x9000);
+
+        for (int frame = 0; frame < 10; frame++)
+        {
+            plain.StepFrame();
+
+            while (debugger.RunFrame().reason != Debugger::StopReason::Frame)
+            {
+            }
+        }
+    }
+
+    check(plain.SaveState() == watched.SaveState(), "identical emulation under the debugger");
+
+    return check.Report();
+}
+
+int RunCheats()
+{
+    Checks check("cheat");
+
+    auto parses = [](const std::string &code, DWord address, Word value, int compare) {
+        CheatEngine::Cheat cheat = CheatEngine::Parse(code);
+        return cheat.address == address && cheat.value == value && cheat.compare == compare;
+    };
+
+    check(parses("SXIOPO", 0x91D9, 0xAD, -1), "6 letters code");
+    check(parses("gossip", 0xD1DD, 0x14, -1), "lower case code");
+    check(parses("ZEXPYGLA", 0x94A7, 0x02, 0x03), "8 letters code");
+    check(parses("8100:22", 0x8100, 0x22, -1), "raw patch");
+    check(parses("C0F3?1A:EA", 0xC0F3, 0xEA, 0x1A), "raw compared patch");
+
+    for (const char *invalid : {"SXIOP", "SXIOPB", "0300:12", "8100:123", "8100?:12", "zz00:12", "8100:\xC3\xA9"})
+    {
+        bool thrown = false;
+
+        try
+        {
+            CheatEngine::Parse(invalid);
+        }
+        catch (const std::runtime_error &)
+        {
+            thrown = true;
+        }
+
+        check(thrown, std::string("rejects ") + invalid);
+    }
+
+    // Copy $8100 and its $C100 mirror to $0300 and $0301 forever
+    std::vector<Word> program = {
+        0xAD, 0x00, 0x81, // $8000 LDA $8100
+        0x8D, 0x00, 0x03, // $8003 STA $0300
+        0xAD, 0x00, 0xC1, // $8006 LDA $C100
+        0x8D, 0x01, 0x03, // $8009 STA $0301
+        0x4C, 0x00, 0x80, // $800C JMP $8000
+    };
+    program.resize(0x102, 0x00);
+    program[0x100] = 0x11;
+    program[0x101] = 0x99;
+    std::vector<Word> image = BuildRom(program);
+
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom(image.data(), image.size());
+    auto values = [&](Word original, Word mirror) {
+        nes.StepFrame();
+        return nes.Peek(0x0300) == original && nes.Peek(0x0301) == mirror;
+    };
+
+    check(values(0x11, 0x11), "unpatched rom");
+
+    nes.AddCheat("8100:22");
+    check(values(0x22, 0x11) && nes.Peek(0x8101) == 0x99, "patch applies to its address only");
+
+    nes.AddCheat("C100?55:44");
+    check(values(0x22, 0x11), "compare mismatch leaves the byte");
+    nes.AddCheat("C100?11:33");
+    check(values(0x22, 0x33), "compare match patches the byte");
+
+    nes.Reset();
+    check(values(0x22, 0x33), "patches survive a reset");
+
+    std::vector<Word> state = nes.SaveState();
+    nes.ClearCheats();
+    check(values(0x11, 0x11), "cleared patches restore the rom");
+
+    nes.AddCheat("8100:22");
+    nes.LoadState(state);
+    check(values(0x22, 0x11), "patches survive a state load");
+
+    return check.Report();
+}
+
+int RunSaves()
+{
+    Checks check("save");
+
+    // Count the loops at $6010 forever
+    const std::vector<Word> program = {
+        0xEE, 0x10, 0x60, // $8000 INC $6010
+        0x4C, 0x00, 0x80, // $8003 JMP $8000
+    };
+    std::vector<Word> image = BuildRom(program, true);
+
+    TempPath save("nesemu-tests-saves", ".sav");
+    std::string path = save.Get().string();
+
+    auto fileByte = [&path](std::size_t offset) {
+        std::ifstream file(path, std::ios::binary);
+        file.seekg(offset);
+        return (Word)file.get();
+    };
+
+    Word saved;
+
+    {
+        Nes nes;
+        nes.SetAudioEnabled(false);
+        nes.LoadRom(image.data(), image.size());
+        nes.StepFrame();
+        Word before = nes.Peek(0x6010);
+
+        nes.OpenSaveFile(path);
+        check(std::filesystem::file_size(path) == Cartridge::s_PrgRamSize, "save file created at the RAM size");
+        check(nes.Peek(0x6010) == before, "RAM content kept when the file is created");
+
+        nes.StepFrame();
+        saved = nes.Peek(0x6010);
+        check(saved != before && fileByte(0x10) == saved, "writes reach the file without flush");
+
+        Nes other;
+        other.SetAudioEnabled(false);
+        other.LoadRom(image.data(), image.size());
+        other.OpenSaveFile(path, false);
+        check(other.Peek(0x6010) == saved, "private file loaded");
+
+        other.StepFrame();
+        check(other.Peek(0x6010) != saved && fileByte(0x10) == saved, "private writes stay in memory");
+
+        nes.Reset();
+        check(nes.Peek(0x6010) == saved, "RAM kept across a reset");
+    }
+
+    {
+        Nes nes;
+        nes.SetAudioEnabled(false);
+        nes.LoadRom(image.data(), image.size());
+        nes.OpenSaveFile(path);
+        check(nes.Peek(0x6010) == saved, "saves found again");
+    }
+
+    return check.Report();
+}
+
+int RunRollback(bool timing)
+{
+    // Shift both pads into $00 and $01 and fold them into $02 forever, the state depends on every input
+    const std::vector<Word> program = {
+        0xA9, 0x01,       // $8000 LDA #$01
+        0x8D, 0x16, 0x40, // $8002 STA $4016
+        0xA9, 0x00,       // $8005 LDA #$00
+        0x8D, 0x16, 0x40, // $8007 STA $4016
+        0xA2, 0x08,       // $800A LDX #$08
+        0xAD, 0x16, 0x40, // $800C LDA $4016
+        0x4A,             // $800F LSR A
+        0x26, 0x00,       // $8010 ROL $00
+        0xAD, 0x17, 0x40, // $8012 LDA $4017
+        0x4A,             // $8015 LSR A
+        0x26, 0x01,       // $8016 ROL $01
+        0xCA,             // $8018 DEX
+        0xD0, 0xF1,       // $8019 BNE $800C
+        0xA5, 0x02,       // $801B LDA $02
+        0x0A,             // $801D ASL A
+        0x65, 0x00,       // $801E ADC $00
+        0x45, 0x01,       // $8020 EOR $01
+        0x85, 0x02,       // $8022 STA $02
+        0x4C, 0x00, 0x80, // $8024 JMP $8000
+    };
+    const std::vector<Word> image = BuildRom(program);
+    constexpr std::uint32_t Frames = 600;
+
+    // Each player holds random buttons for a few frames
+    auto inputs = [](std::uint32_t seed) {
+        std::vector<Word> buttons(Frames);
+        std::uint32_t state = seed;
+
+        for (std::uint32_t frame = 0; frame < Frames; frame++)
+        {
+            state = state * 1664525 + 1013904223;
+            buttons[frame] = frame % 6 == 0 ? static_cast<Word>(state >> 24) : buttons[frame - 1];
+        }
+
+        return buttons;
+    };
+    const std::vector<Word> buttons[2] = {inputs(1), inputs(2)};
+
+    // What both peers must end up with
+    Nes reference;
+    reference.LoadRom(image.data(), image.size());
+
+    for (std::uint32_t frame = 0; frame < Frames; frame++)
+    {
+        reference.SetInput(0, buttons[0][frame]);
+        reference.SetInput(1, buttons[1][frame]);
+        reference.StepFrame();
+    }
+
+    const std::vector<Word> expected = reference.SaveState();
+
+    struct LinkCase
+    {
+        const char *name;
+        QWord delay;
+        QWord jitter;
+        double loss;
+    };
+
+    Checks check("rollback");
+
+    for (const LinkCase &link : {LinkCase{"2 frames", 2, 0, 0.0}, LinkCase{"4+3 frames, 25% loss", 4, 3, 0.25}})
+    {
+        LoopbackLink loopback(link.delay, link.jitter, link.loss, 7);
+        Nes peers[2];
+        std::vector<std::unique_ptr<RollbackSession>> sessions;
+
+        for (std::size_t side = 0; side < 2; side++)
+        {
+            // A headless peer must stay in sync with one producing audio
+            peers[side].SetAudioEnabled(side == 0);
+            peers[side].LoadRom(image.data(), image.size());
+            sessions.push_back(std::make_unique<RollbackSession>(peers[side], loopback.GetEndpoint(side), side, 8));
+        }
+
+        // One tick per frame time, a stalled peer tries again on the next one
+        for (int tick = 0; tick < 10 * static_cast<int>(Frames); tick++)
+        {
+            bool done = true;
+
+            for (std::size_t side = 0; side < 2; side++)
+            {
+                RollbackSession &session = *sessions[side];
+
+                if (session.GetFrame() < Frames)
+                {
+                    session.AdvanceFrame(buttons[side][session.GetFrame()]);
+                }
+                else
+                {
+                    session.Poll();
+                }
+
+                done &= session.GetConfirmedFrame() == Frames;
+            }
+
+            if (done)
+            {
+                break;
+            }
+
+            loopback.Advance();
+        }
+
+        for (std::size_t side = 0; side < 2; side++)
+        {
+            const RollbackSession::Stats &stats = sessions[side]->GetStats();
+            std::string name = std::string(link.name) + ", peer " + std::to_string(side);
+            double frameMs = stats.resimulatedFrames ? stats.resimulationSeconds * 1e3 / stats.resimulatedFrames : 0.0;
+
+            std::printf("%s: %llu rollbacks, %llu frames re-emulated (longest %d), %.3f ms per frame\n",
+                        name.c_str(), static_cast<unsigned long long>(stats.rollbacks),
+                        static_cast<unsigned long long>(stats.resimulatedFrames), stats.longestRollback, frameMs);
+
+            if (sessions[side]->GetConfirmedFrame() != Frames)
+            {
+                check.Fail(name + " confirmed " + std::to_string(sessions[side]->GetConfirmedFrame()) + " frames");
+            }
+            else if (peers[side].SaveState() != expected)
+            {
+                check.Fail(name + " desynchronized");
+            }
+
+            check(stats.rollbacks != 0, name + " never rolled back");
+
+            // A full rollback must fit in a 60 Hz frame, only on request as it depends on the machine and build
+            if (timing && frameMs * 8 > 16.0)
+            {
+                check.Fail(name + " re-emulating 8 frames takes " + std::to_string(frameMs * 8) + " ms");
+            }
+        }
+    }
+
+    return check.Report();
+}
+
+int RunCodeCache()
+{
+    Checks check("code cache");
+
+    // Calls, a branch, an indirect jump and an instruction crossing a page, looping forever
+    std::vector<Word> program = {
+        0xA2, 0x00,       // $8000 LDX #$00
+        0x20, 0x20, 0x80, // $8002 JSR $8020
+        0xE8,             // $8005 INX
+        0x8E, 0x00, 0x03, // $8006 STX $0300
+        0x20, 0xFE, 0x80, // $8009 JSR $80FE
+        0xA9, 0x40,       // $800C LDA #$40
+        0x8D, 0x00, 0x02, // $800E STA $0200
+        0xA9, 0x80,       // $8011 LDA #$80
+        0x8D, 0x01, 0x02, // $8013 STA $0201
+        0x6C, 0x00, 0x02, // $8016 JMP ($0200)
+    };
+    const std::vector<std::pair<DWord, std::vector<Word>>> routines = {
+        {0x8020,
+         {
+             0xAD, 0x00, 0x03, // $8020 LDA $0300
+             0x18,             // $8023 CLC
+             0x69, 0x03,       // $8024 ADC #$03
+             0x90, 0x03,       // $8026 BCC $802B
+             0xEE, 0x02, 0x03, // $8028 INC $0302
+             0x8D, 0x01, 0x03, // $802B STA $0301
+             0x60,             // $802E RTS
+         }},
+        {0x8040,
+         {
+             0xAC, 0x00, 0x03, // $8040 LDY $0300
+             0xC8,             // $8043 INY
+             0x8C, 0x03, 0x03, // $8044 STY $0303
+             0x4C, 0x02, 0x80, // $8047 JMP $8002
+         }},
+        {0x80FE,
+         {
+             0xAD, 0x01, 0x03, // $80FE LDA $0301
+             0x60,             // $8101 RTS
+         }},
+    };
+
+    for (const auto &routine : routines)
+    {
+        program.resize(std::max<std::size_t>(program.size(), routine.first - 0x8000 + routine.second.size()), 0x00);
+        std::copy(routine.second.begin(), routine.second.end(), program.begin() + (routine.first - 0x8000));
+    }
+
+    std::vector<Word> image = BuildRom(program);
+    TempPath temp("nesemu-tests-codecache");
+    const std::filesystem::path &directory = temp.Get();
+
+    Nes reference;
+    reference.SetAudioEnabled(false);
+    reference.LoadRom(image.data(), image.size());
+
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom(image.data(), image.size());
+    check(!nes.LoadCodeCache(directory.string()), "cold start analyzes");
+
+    const CodeCache &cache = *nes.GetCodeCache();
+    auto decoded = [&](DWord address) {
+        return cache.Find(nes.GetMemory().GetReadPage(address >> 8), address);
+    };
+
+    check(decoded(0x8020) && decoded(0x8020)->operand == 0x0300, "called routine decoded");
+    check(decoded(0x8101) != nullptr, "instruction after a page crossing one decoded");
+    check(!decoded(0x80FE), "page crossing instruction left to the interpreter");
+    check(!decoded(0x8040), "indirect jump target left to the interpreter");
+    check(!decoded(0x8021), "operand bytes not decoded");
+
+    const std::vector<CodeCache::Block> &blocks = cache.GetBanks()[0].blocks;
+    auto branch = std::find_if(blocks.begin(), blocks.end(), [](const CodeCache::Block &block) {
+        return block.start == 0x0020;
+    });
+    check(branch != blocks.end() && branch->end == 0x0028 && branch->address == 0x8020 &&
+              std::is_permutation(branch->successors.begin(), branch->successors.end(),
+                                  std::vector<QWord>{0x002B, 0x0028}.begin()),
+          "branch block and successors");
+
+    // Every frame must end in the state the interpreter reaches, patched code included
+    bool identical = true;
+
+    for (int frame = 0; frame < 120; frame++)
+    {
+        if (frame == 60)
+        {
+            reference.AddCheat("8025:05");
+            nes.AddCheat("8025:05");
+        }
+
+        reference.StepFrame();
+        nes.StepFrame();
+        identical = identical && reference.SaveState() == nes.SaveState();
+    }
+
+    check(identical, "same states as the interpreter");
+
+    {
+        Nes warm;
+        warm.LoadRom(image.data(), image.size());
+        check(warm.LoadCodeCache(directory.string()), "warm start loads the analysis");
+        check(warm.GetCodeCache()->GetBlockCount() == cache.GetBlockCount() &&
+                  warm.GetCodeCache()->GetInstructionCount() == cache.GetInstructionCount(),
+              "loaded analysis matches");
+
+        // A damaged file is analyzed again
+        std::filesystem::path file = directory / cache.GetFileName();
+        std::filesystem::resize_file(file, std::filesystem::file_size(file) - 3);
+        check(!warm.LoadCodeCache(directory.string()), "truncated file rejected");
+        check(warm.GetCodeCache()->GetInstructionCount() == cache.GetInstructionCount(),
+              "truncated file replaced");
+    }
+
+    std::cout << cache.GetBlockCount() << " blocks, " << cache.GetInstructionCount() << " instructions" << std::endl;
+    return check.Report();
+}
+
+int RunInterrupts()
+{
+    Checks check("interrupt");
+
+    // Both vectors point to a handler at $9000, X counts the INX which ran before the interrupt
+    auto boot = [](Machine &machine, const std::vector<Word> &program, Word status, Word sp = 0xFD) {
+        machine.Load(0x8000, program);
+        machine.Load(0xFFFA, {0x00, 0x90, 0x00, 0x80, 0x00, 0x90});
+        machine.cpu.SetRegisters({0x8000, sp, 0x00, 0x00, 0x00, status});
+    };
+    auto runToHandler = [](Machine &machine) {
+        for (int cycle = 0; cycle < 100; cycle++)
+        {
+            if (machine.cpu.IsInstructionComplete() && machine.cpu.GetRegisters().PC == 0x9000)
+            {
+                return true;
+            }
+
+            machine.cpu.Clock();
+        }
+
+        return false;
+    };
+
+    {
+        Machine machine;
+        boot(machine, {0xE8, 0xE8, 0xE8, 0x4C, 0x00, 0x80}, 0x24);
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, true);
+        check(!runToHandler(machine), "IRQ masked by the I flag");
+    }
+
+    {
+        Machine machine;
+        boot(machine, {0x58, 0xE8, 0xE8, 0xE8}, 0x24);
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, true);
+        check(runToHandler(machine) && machine.cpu.GetRegisters().X == 0x01, "CLI delays the IRQ by one instruction");
+        check(machine.cpu.GetCycles() == 2 + 2 + 7, "IRQ sequence cycles");
+        check(machine.cpu.GetPendingInterrupts() == Cpu::InterruptApu, "IRQ line held by its source");
+    }
+
+    {
+        Machine machine;
+        boot(machine, {0x78, 0xE8, 0xE8}, 0x20);
+        machine.cpu.SetIrqLine(Cpu::InterruptMapper, true);
+        check(runToHandler(machine) && machine.cpu.GetRegisters().X == 0x00, "IRQ taken right after SEI");
+        check(machine.ram[0x01FB] & 0x04, "SEI pushed with the I flag set");
+    }
+
+    {
+        Machine machine;
+        boot(machine, {0x28, 0xE8, 0xE8, 0xE8}, 0x24);
+        machine.ram[0x01FE] = 0x20;
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, true);
+        check(runToHandler(machine) && machine.cpu.GetRegisters().X == 0x01, "PLP delays the IRQ by one instruction");
+    }
+
+    {
+        Machine machine;
+        std::vector<Word> program(0x13, 0xE8);
+        program[0] = 0x40;
+        boot(machine, program, 0x24, 0xFA);
+        machine.Load(0x01FB, {0x20, 0x10, 0x80});
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, true);
+        check(runToHandler(machine) && machine.cpu.GetRegisters().X == 0x00, "RTI restores the I flag at once");
+    }
+
+    {
+        Machine machine;
+        boot(machine, {0xE8, 0xE8, 0xE8, 0x4C, 0x00, 0x80}, 0x20);
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, true);
+        machine.cpu.SetIrqLine(Cpu::InterruptApu, false);
+        check(!runToHandler(machine), "released IRQ line");
+    }
+
+    // LDA $0200 takes 4 cycles, the lines are polled before the last one
+    for (int cycles : {3, 4})
+    {
+        Machine machine;
+        boot(machine, {0xAD, 0x00, 0x02, 0xE8, 0xE8, 0xE8}, 0x24);
+
+        for (int cycle = 0; cycle < cycles; cycle++)
+        {
+            machine.cpu.Clock();
+        }
+
+        machine.cpu.TriggerNmi();
+        check(runToHandler(machine) && machine.cpu.GetRegisters().X == cycles - 3,
+              "NMI raised after " + std::to_string(cycles) + " cycles of LDA");
+        check(machine.cpu.GetPendingInterrupts() == 0x00, "NMI acknowledged");
+    }
+
+    return check.Report();
+}
+
+int RunProfiler()
+{
+    Checks check("profiler");
+
+    // An NMI fires during the first instruction of a routine
+    const std::vector<Word> program = {
+        0x20, 0x10, 0x80, // $8000 JSR $8010
+        0x4C, 0x03, 0x80, // $8003 JMP $8003
+    };
+    const std::vector<Word> routine = {
+        0xE8, // $8010 INX
+        0xE8, // $8011 INX
+        0xE8, // $8012 INX
+        0x60, // $8013 RTS
+    };
+    const std::vector<Word> handler = {
+        0xC8, // $9000 INY
+        0x40, // $9001 RTI
+    };
+
+    Machine machine;
+    machine.Load(0x8000, program);
+    machine.Load(0x8010, routine);
+    machine.Load(0x9000, handler);
+    machine.Load(0xFFFA, {0x00, 0x90, 0x00, 0x80, 0x00, 0x90});
+    machine.cpu.SetRegisters({0x8000, 0xFD, 0x00, 0x00, 0x00, 0x24});
+
+    CpuProfiler profiler;
+    machine.cpu.SetProfiler(&profiler);
+    std::uint64_t start = machine.cpu.GetCycles();
+
+    while (machine.cpu.GetCycles() < start + 60 || !machine.cpu.IsInstructionComplete())
+    {
+        if (machine.cpu.IsInstructionComplete() && machine.cpu.GetRegisters().PC == 0x8010 &&
+            profiler.GetInterruptCount() == 0)
+        {
+            machine.cpu.TriggerNmi();
+        }
+
+        machine.cpu.Clock();
+    }
+
+    check(machine.cpu.GetRegisters().X == 0x03 && machine.cpu.GetRegisters().Y == 0x01, "routine and handler ran");
+    check(profiler.GetInterruptCount() == 1 && profiler.GetRoutineCalls(0x9000) == 1, "NMI entry recorded");
+    // Entry, INY and RTI
+    check(profiler.GetRoutineCycles(0x9000) == 7 + 2 + 6, "handler cycles");
+    // Three INX and RTS, the handler excluded
+    check(profiler.GetRoutineCalls(0x8010) == 1 && profiler.GetRoutineCycles(0x8010) == 3 * 2 + 6,
+          "interrupted routine cycles");
+    check(profiler.GetCycleCount() == machine.cpu.GetCycles() - start, "every cycle counted");
+
+    return check.Report();
+}
+
+int RunMovie()
+{
+    Checks check("movie");
+
+    // Read the first controller into $0300 forever, A ending up in bit 7 so that $31 reads as $8C
+    const std::vector<Word> program = {
+        0xA9, 0x01,       // $8000 LDA #$01
+        0x8D, 0x16, 0x40, // $8002 STA $4016
+        0xA9, 0x00,       // $8005 LDA #$00
+        0x8D, 0x16, 0x40, // $8007 STA $4016
+        0xA2, 0x08,       // $800A LDX #$08
+        0xAD, 0x16, 0x40, // $800C LDA $4016
+        0x4A,             // $800F LSR A
+        0x2E, 0x00, 0x03, // $8010 ROL $0300
+        0xCA,             // $8013 DEX
+        0xD0, 0xF6,       // $8014 BNE $800C
+        0x4C, 0x00, 0x80, // $8016 JMP $8000
+    };
+    std::vector<Word> image = BuildRom(program);
+
+    Nes recorded;
+    recorded.SetAudioEnabled(false);
+    recorded.LoadRom(image.data(), image.size());
+
+    Movie movie(CodeCache::Hash(*recorded.GetCartridge()));
+
+    for (int frame = 0; frame < 30; frame++)
+    {
+        Word buttons = static_cast<Word>(frame * 37);
+        movie.Record(buttons, 0x00);
+        recorded.SetInput(0, buttons);
+        recorded.StepFrame();
+    }
+
+    check(recorded.Peek(0x0300) == 0x8C, "controller read by the rom");
+
+    TempPath saved("nesemu-tests", ".movie");
+    std::string path = saved.Get().string();
+    movie.Save(path);
+    Movie loaded = Movie::Load(path);
+    check(loaded.GetFrameCount() == 30 && loaded.GetRomHash() == movie.GetRomHash(), "movie header kept");
+    check(loaded.GetInput(29, 0) == movie.GetInput(29, 0) && loaded.GetInput(30, 0) == 0x00,
+          "inputs kept, released past the end");
+
+    Nes replayed;
+    replayed.SetAudioEnabled(false);
+    replayed.LoadRom(image.data(), image.size());
+
+    for (std::size_t frame = 0; frame < loaded.GetFrameCount(); frame++)
+    {
+        loaded.Apply(replayed, frame);
+        replayed.StepFrame();
+    }
+
+    check(replayed.SaveState() == recorded.SaveState(), "replay identical to the recording");
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    bool rejected = false;
+
+    try
+    {
+        Movie::Load(path);
+    }
+    catch (const std::runtime_error &)
+    {
+        rejected = true;
+    }
+
+    check(rejected, "truncated movie rejected");
+
+    return check.Report();
+}
+
+int RunCoverage()
+{
+    Checks check("coverage");
+
+    // Reads four bytes of a table through a loop only reached by an indirect jump
+    std::vector<Word> program = {
+        0xA2, 0x00,       // $8000 LDX #$00
+        0xBD, 0x30, 0x80, // $8002 LDA $8030,X
+        0x8D, 0x00, 0x03, // $8005 STA $0300
+        0xA9, 0x20,       // $8008 LDA #$20
+        0x8D, 0x00, 0x02, // $800A STA $0200
+        0xA9, 0x80,       // $800D LDA #$80
+        0x8D, 0x01, 0x02, // $800F STA $0201
+        0x6C, 0x00, 0x02, // $8012 JMP ($0200)
+    };
+    const std::vector<Word> loop = {
+        0xE8,             // $8020 INX
+        0xE0, 0x04,       // $8021 CPX #$04
+        0xD0, 0xDD,       // $8023 BNE $8002
+        0x4C, 0x25, 0x80, // $8025 JMP $8025
+    };
+    const std::vector<Word> table = {0x11, 0x22, 0x33, 0x44, 0x55};
+
+    program.resize(0x42, 0x00);
+    std::copy(loop.begin(), loop.end(), program.begin() + 0x20);
+    std::copy(table.begin(), table.end(), program.begin() + 0x30);
+    // Never reached
+    program[0x40] = 0xEA;
+    program[0x41] = 0xEA;
+
+    std::vector<Word> image = BuildRom(program);
+    TempPath temp("nesemu-tests-coverage");
+    const std::filesystem::path &directory = temp.Get();
+    std::filesystem::create_directories(directory);
+
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom(image.data(), image.size());
+
+    CoverageMap coverage(*nes.GetCartridge());
+    nes.SetCoverageMap(&coverage);
+
+    for (int frame = 0; frame < 3; frame++)
+    {
+        nes.StepFrame();
+    }
+
+    check(coverage.GetSize() == Cartridge::s_PrgBankSize && coverage.GetBankCount() == 2, "one map per 8 KiB bank");
+    check(coverage.GetKind(0x0000) == CoverageMap::Opcode && coverage.GetKind(0x0001) == CoverageMap::Operand,
+          "immediate instruction");
+    check(coverage.GetKind(0x0003) == CoverageMap::Operand && coverage.GetKind(0x0004) == CoverageMap::Operand,
+          "absolute operands are not data");
+    check(coverage.GetKind(0x0020) == CoverageMap::Opcode && coverage.GetKind(0x0024) == CoverageMap::Operand,
+          "indirect jump target executed");
+    check(coverage.GetKind(0x0030) == CoverageMap::Data && coverage.GetKind(0x0033) == CoverageMap::Data,
+          "table read as data");
+    check(coverage.GetKind(0x0034) == CoverageMap::Untouched && coverage.GetKind(0x0040) == CoverageMap::Untouched,
+          "unread bytes untouched");
+    check(coverage.GetAddress(0x0020) == 0x8020 && coverage.GetAddress(0x2000) == 0x0000, "bank windows");
+
+    CoverageMap::Summary summary = coverage.Summarize();
+    check(summary.opcodes == 12 && summary.operands == 17 && summary.data == 4 &&
+              summary.untouched == Cartridge::s_PrgBankSize - 33,
+          "whole rom summary");
+    check(coverage.Summarize(1).untouched == CoverageMap::s_BankSize, "second bank untouched");
+
+    // The pre-decoded instructions skip their fetches yet are covered the same
+    {
+        Nes cached;
+        cached.SetAudioEnabled(false);
+        cached.LoadRom(image.data(), image.size());
+        cached.LoadCodeCache((directory / "cache").string());
+
+        CoverageMap other(*cached.GetCartridge());
+        cached.SetCoverageMap(&other);
+
+        for (int frame = 0; frame < 3; frame++)
+        {
+            cached.StepFrame();
+        }
+
+        bool same = true;
+
+        for (std::size_t offset = 0; offset < coverage.GetSize(); offset++)
+        {
+            same = same && other.GetKind(offset) == coverage.GetKind(offset);
+        }
+
+        check(same, "same coverage with the code cache");
+    }
+
+    std::string path = (directory / "coverage.cdl").string();
+    coverage.SaveCdl(path);
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<Word> cdl((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    check(cdl.size() == Cartridge::s_PrgBankSize + Cartridge::s_ChrBankSize, "cdl covers PRG and CHR");
+    check(cdl.size() > 0x40 && cdl[0x00] == 0x81 && cdl[0x01] == 0x01 && cdl[0x30] == 0x02 && cdl[0x34] == 0x00,
+          "cdl flags");
+
+    CoverageMap loaded(*nes.GetCartridge());
+    loaded.LoadCdl(path);
+    CoverageMap::Summary reloaded = loaded.Summarize();
+    check(reloaded.opcodes == summary.opcodes && reloaded.operands == summary.operands &&
+              reloaded.data == summary.data && loaded.GetAddress(0x0020) == 0x8020,
+          "cdl loaded back");
+
+    // The loop only reached through JMP ($0200) is decoded once the coverage tells where it is
+    {
+        Nes reference;
+        reference.SetAudioEnabled(false);
+        reference.LoadRom(image.data(), image.size());
+
+        Nes seeded;
+        seeded.SetAudioEnabled(false);
+        seeded.LoadRom(image.data(), image.size());
+        seeded.LoadCodeCache((directory / "cache").string(), &loaded);
+
+        const CodeCache &cache = *seeded.GetCodeCache();
+        auto decoded = [&](DWord address) {
+            return cache.Find(seeded.GetMemory().GetReadPage(address >> 8), address);
+        };
+
+        check(decoded(0x8020) && decoded(0x8025) && decoded(0x8000), "covered code decoded");
+        check(!decoded(0x8030) && !decoded(0x8040), "data and untouched bytes not decoded");
+
+        bool identical = true;
+
+        for (int frame = 0; frame < 10; frame++)
+        {
+            reference.StepFrame();
+            seeded.StepFrame();
+            identical = identical && reference.SaveState() == seeded.SaveState();
+        }
+
+        check(identical, "same states as the interpreter");
+    }
+
+    // A 17 bytes sample at $C080 played at the fastest rate, the DMC reads it as data
+    {
+        const std::vector<Word> player = {
+            0xA9, 0x0F,       // $8000 LDA #$0F
+            0x8D, 0x10, 0x40, // $8002 STA $4010
+            0xA9, 0x02,       // $8005 LDA #$02
+            0x8D, 0x12, 0x40, // $8007 STA $4012
+            0xA9, 0x01,       // $800A LDA #$01
+            0x8D, 0x13, 0x40, // $800C STA $4013
+            0xA9, 0x10,       // $800F LDA #$10
+            0x8D, 0x15, 0x40, // $8011 STA $4015
+            0x4C, 0x14, 0x80, // $8014 JMP $8014
+        };
+        std::vector<Word> sampled = BuildRom(player);
+
+        Nes dmc;
+        dmc.SetAudioEnabled(false);
+        dmc.LoadRom(sampled.data(), sampled.size());
+
+        CoverageMap samples(*dmc.GetCartridge());
+        dmc.SetCoverageMap(&samples);
+        dmc.StepFrame();
+        dmc.StepFrame();
+
+        check(samples.GetKind(0x0080) == CoverageMap::Data && samples.GetKind(0x0090) == CoverageMap::Data &&
+                  samples.GetKind(0x0091) == CoverageMap::Untouched,
+              "DMC sample fetches read as data");
+    }
+
+    coverage.Report(std::cout);
+    return check.Report();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string command = argc > 1 ? argv[1] : "builtin";
+
+    try
+    {
+        if (command == "builtin")
+        {
+            return RunBuiltin();
+        }
+        if (command == "nestest" && argc == 4)
+        {
+            return RunNestest(argv[2], argv[3]);
+        }
+        if (command == "blargg" && argc == 3)
+        {
+            return RunBlargg(argv[2]);
+        }
+        if (command == "debugger")
+        {
+            return RunDebugger();
+        }
+        if (command == "cheats")
+        {
+            return RunCheats();
+        }
+        if (command == "saves")
+        {
+            return RunSaves();
+        }
+        if (command == "rollback" && (argc == 2 || (argc == 3 && std::string(argv[2]) == "--timing")))
+        {
+            return RunRollback(argc == 3);
+        }
+        if (command == "codecache")
+        {
+            return RunCodeCache();
+        }
+        if (command == "interrupts")
+        {
+            return RunInterrupts();
+        }
+        if (command == "profiler")
+        {
+            return RunProfiler();
+        }
+        if (command == "movie")
+        {
+            return RunMovie();
+        }
+        if (command == "coverage")
+        {
+            return RunCoverage();
+        }
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "usage: nesemu-tests [builtin | nestest <rom> <log> | blargg <rom> | debugger | cheats | saves |\n"
+                 "                     rollback [--timing] | codecache | interrupts | profiler | movie | coverage]"
+              << std::endl;
+    return 2;
+}
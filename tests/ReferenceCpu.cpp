@@ -0,0 +1,488 @@
+#include "ReferenceCpu.hpp"
+
+ReferenceCpu::ReferenceCpu(Bus &bus)
+    : m_Bus(bus), m_Cycles(0), m_PC(0x0000), m_SP(0xFD), m_A(0x00), m_X(0x00), m_Y(0x00), m_C(false), m_Z(false),
+      m_I(true), m_D(false), m_V(false), m_N(false)
+{
+}
+
+bool ReferenceCpu::IsSupported(Word opcode)
+{
+    switch (opcode)
+    {
+    // Jams
+    case 0x02: case 0x12: case 0x22: case 0x32: case 0x42: case 0x52:
+    case 0x62: case 0x72: case 0x92: case 0xB2: case 0xD2: case 0xF2:
+    // Immediate combined operations (ANC, ALR, ARR, XAA, LAX, AXS)
+    case 0x0B: case 0x2B: case 0x4B: case 0x6B: case 0x8B: case 0xAB: case 0xCB:
+    // Unstable stores and loads (AHX, TAS, SHY, SHX, LAS)
+    case 0x93: case 0x9F: case 0x9B: case 0x9C: case 0x9E: case 0xBB:
+        return false;
+    default:
+        return true;
+    }
+}
+
+Cpu::Registers ReferenceCpu::GetRegisters() const
+{
+    Word p = m_C | m_Z << 1 | m_I << 2 | m_D << 3 | 1 << 5 | m_V << 6 | m_N << 7;
+    return {m_PC, m_SP, m_A, m_X, m_Y, p};
+}
+
+void ReferenceCpu::SetRegisters(const Cpu::Registers &registers)
+{
+    m_PC = registers.PC;
+    m_SP = registers.SP;
+    m_A = registers.A;
+    m_X = registers.X;
+    m_Y = registers.Y;
+    SetStatus(registers.P);
+}
+
+void ReferenceCpu::SetStatus(Word status)
+{
+    m_C = status & 0x01;
+    m_Z = status & 0x02;
+    m_I = status & 0x04;
+    m_D = status & 0x08;
+    m_V = status & 0x40;
+    m_N = status & 0x80;
+}
+
+ReferenceCpu::Mode ReferenceCpu::DecodeMode(Word opcode)
+{
+    // aaabbbcc: cc selects the group, bbb the addressing mode within it
+    int a = opcode >> 5;
+    int b = (opcode >> 2) & 0x07;
+    int c = opcode & 0x03;
+    // LDX, STX, LAX and SAX index with Y instead of X
+    bool indexY = c >= 2 && (a == 4 || a == 5);
+
+    switch (b)
+    {
+    case 0:
+        if (c & 0x01)
+        {
+            return Mode::IndirectX;
+        }
+        return c == 0 && a < 4 ? Mode::Implied : Mode::Immediate;
+    case 1:
+        return Mode::ZeroPage;
+    case 2:
+        return c & 0x01 ? Mode::Immediate : Mode::Implied;
+    case 3:
+        return Mode::Absolute;
+    case 4:
+        return c & 0x01 ? Mode::IndirectY : Mode::Implied;
+    case 5:
+        return indexY ? Mode::ZeroPageY : Mode::ZeroPageX;
+    case 6:
+        return c & 0x01 ? Mode::AbsoluteY : Mode::Implied;
+    default:
+        return indexY ? Mode::AbsoluteY : Mode::AbsoluteX;
+    }
+}
+
+Word ReferenceCpu::Read(DWord address)
+{
+    m_Cycles++;
+    return m_Bus.Read(address);
+}
+
+void ReferenceCpu::Write(DWord address, Word value)
+{
+    m_Cycles++;
+    m_Bus.Write(address, value, false);
+}
+
+void ReferenceCpu::DummyWrite(DWord address, Word value)
+{
+    m_Cycles++;
+    m_Bus.Write(address, value, true);
+}
+
+Word ReferenceCpu::Fetch()
+{
+    return Read(m_PC++);
+}
+
+void ReferenceCpu::Push(Word value)
+{
+    Write(0x0100 | m_SP--, value);
+}
+
+Word ReferenceCpu::Pull()
+{
+    return Read(0x0100 | ++m_SP);
+}
+
+DWord ReferenceCpu::Address(Mode mode, Access access)
+{
+    DWord base = 0;
+    Word index = 0;
+
+    switch (mode)
+    {
+    case Mode::Implied:
+        return 0;
+    case Mode::Immediate:
+        return m_PC++;
+    case Mode::ZeroPage:
+        return Fetch();
+    case Mode::ZeroPageX:
+    case Mode::ZeroPageY: {
+        Word zero = Fetch();
+        Read(zero);
+        return (zero + (mode == Mode::ZeroPageX ? m_X : m_Y)) & 0xFF;
+    }
+    case Mode::Absolute: {
+        Word lo = Fetch();
+        return Fetch() << 8 | lo;
+    }
+    case Mode::IndirectX: {
+        Word zero = Fetch();
+        Read(zero);
+        zero += m_X;
+        Word lo = Read(zero);
+        return Read((zero + 1) & 0xFF) << 8 | lo;
+    }
+    case Mode::AbsoluteX:
+    case Mode::AbsoluteY: {
+        Word lo = Fetch();
+        base = Fetch() << 8 | lo;
+        index = mode == Mode::AbsoluteX ? m_X : m_Y;
+        break;
+    }
+    case Mode::IndirectY: {
+        Word zero = Fetch();
+        Word lo = Read(zero);
+        base = Read((zero + 1) & 0xFF) << 8 | lo;
+        index = m_Y;
+        break;
+    }
+    }
+
+    // The low byte is added first, the cpu reads from the unfixed address
+    // before the carry reaches the high byte. Only reads skip it when no
+    // carry is needed
+    DWord address = (base + index) & 0xFFFF;
+
+    if (access != Access::Read || (address & 0xFF00) != (base & 0xFF00))
+    {
+        Read((base & 0xFF00) | (address & 0x00FF));
+    }
+
+    return address;
+}
+
+void ReferenceCpu::SetNZ(Word value)
+{
+    m_Z = value == 0;
+    m_N = value & 0x80;
+}
+
+Word ReferenceCpu::Add(Word operand)
+{
+    unsigned sum = m_A + operand + m_C;
+    Word result = sum & 0xFF;
+
+    m_C = sum > 0xFF;
+    m_V = (m_A ^ result) & (operand ^ result) & 0x80;
+    SetNZ(result);
+    return result;
+}
+
+void ReferenceCpu::Compare(Word reg, Word operand)
+{
+    m_C = reg >= operand;
+    SetNZ(reg - operand);
+}
+
+void ReferenceCpu::Branch(bool condition)
+{
+    std::int8_t offset = static_cast<std::int8_t>(Fetch());
+
+    if (!condition)
+    {
+        return;
+    }
+
+    Read(m_PC);
+    DWord target = (m_PC + offset) & 0xFFFF;
+
+    if ((target & 0xFF00) != (m_PC & 0xFF00))
+    {
+        Read((m_PC & 0xFF00) | (target & 0x00FF));
+    }
+
+    m_PC = target;
+}
+
+QWord ReferenceCpu::Step()
+{
+    if (!IsSupported(m_Bus.Read(m_PC)))
+    {
+        return 0;
+    }
+
+    m_Cycles = 0;
+    Word opcode = Fetch();
+    Mode mode = DecodeMode(opcode);
+
+    auto load = [&]() { return Read(Address(mode, Access::Read)); };
+    auto store = [&](Word value) { Write(Address(mode, Access::Write), value); };
+    // Read-modify-write, the unmodified value is written back first
+    auto modify = [&](auto operation) {
+        if (mode == Mode::Implied)
+        {
+            Read(m_PC);
+            m_A = operation(m_A);
+            return m_A;
+        }
+
+        DWord address = Address(mode, Access::Modify);
+        Word value = Read(address);
+        DummyWrite(address, value);
+        value = operation(value);
+        Write(address, value);
+        return value;
+    };
+    auto implied = [&]() { Read(m_PC); };
+
+    auto asl = [&](Word value) {
+        m_C = value & 0x80;
+        SetNZ(value << 1);
+        return static_cast<Word>(value << 1);
+    };
+    auto rol = [&](Word value) {
+        Word result = static_cast<Word>(value << 1 | m_C);
+        m_C = value & 0x80;
+        SetNZ(result);
+        return result;
+    };
+    auto lsr = [&](Word value) {
+        m_C = value & 0x01;
+        SetNZ(value >> 1);
+        return static_cast<Word>(value >> 1);
+    };
+    auto ror = [&](Word value) {
+        Word result = static_cast<Word>(value >> 1 | m_C << 7);
+        m_C = value & 0x01;
+        SetNZ(result);
+        return result;
+    };
+    auto inc = [&](Word value) {
+        SetNZ(value + 1);
+        return static_cast<Word>(value + 1);
+    };
+    auto dec = [&](Word value) {
+        SetNZ(value - 1);
+        return static_cast<Word>(value - 1);
+    };
+
+    switch (opcode)
+    {
+    case 0x01: case 0x05: case 0x09: case 0x0D: case 0x11: case 0x15: case 0x19: case 0x1D:
+        SetNZ(m_A |= load());
+        break;
+    case 0x21: case 0x25: case 0x29: case 0x2D: case 0x31: case 0x35: case 0x39: case 0x3D:
+        SetNZ(m_A &= load());
+        break;
+    case 0x41: case 0x45: case 0x49: case 0x4D: case 0x51: case 0x55: case 0x59: case 0x5D:
+        SetNZ(m_A ^= load());
+        break;
+    case 0x61: case 0x65: case 0x69: case 0x6D: case 0x71: case 0x75: case 0x79: case 0x7D:
+        m_A = Add(load());
+        break;
+    case 0xE1: case 0xE5: case 0xE9: case 0xEB: case 0xED: case 0xF1: case 0xF5: case 0xF9: case 0xFD:
+        m_A = Add(~load());
+        break;
+    case 0xC1: case 0xC5: case 0xC9: case 0xCD: case 0xD1: case 0xD5: case 0xD9: case 0xDD:
+        Compare(m_A, load());
+        break;
+    case 0xE0: case 0xE4: case 0xEC:
+        Compare(m_X, load());
+        break;
+    case 0xC0: case 0xC4: case 0xCC:
+        Compare(m_Y, load());
+        break;
+    case 0x24: case 0x2C: {
+        Word value = load();
+        m_Z = (m_A & value) == 0;
+        m_V = value & 0x40;
+        m_N = value & 0x80;
+        break;
+    }
+
+    case 0xA1: case 0xA5: case 0xA9: case 0xAD: case 0xB1: case 0xB5: case 0xB9: case 0xBD:
+        SetNZ(m_A = load());
+        break;
+    case 0xA2: case 0xA6: case 0xAE: case 0xB6: case 0xBE:
+        SetNZ(m_X = load());
+        break;
+    case 0xA0: case 0xA4: case 0xAC: case 0xB4: case 0xBC:
+        SetNZ(m_Y = load());
+        break;
+    case 0xA3: case 0xA7: case 0xAF: case 0xB3: case 0xB7: case 0xBF:
+        SetNZ(m_A = m_X = load());
+        break;
+
+    case 0x81: case 0x85: case 0x8D: case 0x91: case 0x95: case 0x99: case 0x9D:
+        store(m_A);
+        break;
+    case 0x86: case 0x8E: case 0x96:
+        store(m_X);
+        break;
+    case 0x84: case 0x8C: case 0x94:
+        store(m_Y);
+        break;
+    case 0x83: case 0x87: case 0x8F: case 0x97:
+        store(m_A & m_X);
+        break;
+
+    case 0x06: case 0x0A: case 0x0E: case 0x16: case 0x1E:
+        modify(asl);
+        break;
+    case 0x26: case 0x2A: case 0x2E: case 0x36: case 0x3E:
+        modify(rol);
+        break;
+    case 0x46: case 0x4A: case 0x4E: case 0x56: case 0x5E:
+        modify(lsr);
+        break;
+    case 0x66: case 0x6A: case 0x6E: case 0x76: case 0x7E:
+        modify(ror);
+        break;
+    case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+        modify(inc);
+        break;
+    case 0xC6: case 0xCE: case 0xD6: case 0xDE:
+        modify(dec);
+        break;
+
+    case 0x03: case 0x07: case 0x0F: case 0x13: case 0x17: case 0x1B: case 0x1F:
+        SetNZ(m_A |= modify(asl));
+        break;
+    case 0x23: case 0x27: case 0x2F: case 0x33: case 0x37: case 0x3B: case 0x3F:
+        SetNZ(m_A &= modify(rol));
+        break;
+    case 0x43: case 0x47: case 0x4F: case 0x53: case 0x57: case 0x5B: case 0x5F:
+        SetNZ(m_A ^= modify(lsr));
+        break;
+    case 0x63: case 0x67: case 0x6F: case 0x73: case 0x77: case 0x7B: case 0x7F:
+        m_A = Add(modify(ror));
+        break;
+    case 0xC3: case 0xC7: case 0xCF: case 0xD3: case 0xD7: case 0xDB: case 0xDF:
+        Compare(m_A, modify([](Word value) { return static_cast<Word>(value - 1); }));
+        break;
+    case 0xE3: case 0xE7: case 0xEF: case 0xF3: case 0xF7: case 0xFB: case 0xFF:
+        m_A = Add(~modify([](Word value) { return static_cast<Word>(value + 1); }));
+        break;
+
+    case 0x10: Branch(!m_N); break;
+    case 0x30: Branch(m_N); break;
+    case 0x50: Branch(!m_V); break;
+    case 0x70: Branch(m_V); break;
+    case 0x90: Branch(!m_C); break;
+    case 0xB0: Branch(m_C); break;
+    case 0xD0: Branch(!m_Z); break;
+    case 0xF0: Branch(m_Z); break;
+
+    case 0x18: implied(); m_C = false; break;
+    case 0x38: implied(); m_C = true; break;
+    case 0x58: implied(); m_I = false; break;
+    case 0x78: implied(); m_I = true; break;
+    case 0xB8: implied(); m_V = false; break;
+    case 0xD8: implied(); m_D = false; break;
+    case 0xF8: implied(); m_D = true; break;
+
+    case 0xAA: implied(); SetNZ(m_X = m_A); break;
+    case 0xA8: implied(); SetNZ(m_Y = m_A); break;
+    case 0xBA: implied(); SetNZ(m_X = m_SP); break;
+    case 0x8A: implied(); SetNZ(m_A = m_X); break;
+    case 0x98: implied(); SetNZ(m_A = m_Y); break;
+    case 0x9A: implied(); m_SP = m_X; break;
+    case 0xE8: implied(); SetNZ(++m_X); break;
+    case 0xC8: implied(); SetNZ(++m_Y); break;
+    case 0xCA: implied(); SetNZ(--m_X); break;
+    case 0x88: implied(); SetNZ(--m_Y); break;
+
+    case 0xEA: case 0x1A: case 0x3A: case 0x5A: case 0x7A: case 0xDA: case 0xFA:
+        implied();
+        break;
+    case 0x80: case 0x82: case 0x89: case 0xC2: case 0xE2:
+    case 0x04: case 0x44: case 0x64: case 0x14: case 0x34: case 0x54: case 0x74: case 0xD4: case 0xF4:
+    case 0x0C: case 0x1C: case 0x3C: case 0x5C: case 0x7C: case 0xDC: case 0xFC:
+        load();
+        break;
+
+    case 0x48:
+        implied();
+        Push(m_A);
+        break;
+    case 0x08:
+        implied();
+        // B and the unused bit only exist on the stack
+        Push(GetRegisters().P | 0x10);
+        break;
+    case 0x68:
+        implied();
+        Read(0x0100 | m_SP);
+        SetNZ(m_A = Pull());
+        break;
+    case 0x28:
+        implied();
+        Read(0x0100 | m_SP);
+        SetStatus(Pull());
+        break;
+
+    case 0x00: {
+        Fetch();
+        Push(m_PC >> 8);
+        Push(m_PC & 0xFF);
+        Push(GetRegisters().P | 0x10);
+        m_I = true;
+        Word lo = Read(0xFFFE);
+        m_PC = Read(0xFFFF) << 8 | lo;
+        break;
+    }
+    case 0x20: {
+        Word lo = Fetch();
+        Read(0x0100 | m_SP);
+        Push(m_PC >> 8);
+        Push(m_PC & 0xFF);
+        m_PC = Fetch() << 8 | lo;
+        break;
+    }
+    case 0x40: {
+        implied();
+        Read(0x0100 | m_SP);
+        SetStatus(Pull());
+        Word lo = Pull();
+        m_PC = Pull() << 8 | lo;
+        break;
+    }
+    case 0x60: {
+        implied();
+        Read(0x0100 | m_SP);
+        Word lo = Pull();
+        m_PC = Pull() << 8 | lo;
+        Read(m_PC++);
+        break;
+    }
+    case 0x4C: {
+        Word lo = Fetch();
+        m_PC = Fetch() << 8 | lo;
+        break;
+    }
+    case 0x6C: {
+        Word lo = Fetch();
+        DWord pointer = Fetch() << 8 | lo;
+        lo = Read(pointer);
+        // The pointer high byte never carries
+        m_PC = Read((pointer & 0xFF00) | ((pointer + 1) & 0x00FF)) << 8 | lo;
+        break;
+    }
+    }
+
+    return m_Cycles;
+}
@@ -0,0 +1,91 @@
+#ifndef REFERENCECPU_HPP
+#define REFERENCECPU_HPP
+
+#include "src/MemoryMap.hpp"
+#include "src/Types.hpp"
+#include "src/Cpu/Cpu.hpp"
+#include <cstdint>
+
+/*
+   Reference 6502 model for the differential tests
+
+   Written independently from Cpu: the addressing mode comes from the bit
+   fields of the opcode and every bus cycle of the real chip is performed,
+   dummy reads and the first write of read-modify-write instructions
+   included, so the cycle count of an instruction is the number of
+   accesses rather than an entry of a table. Dummy accesses are flagged
+   to the handler, they never change the state of a flat memory.
+   Only the opcodes that Cpu implements are supported
+ */
+class ReferenceCpu
+{
+public:
+    class Bus
+    {
+    public:
+        virtual ~Bus() = default;
+
+        virtual Word Read(DWord address) = 0;
+        virtual void Write(DWord address, Word value, bool dummy) = 0;
+    };
+
+    ReferenceCpu(Bus &bus);
+
+    // Execute the instruction at PC, returns its cycles or 0 for an unsupported opcode
+    QWord Step();
+    static bool IsSupported(Word opcode);
+
+    Cpu::Registers GetRegisters() const;
+    void SetRegisters(const Cpu::Registers &registers);
+
+private:
+    enum class Mode
+    {
+        Implied,
+        Immediate,
+        ZeroPage,
+        ZeroPageX,
+        ZeroPageY,
+        Absolute,
+        AbsoluteX,
+        AbsoluteY,
+        IndirectX,
+        IndirectY,
+    };
+
+    enum class Access
+    {
+        Read,
+        Write,
+        Modify,
+    };
+
+    static Mode DecodeMode(Word opcode);
+
+    Word Read(DWord address);
+    void Write(DWord address, Word value);
+    void DummyWrite(DWord address, Word value);
+    Word Fetch();
+    void Push(Word value);
+    Word Pull();
+
+    // Effective address of the operand, performing the bus cycles of the mode
+    DWord Address(Mode mode, Access access);
+    void SetStatus(Word status);
+    void SetNZ(Word value);
+    Word Add(Word operand);
+    void Compare(Word reg, Word operand);
+    void Branch(bool condition);
+
+    Bus &m_Bus;
+    QWord m_Cycles;
+
+    DWord m_PC;
+    Word m_SP;
+    Word m_A;
+    Word m_X;
+    Word m_Y;
+    bool m_C, m_Z, m_I, m_D, m_V, m_N;
+};
+
+#endif
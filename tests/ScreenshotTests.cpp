@@ -0,0 +1,512 @@
+/*
+   Screenshot regression runner
+
+   nesemu-screenshot-tests <cases> [--jobs N] [--output directory] [--update]
+   nesemu-screenshot-tests selftest
+
+   Every line of the case file is `rom [movie] frame:hash...`, paths
+   relative to the case file and # starting a comment. The rom runs with
+   the inputs of the movie, if any, and the frame buffer is hashed once
+   the given frames completed (the first StepFrame completes frame 1).
+   Only the captured frames are drawn, skipped frames emulate the same.
+   The cases run in parallel, one per core unless --jobs says otherwise.
+
+   A frame whose hash differs from the golden one is written as a PNG into
+   the output directory (screenshot-failures by default), nothing is
+   written for the others. A hash of - is not known yet, --update writes
+   the hashes obtained back into the case file instead of comparing them.
+
+   selftest runs the whole cycle on a built-in rom. Exits with 0 on
+   success, 1 on mismatches or errors and 77 when the case file is
+   missing so CTest reports the test as skipped
+ */
+
+#include "TestRom.hpp"
+#include "src/Cartridge.hpp"
+#include "src/Movie.hpp"
+#include "src/Nes.hpp"
+#include "src/Dump/PngWriter.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <process.h>
+#define NES_GETPID _getpid
+#else
+#include <unistd.h>
+#define NES_GETPID ::getpid
+#endif
+
+namespace
+{
+constexpr int ExitSkipped = 77;
+
+struct Capture
+{
+    long frame;
+    std::optional<std::uint64_t> golden;
+    std::uint64_t actual = 0;
+    // Written when the hash mismatches
+    std::string png;
+};
+
+struct Case
+{
+    // Line of the case file, rewritten by --update
+    std::size_t line;
+    std::string rom;
+    std::string movie;
+    std::vector<Capture> captures;
+    std::string error;
+};
+
+struct Suite
+{
+    std::filesystem::path directory;
+    std::vector<std::string> lines;
+    std::vector<Case> cases;
+};
+
+std::string FormatHash(std::uint64_t hash)
+{
+    char text[17];
+    std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+// 64 bits FNV-1a of the pixels
+std::uint64_t HashFrame(const QWord *pixels)
+{
+    std::uint64_t hash = 0xCBF29CE484222325;
+    const Word *bytes = reinterpret_cast<const Word *>(pixels);
+
+    for (std::size_t i = 0; i < sizeof(QWord) * Nes::s_Width * Nes::s_Height; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+Suite LoadSuite(const std::string &path)
+{
+    std::ifstream file(path);
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not open '" + path + "'");
+    }
+
+    Suite suite;
+    suite.directory = std::filesystem::path(path).parent_path();
+    std::string line;
+
+    while (std::getline(file, line))
+    {
+        suite.lines.push_back(line);
+        std::stringstream stream(line.substr(0, line.find('#')));
+        std::string token;
+        Case test{suite.lines.size() - 1, {}, {}, {}, {}};
+
+        while (stream >> token)
+        {
+            std::size_t colon = token.find(':');
+
+            if (test.rom.empty())
+            {
+                test.rom = token;
+            }
+            else if (colon == std::string::npos)
+            {
+                test.movie = token;
+            }
+            else
+            {
+                Capture capture{std::strtol(token.c_str(), nullptr, 10), std::nullopt, 0, std::string()};
+                std::string hash = token.substr(colon + 1);
+
+                if (capture.frame <= 0)
+                {
+                    throw std::runtime_error(path + ":" + std::to_string(suite.lines.size()) + ": invalid capture '" +
+                                             token + "'");
+                }
+                if (hash != "-")
+                {
+                    capture.golden = std::strtoull(hash.c_str(), nullptr, 16);
+                }
+
+                test.captures.push_back(capture);
+            }
+        }
+
+        if (!test.rom.empty())
+        {
+            std::sort(test.captures.begin(), test.captures.end(),
+                      [](const Capture &a, const Capture &b) { return a.frame < b.frame; });
+            suite.cases.push_back(std::move(test));
+        }
+    }
+
+    return suite;
+}
+
+void SaveSuite(const std::string &path, const Suite &suite)
+{
+    std::vector<std::string> lines = suite.lines;
+
+    for (const Case &test : suite.cases)
+    {
+        std::string line = test.rom;
+
+        if (!test.movie.empty())
+        {
+            line += " " + test.movie;
+        }
+
+        for (const Capture &capture : test.captures)
+        {
+            line += " " + std::to_string(capture.frame) + ":" + FormatHash(capture.actual);
+        }
+
+        // A trailing comment is kept
+        std::size_t comment = lines[test.line].find('#');
+        lines[test.line] = comment == std::string::npos ? line : line + " " + lines[test.line].substr(comment);
+    }
+
+    std::ofstream file(path);
+
+    for (const std::string &line : lines)
+    {
+        file << line << "\n";
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Could not write '" + path + "'");
+    }
+}
+
+struct Options
+{
+    unsigned jobs;
+    std::string output;
+    bool update;
+};
+
+void RunCase(Case &test, const std::filesystem::path &directory, const Options &options)
+{
+    Nes nes;
+    nes.SetAudioEnabled(false);
+    nes.LoadRom((directory / test.rom).string());
+
+    std::optional<Movie> movie;
+
+    if (!test.movie.empty())
+    {
+        movie = Movie::Load((directory / test.movie).string());
+    }
+
+    long frame = 0;
+
+    for (Capture &capture : test.captures)
+    {
+        while (frame < capture.frame)
+        {
+            if (movie)
+            {
+                movie->Apply(nes, frame);
+            }
+
+            // The frames in between are emulated the same without being drawn
+            nes.SetRenderFrame(frame + 1 == capture.frame);
+            nes.StepFrame();
+            frame++;
+        }
+
+        capture.actual = HashFrame(nes.GetFrameBuffer());
+
+        if (!options.update && capture.golden != capture.actual)
+        {
+            std::string name = std::filesystem::path(test.rom).stem().string() + "-" + std::to_string(test.line + 1) +
+                               "-" + std::to_string(capture.frame) + ".png";
+            capture.png = (std::filesystem::path(options.output) / name).string();
+
+            std::filesystem::create_directories(options.output);
+            WritePng(capture.png, nes.GetFrameBuffer(), Nes::s_Width, Nes::s_Height);
+        }
+    }
+}
+
+// Returns the amount of mismatching frames, a case which could not run counts as one
+int RunSuite(Suite &suite, const Options &options)
+{
+    auto start = std::chrono::steady_clock::now();
+    unsigned jobs = std::max(1u, options.jobs);
+    std::atomic<std::size_t> next{0};
+    std::vector<std::thread> workers;
+
+    for (unsigned job = 0; job < jobs; job++)
+    {
+        workers.emplace_back([&suite, &next, &options] {
+            for (std::size_t index = next++; index < suite.cases.size(); index = next++)
+            {
+                try
+                {
+                    RunCase(suite.cases[index], suite.directory, options);
+                }
+                catch (const std::exception &error)
+                {
+                    suite.cases[index].error = error.what();
+                }
+            }
+        });
+    }
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+
+    int failures = 0;
+    std::size_t captures = 0;
+
+    for (const Case &test : suite.cases)
+    {
+        if (!test.error.empty())
+        {
+            std::cout << "ERROR line " << test.line + 1 << " " << test.rom << ": " << test.error << std::endl;
+            failures++;
+            continue;
+        }
+
+        for (const Capture &capture : test.captures)
+        {
+            captures++;
+
+            if (!capture.png.empty())
+            {
+                std::cout << "FAIL line " << test.line + 1 << " " << test.rom << " frame " << capture.frame
+                          << ": expected " << (capture.golden ? FormatHash(*capture.golden) : "-") << " got "
+                          << FormatHash(capture.actual) << ", written to " << capture.png << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu cases, %zu frames, %d failures in %.2f s on %u jobs\n", suite.cases.size(), captures, failures,
+                seconds, jobs);
+    return failures;
+}
+
+int Run(const std::string &path, const Options &options)
+{
+    if (!std::filesystem::exists(path))
+    {
+        std::cout << "'" << path << "' not found, skipped" << std::endl;
+        return ExitSkipped;
+    }
+
+    Suite suite = LoadSuite(path);
+    int failures = RunSuite(suite, options);
+
+    if (options.update)
+    {
+        SaveSuite(path, suite);
+        std::cout << "golden hashes written to " << path << std::endl;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+// NROM image filling the screen with a striped tile, the background color cycling every 16 frames
+std::vector<Word> BuildSelftestRom()
+{
+    const std::vector<Word> program = {
+        0xA9, 0x3F,       // $8000 LDA #$3F
+        0x8D, 0x06, 0x20, // $8002 STA $2006
+        0xA9, 0x01,       // $8005 LDA #$01
+        0x8D, 0x06, 0x20, // $8007 STA $2006
+        0xA9, 0x16,       // $800A LDA #$16
+        0x8D, 0x07, 0x20, // $800C STA $2007
+        0xA9, 0x2A,       // $800F LDA #$2A
+        0x8D, 0x07, 0x20, // $8011 STA $2007
+        0xA9, 0x12,       // $8014 LDA #$12
+        0x8D, 0x07, 0x20, // $8016 STA $2007
+        0xA9, 0x80,       // $8019 LDA #$80
+        0x8D, 0x00, 0x20, // $801B STA $2000
+        0x4C, 0x1E, 0x80, // $801E JMP $801E
+        // NMI: background color from the frame counter, then the scroll back to 0
+        0xE6, 0x00,       // $8021 INC $00
+        0xA5, 0x00,       // $8023 LDA $00
+        0x4A,             // $8025 LSR A
+        0x4A,             // $8026 LSR A
+        0x4A,             // $8027 LSR A
+        0x4A,             // $8028 LSR A
+        0xA2, 0x3F,       // $8029 LDX #$3F
+        0x8E, 0x06, 0x20, // $802B STX $2006
+        0xA2, 0x00,       // $802E LDX #$00
+        0x8E, 0x06, 0x20, // $8030 STX $2006
+        0x8D, 0x07, 0x20, // $8033 STA $2007
+        0x8E, 0x06, 0x20, // $8036 STX $2006
+        0x8E, 0x06, 0x20, // $8039 STX $2006
+        0xA9, 0x0A,       // $803C LDA #$0A
+        0x8D, 0x01, 0x20, // $803E STA $2001
+        0x40,             // $8041 RTI
+    };
+
+    // Tile 0 in three colors
+    const std::vector<Word> planes = {0xF0, 0xF0, 0x0F, 0x0F, 0xF0, 0xF0, 0x0F, 0x0F,
+                                      0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF, 0x00, 0x00};
+    return BuildRom(program, false, 0x8021, planes);
+}
+
+bool HasPngSignature(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char signature[8] = {};
+    file.read(signature, sizeof(signature));
+    return std::memcmp(signature, "\x89PNG\r\n\x1A\n", sizeof(signature)) == 0;
+}
+
+int RunSelftest(unsigned jobs)
+{
+    int failures = 0;
+    auto check = [&failures](bool condition, const std::string &what) {
+        if (!condition)
+        {
+            std::cout << "FAIL " << what << std::endl;
+            failures++;
+        }
+    };
+
+    // Named after the process so that concurrent runs do not share it
+    std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / ("nesemu-screenshot-selftest-" + std::to_string(NES_GETPID()));
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    std::vector<Word> image = BuildSelftestRom();
+    std::ofstream((directory / "selftest.nes").string(), std::ios::binary)
+        .write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+
+    // The same case many times over, the parallel runs must agree
+    std::string path = (directory / "cases.txt").string();
+    {
+        std::ofstream cases(path);
+        cases << "# built-in cases\n";
+
+        for (int i = 0; i < 8; i++)
+        {
+            cases << "selftest.nes 8:- 40:- 40:- 90:- # copy " << i << "\n";
+        }
+    }
+
+    // At least a few jobs, whatever the core count
+    Options options{std::max(4u, jobs), (directory / "failures").string(), true};
+    check(Run(path, options) == 0, "hashes recorded");
+    check(!std::filesystem::exists(options.output), "no png written while updating");
+
+    Suite suite = LoadSuite(path);
+    check(suite.cases.size() == 8 && suite.lines.front() == "# built-in cases", "case file rewritten");
+
+    for (const Case &test : suite.cases)
+    {
+        for (std::size_t i = 0; i < test.captures.size(); i++)
+        {
+            check(test.captures[i].golden == suite.cases[0].captures[i].golden, "identical hashes across the jobs");
+        }
+    }
+
+    const std::vector<Capture> &captures = suite.cases[0].captures;
+    check(captures[0].golden != captures[1].golden && captures[1].golden == captures[2].golden &&
+              captures[2].golden != captures[3].golden,
+          "distinct frames hash differently");
+
+    options.update = false;
+    check(Run(path, options) == 0 && !std::filesystem::exists(options.output), "golden hashes pass without output");
+
+    // Break the second case's last frame
+    {
+        std::vector<std::string> lines = suite.lines;
+        std::size_t colon = lines[2].rfind(":");
+        lines[2].replace(colon + 1, 16, "0123456789abcdef");
+        std::ofstream cases(path);
+
+        for (const std::string &line : lines)
+        {
+            cases << line << "\n";
+        }
+    }
+
+    check(Run(path, options) == 1, "mismatch detected");
+    std::filesystem::path png = std::filesystem::path(options.output) / "selftest-3-90.png";
+    check(HasPngSignature(png), "png of the mismatch written");
+    std::filesystem::directory_iterator written(options.output);
+    check(std::distance(written, std::filesystem::directory_iterator()) == 1, "only the mismatch written");
+    check(std::filesystem::file_size(png) > Nes::s_Width * Nes::s_Height * 3, "png holds the whole frame");
+
+    std::filesystem::remove_all(directory);
+
+    std::cout << (failures == 0 ? "screenshot checks passed" : "screenshot checks failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: nesemu-screenshot-tests <cases> [--jobs N] [--output directory] [--update] | selftest"
+                  << std::endl;
+        return 2;
+    }
+
+    Options options{std::max(1u, std::thread::hardware_concurrency()), "screenshot-failures", false};
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::string option = argv[i];
+
+        if (option == "--jobs" && i + 1 < argc)
+        {
+            options.jobs = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if (option == "--output" && i + 1 < argc)
+        {
+            options.output = argv[++i];
+        }
+        else if (option == "--update")
+        {
+            options.update = true;
+        }
+    }
+
+    try
+    {
+        if (std::string(argv[1]) == "selftest")
+        {
+            return RunSelftest(options.jobs);
+        }
+
+        return Run(argv[1], options);
+    }
+    catch (const std::exception &error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+}
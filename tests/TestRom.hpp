@@ -0,0 +1,37 @@
+#ifndef TESTROM_HPP
+#define TESTROM_HPP
+
+#include "src/Cartridge.hpp"
+#include "src/Types.hpp"
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+// RTI at the end of the PRG ROM, the default NMI handler and the IRQ handler of the test roms
+constexpr DWord TestRomRti = 0xBFF9;
+
+/*
+   16 KiB NROM image running the given program from $8000, with an 8 KiB
+   CHR ROM starting with the given bytes. The IRQ vector points to an RTI
+   at TestRomRti, as does the NMI vector unless a handler is given
+ */
+inline std::vector<Word> BuildRom(const std::vector<Word> &program, bool battery = false, DWord nmi = TestRomRti,
+                                  const std::vector<Word> &chr = {})
+{
+    std::vector<Word> image = {'N', 'E', 'S', 0x1A, 0x01, 0x01, Word(battery ? 0x02 : 0x00), 0x00};
+    image.resize(16 + Cartridge::s_PrgBankSize + Cartridge::s_ChrBankSize, 0x00);
+
+    Word *prg = &image[16];
+    std::copy(program.begin(), program.end(), prg);
+    prg[TestRomRti - 0x8000] = 0x40;
+
+    const Word vectors[] = {
+        Word(nmi & 0xFF), Word(nmi >> 8), 0x00, 0x80, Word(TestRomRti & 0xFF), Word(TestRomRti >> 8),
+    };
+    std::copy(std::begin(vectors), std::end(vectors), prg + 0x3FFA);
+
+    std::copy(chr.begin(), chr.end(), prg + Cartridge::s_PrgBankSize);
+    return image;
+}
+
+#endif